@@ -0,0 +1,32 @@
+use divan::AllocProfiler;
+use rama::service::layer::limit::policy::{
+    ConcurrentCounter, ConcurrentTracker, ShardedConcurrentCounter,
+};
+
+#[global_allocator]
+static ALLOC: AllocProfiler = AllocProfiler::system();
+
+fn main() {
+    // Run registered benchmarks.
+    divan::main();
+}
+
+const MAX: usize = 1024 * 1024;
+
+#[divan::bench(threads = [1, 4, 8, 16, 32])]
+fn concurrent_counter(bencher: divan::Bencher) {
+    let counter = ConcurrentCounter::new(MAX);
+    bencher.bench(|| {
+        let guard = counter.try_access().unwrap();
+        drop(divan::black_box(guard));
+    });
+}
+
+#[divan::bench(threads = [1, 4, 8, 16, 32])]
+fn sharded_concurrent_counter(bencher: divan::Bencher) {
+    let counter = ShardedConcurrentCounter::new(MAX);
+    bencher.bench(|| {
+        let guard = counter.try_access().unwrap();
+        drop(divan::black_box(guard));
+    });
+}
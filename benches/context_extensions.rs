@@ -0,0 +1,166 @@
+use divan::AllocProfiler;
+use rama::service::context::Extensions;
+use std::any::{Any, TypeId};
+use std::collections::HashMap;
+
+#[global_allocator]
+static ALLOC: AllocProfiler = AllocProfiler::system();
+
+fn main() {
+    // Run registered benchmarks.
+    divan::main();
+}
+
+// Types standing in for the extensions inserted per connection and per request,
+// such as the socket info, forwarded info, request context, proxy filter and user agent.
+
+#[allow(dead_code)]
+#[derive(Debug, Clone, Default)]
+struct ConnectionInfo([u64; 4]);
+
+#[allow(dead_code)]
+#[derive(Debug, Clone, Default)]
+struct TlsInfo(u64);
+
+#[allow(dead_code)]
+#[derive(Debug, Clone, Default)]
+struct RequestInfo([u64; 8]);
+
+#[allow(dead_code)]
+#[derive(Debug, Clone, Default)]
+struct ForwardedInfo(u64);
+
+#[allow(dead_code)]
+#[derive(Debug, Clone, Default)]
+struct FilterInfo(u64, u64);
+
+#[allow(dead_code)]
+#[derive(Debug, Clone, Default)]
+struct AgentInfo(u64);
+
+/// The extensions of a connection, as cloned for each request served over that connection.
+fn connection_extensions() -> Extensions {
+    let mut ext = Extensions::new();
+    ext.insert(ConnectionInfo::default());
+    ext.insert(TlsInfo::default());
+    ext
+}
+
+#[divan::bench]
+fn extensions_per_request(bencher: divan::Bencher) {
+    let connection = connection_extensions();
+    bencher.bench(|| {
+        let mut ext = connection.clone();
+        ext.insert(RequestInfo::default());
+        ext.insert(ForwardedInfo::default());
+        ext.get_or_insert_default::<FilterInfo>().0 += 1;
+        ext.insert(AgentInfo::default());
+        divan::black_box(ext.get::<ConnectionInfo>());
+        divan::black_box(ext.get::<RequestInfo>());
+        divan::black_box(ext.get::<TlsInfo>());
+        ext
+    });
+}
+
+#[divan::bench]
+fn extensions_clone_only(bencher: divan::Bencher) {
+    let connection = connection_extensions();
+    bencher.bench(|| {
+        let ext = connection.clone();
+        divan::black_box(ext.get::<ConnectionInfo>());
+        ext
+    });
+}
+
+// The previous `Extensions` implementation: a boxed hash map of boxed values,
+// deep cloned for each request. Kept here as the baseline to compare against.
+
+trait AnyClone: Any {
+    fn clone_box(&self) -> Box<dyn AnyClone + Send + Sync>;
+    fn as_any(&self) -> &dyn Any;
+    fn as_any_mut(&mut self) -> &mut dyn Any;
+}
+
+impl<T: Clone + Send + Sync + 'static> AnyClone for T {
+    fn clone_box(&self) -> Box<dyn AnyClone + Send + Sync> {
+        Box::new(self.clone())
+    }
+
+    fn as_any(&self) -> &dyn Any {
+        self
+    }
+
+    fn as_any_mut(&mut self) -> &mut dyn Any {
+        self
+    }
+}
+
+impl Clone for Box<dyn AnyClone + Send + Sync> {
+    fn clone(&self) -> Self {
+        (**self).clone_box()
+    }
+}
+
+#[derive(Clone, Default)]
+struct HashMapExtensions {
+    map: Option<Box<HashMap<TypeId, Box<dyn AnyClone + Send + Sync>>>>,
+}
+
+impl HashMapExtensions {
+    fn insert<T: Clone + Send + Sync + 'static>(&mut self, val: T) {
+        self.map
+            .get_or_insert_with(Box::default)
+            .insert(TypeId::of::<T>(), Box::new(val));
+    }
+
+    fn get<T: 'static>(&self) -> Option<&T> {
+        self.map
+            .as_ref()
+            .and_then(|map| map.get(&TypeId::of::<T>()))
+            .and_then(|boxed| (**boxed).as_any().downcast_ref())
+    }
+
+    fn get_or_insert_default<T: Default + Clone + Send + Sync + 'static>(&mut self) -> &mut T {
+        (**self
+            .map
+            .get_or_insert_with(Box::default)
+            .entry(TypeId::of::<T>())
+            .or_insert_with(|| Box::new(T::default())))
+        .as_any_mut()
+        .downcast_mut()
+        .unwrap()
+    }
+}
+
+fn hash_map_connection_extensions() -> HashMapExtensions {
+    let mut ext = HashMapExtensions::default();
+    ext.insert(ConnectionInfo::default());
+    ext.insert(TlsInfo::default());
+    ext
+}
+
+#[divan::bench]
+fn hash_map_extensions_per_request(bencher: divan::Bencher) {
+    let connection = hash_map_connection_extensions();
+    bencher.bench(|| {
+        let mut ext = connection.clone();
+        ext.insert(RequestInfo::default());
+        ext.insert(ForwardedInfo::default());
+        ext.get_or_insert_default::<FilterInfo>().0 += 1;
+        ext.insert(AgentInfo::default());
+        divan::black_box(ext.get::<ConnectionInfo>());
+        divan::black_box(ext.get::<RequestInfo>());
+        divan::black_box(ext.get::<TlsInfo>());
+        ext
+    });
+}
+
+#[divan::bench]
+fn hash_map_extensions_clone_only(bencher: divan::Bencher) {
+    let connection = hash_map_connection_extensions();
+    bencher.bench(|| {
+        let ext = connection.clone();
+        divan::black_box(ext.get::<ConnectionInfo>());
+        ext
+    });
+}
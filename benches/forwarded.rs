@@ -0,0 +1,51 @@
+use divan::AllocProfiler;
+use rama::net::forwarded::Forwarded;
+use std::fmt::Write;
+
+#[global_allocator]
+static ALLOC: AllocProfiler = AllocProfiler::system();
+
+fn main() {
+    // Run registered benchmarks.
+    divan::main();
+}
+
+/// `Forwarded` header values as seen behind one or more proxies.
+const FORWARDED_HEADERS: &[&str] = &[
+    "for=192.0.2.43",
+    r#"for="[2001:db8:cafe::17]:4711";proto=https;host=example.com"#,
+    "for=192.0.2.43;by=203.0.113.60;proto=http;host=example.com,for=198.51.100.17;by=203.0.113.61",
+    r#"for=192.0.2.43, for="[2001:db8:cafe::17]", for=unknown;by=_hidden, for=198.51.100.17;proto=https"#,
+];
+
+#[divan::bench(args = FORWARDED_HEADERS)]
+fn parse(bencher: divan::Bencher, header: &str) {
+    bencher
+        .counter(divan::counter::BytesCount::of_str(header))
+        .bench(|| {
+            divan::black_box(divan::black_box(header).parse::<Forwarded>().unwrap());
+        });
+}
+
+#[divan::bench(args = FORWARDED_HEADERS)]
+fn render(bencher: divan::Bencher, header: &str) {
+    let forwarded: Forwarded = header.parse().unwrap();
+    let mut buf = String::with_capacity(256);
+    bencher
+        .counter(divan::counter::BytesCount::of_str(header))
+        .bench_local(|| {
+            buf.clear();
+            write!(buf, "{}", divan::black_box(&forwarded)).unwrap();
+            divan::black_box(&buf);
+        });
+}
+
+#[divan::bench(args = FORWARDED_HEADERS)]
+fn parse_and_render(bencher: divan::Bencher, header: &str) {
+    bencher
+        .counter(divan::counter::BytesCount::of_str(header))
+        .bench(|| {
+            let forwarded: Forwarded = divan::black_box(header).parse().unwrap();
+            divan::black_box(forwarded.to_string());
+        });
+}
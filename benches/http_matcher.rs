@@ -0,0 +1,110 @@
+use divan::AllocProfiler;
+use rama::{
+    http::{
+        header,
+        matcher::{DomainSetMatcher, HttpMatcher, PathMatcher},
+        Body, HeaderValue, Method, Request,
+    },
+    net::address::Domain,
+    service::{context::Extensions, Context, Matcher},
+};
+
+#[global_allocator]
+static ALLOC: AllocProfiler = AllocProfiler::system();
+
+fn main() {
+    // Run registered benchmarks.
+    divan::main();
+}
+
+fn request(method: Method, uri: &str) -> Request {
+    Request::builder()
+        .method(method)
+        .uri(uri)
+        .header(header::ACCEPT, HeaderValue::from_static("application/json"))
+        .body(Body::empty())
+        .unwrap()
+}
+
+#[divan::bench(args = ["/", "/api/v1/users/42", "/api/v1/users/42/posts/7", "/static/css/main.css"])]
+fn path_matcher(bencher: divan::Bencher, path: &str) {
+    let matchers = [
+        PathMatcher::new("/"),
+        PathMatcher::new("/api/v1/users/:id"),
+        PathMatcher::new("/api/v1/users/:id/posts/:post"),
+        PathMatcher::new("/static/*"),
+    ];
+    let ctx: Context<()> = Context::default();
+    let req = request(Method::GET, &format!("http://example.com{path}"));
+    bencher
+        .counter(divan::counter::ItemsCount::new(1usize))
+        .bench_local(|| {
+            let mut ext = Extensions::new();
+            let matched = matchers
+                .iter()
+                .any(|matcher| matcher.matches(Some(&mut ext), &ctx, divan::black_box(&req)));
+            assert!(matched);
+            divan::black_box(ext);
+        });
+}
+
+/// The matchers of a typical (web) service router, tried in order.
+fn router() -> Vec<HttpMatcher<(), Body>> {
+    vec![
+        HttpMatcher::get("/"),
+        HttpMatcher::get("/health").or_path("/ready"),
+        HttpMatcher::get("/api/v1/users"),
+        HttpMatcher::post("/api/v1/users"),
+        HttpMatcher::get("/api/v1/users/:id"),
+        HttpMatcher::method_put()
+            .or_method_patch()
+            .and_path("/api/v1/users/:id"),
+        HttpMatcher::method_delete().and_path("/api/v1/users/:id"),
+        HttpMatcher::get("/api/v1/users/:id/posts/:post")
+            .and_header(header::ACCEPT, HeaderValue::from_static("application/json")),
+        HttpMatcher::domain(Domain::from_static("static.example.com"))
+            .and_method_get()
+            .and_path("/*"),
+        HttpMatcher::get("/*"),
+    ]
+}
+
+#[divan::bench(args = [
+    "/",
+    "/api/v1/users/42",
+    "/api/v1/users/42/posts/7",
+    "/not/found",
+])]
+fn http_matcher_router(bencher: divan::Bencher, path: &str) {
+    let router = router();
+    let ctx = Context::default();
+    let req = request(Method::GET, &format!("http://example.com{path}"));
+    bencher
+        .counter(divan::counter::ItemsCount::new(1usize))
+        .bench_local(|| {
+            let mut ext = Extensions::new();
+            let index = router
+                .iter()
+                .position(|matcher| matcher.matches(Some(&mut ext), &ctx, divan::black_box(&req)));
+            divan::black_box((index, ext));
+        });
+}
+
+#[divan::bench(args = ["example.com", "ads.tracker.example.net", "unknown.example.org"])]
+fn http_matcher_domain_set(bencher: divan::Bencher, host: &str) {
+    let domains: DomainSetMatcher = (0..10_000)
+        .map(|i| format!("host{i}.example.net").parse::<Domain>().unwrap())
+        .chain([
+            Domain::from_static("example.com"),
+            Domain::from_static("tracker.example.net"),
+        ])
+        .collect();
+    let matcher: HttpMatcher<(), Body> = HttpMatcher::domain_set(domains).and_method_get();
+    let ctx = Context::default();
+    let req = request(Method::GET, &format!("http://{host}/"));
+    bencher
+        .counter(divan::counter::ItemsCount::new(1usize))
+        .bench_local(|| {
+            divan::black_box(matcher.matches(None, &ctx, divan::black_box(&req)));
+        });
+}
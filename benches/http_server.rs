@@ -0,0 +1,226 @@
+use divan::AllocProfiler;
+use rama::{
+    http::{
+        client::{ClientConnection, ClientConnectionPool, HttpClient},
+        layer::upgrade::{UpgradeLayer, Upgraded},
+        matcher::MethodMatcher,
+        server::HttpServer,
+        Body, BodyExtractExt, IntoResponse, Request, Response, StatusCode, Version,
+    },
+    net::address::ProxyAddress,
+    proxy::http::client::layer::HttpProxyConnectorService,
+    rt::Executor,
+    service::{service_fn, Context, Service, ServiceBuilder},
+    tcp::{
+        client::service::{Forwarder, HttpConnector},
+        server::TcpListener,
+    },
+};
+use std::{convert::Infallible, net::SocketAddr, str::FromStr};
+use tokio::{
+    io::{AsyncReadExt, AsyncWriteExt},
+    net::TcpStream,
+    runtime::Runtime,
+};
+
+#[global_allocator]
+static ALLOC: AllocProfiler = AllocProfiler::system();
+
+fn main() {
+    // Run registered benchmarks.
+    divan::main();
+}
+
+fn runtime() -> Runtime {
+    tokio::runtime::Builder::new_multi_thread()
+        .worker_threads(2)
+        .enable_all()
+        .build()
+        .unwrap()
+}
+
+async fn hello(_ctx: Context<()>, _req: Request) -> Result<Response, Infallible> {
+    Ok("Hello, World!".into_response())
+}
+
+/// Spawn a hello world [`HttpServer`] of the given kind on a loopback address.
+fn spawn_hello_server(rt: &Runtime, kind: &str) -> SocketAddr {
+    let listener = rt.block_on(TcpListener::bind("127.0.0.1:0")).unwrap();
+    let addr = listener.local_addr().unwrap();
+    match kind {
+        "h1" => rt.spawn(listener.serve(HttpServer::http1().service(service_fn(hello)))),
+        "h2" => {
+            rt.spawn(listener.serve(HttpServer::h2(Executor::new()).service(service_fn(hello))))
+        }
+        _ => rt.spawn(listener.serve(HttpServer::auto(Executor::new()).service(service_fn(hello)))),
+    };
+    addr
+}
+
+/// Returns the server kind and the http version used by the client for the given bench argument.
+fn http_server_kind(arg: &str) -> (&'static str, Version) {
+    match arg {
+        "h1" => ("h1", Version::HTTP_11),
+        "h2" => ("h2", Version::HTTP_2),
+        "auto_h1" => ("auto", Version::HTTP_11),
+        _ => ("auto", Version::HTTP_2),
+    }
+}
+
+const HTTP_SERVERS: &[&str] = &["h1", "h2", "auto_h1", "auto_h2"];
+
+async fn get(
+    client: &impl Service<(), Request, Response = Response, Error = impl std::fmt::Debug>,
+    addr: SocketAddr,
+    version: Version,
+) {
+    let req = Request::builder()
+        .uri(format!("http://{addr}/"))
+        .version(version)
+        .body(Body::empty())
+        .unwrap();
+    let res = client.serve(Context::default(), req).await.unwrap();
+    assert_eq!(res.status(), StatusCode::OK);
+    divan::black_box(res.try_into_string().await.unwrap());
+}
+
+#[divan::bench(args = HTTP_SERVERS)]
+fn hello_world(bencher: divan::Bencher, server: &str) {
+    let (kind, version) = http_server_kind(server);
+    let rt = runtime();
+    let addr = spawn_hello_server(&rt, kind);
+    let client = HttpClient::default().with_connection_pool(ClientConnectionPool::new());
+
+    bencher
+        .counter(divan::counter::ItemsCount::new(1usize))
+        .bench_local(|| rt.block_on(get(&client, addr, version)));
+}
+
+const CONCURRENT_REQUESTS: usize = 32;
+
+#[divan::bench(args = HTTP_SERVERS)]
+fn hello_world_concurrent(bencher: divan::Bencher, server: &str) {
+    let (kind, version) = http_server_kind(server);
+    let rt = runtime();
+    let addr = spawn_hello_server(&rt, kind);
+    let client = HttpClient::default().with_connection_pool(ClientConnectionPool::new());
+
+    bencher
+        .counter(divan::counter::ItemsCount::new(CONCURRENT_REQUESTS))
+        .bench_local(|| {
+            rt.block_on(async {
+                let handles: Vec<_> = (0..CONCURRENT_REQUESTS)
+                    .map(|_| {
+                        let client = client.clone();
+                        tokio::spawn(async move { get(&client, addr, version).await })
+                    })
+                    .collect();
+                for handle in handles {
+                    handle.await.unwrap();
+                }
+            })
+        });
+}
+
+/// Spawn a TCP echo server on a loopback address.
+fn spawn_echo_server(rt: &Runtime) -> SocketAddr {
+    let listener = rt.block_on(TcpListener::bind("127.0.0.1:0")).unwrap();
+    let addr = listener.local_addr().unwrap();
+    rt.spawn(listener.serve(service_fn(
+        |_ctx: Context<()>, mut stream: TcpStream| async move {
+            let (mut reader, mut writer) = stream.split();
+            let _ = tokio::io::copy(&mut reader, &mut writer).await;
+            Ok::<_, Infallible>(())
+        },
+    )));
+    addr
+}
+
+/// Spawn an http proxy on a loopback address,
+/// which tunnels all `CONNECT` requests to the given target using a [`Forwarder`].
+fn spawn_connect_proxy(rt: &Runtime, target: SocketAddr) -> SocketAddr {
+    async fn accept(
+        ctx: Context<()>,
+        req: Request,
+    ) -> Result<(Response, Context<()>, Request), Response> {
+        Ok((StatusCode::OK.into_response(), ctx, req))
+    }
+
+    async fn not_found(_ctx: Context<()>, _req: Request) -> Result<Response, Infallible> {
+        Ok(StatusCode::NOT_FOUND.into_response())
+    }
+
+    let forwarder = Forwarder::target(target);
+    let tunnel = service_fn(move |ctx: Context<()>, upgraded: Upgraded| {
+        let forwarder = forwarder.clone();
+        async move {
+            let _ = forwarder.serve(ctx, upgraded).await;
+            Ok::<_, Infallible>(())
+        }
+    });
+
+    let listener = rt.block_on(TcpListener::bind("127.0.0.1:0")).unwrap();
+    let addr = listener.local_addr().unwrap();
+    rt.spawn(
+        listener.serve(
+            HttpServer::http1().service(
+                ServiceBuilder::new()
+                    .layer(UpgradeLayer::new(
+                        MethodMatcher::CONNECT,
+                        service_fn(accept),
+                        tunnel,
+                    ))
+                    .service_fn(not_found),
+            ),
+        ),
+    );
+    addr
+}
+
+/// Establish a tunnel to the echo server, through the http proxy.
+async fn connect_tunnel(proxy: SocketAddr) -> ClientConnection<TcpStream> {
+    let connector = HttpProxyConnectorService::required(HttpConnector::new());
+    let mut ctx = Context::default();
+    ctx.insert(ProxyAddress::from_str(&format!("http://{proxy}")).unwrap());
+    let req = Request::builder()
+        .uri("https://echo.internal/")
+        .body(Body::empty())
+        .unwrap();
+    connector.serve(ctx, req).await.unwrap().conn
+}
+
+async fn echo(stream: &mut ClientConnection<TcpStream>, payload: &[u8]) {
+    let mut buf = vec![0; payload.len()];
+    stream.write_all(payload).await.unwrap();
+    stream.read_exact(&mut buf).await.unwrap();
+    divan::black_box(buf);
+}
+
+#[divan::bench]
+fn connect_tunnel_establish(bencher: divan::Bencher) {
+    let rt = runtime();
+    let echo_addr = spawn_echo_server(&rt);
+    let proxy_addr = spawn_connect_proxy(&rt, echo_addr);
+
+    bencher
+        .counter(divan::counter::ItemsCount::new(1usize))
+        .bench_local(|| {
+            rt.block_on(async {
+                let mut stream = connect_tunnel(proxy_addr).await;
+                echo(&mut stream, b"ping").await;
+            })
+        });
+}
+
+#[divan::bench(args = [1024, 16 * 1024, 256 * 1024])]
+fn connect_tunnel_echo(bencher: divan::Bencher, size: usize) {
+    let rt = runtime();
+    let echo_addr = spawn_echo_server(&rt);
+    let proxy_addr = spawn_connect_proxy(&rt, echo_addr);
+    let mut stream = rt.block_on(connect_tunnel(proxy_addr));
+    let payload = vec![b'x'; size];
+
+    bencher
+        .counter(divan::counter::BytesCount::new(size))
+        .bench_local(|| rt.block_on(echo(&mut stream, &payload)));
+}
@@ -0,0 +1,146 @@
+use divan::AllocProfiler;
+use rama::{
+    http::{RequestContext, Version},
+    net::{address::ProxyAddress, Protocol},
+    proxy::{MemoryProxyDB, Proxy, ProxyDB, ProxyFilter, ProxyFilterUsernameParser},
+    service::context::Extensions,
+    utils::{
+        str::NonEmptyString,
+        username::{parse_username, UsernameOpaqueLabelParser, DEFAULT_USERNAME_LABEL_SEPARATOR},
+    },
+};
+use std::{str::FromStr, sync::OnceLock};
+
+#[global_allocator]
+static ALLOC: AllocProfiler = AllocProfiler::system();
+
+fn main() {
+    // Run registered benchmarks.
+    divan::main();
+}
+
+const ROWS: usize = 1_000_000;
+
+const COUNTRIES: &[&str] = &["us", "be", "nl", "de", "fr", "gb", "jp", "br", "in", "za"];
+const CITIES: &[&str] = &["new york", "brussels", "amsterdam", "berlin", "paris"];
+const CARRIERS: &[&str] = &["att", "proximus", "kpn", "vodafone", "orange"];
+
+/// A proxy database of [`ROWS`] proxies, spread over
+/// countries, cities, carriers, pools and proxy kinds.
+fn proxy_db() -> &'static MemoryProxyDB {
+    static DB: OnceLock<MemoryProxyDB> = OnceLock::new();
+    DB.get_or_init(|| {
+        let address = ProxyAddress::from_str("127.0.0.1:8080").unwrap();
+        let rows = (0..ROWS)
+            .map(|i| Proxy {
+                id: NonEmptyString::try_from(i.to_string()).unwrap(),
+                address: address.clone(),
+                tcp: true,
+                udp: i % 2 == 0,
+                http: true,
+                socks5: i % 3 == 0,
+                datacenter: i % 3 == 0,
+                residential: i % 3 == 1,
+                mobile: i % 3 == 2,
+                pool_id: Some(format!("pool{}", i % 100).into()),
+                country: Some(COUNTRIES[i % COUNTRIES.len()].into()),
+                city: Some(CITIES[(i / 7) % CITIES.len()].into()),
+                carrier: (i % 3 == 2).then(|| CARRIERS[(i / 11) % CARRIERS.len()].into()),
+            })
+            .collect();
+        MemoryProxyDB::try_from_rows(rows).unwrap()
+    })
+}
+
+fn request_context() -> RequestContext {
+    RequestContext {
+        http_version: Version::HTTP_11,
+        protocol: Protocol::HTTPS,
+        authority: Some("example.com:443".try_into().unwrap()),
+    }
+}
+
+#[divan::bench(args = ["id", "country", "country_residential", "country_city_pool", "mobile_carrier"])]
+fn memory_proxy_db_get_proxy(bencher: divan::Bencher, query: &str) {
+    let db = proxy_db();
+    let filter = match query {
+        "id" => ProxyFilter {
+            id: Some(NonEmptyString::from_static("424242")),
+            ..Default::default()
+        },
+        "country" => ProxyFilter {
+            country: Some(vec!["be".into()]),
+            ..Default::default()
+        },
+        "country_residential" => ProxyFilter {
+            country: Some(vec!["nl".into()]),
+            residential: Some(true),
+            ..Default::default()
+        },
+        "country_city_pool" => ProxyFilter {
+            country: Some(vec!["us".into()]),
+            city: Some(vec!["brussels".into()]),
+            pool_id: Some(vec!["pool10".into(), "pool20".into()]),
+            ..Default::default()
+        },
+        _ => ProxyFilter {
+            mobile: Some(true),
+            carrier: Some(vec!["kpn".into()]),
+            ..Default::default()
+        },
+    };
+    let rt = tokio::runtime::Builder::new_current_thread()
+        .build()
+        .unwrap();
+    bencher
+        .counter(divan::counter::ItemsCount::new(1usize))
+        .with_inputs(|| (request_context(), filter.clone()))
+        .bench_local_values(|(ctx, filter)| {
+            let proxy = rt.block_on(db.get_proxy(ctx, filter)).unwrap();
+            divan::black_box(proxy);
+        });
+}
+
+const USERNAMES: &[&str] = &[
+    "john",
+    "john-residential-country-us",
+    "john-country-be-city-brussels-pool-p1-pool-p2-!datacenter",
+    "john-id-424242-mobile-carrier-vodafone-country-nl",
+];
+
+#[divan::bench(args = USERNAMES)]
+fn proxy_filter_username_parser(bencher: divan::Bencher, username: &str) {
+    bencher
+        .counter(divan::counter::BytesCount::of_str(username))
+        .bench(|| {
+            let mut ext = Extensions::new();
+            let username = parse_username(
+                &mut ext,
+                ProxyFilterUsernameParser::default(),
+                divan::black_box(username),
+                DEFAULT_USERNAME_LABEL_SEPARATOR,
+            )
+            .unwrap();
+            divan::black_box((username, ext));
+        });
+}
+
+#[divan::bench(args = USERNAMES)]
+fn proxy_filter_username_parser_with_opaque(bencher: divan::Bencher, username: &str) {
+    bencher
+        .counter(divan::counter::BytesCount::of_str(username))
+        .bench(|| {
+            let mut ext = Extensions::new();
+            let username = parse_username(
+                &mut ext,
+                (
+                    ProxyFilterUsernameParser::default(),
+                    UsernameOpaqueLabelParser::default(),
+                ),
+                divan::black_box(username),
+                DEFAULT_USERNAME_LABEL_SEPARATOR,
+            )
+            .unwrap();
+            divan::black_box((username, ext));
+        });
+}
@@ -0,0 +1,58 @@
+use divan::AllocProfiler;
+use rama::proxy::pp::protocol::{v2, HeaderResult};
+use std::net::SocketAddr;
+
+#[global_allocator]
+static ALLOC: AllocProfiler = AllocProfiler::system();
+
+fn main() {
+    // Run registered benchmarks.
+    divan::main();
+}
+
+const V1_HEADERS: &[&str] = &[
+    "PROXY TCP4 192.168.0.1 192.168.0.11 56324 443\r\n",
+    "PROXY TCP6 2001:db8::1 2001:db8::11 56324 443\r\n",
+    "PROXY UNKNOWN\r\n",
+];
+
+fn v2_header(source: &str, destination: &str, authority: Option<&str>) -> Vec<u8> {
+    let source: SocketAddr = source.parse().unwrap();
+    let destination: SocketAddr = destination.parse().unwrap();
+    let mut builder = v2::Builder::with_addresses(
+        v2::Version::Two | v2::Command::Proxy,
+        v2::Protocol::Stream,
+        (source, destination),
+    );
+    if let Some(authority) = authority {
+        builder = builder
+            .write_tlv(v2::Type::Authority, authority.as_bytes())
+            .unwrap();
+    }
+    builder.build().unwrap()
+}
+
+#[divan::bench(args = V1_HEADERS)]
+fn parse_v1(bencher: divan::Bencher, header: &str) {
+    bencher
+        .counter(divan::counter::BytesCount::of_str(header))
+        .bench(|| {
+            let result = HeaderResult::parse(divan::black_box(header.as_bytes()));
+            assert!(matches!(result, HeaderResult::V1(Ok(_))));
+        });
+}
+
+#[divan::bench(args = ["ipv4", "ipv6", "ipv4_tlv"])]
+fn parse_v2(bencher: divan::Bencher, kind: &str) {
+    let header = match kind {
+        "ipv4" => v2_header("192.168.0.1:56324", "192.168.0.11:443", None),
+        "ipv6" => v2_header("[2001:db8::1]:56324", "[2001:db8::11]:443", None),
+        _ => v2_header("192.168.0.1:56324", "192.168.0.11:443", Some("example.com")),
+    };
+    bencher
+        .counter(divan::counter::BytesCount::of_slice(&header))
+        .bench(|| {
+            let result = HeaderResult::parse(divan::black_box(&header));
+            assert!(matches!(result, HeaderResult::V2(Ok(_))));
+        });
+}
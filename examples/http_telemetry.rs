@@ -37,7 +37,7 @@ use rama::{
         server::HttpServer,
         service::web::{extract::State, PrometheusMetricsHandler, WebService},
     },
-    net::stream::layer::opentelemetry::NetworkMetricsLayer,
+    net::stream::layer::{opentelemetry::NetworkMetricsLayer, BytesTrackerLayer},
     rt::Executor,
     service::ServiceBuilder,
     tcp::server::TcpListener,
@@ -135,6 +135,8 @@ async fn main() {
             .serve_graceful(
                 guard,
                 ServiceBuilder::new()
+                    // track the bytes and timing of each connection for the network metrics
+                    .layer(BytesTrackerLayer::new().with_timing(true))
                     .layer(NetworkMetricsLayer::default())
                     .service(http_service),
             )
@@ -39,7 +39,11 @@ use rama::{
     net::{stream::layer::http::BodyLimitLayer, user::Basic},
     rt::Executor,
     service::{service_fn, Context, Service, ServiceBuilder},
-    tcp::{server::TcpListener, utils::is_connection_error},
+    tcp::{
+        client::service::{forward_bidirectional, Forwarder},
+        server::TcpListener,
+        utils::is_connection_error,
+    },
     tls::{
         dep::rcgen::KeyPair,
         rustls::{
@@ -202,7 +206,9 @@ where
             return Ok(());
         }
     };
-    if let Err(err) = tokio::io::copy_bidirectional(&mut upgraded, &mut stream).await {
+    if let Err(err) =
+        forward_bidirectional(&mut upgraded, &mut stream, Forwarder::DEFAULT_BUFFER_SIZE).await
+    {
         if !is_connection_error(&err) {
             tracing::error!(error = %err, "error copying data");
         }
@@ -35,7 +35,9 @@ use rama::tls::rustls::dep::{pki_types::PrivatePkcs8KeyDer, rustls::ServerConfig
 use rama::{
     service::ServiceBuilder,
     tcp::{client::service::Forwarder, server::TcpListener},
-    tls::rustls::server::{IncomingClientHello, TlsAcceptorLayer, TlsClientConfigHandler},
+    tls::rustls::server::{
+        IncomingClientHello, TlsAcceptorLayer, TlsClientConfigHandler, TlsSessionResumption,
+    },
     utils::graceful::Shutdown,
 };
 use rcgen::KeyPair;
@@ -111,11 +113,18 @@ async fn main() {
             )
             .expect("create tls server config");
 
+        // allow returning clients to resume their session, skipping the full handshake
+        let session_resumption =
+            TlsSessionResumption::new().expect("create tls session resumption");
+
         let tcp_service = ServiceBuilder::new()
-            .layer(TlsAcceptorLayer::with_client_config_handler(
-                tls_server_config,
-                tls_client_config_handler,
-            ))
+            .layer(
+                TlsAcceptorLayer::with_client_config_handler(
+                    tls_server_config,
+                    tls_client_config_handler,
+                )
+                .with_session_resumption(&session_resumption),
+            )
             .service(Forwarder::target("127.0.0.1:62800".parse().unwrap()));
 
         TcpListener::bind("127.0.0.1:63800")
@@ -0,0 +1,512 @@
+//! rama http load generator
+
+use clap::Args;
+use rama::{
+    cli::args::RequestArgsBuilder,
+    error::{BoxError, ErrorContext},
+    http::{
+        client::{ClientConnectionPool, HttpClient},
+        dep::http_body_util::BodyExt,
+        layer::{required_header::AddRequiredRequestHeadersLayer, timeout::TimeoutLayer},
+        Body, HeaderMap, Method, Request, Response, Uri, Version,
+    },
+    net::{address::ProxyAddress, user::ProxyCredential},
+    proxy::http::client::layer::{HttpProxyAddressLayer, HttpProxyConnectorLayer},
+    service::{Context, Service, ServiceBuilder},
+    tcp::client::service::HttpConnector,
+    tls::rustls::client::HttpsConnectorLayer,
+    utils::{graceful, latency::LatencyHistogram},
+};
+use std::{
+    collections::BTreeMap,
+    io::Write,
+    sync::{
+        atomic::{AtomicBool, AtomicU64, Ordering},
+        Arc,
+    },
+    time::Duration,
+};
+use tokio::time::Instant;
+use tracing::level_filters::LevelFilter;
+use tracing_subscriber::{fmt, layer::SubscriberExt, util::SubscriberInitExt, EnvFilter};
+
+use super::http::tls;
+
+#[derive(Args, Debug, Clone)]
+/// rama http load generator
+pub struct CliCommandBench {
+    #[arg(short = 'c', long, default_value_t = 10)]
+    /// the amount of requests in flight at the same time
+    concurrency: usize,
+
+    #[arg(short = 'n', long)]
+    /// the total amount of requests to send (unlimited by default, bound by the duration)
+    requests: Option<u64>,
+
+    #[arg(short = 'd', long, default_value_t = 10)]
+    /// the duration of the benchmark in seconds (0 = unlimited, bound by the amount of requests)
+    duration: u64,
+
+    #[arg(short = 'r', long, default_value_t = 0)]
+    /// the target rate in requests per second, spread over all concurrent workers
+    /// (0 = as fast as possible)
+    ///
+    /// With a target rate the latency is measured from the moment the request
+    /// was scheduled to be sent, rather than the moment it actually was sent,
+    /// such that a stalling server is not hidden by the load generator
+    /// backing off (coordinated omission).
+    rate: u64,
+
+    #[arg(long = "http2")]
+    /// use http/2 (prior knowledge for http, negotiated using ALPN for https)
+    http2: bool,
+
+    #[arg(long)]
+    /// use a new connection for every request instead of reusing connections
+    no_reuse: bool,
+
+    #[arg(short = 'j', long)]
+    /// data items from the command line are serialized as a JSON object.
+    /// The `Content-Type` and `Accept headers` are set to `application/json`
+    /// (if not specified)
+    ///
+    /// (default)
+    json: bool,
+
+    #[arg(short = 'f', long)]
+    /// data items from the command line are serialized as form fields.
+    ///
+    /// The `Content-Type` is set to `application/x-www-form-urlencoded` (if not specified).
+    form: bool,
+
+    #[arg(long, short = 'P')]
+    /// upstream proxy to use (can also be specified using PROXY env variable)
+    proxy: Option<String>,
+
+    #[arg(long, short = 'U')]
+    /// upstream proxy user credentials to use (or overwrite)
+    proxy_user: Option<String>,
+
+    #[arg(short = 'k', long)]
+    /// skip Tls certificate verification
+    insecure: bool,
+
+    #[arg(long)]
+    /// the desired tls version to use (automatically defined by default, choices are: 1.2, 1.3)
+    tls: Option<String>,
+
+    #[arg(long)]
+    /// the client tls certificate file path to use
+    cert: Option<String>,
+
+    #[arg(long)]
+    /// the client tls key file path to use
+    cert_key: Option<String>,
+
+    #[arg(long, short = 't', default_value = "0")]
+    /// the timeout in seconds for each request (0 = default timeout of 30s)
+    timeout: u64,
+
+    #[arg(long)]
+    /// print debug info
+    debug: bool,
+
+    #[arg(trailing_var_arg = true, allow_hyphen_values = true)]
+    /// positional arguments to populate request headers and body,
+    /// in the same format as the `rama http` command
+    ///
+    /// Only the URL is required, e.g.:
+    ///
+    ///     $ rama bench -c 64 -d 30 -r 10000 :8080/api name=rama
+    args: Vec<String>,
+}
+
+/// Run the HTTP load generator command.
+pub async fn run(cfg: CliCommandBench) -> Result<(), BoxError> {
+    tracing_subscriber::registry()
+        .with(fmt::layer())
+        .with(
+            EnvFilter::builder()
+                .with_default_directive(
+                    if cfg.debug {
+                        LevelFilter::DEBUG
+                    } else {
+                        LevelFilter::ERROR
+                    }
+                    .into(),
+                )
+                .from_env_lossy(),
+        )
+        .init();
+
+    if cfg.duration == 0 && cfg.requests.is_none() {
+        return Err("either a duration or an amount of requests is required".into());
+    }
+
+    let mut request_args_builder = if cfg.json {
+        RequestArgsBuilder::new_json()
+    } else if cfg.form {
+        RequestArgsBuilder::new_form()
+    } else {
+        RequestArgsBuilder::new()
+    };
+    for arg in cfg.args.clone() {
+        request_args_builder.parse_arg(arg);
+    }
+    let mut template = RequestTemplate::new(request_args_builder.build()?).await?;
+    if cfg.http2 {
+        template.version = Version::HTTP_2;
+    }
+
+    let client = Arc::new(create_client(&cfg).await?);
+
+    let stop = Arc::new(AtomicBool::new(false));
+    tokio::spawn({
+        let stop = stop.clone();
+        async move {
+            graceful::default_signal().await;
+            stop.store(true, Ordering::Release);
+        }
+    });
+
+    let concurrency = cfg.concurrency.max(1);
+    let start = Instant::now();
+    let plan = Arc::new(Plan {
+        start,
+        deadline: (cfg.duration > 0).then(|| start + Duration::from_secs(cfg.duration)),
+        max_requests: cfg.requests,
+        interval: (cfg.rate > 0).then(|| 1.0 / cfg.rate as f64),
+        next: AtomicU64::new(0),
+        stop,
+    });
+    let template = Arc::new(template);
+
+    let workers: Vec<_> = (0..concurrency)
+        .map(|_| tokio::spawn(run_worker(client.clone(), template.clone(), plan.clone())))
+        .collect();
+
+    let mut report = Report::new();
+    for worker in workers {
+        report.merge(&worker.await?);
+    }
+    let elapsed = start.elapsed();
+
+    report
+        .write(&mut std::io::stdout().lock(), &cfg, &template, elapsed)
+        .context("write bench report")?;
+    Ok(())
+}
+
+async fn create_client(
+    cfg: &CliCommandBench,
+) -> Result<impl Service<(), Request, Response = Response, Error = BoxError>, BoxError> {
+    let mut tls_client_config = (*tls::create_tls_client_config(
+        cfg.insecure,
+        cfg.tls.clone(),
+        cfg.cert.clone(),
+        cfg.cert_key.clone(),
+    )
+    .await?)
+        .clone();
+    tls_client_config.alpn_protocols = if cfg.http2 {
+        vec![b"h2".to_vec()]
+    } else {
+        vec![b"http/1.1".to_vec()]
+    };
+
+    let client = HttpClient::new(
+        ServiceBuilder::new()
+            .layer(HttpsConnectorLayer::auto().with_config(Arc::new(tls_client_config)))
+            .layer(HttpProxyConnectorLayer::optional())
+            .layer(HttpsConnectorLayer::tunnel())
+            .service(HttpConnector::default()),
+    );
+    let client = if cfg.no_reuse {
+        client
+    } else {
+        client.with_connection_pool(ClientConnectionPool::new())
+    };
+
+    Ok(ServiceBuilder::new()
+        .map_result(map_client_error)
+        .layer(TimeoutLayer::new(if cfg.timeout > 0 {
+            Duration::from_secs(cfg.timeout)
+        } else {
+            Duration::from_secs(30)
+        }))
+        .layer(AddRequiredRequestHeadersLayer::default())
+        .layer(match cfg.proxy.clone() {
+            None => HttpProxyAddressLayer::try_from_env_default()?,
+            Some(proxy) => {
+                let mut proxy_address: ProxyAddress =
+                    proxy.parse().context("parse proxy address")?;
+                if let Some(proxy_user) = cfg.proxy_user.clone() {
+                    let credential = ProxyCredential::try_from_clear_str(proxy_user)
+                        .context("parse proxy credentials")?;
+                    proxy_address.with_credential(credential);
+                }
+                HttpProxyAddressLayer::maybe(Some(proxy_address))
+            }
+        })
+        .service(client))
+}
+
+fn map_client_error<E>(result: Result<Response, E>) -> Result<Response, BoxError>
+where
+    E: Into<BoxError>,
+{
+    result.map_err(Into::into)
+}
+
+/// The request to send, built once from the cli arguments
+/// and cheaply cloned for every request sent.
+#[derive(Debug)]
+struct RequestTemplate {
+    method: Method,
+    uri: Uri,
+    version: Version,
+    headers: HeaderMap,
+    body: bytes::Bytes,
+}
+
+impl RequestTemplate {
+    async fn new(request: Request) -> Result<Self, BoxError> {
+        let (parts, body) = request.into_parts();
+        let body = body.collect().await.context("collect request body")?;
+        Ok(Self {
+            method: parts.method,
+            uri: parts.uri,
+            version: parts.version,
+            headers: parts.headers,
+            body: body.to_bytes(),
+        })
+    }
+
+    fn request(&self) -> Request {
+        let mut request = Request::new(Body::from(self.body.clone()));
+        *request.method_mut() = self.method.clone();
+        *request.uri_mut() = self.uri.clone();
+        *request.version_mut() = self.version;
+        *request.headers_mut() = self.headers.clone();
+        request
+    }
+}
+
+/// The schedule shared by all workers.
+#[derive(Debug)]
+struct Plan {
+    start: Instant,
+    deadline: Option<Instant>,
+    max_requests: Option<u64>,
+    /// seconds between two requests, in case of a target rate
+    interval: Option<f64>,
+    next: AtomicU64,
+    stop: Arc<AtomicBool>,
+}
+
+impl Plan {
+    /// Claim the next request to send, returning the moment it is scheduled for,
+    /// or `None` in case the benchmark is finished.
+    fn next(&self) -> Option<Instant> {
+        if self.stop.load(Ordering::Acquire) {
+            return None;
+        }
+        let index = self.next.fetch_add(1, Ordering::Relaxed);
+        if self.max_requests.is_some_and(|max| index >= max) {
+            return None;
+        }
+        let scheduled = match self.interval {
+            Some(interval) => self.start + Duration::from_secs_f64(index as f64 * interval),
+            None => Instant::now(),
+        };
+        match self.deadline {
+            Some(deadline) if scheduled >= deadline => None,
+            _ => Some(scheduled),
+        }
+    }
+}
+
+async fn run_worker<S>(client: Arc<S>, template: Arc<RequestTemplate>, plan: Arc<Plan>) -> Report
+where
+    S: Service<(), Request, Response = Response, Error = BoxError>,
+{
+    let mut report = Report::new();
+    while let Some(scheduled) = plan.next() {
+        // requests behind schedule are sent right away, but their latency
+        // still includes the time they were waiting to be sent
+        tokio::time::sleep_until(scheduled).await;
+        if plan.stop.load(Ordering::Acquire) {
+            break;
+        }
+
+        match client.serve(Context::default(), template.request()).await {
+            Ok(response) => {
+                let status = response.status();
+                let mut body = response.into_body();
+                let mut received = 0;
+                let mut failed = false;
+                while let Some(frame) = body.frame().await {
+                    match frame {
+                        Ok(frame) => {
+                            if let Some(data) = frame.data_ref() {
+                                received += data.len() as u64;
+                            }
+                        }
+                        Err(err) => {
+                            tracing::debug!(error = %err, "bench: read response body");
+                            failed = true;
+                            break;
+                        }
+                    }
+                }
+                report.bytes += received;
+                if failed {
+                    report.errors += 1;
+                } else {
+                    report.latency.record(scheduled.elapsed());
+                    *report.statuses.entry(status.as_u16()).or_default() += 1;
+                }
+            }
+            Err(err) => {
+                tracing::debug!(error = %err, "bench: send request");
+                report.errors += 1;
+            }
+        }
+    }
+    report
+}
+
+/// The results of (a worker of) the benchmark.
+#[derive(Debug)]
+struct Report {
+    latency: LatencyHistogram,
+    statuses: BTreeMap<u16, u64>,
+    errors: u64,
+    bytes: u64,
+}
+
+impl Report {
+    fn new() -> Self {
+        Self {
+            // count all latencies, instead of following the recent ones
+            latency: LatencyHistogram::new().with_window(u64::MAX),
+            statuses: BTreeMap::new(),
+            errors: 0,
+            bytes: 0,
+        }
+    }
+
+    fn merge(&mut self, other: &Self) {
+        self.latency.merge(&other.latency);
+        for (status, count) in other.statuses.iter() {
+            *self.statuses.entry(*status).or_default() += count;
+        }
+        self.errors += other.errors;
+        self.bytes += other.bytes;
+    }
+
+    fn write(
+        &self,
+        w: &mut impl Write,
+        cfg: &CliCommandBench,
+        template: &RequestTemplate,
+        elapsed: Duration,
+    ) -> std::io::Result<()> {
+        let seconds = elapsed.as_secs_f64().max(f64::EPSILON);
+        let completed = self.latency.count();
+
+        writeln!(
+            w,
+            "{} {} ({:?}) for {}",
+            template.method,
+            template.uri,
+            template.version,
+            fmt_duration(elapsed)
+        )?;
+        writeln!(
+            w,
+            "  {} concurrent, {}, {}",
+            cfg.concurrency.max(1),
+            if cfg.rate > 0 {
+                format!("target rate of {} req/s", cfg.rate)
+            } else {
+                "closed loop".to_owned()
+            },
+            if cfg.no_reuse {
+                "new connection per request"
+            } else {
+                "reusing connections"
+            }
+        )?;
+        writeln!(w)?;
+
+        writeln!(
+            w,
+            "  Latency   min {}  mean {}  stdev {}  max {}",
+            fmt_duration(self.latency.min().unwrap_or_default()),
+            fmt_duration(self.latency.mean().unwrap_or_default()),
+            fmt_duration(self.latency.stdev().unwrap_or_default()),
+            fmt_duration(self.latency.max().unwrap_or_default()),
+        )?;
+        writeln!(w)?;
+        writeln!(w, "  Latency distribution")?;
+        writeln!(
+            w,
+            "  {:>10}  {:>10}  {:>12}",
+            "percentile", "value", "count"
+        )?;
+        for quantile in [0.5, 0.75, 0.9, 0.95, 0.99, 0.999, 0.9999, 0.99999, 1.0] {
+            writeln!(
+                w,
+                "  {:>9.3}%  {:>10}  {:>12}",
+                quantile * 100.0,
+                fmt_duration(self.latency.quantile(quantile).unwrap_or_default()),
+                (quantile * completed as f64).ceil() as u64,
+            )?;
+        }
+        writeln!(w)?;
+
+        writeln!(
+            w,
+            "  {} requests completed in {}, {} errors",
+            completed,
+            fmt_duration(elapsed),
+            self.errors
+        )?;
+        write!(w, "  Status codes:")?;
+        for (status, count) in self.statuses.iter() {
+            write!(w, " [{status}] {count}")?;
+        }
+        writeln!(w)?;
+        writeln!(w, "  Requests/sec: {:.2}", completed as f64 / seconds)?;
+        writeln!(
+            w,
+            "  Transfer/sec: {} (total {})",
+            fmt_bytes(self.bytes as f64 / seconds),
+            fmt_bytes(self.bytes as f64)
+        )?;
+        Ok(())
+    }
+}
+
+fn fmt_duration(duration: Duration) -> String {
+    let micros = duration.as_micros();
+    if micros < 1_000 {
+        format!("{micros}µs")
+    } else if micros < 1_000_000 {
+        format!("{:.2}ms", micros as f64 / 1_000.0)
+    } else {
+        format!("{:.2}s", duration.as_secs_f64())
+    }
+}
+
+fn fmt_bytes(bytes: f64) -> String {
+    const UNITS: [&str; 4] = ["B", "KiB", "MiB", "GiB"];
+    let mut value = bytes;
+    let mut unit = 0;
+    while value >= 1024.0 && unit < UNITS.len() - 1 {
+        value /= 1024.0;
+        unit += 1;
+    }
+    format!("{value:.2} {}", UNITS[unit])
+}
@@ -32,7 +32,7 @@ use tracing_subscriber::{fmt, layer::SubscriberExt, util::SubscriberInitExt, Env
 
 use crate::error::ErrorWithExitCode;
 
-mod tls;
+pub(crate) mod tls;
 mod writer;
 
 #[derive(Args, Debug, Clone)]
@@ -1,5 +1,6 @@
 //! rama cli subcommands
 
+pub mod bench;
 pub mod echo;
 pub mod http;
 pub mod ip;
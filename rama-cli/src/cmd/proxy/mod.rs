@@ -21,7 +21,11 @@ use rama::{
         layer::{limit::policy::ConcurrentPolicy, LimitLayer, TimeoutLayer},
         service_fn, Context, Service, ServiceBuilder,
     },
-    tcp::{server::TcpListener, utils::is_connection_error},
+    tcp::{
+        client::service::{forward_bidirectional, Forwarder},
+        server::TcpListener,
+        utils::is_connection_error,
+    },
 };
 use std::{convert::Infallible, time::Duration};
 use tracing::level_filters::LevelFilter;
@@ -145,7 +149,9 @@ where
             return Ok(());
         }
     };
-    if let Err(err) = tokio::io::copy_bidirectional(&mut upgraded, &mut stream).await {
+    if let Err(err) =
+        forward_bidirectional(&mut upgraded, &mut stream, Forwarder::DEFAULT_BUFFER_SIZE).await
+    {
         if !is_connection_error(&err) {
             tracing::error!(error = %err, "error copying data");
         }
@@ -45,7 +45,7 @@ use clap::{Parser, Subcommand};
 use rama::error::BoxError;
 
 pub mod cmd;
-use cmd::{echo, http, ip, proxy};
+use cmd::{bench, echo, http, ip, proxy};
 
 pub mod error;
 
@@ -65,6 +65,7 @@ enum CliCommands {
     Http(http::CliCommandHttp),
     Proxy(proxy::CliCommandProxy),
     Ip(ip::CliCommandIp),
+    Bench(bench::CliCommandBench),
 }
 
 #[tokio::main]
@@ -77,6 +78,7 @@ async fn main() -> Result<(), BoxError> {
         CliCommands::Http(cfg) => http::run(cfg).await,
         CliCommands::Proxy(cfg) => proxy::run(cfg).await,
         CliCommands::Ip(cfg) => ip::run(cfg).await,
+        CliCommands::Bench(cfg) => bench::run(cfg).await,
     } {
         Ok(()) => Ok(()),
         Err(err) => {
@@ -0,0 +1,162 @@
+use super::{
+    cache::{DnsCacheConfig, ShardedCache},
+    Dns, DnsCache,
+};
+use crate::net::address::Domain;
+use hickory_resolver::{
+    config::{NameServerConfigGroup, ResolverConfig, ResolverOpts},
+    TokioAsyncResolver,
+};
+use std::{collections::HashMap, net::IpAddr, sync::Arc, time::Duration};
+
+#[derive(Debug, Clone)]
+/// Builder to create a configured [`Dns`] resolver.
+///
+/// By default the resolver uses the Cloudflare nameservers,
+/// and caches lookup results in a sharded cache that respects record TTLs,
+/// including negative results for domains without records.
+///
+/// # Example
+///
+/// ```
+/// use rama::dns::DnsBuilder;
+/// use std::{net::{IpAddr, Ipv4Addr}, time::Duration};
+///
+/// let dns = DnsBuilder::new()
+///     .with_nameservers(&[IpAddr::V4(Ipv4Addr::new(8, 8, 8, 8))], 53)
+///     .with_cache_capacity(16 * 1024)
+///     .with_max_ttl(Duration::from_secs(300))
+///     .with_prefetch_threshold(Duration::from_secs(5))
+///     .build();
+/// # let _ = dns;
+/// ```
+pub struct DnsBuilder {
+    config: ResolverConfig,
+    opts: ResolverOpts,
+    cache: Option<DnsCacheConfig>,
+    overwrites: Option<HashMap<Domain, Vec<IpAddr>>>,
+}
+
+impl Default for DnsBuilder {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl DnsBuilder {
+    /// Create a new [`DnsBuilder`] with the default configuration.
+    pub fn new() -> Self {
+        Self {
+            config: ResolverConfig::cloudflare(),
+            opts: ResolverOpts::default(),
+            cache: Some(DnsCacheConfig::default()),
+            overwrites: None,
+        }
+    }
+
+    /// Use the given [`ResolverConfig`] for the upstream resolver,
+    /// e.g. to use another well known provider.
+    ///
+    /// [`ResolverConfig`]: https://docs.rs/hickory-resolver/latest/hickory_resolver/config/struct.ResolverConfig.html
+    pub fn with_resolver_config(mut self, config: ResolverConfig) -> Self {
+        self.config = config;
+        self
+    }
+
+    /// Use the given nameservers (over UDP and TCP) for the upstream resolver.
+    pub fn with_nameservers(mut self, addresses: &[IpAddr], port: u16) -> Self {
+        self.config = ResolverConfig::from_parts(
+            None,
+            vec![],
+            NameServerConfigGroup::from_ips_clear(addresses, port, true),
+        );
+        self
+    }
+
+    /// Use the given [`ResolverOpts`] for the upstream resolver.
+    ///
+    /// [`ResolverOpts`]: https://docs.rs/hickory-resolver/latest/hickory_resolver/config/struct.ResolverOpts.html
+    pub fn with_resolver_opts(mut self, opts: ResolverOpts) -> Self {
+        self.opts = opts;
+        self
+    }
+
+    /// Disable the caching of lookup results.
+    ///
+    /// Every lookup will go to the upstream resolver
+    /// (which can still cache on its own, see [`ResolverOpts`]).
+    ///
+    /// [`ResolverOpts`]: https://docs.rs/hickory-resolver/latest/hickory_resolver/config/struct.ResolverOpts.html
+    pub fn without_cache(mut self) -> Self {
+        self.cache = None;
+        self
+    }
+
+    /// Set the maximum amount of domains cached per record type.
+    pub fn with_cache_capacity(mut self, capacity: usize) -> Self {
+        self.cache.get_or_insert_with(Default::default).capacity = capacity;
+        self
+    }
+
+    /// Set the amount of shards the cache is split into,
+    /// reducing lock contention across threads.
+    pub fn with_cache_shards(mut self, shards: usize) -> Self {
+        self.cache.get_or_insert_with(Default::default).shards = shards;
+        self
+    }
+
+    /// Set the minimum duration a lookup result is cached for,
+    /// regardless of the TTL of the records.
+    pub fn with_min_ttl(mut self, ttl: Duration) -> Self {
+        self.cache.get_or_insert_with(Default::default).min_ttl = ttl;
+        self
+    }
+
+    /// Set the maximum duration a lookup result is cached for,
+    /// regardless of the TTL of the records.
+    pub fn with_max_ttl(mut self, ttl: Duration) -> Self {
+        self.cache.get_or_insert_with(Default::default).max_ttl = ttl;
+        self
+    }
+
+    /// Set the duration a domain without records is cached for,
+    /// in case the nameserver did not report a negative TTL.
+    pub fn with_negative_ttl(mut self, ttl: Duration) -> Self {
+        self.cache.get_or_insert_with(Default::default).negative_ttl = ttl;
+        self
+    }
+
+    /// Refresh cached records in the background when they are used
+    /// while they are to expire within the given duration,
+    /// such that hot domains never have to wait on the upstream resolver.
+    pub fn with_prefetch_threshold(mut self, threshold: Duration) -> Self {
+        self.cache
+            .get_or_insert_with(Default::default)
+            .prefetch_threshold = Some(threshold);
+        self
+    }
+
+    /// Inserts a domain to IP address mapping to overwrite the DNS lookup.
+    ///
+    /// See [`Dns::insert_overwrite`] for more information.
+    pub fn with_overwrite(mut self, domain: Domain, addresses: Vec<IpAddr>) -> Self {
+        self.overwrites
+            .get_or_insert_with(HashMap::new)
+            .insert(domain, addresses);
+        self
+    }
+
+    /// Build the [`Dns`] resolver.
+    pub fn build(self) -> Dns {
+        Dns {
+            resolver: Arc::new(TokioAsyncResolver::tokio(self.config, self.opts)),
+            overwrites: self.overwrites,
+            cache: self.cache.map(|config| {
+                Arc::new(DnsCache {
+                    ipv4: ShardedCache::new(config.clone()),
+                    ipv6: ShardedCache::new(config),
+                })
+            }),
+        }
+    }
+}
@@ -0,0 +1,351 @@
+//! Sharded, TTL-aware cache used by [`Dns`] to store
+//! positive and negative lookup results.
+//!
+//! [`Dns`]: super::Dns
+
+use crate::net::address::Domain;
+use crate::utils::lru::LruCache;
+use parking_lot::Mutex;
+use std::{
+    collections::hash_map::RandomState,
+    fmt,
+    hash::BuildHasher,
+    sync::Arc,
+    time::{Duration, Instant},
+};
+
+/// Configuration of the cache used by [`Dns`].
+///
+/// [`Dns`]: super::Dns
+#[derive(Debug, Clone)]
+pub(super) struct DnsCacheConfig {
+    pub(super) capacity: usize,
+    pub(super) shards: usize,
+    pub(super) min_ttl: Duration,
+    pub(super) max_ttl: Duration,
+    pub(super) negative_ttl: Duration,
+    pub(super) prefetch_threshold: Option<Duration>,
+}
+
+impl Default for DnsCacheConfig {
+    fn default() -> Self {
+        Self {
+            capacity: 4096,
+            shards: 16,
+            min_ttl: Duration::from_secs(1),
+            max_ttl: Duration::from_secs(60 * 60),
+            negative_ttl: Duration::from_secs(30),
+            prefetch_threshold: None,
+        }
+    }
+}
+
+/// Result of a cache lookup.
+#[derive(Debug)]
+pub(super) enum CacheLookup<T> {
+    /// Addresses found in the cache, with `prefetch` set to `true`
+    /// if the caller is expected to refresh the entry in the background.
+    Hit { addresses: Arc<[T]>, prefetch: bool },
+    /// The domain is known to have no records (negative cache).
+    Negative,
+    /// Nothing (valid) found in the cache.
+    Miss,
+}
+
+/// A sharded cache of lookup results for a single record type.
+///
+/// Once a shard is full, its expired entries are dropped
+/// or else its least recently used entry is evicted to make room.
+pub(super) struct ShardedCache<T> {
+    shards: Box<[Mutex<LruCache<Domain, CacheEntry<T>>>]>,
+    hasher: RandomState,
+    config: DnsCacheConfig,
+}
+
+struct CacheEntry<T> {
+    addresses: Option<Arc<[T]>>,
+    valid_until: Instant,
+    prefetching: bool,
+}
+
+impl<T> fmt::Debug for ShardedCache<T> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("ShardedCache")
+            .field("shards", &self.shards.len())
+            .field("capacity_per_shard", &self.shards[0].lock().capacity())
+            .field("config", &self.config)
+            .finish()
+    }
+}
+
+impl<T> ShardedCache<T> {
+    pub(super) fn new(config: DnsCacheConfig) -> Self {
+        let shard_count = config.shards.max(1);
+        let capacity_per_shard = config.capacity.div_ceil(shard_count).max(1);
+        let shards = (0..shard_count)
+            .map(|_| Mutex::new(LruCache::new(capacity_per_shard, usize::MAX)))
+            .collect();
+        Self {
+            shards,
+            hasher: RandomState::new(),
+            config,
+        }
+    }
+
+    fn shard(&self, domain: &Domain) -> &Mutex<LruCache<Domain, CacheEntry<T>>> {
+        let index = self.hasher.hash_one(domain) as usize % self.shards.len();
+        &self.shards[index]
+    }
+
+    /// Get the cached result for the given domain, if any.
+    pub(super) fn get(&self, domain: &Domain) -> CacheLookup<T> {
+        let now = Instant::now();
+        let mut shard = self.shard(domain).lock();
+
+        let entry = match shard.get(domain) {
+            Some(entry) => entry,
+            None => return CacheLookup::Miss,
+        };
+
+        if entry.valid_until <= now {
+            shard.remove(domain);
+            return CacheLookup::Miss;
+        }
+
+        match entry.addresses.clone() {
+            Some(addresses) => {
+                let prefetch = !entry.prefetching
+                    && self
+                        .config
+                        .prefetch_threshold
+                        .map(|threshold| entry.valid_until - now <= threshold)
+                        .unwrap_or_default();
+                if prefetch {
+                    entry.prefetching = true;
+                }
+                CacheLookup::Hit {
+                    addresses,
+                    prefetch,
+                }
+            }
+            None => CacheLookup::Negative,
+        }
+    }
+
+    /// Store the addresses found for the given domain,
+    /// valid until the given instant (clamped by the configured min and max TTL).
+    pub(super) fn insert(&self, domain: Domain, addresses: Arc<[T]>, valid_until: Instant) {
+        let now = Instant::now();
+        let ttl = valid_until
+            .saturating_duration_since(now)
+            .clamp(self.config.min_ttl, self.config.max_ttl);
+        self.insert_entry(domain, Some(addresses), now + ttl)
+    }
+
+    /// Store that the given domain has no records,
+    /// using the negative TTL reported by the nameserver,
+    /// or the configured negative TTL if none was reported.
+    pub(super) fn insert_negative(&self, domain: Domain, ttl: Option<Duration>) {
+        let ttl = ttl
+            .unwrap_or(self.config.negative_ttl)
+            .clamp(self.config.min_ttl, self.config.max_ttl);
+        self.insert_entry(domain, None, Instant::now() + ttl)
+    }
+
+    /// Mark the entry for the given domain as no longer prefetching,
+    /// used in case a prefetch failed, so it can be retried.
+    pub(super) fn reset_prefetch(&self, domain: &Domain) {
+        if let Some(entry) = self.shard(domain).lock().peek_mut(domain) {
+            entry.prefetching = false;
+        }
+    }
+
+    fn insert_entry(&self, domain: Domain, addresses: Option<Arc<[T]>>, valid_until: Instant) {
+        let mut shard = self.shard(&domain).lock();
+
+        // drop the expired entries which were used least recently,
+        // any other entry which no longer fits is evicted by the insert
+        let now = Instant::now();
+        while shard
+            .peek_lru()
+            .map_or(false, |(_, entry)| entry.valid_until <= now)
+        {
+            shard.pop_lru();
+        }
+
+        shard.insert(
+            domain,
+            CacheEntry {
+                addresses,
+                valid_until,
+                prefetching: false,
+            },
+            0,
+        );
+    }
+
+    #[cfg(test)]
+    fn len(&self) -> usize {
+        self.shards.iter().map(|shard| shard.lock().len()).sum()
+    }
+}
+
+/// Iterator over the addresses of a (cached) lookup result.
+#[derive(Debug, Clone)]
+pub(super) struct CachedAddresses<T> {
+    addresses: Arc<[T]>,
+    index: usize,
+}
+
+impl<T> CachedAddresses<T> {
+    pub(super) fn new(addresses: Arc<[T]>) -> Self {
+        Self {
+            addresses,
+            index: 0,
+        }
+    }
+}
+
+impl<T: Copy> Iterator for CachedAddresses<T> {
+    type Item = T;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let item = self.addresses.get(self.index).copied()?;
+        self.index += 1;
+        Some(item)
+    }
+
+    fn size_hint(&self) -> (usize, Option<usize>) {
+        let remaining = self.addresses.len() - self.index;
+        (remaining, Some(remaining))
+    }
+}
+
+impl<T: Copy> ExactSizeIterator for CachedAddresses<T> {}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::net::Ipv4Addr;
+
+    fn domain(s: &'static str) -> Domain {
+        Domain::from_static(s)
+    }
+
+    fn addresses() -> Arc<[Ipv4Addr]> {
+        vec![Ipv4Addr::new(127, 0, 0, 1), Ipv4Addr::new(127, 0, 0, 2)].into()
+    }
+
+    #[test]
+    fn test_cache_hit_and_miss() {
+        let cache = ShardedCache::new(DnsCacheConfig::default());
+        assert!(matches!(
+            cache.get(&domain("example.com")),
+            CacheLookup::Miss
+        ));
+
+        cache.insert(
+            domain("example.com"),
+            addresses(),
+            Instant::now() + Duration::from_secs(10),
+        );
+        match cache.get(&domain("example.com")) {
+            CacheLookup::Hit {
+                addresses,
+                prefetch,
+            } => {
+                assert!(!prefetch);
+                assert_eq!(
+                    CachedAddresses::new(addresses).collect::<Vec<_>>(),
+                    vec![Ipv4Addr::new(127, 0, 0, 1), Ipv4Addr::new(127, 0, 0, 2)]
+                );
+            }
+            other => panic!("unexpected lookup result: {other:?}"),
+        }
+        assert!(matches!(
+            cache.get(&domain("example.org")),
+            CacheLookup::Miss
+        ));
+    }
+
+    #[test]
+    fn test_cache_negative() {
+        let cache = ShardedCache::<Ipv4Addr>::new(DnsCacheConfig::default());
+        cache.insert_negative(domain("example.com"), None);
+        assert!(matches!(
+            cache.get(&domain("example.com")),
+            CacheLookup::Negative
+        ));
+    }
+
+    #[test]
+    fn test_cache_expired() {
+        let cache = ShardedCache::new(DnsCacheConfig {
+            min_ttl: Duration::ZERO,
+            ..Default::default()
+        });
+        cache.insert(domain("example.com"), addresses(), Instant::now());
+        assert!(matches!(
+            cache.get(&domain("example.com")),
+            CacheLookup::Miss
+        ));
+        assert_eq!(cache.len(), 0);
+    }
+
+    #[test]
+    fn test_cache_prefetch_once() {
+        let cache = ShardedCache::new(DnsCacheConfig {
+            prefetch_threshold: Some(Duration::from_secs(60)),
+            ..Default::default()
+        });
+        cache.insert(
+            domain("example.com"),
+            addresses(),
+            Instant::now() + Duration::from_secs(10),
+        );
+        assert!(matches!(
+            cache.get(&domain("example.com")),
+            CacheLookup::Hit { prefetch: true, .. }
+        ));
+        assert!(matches!(
+            cache.get(&domain("example.com")),
+            CacheLookup::Hit {
+                prefetch: false,
+                ..
+            }
+        ));
+        cache.reset_prefetch(&domain("example.com"));
+        assert!(matches!(
+            cache.get(&domain("example.com")),
+            CacheLookup::Hit { prefetch: true, .. }
+        ));
+    }
+
+    #[test]
+    fn test_cache_capacity() {
+        let cache = ShardedCache::new(DnsCacheConfig {
+            capacity: 2,
+            shards: 1,
+            ..Default::default()
+        });
+        let valid_until = Instant::now() + Duration::from_secs(10);
+        cache.insert(domain("a.com"), addresses(), valid_until);
+        cache.insert(domain("b.com"), addresses(), valid_until);
+        assert!(matches!(
+            cache.get(&domain("a.com")),
+            CacheLookup::Hit { .. }
+        ));
+        // the least recently used entry is evicted
+        cache.insert(domain("c.com"), addresses(), valid_until);
+        assert_eq!(cache.len(), 2);
+        assert!(matches!(
+            cache.get(&domain("c.com")),
+            CacheLookup::Hit { .. }
+        ));
+        assert!(matches!(
+            cache.get(&domain("a.com")),
+            CacheLookup::Hit { .. }
+        ));
+        assert!(matches!(cache.get(&domain("b.com")), CacheLookup::Miss));
+    }
+}
@@ -3,16 +3,19 @@
 //! The star of the show is the [`Dns`] struct, which is a DNS resolver for all your lookup needs.
 //! It is made available as [`Context::dns`] for your convenience.
 //!
+//! Use the [`DnsBuilder`] to configure the upstream resolver and the lookup cache.
+//!
 //! [`Context::dns`]: crate::service::Context::dns
 
 use std::{
     collections::HashMap,
     net::{IpAddr, Ipv4Addr, Ipv6Addr},
     sync::Arc,
+    time::Duration,
 };
 
 use hickory_resolver::{
-    config::{ResolverConfig, ResolverOpts},
+    error::{ResolveError, ResolveErrorKind},
     proto::rr::rdata::{A, AAAA},
     IntoName, Name, TokioAsyncResolver,
 };
@@ -25,36 +28,49 @@ use crate::{
 
 pub mod layer;
 
+mod builder;
+#[doc(inline)]
+pub use builder::DnsBuilder;
+
+mod cache;
+use cache::{CacheLookup, CachedAddresses, ShardedCache};
+
 #[derive(Debug, Clone)]
 /// Dns Resolver for all your lookup needs.
 ///
 /// We try to keep this module as minimal as possible, and only expose the
 /// necessary functions to perform DNS lookups in function of Rama.
 ///
+/// Lookup results are cached by default, respecting the TTL of the records,
+/// and domains without records are cached as well (negative caching).
+/// See [`DnsBuilder`] for more information on how to configure this.
+///
 /// Please [open an issue](https://github.com/plabayo/rama/issues/new)
 /// with clear goals and motivation if you need more functionality.
 pub struct Dns {
     resolver: Arc<TokioAsyncResolver>,
     overwrites: Option<HashMap<Domain, Vec<IpAddr>>>,
+    cache: Option<Arc<DnsCache>>,
+}
+
+#[derive(Debug)]
+struct DnsCache {
+    ipv4: ShardedCache<Ipv4Addr>,
+    ipv6: ShardedCache<Ipv6Addr>,
 }
 
 impl Default for Dns {
     fn default() -> Self {
-        Self {
-            resolver: Arc::new(TokioAsyncResolver::tokio(
-                // TODO: make this configurable in a `DnsBuilder`,
-                // if we ever get a feature request for this
-                ResolverConfig::cloudflare(),
-                // TODO: make this configurable in a `DnsBuilder`,
-                // if we ever get a feature request for this
-                ResolverOpts::default(),
-            )),
-            overwrites: None,
-        }
+        DnsBuilder::new().build()
     }
 }
 
 impl Dns {
+    /// Create a new [`DnsBuilder`] to configure a [`Dns`] resolver.
+    pub fn builder() -> DnsBuilder {
+        DnsBuilder::new()
+    }
+
     /// Inserts a domain to IP address mapping to overwrite the DNS lookup.
     ///
     /// Existing mappings will be overwritten.
@@ -98,14 +114,29 @@ impl Dns {
             )));
         }
 
-        Ok(Either::B(
-            self.resolver
-                .ipv4_lookup(domain_str_as_fqdn(domain)?)
-                .await
-                .context("lookup IPv4 address(es)")?
-                .into_iter()
-                .map(|A(ip)| ip),
-        ))
+        if let Some(cache) = self.cache.as_ref() {
+            match cache.ipv4.get(&domain) {
+                CacheLookup::Hit {
+                    addresses,
+                    prefetch,
+                } => {
+                    if prefetch {
+                        self.prefetch_ipv4(domain);
+                    }
+                    return Ok(Either::B(CachedAddresses::new(addresses)));
+                }
+                CacheLookup::Negative => {
+                    return Err(OpaqueError::from_display(
+                        "lookup IPv4 address(es): no records found (cached)",
+                    ));
+                }
+                CacheLookup::Miss => (),
+            }
+        }
+
+        self.resolve_ipv4(domain)
+            .await
+            .map(|addresses| Either::B(CachedAddresses::new(addresses)))
     }
 
     /// Performs a 'AAAA' DNS record lookup.
@@ -126,14 +157,116 @@ impl Dns {
             )));
         }
 
-        Ok(Either::B(
-            self.resolver
-                .ipv6_lookup(domain_str_as_fqdn(domain)?)
-                .await
-                .context("lookup IPv6 address(es)")?
-                .into_iter()
-                .map(|AAAA(ip)| ip),
-        ))
+        if let Some(cache) = self.cache.as_ref() {
+            match cache.ipv6.get(&domain) {
+                CacheLookup::Hit {
+                    addresses,
+                    prefetch,
+                } => {
+                    if prefetch {
+                        self.prefetch_ipv6(domain);
+                    }
+                    return Ok(Either::B(CachedAddresses::new(addresses)));
+                }
+                CacheLookup::Negative => {
+                    return Err(OpaqueError::from_display(
+                        "lookup IPv6 address(es): no records found (cached)",
+                    ));
+                }
+                CacheLookup::Miss => (),
+            }
+        }
+
+        self.resolve_ipv6(domain)
+            .await
+            .map(|addresses| Either::B(CachedAddresses::new(addresses)))
+    }
+
+    async fn resolve_ipv4(&self, domain: Domain) -> Result<Arc<[Ipv4Addr]>, OpaqueError> {
+        match self
+            .resolver
+            .ipv4_lookup(domain_str_as_fqdn(domain.clone())?)
+            .await
+        {
+            Ok(lookup) => {
+                let addresses: Arc<[Ipv4Addr]> = lookup.iter().map(|A(ip)| *ip).collect();
+                if let Some(cache) = self.cache.as_ref() {
+                    cache
+                        .ipv4
+                        .insert(domain, addresses.clone(), lookup.valid_until());
+                }
+                Ok(addresses)
+            }
+            Err(err) => {
+                if let (Some(cache), Some(ttl)) = (self.cache.as_ref(), negative_ttl(&err)) {
+                    cache.ipv4.insert_negative(domain, ttl);
+                }
+                Err(err).context("lookup IPv4 address(es)")
+            }
+        }
+    }
+
+    async fn resolve_ipv6(&self, domain: Domain) -> Result<Arc<[Ipv6Addr]>, OpaqueError> {
+        match self
+            .resolver
+            .ipv6_lookup(domain_str_as_fqdn(domain.clone())?)
+            .await
+        {
+            Ok(lookup) => {
+                let addresses: Arc<[Ipv6Addr]> = lookup.iter().map(|AAAA(ip)| *ip).collect();
+                if let Some(cache) = self.cache.as_ref() {
+                    cache
+                        .ipv6
+                        .insert(domain, addresses.clone(), lookup.valid_until());
+                }
+                Ok(addresses)
+            }
+            Err(err) => {
+                if let (Some(cache), Some(ttl)) = (self.cache.as_ref(), negative_ttl(&err)) {
+                    cache.ipv6.insert_negative(domain, ttl);
+                }
+                Err(err).context("lookup IPv6 address(es)")
+            }
+        }
+    }
+
+    /// Refresh a cached 'A' record in the background, before it expires.
+    fn prefetch_ipv4(&self, domain: Domain) {
+        let dns = self.clone();
+        tokio::spawn(async move {
+            if let Err(err) = dns.resolve_ipv4(domain.clone()).await {
+                tracing::debug!(err = %err, "dns: failed to prefetch IPv4 address(es) for {domain}");
+                if let Some(cache) = dns.cache.as_ref() {
+                    cache.ipv4.reset_prefetch(&domain);
+                }
+            }
+        });
+    }
+
+    /// Refresh a cached 'AAAA' record in the background, before it expires.
+    fn prefetch_ipv6(&self, domain: Domain) {
+        let dns = self.clone();
+        tokio::spawn(async move {
+            if let Err(err) = dns.resolve_ipv6(domain.clone()).await {
+                tracing::debug!(err = %err, "dns: failed to prefetch IPv6 address(es) for {domain}");
+                if let Some(cache) = dns.cache.as_ref() {
+                    cache.ipv6.reset_prefetch(&domain);
+                }
+            }
+        });
+    }
+}
+
+/// Returns the negative TTL to cache the failed lookup for,
+/// or `None` in case the error is not cacheable.
+///
+/// The inner option is `None` when the nameserver did not report a negative TTL.
+fn negative_ttl(err: &ResolveError) -> Option<Option<Duration>> {
+    match err.kind() {
+        ResolveErrorKind::NoRecordsFound { negative_ttl, .. } => {
+            Some(negative_ttl.map(|ttl| Duration::from_secs(ttl as u64)))
+        }
+        _ => None,
     }
 }
 
@@ -8,12 +8,15 @@ use crate::{
         get_request_context,
         header::HOST,
         headers::{self, HeaderMapExt},
-        Request, Response, Version,
+        Request, Response, Uri, Version,
     },
     net::{address::ProxyAddress, stream::Stream},
     service::{Context, Service},
     tcp::client::service::HttpConnector,
-    tls::rustls::client::{AutoTlsStream, HttpsConnector},
+    tls::{
+        rustls::client::{AutoTlsStream, HttpsConnector},
+        HttpsTunnel,
+    },
 };
 use hyper_util::rt::TokioIo;
 use std::fmt;
@@ -31,12 +34,21 @@ mod conn;
 #[doc(inline)]
 pub use conn::{ClientConnection, EstablishedClientConnection};
 
+mod pool;
+#[doc(inline)]
+pub use pool::ClientConnectionPool;
+use pool::{PoolKey, PooledSender};
+
 /// An http client that can be used to serve HTTP requests.
 ///
 /// The underlying connections are established using the provided connection [`Service`],
 /// which is a [`Service`] that is expected to return as output an [`EstablishedClientConnection`].
+///
+/// By default a new connection is established for every request.
+/// Use [`HttpClient::with_connection_pool`] to reuse connections instead.
 pub struct HttpClient<C, S> {
     connector: C,
+    pool: Option<ClientConnectionPool>,
     _phantom: std::marker::PhantomData<S>,
 }
 
@@ -44,6 +56,7 @@ impl<C: fmt::Debug, S> fmt::Debug for HttpClient<C, S> {
     fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
         f.debug_struct("HttpClient")
             .field("connector", &self.connector)
+            .field("pool", &self.pool)
             .finish()
     }
 }
@@ -52,6 +65,7 @@ impl<C: Clone, S> Clone for HttpClient<C, S> {
     fn clone(&self) -> Self {
         Self {
             connector: self.connector.clone(),
+            pool: self.pool.clone(),
             _phantom: std::marker::PhantomData,
         }
     }
@@ -63,15 +77,31 @@ impl<C, S> HttpClient<C, S> {
     pub fn new(connector: C) -> Self {
         Self {
             connector,
+            pool: None,
             _phantom: std::marker::PhantomData,
         }
     }
+
+    /// Attach a [`ClientConnectionPool`] to this [`HttpClient`],
+    /// such that established connections are reused for requests to the same target.
+    ///
+    /// The pool can be shared between multiple clients by cloning it.
+    pub fn with_connection_pool(mut self, pool: ClientConnectionPool) -> Self {
+        self.pool = Some(pool);
+        self
+    }
+
+    /// Return the [`ClientConnectionPool`] used by this [`HttpClient`], if any.
+    pub fn connection_pool(&self) -> Option<&ClientConnectionPool> {
+        self.pool.as_ref()
+    }
 }
 
 impl Default for HttpClient<HttpsConnector<HttpConnector>, AutoTlsStream<TcpStream>> {
     fn default() -> Self {
         Self {
             connector: HttpsConnector::auto(HttpConnector::default()),
+            pool: None,
             _phantom: std::marker::PhantomData,
         }
     }
@@ -108,18 +138,38 @@ where
         // clone the request uri for error reporting
         let uri = req.uri().clone();
 
-        let EstablishedClientConnection { ctx, req, conn } =
-            self.connector
-                .serve(ctx, req)
-                .await
-                .map_err(|err| HttpClientError::from_boxed(err.into()).with_uri(uri.clone()))?;
+        // fail fast for versions without a transport (e.g. http/3, which requires QUIC),
+        // instead of only finding out once a (tcp) connection is already established
+        ensure_supported_version(req.version(), &uri)?;
+
+        if let Some(pool) = self.pool.as_ref() {
+            if let Some(key) = pool_key(&mut ctx, &req) {
+                if let Some(sender) = pool.checkout::<Body>(&key) {
+                    tracing::trace!(uri = %uri, "http client: reuse pooled connection");
+                    return send_request(&ctx, sender, Some((pool.clone(), key)), req, uri).await;
+                }
+            }
+        }
+
+        let EstablishedClientConnection { mut ctx, req, conn } = self
+            .connector
+            .serve(ctx, req)
+            .await
+            .map_err(|err| HttpClientError::from_boxed(err.into()).with_uri(uri.clone()))?;
 
         let io = TokioIo::new(Box::pin(conn));
 
-        let resp = match req.version() {
+        // the connector might have changed the version (e.g. negotiated using ALPN),
+        // so the new connection is pooled using the request it returned
+        ensure_supported_version(req.version(), &uri)?;
+        let pool = match self.pool.as_ref() {
+            Some(pool) => pool_key(&mut ctx, &req).map(|key| (pool.clone(), key)),
+            None => None,
+        };
+        let sender = match req.version() {
             Version::HTTP_2 => {
                 let executor = ctx.executor().clone();
-                let (mut sender, conn) = hyper::client::conn::http2::handshake(executor, io)
+                let (sender, conn) = hyper::client::conn::http2::handshake(executor, io)
                     .await
                     .map_err(|err| HttpClientError::from_std(err).with_uri(uri.clone()))?;
 
@@ -129,13 +179,15 @@ where
                     }
                 });
 
-                sender
-                    .send_request(req)
-                    .await
-                    .map_err(|err: hyper::Error| HttpClientError::from_std(err).with_uri(uri))?
+                if let Some((pool, key)) = pool.as_ref() {
+                    // h2 connections are multiplexed, so can be shared immediately
+                    pool.checkin(key.clone(), PooledSender::Http2(sender.clone()));
+                }
+
+                PooledSender::Http2(sender)
             }
-            Version::HTTP_11 | Version::HTTP_10 | Version::HTTP_09 => {
-                let (mut sender, conn) = hyper::client::conn::http1::handshake(io)
+            _ => {
+                let (sender, conn) = hyper::client::conn::http1::handshake(io)
                     .await
                     .map_err(|err| HttpClientError::from_std(err).with_uri(uri.clone()))?;
 
@@ -145,22 +197,89 @@ where
                     }
                 });
 
-                sender
-                    .send_request(req)
-                    .await
-                    .map_err(|err| HttpClientError::from_std(err).with_uri(uri))?
-            }
-            version => {
-                return Err(HttpClientError::from_display(format!(
-                    "unsupported Http version: {:?}",
-                    version
-                ))
-                .with_uri(uri));
+                PooledSender::Http1(sender)
             }
         };
 
-        let resp = resp.map(crate::http::Body::new);
-        Ok(resp)
+        send_request(
+            &ctx,
+            sender,
+            pool.as_ref().map(|(pool, key)| (pool.clone(), key.clone())),
+            req,
+            uri,
+        )
+        .await
+    }
+}
+
+/// Send the request over the established connection,
+/// returning the http/1.1 connection to the pool (if any) once it can be reused.
+async fn send_request<State, Body>(
+    ctx: &Context<State>,
+    sender: PooledSender<Body>,
+    pool: Option<(ClientConnectionPool, PoolKey)>,
+    req: Request<Body>,
+    uri: crate::http::Uri,
+) -> Result<Response, HttpClientError>
+where
+    State: Send + Sync + 'static,
+    Body: http_body::Body + Unpin + Send + 'static,
+    Body::Data: Send + 'static,
+    Body::Error: Into<Box<dyn std::error::Error + Send + Sync>>,
+{
+    let resp = match sender {
+        PooledSender::Http2(mut sender) => sender
+            .send_request(req)
+            .await
+            .map_err(|err: hyper::Error| HttpClientError::from_std(err).with_uri(uri))?,
+        PooledSender::Http1(mut sender) => {
+            let resp = sender
+                .send_request(req)
+                .await
+                .map_err(|err| HttpClientError::from_std(err).with_uri(uri))?;
+
+            if let Some((pool, key)) = pool {
+                // an http/1.1 connection only becomes ready again
+                // once the response body has been fully consumed
+                ctx.spawn(async move {
+                    if sender.ready().await.is_ok() {
+                        pool.checkin(key, PooledSender::Http1(sender));
+                    }
+                });
+            }
+
+            resp
+        }
+    };
+
+    Ok(resp.map(crate::http::Body::new))
+}
+
+/// Returns the [`PoolKey`] of the connection to send the given request over, if poolable.
+fn pool_key<State, Body: 'static>(
+    ctx: &mut Context<State>,
+    req: &Request<Body>,
+) -> Option<PoolKey> {
+    let request_ctx = get_request_context!(*ctx, *req);
+    PoolKey::new(
+        request_ctx.authority.as_ref(),
+        &request_ctx.protocol,
+        ctx.get::<ProxyAddress>(),
+        ctx.get::<HttpsTunnel>(),
+        req,
+    )
+}
+
+/// Returns an error in case the [`HttpClient`] has no transport for the given http version,
+/// meaning any version other than http/0.9, http/1.0, http/1.1 and h2.
+fn ensure_supported_version(version: Version, uri: &Uri) -> Result<(), HttpClientError> {
+    match version {
+        Version::HTTP_2 | Version::HTTP_11 | Version::HTTP_10 | Version::HTTP_09 => Ok(()),
+        version => Err(HttpClientError::from_display(format!(
+            "unsupported Http version: {:?}",
+            version
+        ))
+        .with_uri(uri.clone())),
     }
 }
 
@@ -210,3 +329,30 @@ fn sanitize_client_req_header<S, B>(
         }
     })
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{error::OpaqueError, http::Body, service::service_fn};
+
+    #[tokio::test]
+    async fn test_http_client_unsupported_version_does_not_connect() {
+        let client = HttpClient::new(service_fn(
+            |_ctx: Context<()>, _req: Request<Body>| async move {
+                Err::<EstablishedClientConnection<tokio::io::DuplexStream, Body, ()>, _>(
+                    OpaqueError::from_display("connector called"),
+                )
+            },
+        ));
+
+        let req = Request::builder()
+            .version(Version::HTTP_3)
+            .uri("https://www.example.com/")
+            .body(Body::empty())
+            .unwrap();
+        let err = client.serve(Context::default(), req).await.unwrap_err();
+        let err = err.to_string();
+        assert!(err.contains("unsupported Http version"), "error: {err}");
+        assert!(!err.contains("connector called"), "error: {err}");
+    }
+}
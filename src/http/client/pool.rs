@@ -0,0 +1,505 @@
+use crate::{
+    http::{Request, Version},
+    net::{
+        address::{Authority, ProxyAddress},
+        Protocol,
+    },
+    tls::HttpsTunnel,
+};
+use hyper::client::conn::{http1, http2};
+use parking_lot::Mutex;
+use std::{
+    any::{Any, TypeId},
+    collections::HashMap,
+    fmt,
+    hash::{Hash, Hasher},
+    sync::Arc,
+    time::{Duration, Instant},
+};
+
+/// A pool of established http client connections,
+/// which can be used by the [`HttpClient`] to reuse connections
+/// instead of establishing a new one for every request.
+///
+/// Connections are keyed by the target [`Authority`], [`Protocol`] and http [`Version`],
+/// as well as the [`ProxyAddress`] and [`HttpsTunnel`] found in the [`Context`], if any.
+///
+/// - http/1.1 connections are reused one request at a time, and are only
+///   returned to the pool once the previous response has been fully consumed;
+/// - h2 connections are multiplexed, meaning a single connection per key is
+///   shared between all requests for as long as it remains open.
+///
+/// Connections not used for longer than the idle timeout are dropped,
+/// and the amount of idle connections kept per key is capped.
+///
+/// A pooled connection bypasses the connector of the [`HttpClient`] that created it,
+/// so any per-request side effects of that connector only apply to the first request.
+///
+/// [`HttpClient`]: crate::http::client::HttpClient
+/// [`Context`]: crate::service::Context
+#[derive(Clone)]
+pub struct ClientConnectionPool {
+    inner: Arc<PoolInner>,
+}
+
+struct PoolInner {
+    idle_timeout: Duration,
+    max_idle_per_host: usize,
+    connections: Mutex<HashMap<PoolKey, Vec<IdleConnection>>>,
+}
+
+struct IdleConnection {
+    sender: Box<dyn Any + Send>,
+    /// checks if the (type erased) sender is closed, see [`PooledSender::is_closed_erased`]
+    is_closed: fn(&(dyn Any + Send)) -> bool,
+    idle_since: Instant,
+}
+
+impl fmt::Debug for ClientConnectionPool {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("ClientConnectionPool")
+            .field("idle_timeout", &self.inner.idle_timeout)
+            .field("max_idle_per_host", &self.inner.max_idle_per_host)
+            .finish()
+    }
+}
+
+impl Default for ClientConnectionPool {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl ClientConnectionPool {
+    /// The default duration after which an idle connection is dropped.
+    pub const DEFAULT_IDLE_TIMEOUT: Duration = Duration::from_secs(90);
+
+    /// The default amount of idle connections kept for a single key.
+    pub const DEFAULT_MAX_IDLE_PER_HOST: usize = 32;
+
+    /// Create a new [`ClientConnectionPool`] with the default settings.
+    pub fn new() -> Self {
+        Self::with_settings(Self::DEFAULT_IDLE_TIMEOUT, Self::DEFAULT_MAX_IDLE_PER_HOST)
+    }
+
+    /// Create a new [`ClientConnectionPool`] with the given idle timeout
+    /// and maximum amount of idle connections per key.
+    pub fn with_settings(idle_timeout: Duration, max_idle_per_host: usize) -> Self {
+        Self {
+            inner: Arc::new(PoolInner {
+                idle_timeout,
+                max_idle_per_host,
+                connections: Mutex::new(HashMap::new()),
+            }),
+        }
+    }
+
+    /// Return the duration after which an idle connection is dropped.
+    pub fn idle_timeout(&self) -> Duration {
+        self.inner.idle_timeout
+    }
+
+    /// Return the maximum amount of idle connections kept for a single key.
+    pub fn max_idle_per_host(&self) -> usize {
+        self.inner.max_idle_per_host
+    }
+
+    /// Return the amount of idle connections currently stored in the pool.
+    pub fn idle_count(&self) -> usize {
+        self.inner.connections.lock().values().map(Vec::len).sum()
+    }
+
+    /// Drop all idle connections that are closed or idle for too long.
+    pub fn purge_expired(&self) {
+        let idle_timeout = self.inner.idle_timeout;
+        let mut connections = self.inner.connections.lock();
+        connections.retain(|_, idle| {
+            idle.retain(|conn| {
+                conn.idle_since.elapsed() < idle_timeout && !(conn.is_closed)(conn.sender.as_ref())
+            });
+            !idle.is_empty()
+        });
+    }
+
+    /// Checkout a sender from the pool which is ready to send a request.
+    ///
+    /// h2 senders remain in the pool, as they can be shared,
+    /// while http/1.1 senders are removed until they are returned via [`Self::checkin`].
+    pub(crate) fn checkout<B: Send + 'static>(&self, key: &PoolKey) -> Option<PooledSender<B>> {
+        debug_assert_eq!(key.body, TypeId::of::<B>());
+
+        let mut connections = self.inner.connections.lock();
+        let idle = connections.get_mut(key)?;
+
+        let idle_timeout = self.inner.idle_timeout;
+        let mut found = None;
+
+        while let Some(mut conn) = idle.pop() {
+            let usable = conn.idle_since.elapsed() < idle_timeout
+                && conn
+                    .sender
+                    .downcast_ref::<PooledSender<B>>()
+                    .map(PooledSender::is_ready)
+                    .unwrap_or_default();
+            if !usable {
+                tracing::trace!(?key, "http client pool: drop expired or closed connection");
+                continue;
+            }
+
+            match conn.sender.downcast::<PooledSender<B>>() {
+                Ok(sender) => match *sender {
+                    PooledSender::Http2(sender) => {
+                        conn.sender = Box::new(PooledSender::Http2(sender.clone()));
+                        conn.idle_since = Instant::now();
+                        idle.push(conn);
+                        found = Some(PooledSender::Http2(sender));
+                    }
+                    sender @ PooledSender::Http1(_) => found = Some(sender),
+                },
+                Err(_) => continue,
+            }
+            break;
+        }
+
+        if idle.is_empty() {
+            connections.remove(key);
+        }
+
+        found
+    }
+
+    /// Return a sender to the pool so it can be reused by future requests.
+    ///
+    /// The sender is dropped in case the pool has no room left for the given key.
+    pub(crate) fn checkin<B: Send + 'static>(&self, key: PoolKey, sender: PooledSender<B>) {
+        debug_assert_eq!(key.body, TypeId::of::<B>());
+
+        if !sender.is_ready() {
+            return;
+        }
+
+        let mut connections = self.inner.connections.lock();
+        let idle = connections.entry(key).or_default();
+        if idle.len() >= self.inner.max_idle_per_host {
+            tracing::trace!("http client pool: drop connection, max idle connections reached");
+            return;
+        }
+        idle.push(IdleConnection {
+            sender: Box::new(sender),
+            is_closed: PooledSender::<B>::is_closed_erased,
+            idle_since: Instant::now(),
+        });
+    }
+}
+
+/// A sender of an established connection stored in the [`ClientConnectionPool`].
+pub(crate) enum PooledSender<B> {
+    Http1(http1::SendRequest<B>),
+    Http2(http2::SendRequest<B>),
+}
+
+impl<B> PooledSender<B> {
+    fn is_ready(&self) -> bool {
+        match self {
+            PooledSender::Http1(sender) => sender.is_ready() && !sender.is_closed(),
+            PooledSender::Http2(sender) => sender.is_ready() && !sender.is_closed(),
+        }
+    }
+
+    fn is_closed(&self) -> bool {
+        match self {
+            PooledSender::Http1(sender) => sender.is_closed(),
+            PooledSender::Http2(sender) => sender.is_closed(),
+        }
+    }
+}
+
+impl<B: Send + 'static> PooledSender<B> {
+    /// Checks if the given type erased sender, stored in the pool, is closed.
+    fn is_closed_erased(sender: &(dyn Any + Send)) -> bool {
+        sender
+            .downcast_ref::<Self>()
+            .map(Self::is_closed)
+            .unwrap_or(true)
+    }
+}
+
+#[derive(Clone, PartialEq, Eq)]
+/// The key used to store and find connections in the [`ClientConnectionPool`].
+pub(crate) struct PoolKey {
+    authority: Authority,
+    protocol: Protocol,
+    version: Version,
+    proxy: Option<ProxyAddress>,
+    tunnel: Option<String>,
+    body: TypeId,
+}
+
+impl PoolKey {
+    /// Create a new [`PoolKey`] for the given request.
+    ///
+    /// Returns `None` in case the request is not fit to be sent over a pooled connection.
+    pub(crate) fn new<Body: 'static>(
+        authority: Option<&Authority>,
+        protocol: &Protocol,
+        proxy: Option<&ProxyAddress>,
+        tunnel: Option<&HttpsTunnel>,
+        req: &Request<Body>,
+    ) -> Option<Self> {
+        if req.method() == crate::http::Method::CONNECT
+            || req.headers().contains_key(crate::http::header::UPGRADE)
+        {
+            // upgraded connections are consumed by the request that upgraded them
+            return None;
+        }
+
+        let version = match req.version() {
+            Version::HTTP_2 => Version::HTTP_2,
+            Version::HTTP_11 | Version::HTTP_10 => Version::HTTP_11,
+            _ => return None,
+        };
+
+        Some(Self {
+            authority: authority?.clone(),
+            protocol: protocol.clone(),
+            version,
+            proxy: proxy.cloned(),
+            tunnel: tunnel.map(|tunnel| tunnel.server_name.clone()),
+            body: TypeId::of::<Body>(),
+        })
+    }
+}
+
+impl Hash for PoolKey {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        self.authority.hash(state);
+        self.protocol.hash(state);
+        self.version.hash(state);
+        // credentials are not hashed, only compared,
+        // which is fine given equal keys still produce equal hashes
+        self.proxy
+            .as_ref()
+            .map(|proxy| (proxy.protocol(), proxy.authority()))
+            .hash(state);
+        self.tunnel.hash(state);
+        self.body.hash(state);
+    }
+}
+
+impl fmt::Debug for PoolKey {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("PoolKey")
+            .field("authority", &self.authority)
+            .field("protocol", &self.protocol)
+            .field("version", &self.version)
+            .field("proxy", &self.proxy.as_ref().map(|proxy| proxy.authority()))
+            .field("tunnel", &self.tunnel)
+            .finish()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::error::OpaqueError;
+    use crate::http::client::{ClientConnection, EstablishedClientConnection, HttpClient};
+    use crate::http::server::HttpServer;
+    use crate::http::{Body, BodyExtractExt, IntoResponse};
+    use crate::rt::Executor;
+    use crate::service::{service_fn, Context, Service};
+    use std::convert::Infallible;
+    use std::sync::atomic::{AtomicUsize, Ordering};
+    use tokio::task::JoinHandle;
+
+    /// A pooled [`HttpClient`] connecting over in-memory streams to an http server,
+    /// keeping track of the server connections it established.
+    fn loopback_client(
+        pool: ClientConnectionPool,
+        servers: Arc<Mutex<Vec<JoinHandle<()>>>>,
+    ) -> impl Service<
+        (),
+        Request<Body>,
+        Response = crate::http::Response,
+        Error = crate::http::client::HttpClientError,
+    > {
+        HttpClient::new(service_fn(move |ctx: Context<()>, req: Request<Body>| {
+            let servers = servers.clone();
+            async move {
+                let (client, server) = tokio::io::duplex(64 * 1024);
+                servers.lock().push(tokio::spawn(async move {
+                    let _ = HttpServer::auto(Executor::new())
+                        .serve(
+                            Context::default(),
+                            server,
+                            service_fn(|_ctx: Context<()>, _req: Request| async {
+                                Ok::<_, Infallible>("hello".into_response())
+                            }),
+                        )
+                        .await;
+                }));
+                Ok::<_, OpaqueError>(EstablishedClientConnection {
+                    ctx,
+                    req,
+                    conn: ClientConnection::new(([127, 0, 0, 1], 80).into(), client),
+                })
+            }
+        }))
+        .with_connection_pool(pool)
+    }
+
+    fn request(version: Version) -> Request<Body> {
+        Request::builder()
+            .version(version)
+            .uri("http://example.com/")
+            .body(Body::empty())
+            .unwrap()
+    }
+
+    async fn idle_count_eventually(pool: &ClientConnectionPool, count: usize) {
+        for _ in 0..100 {
+            if pool.idle_count() == count {
+                return;
+            }
+            tokio::time::sleep(Duration::from_millis(10)).await;
+        }
+        assert_eq!(pool.idle_count(), count);
+    }
+
+    fn key(authority: &str, version: Version) -> Option<PoolKey> {
+        let authority: Authority = authority.try_into().unwrap();
+        let req = Request::builder()
+            .version(version)
+            .uri(format!("http://{authority}/"))
+            .body(())
+            .unwrap();
+        PoolKey::new(Some(&authority), &Protocol::HTTP, None, None, &req)
+    }
+
+    #[test]
+    fn test_pool_key_eq() {
+        assert_eq!(
+            key("example.com:80", Version::HTTP_11),
+            key("example.com:80", Version::HTTP_10)
+        );
+        assert_ne!(
+            key("example.com:80", Version::HTTP_11),
+            key("example.com:80", Version::HTTP_2)
+        );
+        assert_ne!(
+            key("example.com:80", Version::HTTP_11),
+            key("example.com:8080", Version::HTTP_11)
+        );
+    }
+
+    #[test]
+    fn test_pool_key_not_poolable() {
+        assert!(key("example.com:80", Version::HTTP_09).is_none());
+
+        let authority: Authority = "example.com:443".try_into().unwrap();
+        let req = Request::builder()
+            .method(crate::http::Method::CONNECT)
+            .uri("example.com:443")
+            .body(())
+            .unwrap();
+        assert!(PoolKey::new(Some(&authority), &Protocol::HTTPS, None, None, &req).is_none());
+
+        let req = Request::builder()
+            .uri("http://example.com/")
+            .body(())
+            .unwrap();
+        assert!(PoolKey::new(None, &Protocol::HTTP, None, None, &req).is_none());
+    }
+
+    #[test]
+    fn test_pool_empty_checkout() {
+        let pool = ClientConnectionPool::new();
+        let key = key("example.com:80", Version::HTTP_11).unwrap();
+        assert!(pool.checkout::<()>(&key).is_none());
+        assert_eq!(pool.idle_count(), 0);
+    }
+
+    #[tokio::test]
+    async fn test_pool_reuses_http1_connection() {
+        let pool = ClientConnectionPool::new();
+        let servers = Arc::new(Mutex::new(Vec::new()));
+        let client = loopback_client(pool.clone(), servers.clone());
+
+        for _ in 0..2 {
+            let res = client
+                .serve(Context::default(), request(Version::HTTP_11))
+                .await
+                .unwrap();
+            assert_eq!(res.try_into_string().await.unwrap(), "hello");
+            // returned to the pool once the response is consumed
+            idle_count_eventually(&pool, 1).await;
+        }
+        assert_eq!(servers.lock().len(), 1);
+    }
+
+    #[tokio::test]
+    async fn test_pool_shares_h2_connection() {
+        let pool = ClientConnectionPool::new();
+        let servers = Arc::new(Mutex::new(Vec::new()));
+        let client = loopback_client(pool.clone(), servers.clone());
+
+        // h2 senders are pooled as soon as the connection is established,
+        // and remain in the pool while in use
+        let first = client
+            .serve(Context::default(), request(Version::HTTP_2))
+            .await
+            .unwrap();
+        assert_eq!(pool.idle_count(), 1);
+        let second = client
+            .serve(Context::default(), request(Version::HTTP_2))
+            .await
+            .unwrap();
+        assert_eq!(pool.idle_count(), 1);
+
+        assert_eq!(first.try_into_string().await.unwrap(), "hello");
+        assert_eq!(second.try_into_string().await.unwrap(), "hello");
+        assert_eq!(servers.lock().len(), 1);
+    }
+
+    #[tokio::test]
+    async fn test_pool_purge_expired() {
+        let pool = ClientConnectionPool::with_settings(Duration::from_millis(200), 8);
+        let servers = Arc::new(Mutex::new(Vec::new()));
+        let client = loopback_client(pool.clone(), servers.clone());
+
+        // dropped once idle for longer than the idle timeout
+        let res = client
+            .serve(Context::default(), request(Version::HTTP_11))
+            .await
+            .unwrap();
+        res.try_into_string().await.unwrap();
+        idle_count_eventually(&pool, 1).await;
+        pool.purge_expired();
+        assert_eq!(pool.idle_count(), 1);
+        tokio::time::sleep(Duration::from_millis(300)).await;
+        pool.purge_expired();
+        assert_eq!(pool.idle_count(), 0);
+
+        // a closed connection is dropped as well, even while not yet idle for too long
+        let pool = ClientConnectionPool::new();
+        let servers = Arc::new(Mutex::new(Vec::new()));
+        let client = loopback_client(pool.clone(), servers.clone());
+        let res = client
+            .serve(Context::default(), request(Version::HTTP_2))
+            .await
+            .unwrap();
+        res.try_into_string().await.unwrap();
+        pool.purge_expired();
+        assert_eq!(pool.idle_count(), 1);
+        for server in servers.lock().iter() {
+            server.abort();
+        }
+        for _ in 0..100 {
+            pool.purge_expired();
+            if pool.idle_count() == 0 {
+                break;
+            }
+            tokio::time::sleep(Duration::from_millis(1)).await;
+        }
+        assert_eq!(pool.idle_count(), 0);
+    }
+}
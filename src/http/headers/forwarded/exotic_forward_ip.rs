@@ -102,7 +102,7 @@ macro_rules! exotic_forward_ip_headers {
 
                 fn encode<E: Extend<HeaderValue>>(&self, values: &mut E) {
                     let s = self.0.to_string();
-                    values.extend(Some(HeaderValue::from_str(&s).unwrap()))
+                    values.extend(Some(HeaderValue::try_from(s).unwrap()))
                 }
             }
 
@@ -1,5 +1,8 @@
+use crate::http::headers::HeaderMapExt;
+use crate::http::{header, HeaderMap, HeaderValue};
 pub use crate::net::forwarded::Forwarded;
 use crate::net::forwarded::ForwardedElement;
+use std::fmt::Write;
 
 mod via;
 #[doc(inline)]
@@ -33,6 +36,22 @@ pub trait ForwardHeader:
     where
         I: IntoIterator<Item = &'a ForwardedElement>,
         Self: Sized;
+
+    /// Insert the header for the given iterator of `ForwardedElement`,
+    /// replacing the existing header values, if any.
+    ///
+    /// Nothing is inserted in case the conversion fails.
+    /// Implementations can overwrite this method to write the header value
+    /// directly, without creating the header first.
+    fn insert_forwarded<'a, I>(headers: &mut HeaderMap, input: I)
+    where
+        I: IntoIterator<Item = &'a ForwardedElement>,
+        Self: Sized,
+    {
+        if let Some(header) = Self::try_from_forwarded(input) {
+            headers.typed_insert(header);
+        }
+    }
 }
 
 impl ForwardHeader for Forwarded {
@@ -45,6 +64,32 @@ impl ForwardHeader for Forwarded {
         forwarded.extend(it.cloned());
         Some(forwarded)
     }
+
+    fn insert_forwarded<'a, I>(headers: &mut HeaderMap, input: I)
+    where
+        I: IntoIterator<Item = &'a ForwardedElement>,
+    {
+        // render the elements straight into a single buffer,
+        // instead of cloning them into a new chain first
+        let mut value = String::new();
+        for element in input {
+            if !value.is_empty() {
+                value.push(',');
+            }
+            let _ = write!(value, "{element}");
+        }
+        if value.is_empty() {
+            return;
+        }
+        match HeaderValue::try_from(value) {
+            Ok(value) => {
+                headers.insert(header::FORWARDED, value);
+            }
+            Err(err) => {
+                tracing::trace!(err = %err, "failed to turn Forwarded elements into header value");
+            }
+        }
+    }
 }
 
 #[cfg(test)]
@@ -66,4 +111,37 @@ mod tests {
         assert_forward_header::<ClientIp>();
         assert_forward_header::<XRealIp>();
     }
+
+    #[test]
+    fn test_forwarded_insert_forwarded() {
+        let forwarded: Forwarded =
+            "for=12.23.34.45,by=12.23.34.46;for=\"127.0.0.1:62345\";proto=https"
+                .parse()
+                .unwrap();
+
+        let mut headers = HeaderMap::new();
+        headers.insert(header::FORWARDED, HeaderValue::from_static("for=1.1.1.1"));
+        Forwarded::insert_forwarded(&mut headers, forwarded.iter());
+        assert_eq!(headers.get_all(header::FORWARDED).iter().count(), 1);
+        assert_eq!(headers.typed_get::<Forwarded>(), Some(forwarded.clone()));
+
+        let mut typed_headers = HeaderMap::new();
+        typed_headers.typed_insert(forwarded);
+        assert_eq!(headers, typed_headers);
+
+        let mut headers = HeaderMap::new();
+        Forwarded::insert_forwarded(&mut headers, std::iter::empty());
+        assert!(headers.is_empty());
+
+        XForwardedFor::insert_forwarded(
+            &mut headers,
+            [
+                &ForwardedElement::forwarded_for(
+                    "12.23.34.45".parse::<std::net::IpAddr>().unwrap(),
+                ),
+                &ForwardedElement::forwarded_by(std::net::IpAddr::from([127, 0, 0, 1])),
+            ],
+        );
+        assert_eq!(headers.get("x-forwarded-for").unwrap(), "12.23.34.45");
+    }
 }
@@ -76,7 +76,7 @@ impl Header for Via {
                 crate::http::headers::util::csv::fmt_comma_delimited(&mut *f, self.0.iter())
             })
         );
-        values.extend(Some(HeaderValue::from_str(&s).unwrap()))
+        values.extend(Some(HeaderValue::try_from(s).unwrap()))
     }
 }
 
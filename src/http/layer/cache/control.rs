@@ -0,0 +1,101 @@
+use crate::http::{header, HeaderMap};
+use std::time::Duration;
+
+/// The `Cache-Control` directives relevant to a shared cache,
+/// of either a request or a response.
+///
+/// Directives with a field-name list (e.g. `no-cache="set-cookie"`)
+/// are treated as their unqualified variant, which is the conservative choice.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub(super) struct CacheControl {
+    pub(super) no_store: bool,
+    pub(super) no_cache: bool,
+    pub(super) private: bool,
+    pub(super) public: bool,
+    pub(super) must_revalidate: bool,
+    pub(super) only_if_cached: bool,
+    pub(super) max_age: Option<Duration>,
+    pub(super) s_maxage: Option<Duration>,
+    pub(super) max_stale: Option<Duration>,
+    pub(super) min_fresh: Option<Duration>,
+    pub(super) stale_while_revalidate: Option<Duration>,
+}
+
+impl CacheControl {
+    /// Parse the directives of all `Cache-Control` headers,
+    /// ignoring unknown and invalid directives.
+    pub(super) fn from_headers(headers: &HeaderMap) -> Self {
+        let mut cc = Self::default();
+        for value in headers.get_all(header::CACHE_CONTROL) {
+            let Ok(value) = value.to_str() else {
+                continue;
+            };
+            for directive in value.split(',') {
+                let (name, arg) = match directive.split_once('=') {
+                    Some((name, arg)) => (name.trim(), Some(arg.trim().trim_matches('"'))),
+                    None => (directive.trim(), None),
+                };
+                let seconds = || {
+                    arg.and_then(|arg| arg.parse::<u64>().ok())
+                        .map(Duration::from_secs)
+                };
+                match name.to_ascii_lowercase().as_str() {
+                    "no-store" => cc.no_store = true,
+                    "no-cache" => cc.no_cache = true,
+                    "private" => cc.private = true,
+                    "public" => cc.public = true,
+                    "must-revalidate" | "proxy-revalidate" => cc.must_revalidate = true,
+                    "only-if-cached" => cc.only_if_cached = true,
+                    "max-age" => cc.max_age = seconds(),
+                    "s-maxage" => cc.s_maxage = seconds(),
+                    // a max-stale without value accepts a response of any staleness
+                    "max-stale" => cc.max_stale = seconds().or(Some(Duration::MAX)),
+                    "min-fresh" => cc.min_fresh = seconds(),
+                    "stale-while-revalidate" => cc.stale_while_revalidate = seconds(),
+                    _ => (),
+                }
+            }
+        }
+        cc
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::http::HeaderValue;
+
+    #[test]
+    fn test_cache_control_from_headers() {
+        let mut headers = HeaderMap::new();
+        headers.append(
+            header::CACHE_CONTROL,
+            HeaderValue::from_static("public, Max-Age=60, s-maxage=\"120\""),
+        );
+        headers.append(
+            header::CACHE_CONTROL,
+            HeaderValue::from_static("stale-while-revalidate=30, no-cache=\"set-cookie\", foo"),
+        );
+        let cc = CacheControl::from_headers(&headers);
+        assert_eq!(
+            cc,
+            CacheControl {
+                public: true,
+                no_cache: true,
+                max_age: Some(Duration::from_secs(60)),
+                s_maxage: Some(Duration::from_secs(120)),
+                stale_while_revalidate: Some(Duration::from_secs(30)),
+                ..Default::default()
+            }
+        );
+
+        let mut headers = HeaderMap::new();
+        headers.insert(
+            header::CACHE_CONTROL,
+            HeaderValue::from_static("max-stale, max-age=invalid"),
+        );
+        let cc = CacheControl::from_headers(&headers);
+        assert_eq!(cc.max_stale, Some(Duration::MAX));
+        assert_eq!(cc.max_age, None);
+    }
+}
@@ -0,0 +1,64 @@
+use super::service::CacheShared;
+use super::{Cache, MemoryStorage};
+use crate::service::Layer;
+use std::sync::Arc;
+
+/// A [`Layer`] which stores responses in a shared HTTP cache and serves requests from it.
+///
+/// See the [module docs](super) for more details.
+#[derive(Debug, Clone)]
+pub struct CacheLayer<St = MemoryStorage> {
+    storage: St,
+    max_body_size: usize,
+}
+
+impl CacheLayer {
+    /// The default maximum size of a response body that is stored.
+    pub const DEFAULT_MAX_BODY_SIZE: usize = 1024 * 1024;
+
+    /// Create a new [`CacheLayer`], using a new [`MemoryStorage`].
+    pub fn new() -> Self {
+        Self::with_storage(MemoryStorage::new())
+    }
+}
+
+impl Default for CacheLayer {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl<St> CacheLayer<St> {
+    /// Create a new [`CacheLayer`], storing the responses in the given [`CacheStorage`].
+    ///
+    /// The storage is cloned for every service created by this layer,
+    /// wrap it in an [`Arc`] in case it cannot be cloned cheaply
+    /// or its clones do not share their entries.
+    ///
+    /// [`CacheStorage`]: super::CacheStorage
+    pub fn with_storage(storage: St) -> Self {
+        Self {
+            storage,
+            max_body_size: CacheLayer::<MemoryStorage>::DEFAULT_MAX_BODY_SIZE,
+        }
+    }
+
+    /// Set the maximum size of a response body that is stored.
+    ///
+    /// Larger responses are streamed to the client without being stored.
+    pub fn with_max_body_size(mut self, max_body_size: usize) -> Self {
+        self.max_body_size = max_body_size;
+        self
+    }
+}
+
+impl<S, St: Clone> Layer<S> for CacheLayer<St> {
+    type Service = Cache<S, St>;
+
+    fn layer(&self, inner: S) -> Self::Service {
+        Cache::from_shared(
+            inner,
+            Arc::new(CacheShared::new(self.storage.clone(), self.max_body_size)),
+        )
+    }
+}
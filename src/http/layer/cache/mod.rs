@@ -0,0 +1,86 @@
+//! Middleware which caches responses, as a shared HTTP cache ([RFC 9111]).
+//!
+//! The [`Cache`] middleware stores the responses of `GET` requests
+//! that are allowed to be stored by a shared cache, and serves later requests
+//! for the same target from it, for as long as the stored response is fresh:
+//!
+//! - freshness is determined by `Cache-Control: s-maxage` or `max-age`,
+//!   or by `Expires`, falling back to a heuristic based on `Last-Modified`;
+//! - stale responses with an `ETag` or `Last-Modified` validator are revalidated
+//!   using a conditional request, updating the stored response on `304 Not Modified`;
+//! - `stale-while-revalidate` responses are served stale while revalidating in the background;
+//! - `Vary` is respected, storing a variant per set of selected request header values;
+//! - concurrent requests for a response which is not stored yet
+//!   are collapsed into a single upstream request.
+//!
+//! Responses marked `no-store` or `private`, responses with a `Set-Cookie` header
+//! and (unless explicitly allowed) responses to requests with an `Authorization` header
+//! are never stored. Unsafe requests (e.g. `POST`) invalidate the stored responses
+//! of their target, in case they succeed.
+//!
+//! Responses are kept in a [`CacheStorage`], which is a sharded in-memory
+//! [`MemoryStorage`] by default, bounded by a byte budget.
+//!
+//! Place the [`CacheLayer`] outside of a [`CompressionLayer`], such that compressed
+//! responses are stored as variants of the `Accept-Encoding` request header
+//! and do not need to be compressed again. It can as well wrap an
+//! [`HttpClient`](crate::http::client::HttpClient), to cache upstream responses
+//! in a (reverse) proxy.
+//!
+//! [RFC 9111]: https://www.rfc-editor.org/rfc/rfc9111
+//! [`CompressionLayer`]: crate::http::layer::compression::CompressionLayer
+//!
+//! # Example
+//!
+//! ```
+//! use rama::http::layer::cache::{CacheLayer, MemoryStorage};
+//! use rama::http::{header, Body, HeaderValue, IntoResponse, Request, Response};
+//! use rama::service::{Context, Layer, Service, service_fn};
+//! use std::convert::Infallible;
+//! use std::sync::atomic::{AtomicUsize, Ordering};
+//!
+//! # #[tokio::main]
+//! # async fn main() {
+//! static CALLS: AtomicUsize = AtomicUsize::new(0);
+//!
+//! let service = CacheLayer::with_storage(MemoryStorage::new().with_max_size(16 * 1024 * 1024))
+//!     .layer(service_fn(|_ctx: Context<()>, _req: Request| async move {
+//!         CALLS.fetch_add(1, Ordering::SeqCst);
+//!         let mut res = "Hello, World!".into_response();
+//!         res.headers_mut().insert(
+//!             header::CACHE_CONTROL,
+//!             HeaderValue::from_static("public, max-age=60"),
+//!         );
+//!         Ok::<_, Infallible>(res)
+//!     }));
+//!
+//! for _ in 0..3 {
+//!     let req = Request::builder()
+//!         .uri("http://example.com/hello")
+//!         .body(Body::empty())
+//!         .unwrap();
+//!     let res = service.serve(Context::default(), req).await.unwrap();
+//!     assert!(res.status().is_success());
+//! }
+//!
+//! // served from the cache after the first request
+//! assert_eq!(CALLS.load(Ordering::SeqCst), 1);
+//! # }
+//! ```
+
+mod control;
+
+mod storage;
+#[doc(inline)]
+pub use storage::{CacheEntry, CacheStorage, CachedResponse, MemoryStorage};
+
+mod service;
+#[doc(inline)]
+pub use service::Cache;
+
+mod layer;
+#[doc(inline)]
+pub use layer::CacheLayer;
+
+#[cfg(test)]
+mod tests;
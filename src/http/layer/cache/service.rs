@@ -0,0 +1,644 @@
+use super::control::CacheControl;
+use super::storage::{CacheEntry, CacheStorage, CachedResponse, MemoryStorage};
+use crate::error::BoxError;
+use crate::http::dep::http_body::{Body as HttpBody, Frame};
+use crate::http::dep::http_body_util::{BodyExt, BodyStream, StreamBody};
+use crate::http::headers::{self, HeaderMapExt};
+use crate::http::{
+    get_request_context, header, Body, HeaderMap, HeaderValue, Method, Request, Response,
+    StatusCode,
+};
+use crate::service::{Context, Service};
+use bytes::{Bytes, BytesMut};
+use parking_lot::Mutex;
+use std::{
+    collections::HashMap,
+    fmt,
+    sync::Arc,
+    time::{Duration, Instant, SystemTime},
+};
+
+/// Middleware which stores responses in a shared HTTP cache,
+/// as specified by [RFC 9111], and serves requests from it.
+///
+/// See the [module docs](super) for more details.
+///
+/// [RFC 9111]: https://www.rfc-editor.org/rfc/rfc9111
+pub struct Cache<S, St = MemoryStorage> {
+    inner: Arc<S>,
+    shared: Arc<CacheShared<St>>,
+}
+
+pub(super) struct CacheShared<St> {
+    pub(super) storage: St,
+    pub(super) max_body_size: usize,
+    /// locks of the requests currently fetching a response for a key,
+    /// which concurrent requests for the same key wait on
+    inflight: Mutex<HashMap<String, Arc<tokio::sync::Mutex<()>>>>,
+}
+
+impl<St> CacheShared<St> {
+    pub(super) fn new(storage: St, max_body_size: usize) -> Self {
+        Self {
+            storage,
+            max_body_size,
+            inflight: Mutex::new(HashMap::new()),
+        }
+    }
+}
+
+impl<St: fmt::Debug> fmt::Debug for CacheShared<St> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("CacheShared")
+            .field("storage", &self.storage)
+            .field("max_body_size", &self.max_body_size)
+            .finish()
+    }
+}
+
+impl<S, St> Cache<S, St> {
+    pub(super) fn from_shared(inner: S, shared: Arc<CacheShared<St>>) -> Self {
+        Self {
+            inner: Arc::new(inner),
+            shared,
+        }
+    }
+
+    /// Gets a reference to the underlying service.
+    pub fn get_ref(&self) -> &S {
+        &self.inner
+    }
+
+    /// Gets a reference to the [`CacheStorage`] used by this service.
+    pub fn storage(&self) -> &St {
+        &self.shared.storage
+    }
+}
+
+impl<S> Cache<S> {
+    /// Create a new [`Cache`] wrapping the given service,
+    /// using a new [`MemoryStorage`].
+    ///
+    /// See [`CacheLayer`] to configure the cache.
+    ///
+    /// [`CacheLayer`]: super::CacheLayer
+    pub fn new(inner: S) -> Self {
+        Self::from_shared(
+            inner,
+            Arc::new(CacheShared::new(
+                MemoryStorage::new(),
+                super::CacheLayer::<MemoryStorage>::DEFAULT_MAX_BODY_SIZE,
+            )),
+        )
+    }
+}
+
+impl<S: fmt::Debug, St: fmt::Debug> fmt::Debug for Cache<S, St> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("Cache")
+            .field("inner", &self.inner)
+            .field("shared", &self.shared)
+            .finish()
+    }
+}
+
+impl<S, St> Clone for Cache<S, St> {
+    fn clone(&self) -> Self {
+        Self {
+            inner: self.inner.clone(),
+            shared: self.shared.clone(),
+        }
+    }
+}
+
+/// How a request can be served, given the stored response (if any).
+enum Lookup {
+    /// the stored response can be served as-is
+    Fresh(Arc<CachedResponse>),
+    /// the stored response can be served, but has to revalidated in the background
+    StaleWhileRevalidate(Arc<CachedResponse>),
+    /// the stored response can only be served after revalidating it
+    Revalidate(Arc<CachedResponse>),
+    /// no (usable) stored response
+    Miss,
+}
+
+impl<S, St, State, ReqBody, ResBody> Service<State, Request<ReqBody>> for Cache<S, St>
+where
+    S: Service<State, Request<ReqBody>, Response = Response<ResBody>>,
+    S::Error: Into<BoxError>,
+    St: CacheStorage,
+    State: Send + Sync + 'static,
+    ReqBody: Send + 'static,
+    ResBody: HttpBody<Data = Bytes> + Send + Sync + 'static,
+    ResBody::Error: Into<BoxError>,
+{
+    type Response = Response;
+    type Error = BoxError;
+
+    async fn serve(
+        &self,
+        mut ctx: Context<State>,
+        req: Request<ReqBody>,
+    ) -> Result<Self::Response, Self::Error> {
+        let key = cache_key(get_request_context!(ctx, req).protocol.as_str(), &req);
+
+        if req.method() != Method::GET || req.headers().contains_key(header::RANGE) {
+            let invalidate = !req.method().is_safe();
+            let res = self.inner.serve(ctx, req).await.map_err(Into::into)?;
+            if let Some(key) = key.filter(|_| {
+                invalidate && (res.status().is_success() || res.status().is_redirection())
+            }) {
+                // unsafe methods invalidate the stored responses of their target
+                self.shared.storage.remove(&key).await;
+            }
+            return Ok(res.map(Body::new));
+        }
+
+        let Some(key) = key else {
+            let res = self.inner.serve(ctx, req).await.map_err(Into::into)?;
+            return Ok(res.map(Body::new));
+        };
+
+        let req_cc = CacheControl::from_headers(req.headers());
+
+        match lookup(&self.shared, &key, req.headers(), &req_cc).await {
+            Lookup::Fresh(cached) => return Ok(serve_cached(&cached, req.headers())),
+            Lookup::StaleWhileRevalidate(cached) => {
+                let res = serve_cached(&cached, req.headers());
+                // revalidate in the background, unless it is already being fetched
+                if let Ok(inflight) = InflightGuard::try_lead(&self.shared, &key) {
+                    let inner = self.inner.clone();
+                    let background_ctx = ctx.clone();
+                    ctx.spawn(async move {
+                        let shared = &inflight.shared;
+                        if let Err(err) =
+                            fetch(&*inner, shared, background_ctx, req, key, Some(cached)).await
+                        {
+                            tracing::debug!(
+                                error = %err,
+                                "failed to revalidate stale cached response"
+                            );
+                        }
+                    });
+                }
+                return Ok(res);
+            }
+            Lookup::Revalidate(cached) => {
+                return fetch(&*self.inner, &self.shared, ctx, req, key, Some(cached)).await;
+            }
+            Lookup::Miss if req_cc.only_if_cached => {
+                let mut res = Response::new(Body::empty());
+                *res.status_mut() = StatusCode::GATEWAY_TIMEOUT;
+                return Ok(res);
+            }
+            Lookup::Miss => (),
+        }
+
+        // collapse concurrent misses for the same key into a single upstream fetch
+        let lock = match InflightGuard::try_lead(&self.shared, &key) {
+            Ok(_inflight) => {
+                return fetch(&*self.inner, &self.shared, ctx, req, key, None).await;
+            }
+            Err(lock) => lock,
+        };
+
+        // wait for the leading request, and use its response if it got stored
+        drop(lock.lock().await);
+        if let Lookup::Fresh(cached) = lookup(&self.shared, &key, req.headers(), &req_cc).await {
+            return Ok(serve_cached(&cached, req.headers()));
+        }
+
+        fetch(&*self.inner, &self.shared, ctx, req, key, None).await
+    }
+}
+
+/// Registers the upstream fetch for a key, for as long as it is alive,
+/// such that concurrent requests for the same key can wait on it.
+struct InflightGuard<St> {
+    shared: Arc<CacheShared<St>>,
+    key: String,
+    lock: Arc<tokio::sync::Mutex<()>>,
+    _guard: tokio::sync::OwnedMutexGuard<()>,
+}
+
+impl<St> InflightGuard<St> {
+    /// Register an upstream fetch for the given key,
+    /// or return the lock of the fetch already in flight.
+    fn try_lead(
+        shared: &Arc<CacheShared<St>>,
+        key: &str,
+    ) -> Result<Self, Arc<tokio::sync::Mutex<()>>> {
+        let mut inflight = shared.inflight.lock();
+        if let Some(lock) = inflight.get(key) {
+            return Err(lock.clone());
+        }
+        let lock = Arc::new(tokio::sync::Mutex::new(()));
+        let guard = lock
+            .clone()
+            .try_lock_owned()
+            .expect("new lock is not locked");
+        inflight.insert(key.to_owned(), lock.clone());
+        Ok(Self {
+            shared: shared.clone(),
+            key: key.to_owned(),
+            lock,
+            _guard: guard,
+        })
+    }
+}
+
+impl<St> Drop for InflightGuard<St> {
+    fn drop(&mut self) {
+        // unregister the fetch, after which the requests waiting on it are woken up
+        let mut inflight = self.shared.inflight.lock();
+        if inflight
+            .get(&self.key)
+            .map_or(false, |lock| Arc::ptr_eq(lock, &self.lock))
+        {
+            inflight.remove(&self.key);
+        }
+    }
+}
+
+/// Returns the key used to store the responses for the given request,
+/// if the request has an authority.
+///
+/// The key includes the scheme, such that `http` and `https` responses
+/// for the same target are never served in place of one another.
+fn cache_key<Body>(scheme: &str, req: &Request<Body>) -> Option<String> {
+    let authority = match req.uri().authority() {
+        Some(authority) => authority.as_str(),
+        None => req.headers().get(header::HOST)?.to_str().ok()?,
+    };
+    let path = req
+        .uri()
+        .path_and_query()
+        .map(|path| path.as_str())
+        .unwrap_or("/");
+    Some(format!(
+        "{scheme}://{}{path}",
+        authority.to_ascii_lowercase()
+    ))
+}
+
+async fn lookup<St: CacheStorage>(
+    shared: &CacheShared<St>,
+    key: &str,
+    headers: &HeaderMap,
+    req_cc: &CacheControl,
+) -> Lookup {
+    let Some(entry) = shared.storage.get(key).await else {
+        return Lookup::Miss;
+    };
+    let Some(cached) = entry
+        .variants
+        .iter()
+        .find(|variant| variant.matches_vary(headers))
+    else {
+        return Lookup::Miss;
+    };
+
+    if req_cc.no_cache || cached.no_cache {
+        return Lookup::Revalidate(cached.clone());
+    }
+
+    let age = cached.age();
+    let acceptable_age = match req_cc.max_age {
+        Some(max_age) => age <= max_age,
+        None => true,
+    };
+    let fresh = age.saturating_add(req_cc.min_fresh.unwrap_or_default()) < cached.freshness;
+    if fresh && acceptable_age {
+        return Lookup::Fresh(cached.clone());
+    }
+
+    let staleness = age.saturating_sub(cached.freshness);
+    if !cached.must_revalidate && acceptable_age {
+        if req_cc
+            .max_stale
+            .map_or(false, |max_stale| staleness <= max_stale)
+        {
+            return Lookup::Fresh(cached.clone());
+        }
+        if staleness < cached.stale_while_revalidate {
+            return Lookup::StaleWhileRevalidate(cached.clone());
+        }
+    }
+
+    Lookup::Revalidate(cached.clone())
+}
+
+/// Serve the stored response, or a `304 Not Modified` response
+/// in case the conditional request headers match it.
+fn serve_cached(cached: &CachedResponse, req_headers: &HeaderMap) -> Response {
+    let not_modified = match req_headers.typed_get::<headers::IfNoneMatch>() {
+        Some(if_none_match) => cached
+            .headers
+            .typed_get::<headers::ETag>()
+            .map_or(false, |etag| !if_none_match.precondition_passes(&etag)),
+        None => match (
+            req_headers.typed_get::<headers::IfModifiedSince>(),
+            cached.headers.typed_get::<headers::LastModified>(),
+        ) {
+            (Some(since), Some(last_modified)) => {
+                !since.is_modified(SystemTime::from(last_modified))
+            }
+            _ => false,
+        },
+    };
+
+    let mut headers = cached.headers.clone();
+    headers.insert(header::AGE, HeaderValue::from(cached.age().as_secs()));
+
+    let (status, body) = if not_modified && cached.status == StatusCode::OK {
+        headers.remove(header::CONTENT_LENGTH);
+        (StatusCode::NOT_MODIFIED, Body::empty())
+    } else {
+        (cached.status, Body::from(cached.body.clone()))
+    };
+
+    let mut res = Response::new(body);
+    *res.status_mut() = status;
+    *res.version_mut() = cached.version;
+    *res.headers_mut() = headers;
+    res
+}
+
+/// Fetch the response from the inner service, storing it if possible.
+///
+/// In case a stored response is given, the request is made conditional
+/// to revalidate it, unless the request already is conditional.
+async fn fetch<S, St, State, ReqBody, ResBody>(
+    inner: &S,
+    shared: &CacheShared<St>,
+    ctx: Context<State>,
+    mut req: Request<ReqBody>,
+    key: String,
+    cached: Option<Arc<CachedResponse>>,
+) -> Result<Response, BoxError>
+where
+    S: Service<State, Request<ReqBody>, Response = Response<ResBody>>,
+    S::Error: Into<BoxError>,
+    St: CacheStorage,
+    ResBody: HttpBody<Data = Bytes> + Send + Sync + 'static,
+    ResBody::Error: Into<BoxError>,
+{
+    let req_headers = req.headers().clone();
+    let req_cc = CacheControl::from_headers(&req_headers);
+    let has_authorization = req_headers.contains_key(header::AUTHORIZATION);
+
+    let client_conditional = req_headers.contains_key(header::IF_NONE_MATCH)
+        || req_headers.contains_key(header::IF_MODIFIED_SINCE);
+    let cached = cached.filter(|_| !client_conditional);
+    if let Some(cached) = &cached {
+        if let Some(etag) = cached.headers.get(header::ETAG) {
+            req.headers_mut()
+                .insert(header::IF_NONE_MATCH, etag.clone());
+        } else if let Some(last_modified) = cached.headers.get(header::LAST_MODIFIED) {
+            req.headers_mut()
+                .insert(header::IF_MODIFIED_SINCE, last_modified.clone());
+        }
+    }
+
+    let request_time = Instant::now();
+    let res = inner.serve(ctx, req).await.map_err(Into::into)?;
+
+    if let Some(cached) = cached.filter(|_| res.status() == StatusCode::NOT_MODIFIED) {
+        // freshen the stored response using the headers of the 304 response
+        let mut headers = cached.headers.clone();
+        for name in res.headers().keys() {
+            if name != header::CONTENT_LENGTH {
+                headers.remove(name);
+            }
+        }
+        for (name, value) in res.headers() {
+            if name != header::CONTENT_LENGTH {
+                headers.append(name.clone(), value.clone());
+            }
+        }
+        let res_cc = CacheControl::from_headers(&headers);
+        let updated = Arc::new(CachedResponse {
+            status: cached.status,
+            version: cached.version,
+            freshness: freshness_lifetime(cached.status, &headers, &res_cc).unwrap_or_default(),
+            initial_age: initial_age(&headers, request_time),
+            stale_while_revalidate: res_cc.stale_while_revalidate.unwrap_or_default(),
+            must_revalidate: res_cc.must_revalidate,
+            no_cache: res_cc.no_cache,
+            headers,
+            body: cached.body.clone(),
+            vary: cached.vary.clone(),
+            stored_at: Instant::now(),
+        });
+        if res_cc.no_store {
+            shared.storage.remove(&key).await;
+        } else {
+            store(shared, key, updated.clone()).await;
+        }
+        return Ok(serve_cached(&updated, &HeaderMap::new()));
+    }
+
+    let res_cc = CacheControl::from_headers(res.headers());
+    let freshness = match storable(&req_cc, has_authorization, &res, &res_cc) {
+        Some(freshness) => freshness,
+        None => return Ok(res.map(Body::new)),
+    };
+    let vary = match vary_values(res.headers(), &req_headers) {
+        Some(vary) => vary,
+        None => return Ok(res.map(Body::new)),
+    };
+
+    let (mut parts, body) = res.into_parts();
+    let body = match collect_body(Body::new(body), shared.max_body_size).await? {
+        Ok(body) => body,
+        // too large to be stored, stream it
+        Err(body) => return Ok(Response::from_parts(parts, body)),
+    };
+
+    parts.headers.remove(header::TRANSFER_ENCODING);
+    parts.headers.remove(header::CONNECTION);
+    parts
+        .headers
+        .insert(header::CONTENT_LENGTH, HeaderValue::from(body.len()));
+
+    let cached = Arc::new(CachedResponse {
+        status: parts.status,
+        version: parts.version,
+        initial_age: initial_age(&parts.headers, request_time),
+        headers: parts.headers,
+        body,
+        vary,
+        stored_at: Instant::now(),
+        freshness,
+        stale_while_revalidate: res_cc.stale_while_revalidate.unwrap_or_default(),
+        must_revalidate: res_cc.must_revalidate,
+        no_cache: res_cc.no_cache,
+    });
+    store(shared, key, cached.clone()).await;
+
+    Ok(serve_cached(&cached, &req_headers))
+}
+
+/// Store the response as a variant of the entry of the given key,
+/// replacing the variant with the same `Vary` request header values, if any.
+async fn store<St: CacheStorage>(
+    shared: &CacheShared<St>,
+    key: String,
+    cached: Arc<CachedResponse>,
+) {
+    let mut entry = shared.storage.get(&key).await.unwrap_or_default();
+    entry.variants.retain(|variant| variant.vary != cached.vary);
+    if entry.variants.len() >= CacheEntry::MAX_VARIANTS {
+        entry.variants.remove(0);
+    }
+    entry.variants.push(cached);
+    shared.storage.insert(key, entry).await;
+}
+
+/// Returns the status codes which are cacheable by default, as defined in RFC 9110.
+fn is_heuristically_cacheable(status: StatusCode) -> bool {
+    matches!(
+        status.as_u16(),
+        200 | 203 | 204 | 300 | 301 | 308 | 404 | 405 | 410 | 414 | 501
+    )
+}
+
+/// Returns the freshness lifetime of the response, if it is allowed to be stored
+/// by a shared cache for the given request.
+fn storable(
+    req_cc: &CacheControl,
+    has_authorization: bool,
+    res: &Response<impl HttpBody>,
+    res_cc: &CacheControl,
+) -> Option<Duration> {
+    if req_cc.no_store || res_cc.no_store || res_cc.private {
+        return None;
+    }
+    if res.status() == StatusCode::PARTIAL_CONTENT
+        || res.status() == StatusCode::NOT_MODIFIED
+        || res.status().is_informational()
+        || res.headers().contains_key(header::SET_COOKIE)
+    {
+        return None;
+    }
+    if has_authorization && !(res_cc.public || res_cc.s_maxage.is_some() || res_cc.must_revalidate)
+    {
+        return None;
+    }
+
+    match freshness_lifetime(res.status(), res.headers(), res_cc) {
+        Some(freshness) => Some(freshness),
+        // can still be stored to be revalidated on every use
+        None if is_heuristically_cacheable(res.status())
+            && (res.headers().contains_key(header::ETAG)
+                || res.headers().contains_key(header::LAST_MODIFIED)) =>
+        {
+            Some(Duration::ZERO)
+        }
+        None => None,
+    }
+}
+
+/// Returns the freshness lifetime of a response, as defined in RFC 9111 section 4.2.1.
+fn freshness_lifetime(
+    status: StatusCode,
+    headers: &HeaderMap,
+    res_cc: &CacheControl,
+) -> Option<Duration> {
+    if let Some(max_age) = res_cc.s_maxage.or(res_cc.max_age) {
+        return Some(max_age);
+    }
+
+    let date = headers
+        .typed_get::<headers::Date>()
+        .map(SystemTime::from)
+        .unwrap_or_else(SystemTime::now);
+
+    if headers.contains_key(header::EXPIRES) {
+        // an invalid date (e.g. "0") represents a time in the past
+        return Some(
+            headers
+                .typed_get::<headers::Expires>()
+                .and_then(|expires| SystemTime::from(expires).duration_since(date).ok())
+                .unwrap_or_default(),
+        );
+    }
+
+    if !is_heuristically_cacheable(status) && !res_cc.public {
+        return None;
+    }
+
+    // heuristic freshness: 10% of the time since the last modification, at most a day
+    let last_modified = SystemTime::from(headers.typed_get::<headers::LastModified>()?);
+    let since_modified = date.duration_since(last_modified).ok()?;
+    Some((since_modified / 10).min(Duration::from_secs(24 * 60 * 60)))
+}
+
+/// Returns the age of a response at the moment it is received,
+/// as defined in RFC 9111 section 4.2.3.
+fn initial_age(headers: &HeaderMap, request_time: Instant) -> Duration {
+    let age = headers
+        .typed_get::<headers::Age>()
+        .map(|age| Duration::from_secs(age.as_secs()))
+        .unwrap_or_default();
+    let apparent_age = headers
+        .typed_get::<headers::Date>()
+        .and_then(|date| SystemTime::now().duration_since(date.into()).ok())
+        .unwrap_or_default();
+    apparent_age.max(age.saturating_add(request_time.elapsed()))
+}
+
+/// Returns the request header values selected by the `Vary` header of the response,
+/// or `None` in case the response varies on anything (`Vary: *`).
+fn vary_values(
+    res_headers: &HeaderMap,
+    req_headers: &HeaderMap,
+) -> Option<Vec<(header::HeaderName, Vec<HeaderValue>)>> {
+    let mut vary = Vec::new();
+    for value in res_headers.get_all(header::VARY) {
+        for name in value.to_str().ok()?.split(',') {
+            let name = name.trim();
+            if name == "*" {
+                return None;
+            }
+            if name.is_empty() {
+                continue;
+            }
+            let name = header::HeaderName::from_bytes(name.as_bytes()).ok()?;
+            if vary.iter().any(|(vary_name, _)| vary_name == &name) {
+                continue;
+            }
+            let values = req_headers.get_all(&name).iter().cloned().collect();
+            vary.push((name, values));
+        }
+    }
+    Some(vary)
+}
+
+/// Collect the body in case it is not larger than `max_size` and has no trailers,
+/// otherwise returns a body streaming the (partially) read body.
+async fn collect_body(mut body: Body, max_size: usize) -> Result<Result<Bytes, Body>, BoxError> {
+    if body.size_hint().lower() > max_size as u64 {
+        return Ok(Err(body));
+    }
+
+    let mut buf = BytesMut::new();
+    while let Some(frame) = body.frame().await {
+        let frame = frame?;
+        match frame.data_ref() {
+            Some(data) if buf.len() + data.len() <= max_size => {
+                buf.extend_from_slice(data);
+                continue;
+            }
+            // too large or trailers, which are not stored either
+            _ => (),
+        }
+        let read = futures_lite::stream::iter([Ok(Frame::data(buf.freeze())), Ok(frame)]);
+        let rest = BodyStream::new(body);
+        return Ok(Err(Body::new(StreamBody::new(
+            futures_lite::StreamExt::chain(read, rest),
+        ))));
+    }
+    Ok(Ok(buf.freeze()))
+}
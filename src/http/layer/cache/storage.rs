@@ -0,0 +1,270 @@
+use crate::http::{HeaderMap, HeaderName, HeaderValue, StatusCode, Version};
+use crate::utils::lru::LruCache;
+use bytes::Bytes;
+use parking_lot::Mutex;
+use std::{
+    collections::hash_map::RandomState,
+    fmt,
+    future::Future,
+    hash::BuildHasher,
+    sync::Arc,
+    time::{Duration, Instant},
+};
+
+/// The storage used by the [`Cache`] middleware to store responses.
+///
+/// [`MemoryStorage`] is the default storage, but other storages
+/// (e.g. disk-backed or distributed) can be used by implementing this trait.
+///
+/// The cache key is derived from the authority and path (and query) of the request,
+/// and its [`CacheEntry`] holds all stored variants (see `Vary`) of the response.
+///
+/// [`Cache`]: super::Cache
+pub trait CacheStorage: Send + Sync + 'static {
+    /// Get the entry stored for the given key, if any.
+    fn get<'a>(&'a self, key: &'a str) -> impl Future<Output = Option<CacheEntry>> + Send + 'a;
+
+    /// Store the entry for the given key, replacing the existing entry, if any.
+    fn insert(&self, key: String, entry: CacheEntry) -> impl Future<Output = ()> + Send + '_;
+
+    /// Remove the entry stored for the given key, if any.
+    fn remove<'a>(&'a self, key: &'a str) -> impl Future<Output = ()> + Send + 'a;
+}
+
+impl<T: CacheStorage> CacheStorage for Arc<T> {
+    fn get<'a>(&'a self, key: &'a str) -> impl Future<Output = Option<CacheEntry>> + Send + 'a {
+        (**self).get(key)
+    }
+
+    fn insert(&self, key: String, entry: CacheEntry) -> impl Future<Output = ()> + Send + '_ {
+        (**self).insert(key, entry)
+    }
+
+    fn remove<'a>(&'a self, key: &'a str) -> impl Future<Output = ()> + Send + 'a {
+        (**self).remove(key)
+    }
+}
+
+/// All stored variants of the response for a single cache key.
+#[derive(Debug, Clone, Default)]
+pub struct CacheEntry {
+    pub(super) variants: Vec<Arc<CachedResponse>>,
+}
+
+impl CacheEntry {
+    /// The maximum amount of variants stored for a single key,
+    /// dropping the oldest variant to make room for a new one.
+    pub(super) const MAX_VARIANTS: usize = 8;
+
+    /// Returns the amount of stored variants.
+    pub fn len(&self) -> usize {
+        self.variants.len()
+    }
+
+    /// Returns `true` if no variants are stored.
+    pub fn is_empty(&self) -> bool {
+        self.variants.is_empty()
+    }
+
+    /// Returns the (approximate) amount of bytes used by the stored variants.
+    pub fn size(&self) -> usize {
+        self.variants.iter().map(|variant| variant.size()).sum()
+    }
+
+    /// Returns the stored variants.
+    pub fn variants(&self) -> impl Iterator<Item = &CachedResponse> {
+        self.variants.iter().map(AsRef::as_ref)
+    }
+}
+
+/// A response stored by the [`Cache`] middleware.
+///
+/// [`Cache`]: super::Cache
+pub struct CachedResponse {
+    pub(super) status: StatusCode,
+    pub(super) version: Version,
+    pub(super) headers: HeaderMap,
+    pub(super) body: Bytes,
+    /// the request header values selected by the `Vary` header of the response
+    pub(super) vary: Vec<(HeaderName, Vec<HeaderValue>)>,
+    /// the moment the response was received
+    pub(super) stored_at: Instant,
+    /// the age the response already had when it was received
+    pub(super) initial_age: Duration,
+    pub(super) freshness: Duration,
+    pub(super) stale_while_revalidate: Duration,
+    pub(super) must_revalidate: bool,
+    pub(super) no_cache: bool,
+}
+
+impl CachedResponse {
+    /// Returns the status code of the stored response.
+    pub fn status(&self) -> StatusCode {
+        self.status
+    }
+
+    /// Returns the headers of the stored response.
+    pub fn headers(&self) -> &HeaderMap {
+        &self.headers
+    }
+
+    /// Returns the body of the stored response.
+    pub fn body(&self) -> &Bytes {
+        &self.body
+    }
+
+    /// Returns the current age of the stored response.
+    pub fn age(&self) -> Duration {
+        self.initial_age.saturating_add(self.stored_at.elapsed())
+    }
+
+    /// Returns `true` if the stored response is fresh,
+    /// meaning it can be served without revalidating it.
+    pub fn is_fresh(&self) -> bool {
+        !self.no_cache && self.age() < self.freshness
+    }
+
+    /// Returns the (approximate) amount of bytes used by the stored response.
+    pub fn size(&self) -> usize {
+        self.body.len()
+            + self
+                .headers
+                .iter()
+                .map(|(name, value)| name.as_str().len() + value.len())
+                .sum::<usize>()
+    }
+
+    /// Returns `true` if the `Vary` request header values match the given request headers.
+    pub(super) fn matches_vary(&self, headers: &HeaderMap) -> bool {
+        self.vary
+            .iter()
+            .all(|(name, values)| headers.get_all(name).iter().eq(values.iter()))
+    }
+}
+
+impl fmt::Debug for CachedResponse {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("CachedResponse")
+            .field("status", &self.status)
+            .field("version", &self.version)
+            .field("headers", &self.headers)
+            .field("body_len", &self.body.len())
+            .field("vary", &self.vary)
+            .field("age", &self.age())
+            .field("freshness", &self.freshness)
+            .finish()
+    }
+}
+
+/// A sharded in-memory [`CacheStorage`], bounded by a byte budget.
+///
+/// Keys are spread over shards, each guarded by its own lock and holding
+/// an equal part of the byte budget. Once a shard exceeds its part,
+/// its least recently used entries are evicted.
+///
+/// Cloning the storage shares its entries.
+#[derive(Clone)]
+pub struct MemoryStorage {
+    shards: Arc<[Mutex<LruCache<String, CacheEntry>>]>,
+    hasher: RandomState,
+}
+
+impl MemoryStorage {
+    /// The default maximum amount of bytes stored.
+    pub const DEFAULT_MAX_SIZE: usize = 64 * 1024 * 1024;
+
+    /// Create a new [`MemoryStorage`],
+    /// using one shard per available core.
+    pub fn new() -> Self {
+        let shards = std::thread::available_parallelism()
+            .map(usize::from)
+            .unwrap_or(1);
+        Self::with_shards(Self::DEFAULT_MAX_SIZE, shards)
+    }
+
+    /// Create a new [`MemoryStorage`], storing at most `max_size` bytes,
+    /// spread over the given amount of shards.
+    pub fn with_shards(max_size: usize, shards: usize) -> Self {
+        let shards = shards.max(1);
+        let max_shard_size = max_size.div_ceil(shards);
+        Self {
+            shards: (0..shards)
+                .map(|_| Mutex::new(LruCache::new(usize::MAX, max_shard_size)))
+                .collect(),
+            hasher: RandomState::new(),
+        }
+    }
+
+    /// Set the maximum amount of bytes stored, over all shards.
+    ///
+    /// Entries larger than a single shard's part of this budget are never stored.
+    pub fn with_max_size(self, max_size: usize) -> Self {
+        let max_shard_size = max_size.div_ceil(self.shards.len());
+        for shard in self.shards.iter() {
+            shard.lock().set_max_size(max_shard_size);
+        }
+        self
+    }
+
+    /// Returns the amount of stored entries.
+    pub fn len(&self) -> usize {
+        self.shards.iter().map(|shard| shard.lock().len()).sum()
+    }
+
+    /// Returns `true` if no entries are stored.
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Returns the amount of bytes stored.
+    pub fn size(&self) -> usize {
+        self.shards.iter().map(|shard| shard.lock().size()).sum()
+    }
+
+    /// Remove all stored entries.
+    pub fn clear(&self) {
+        for shard in self.shards.iter() {
+            shard.lock().clear();
+        }
+    }
+
+    fn shard(&self, key: &str) -> &Mutex<LruCache<String, CacheEntry>> {
+        let index = self.hasher.hash_one(key) as usize % self.shards.len();
+        &self.shards[index]
+    }
+}
+
+impl Default for MemoryStorage {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl fmt::Debug for MemoryStorage {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("MemoryStorage")
+            .field("shards", &self.shards.len())
+            .field("max_shard_size", &self.shards[0].lock().max_size())
+            .field("len", &self.len())
+            .field("size", &self.size())
+            .finish()
+    }
+}
+
+impl CacheStorage for MemoryStorage {
+    fn get<'a>(&'a self, key: &'a str) -> impl Future<Output = Option<CacheEntry>> + Send + 'a {
+        let entry = self.shard(key).lock().get(key).cloned();
+        std::future::ready(entry)
+    }
+
+    fn insert(&self, key: String, entry: CacheEntry) -> impl Future<Output = ()> + Send + '_ {
+        let size = key.len() + entry.size();
+        self.shard(&key).lock().insert(key, entry, size);
+        std::future::ready(())
+    }
+
+    fn remove<'a>(&'a self, key: &'a str) -> impl Future<Output = ()> + Send + 'a {
+        self.shard(key).lock().remove(key);
+        std::future::ready(())
+    }
+}
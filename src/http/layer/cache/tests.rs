@@ -0,0 +1,441 @@
+use super::*;
+use crate::http::{
+    header, Body, BodyExtractExt, HeaderValue, IntoResponse, Method, Request, Response, StatusCode,
+};
+use crate::service::{service_fn, Context, Layer, Service};
+use std::{
+    convert::Infallible,
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Arc,
+    },
+    time::Duration,
+};
+
+fn request(method: Method, path: &str) -> Request {
+    Request::builder()
+        .method(method)
+        .uri(format!("http://example.com{path}"))
+        .body(Body::empty())
+        .unwrap()
+}
+
+fn response(body: &'static str, headers: &[(header::HeaderName, &'static str)]) -> Response {
+    let mut res = body.into_response();
+    for (name, value) in headers {
+        res.headers_mut()
+            .append(name.clone(), HeaderValue::from_static(value));
+    }
+    res
+}
+
+async fn serve(
+    service: &impl Service<(), Request, Response = Response, Error = crate::error::BoxError>,
+    req: Request,
+) -> (StatusCode, String) {
+    let res = service.serve(Context::default(), req).await.unwrap();
+    (res.status(), res.try_into_string().await.unwrap())
+}
+
+#[tokio::test]
+async fn test_cache_serves_fresh_response() {
+    let calls = Arc::new(AtomicUsize::new(0));
+    let service = CacheLayer::new().layer(service_fn({
+        let calls = calls.clone();
+        move |_ctx: Context<()>, _req: Request| {
+            let calls = calls.clone();
+            async move {
+                calls.fetch_add(1, Ordering::SeqCst);
+                Ok::<_, Infallible>(response("hello", &[(header::CACHE_CONTROL, "max-age=60")]))
+            }
+        }
+    }));
+
+    for _ in 0..3 {
+        let res = service
+            .serve(Context::default(), request(Method::GET, "/hello"))
+            .await
+            .unwrap();
+        assert!(res.headers().contains_key(header::AGE));
+        assert_eq!(res.try_into_string().await.unwrap(), "hello");
+    }
+    assert_eq!(calls.load(Ordering::SeqCst), 1);
+
+    // other targets are stored separately
+    assert_eq!(
+        serve(&service, request(Method::GET, "/hello?name=world")).await,
+        (StatusCode::OK, "hello".to_owned())
+    );
+    assert_eq!(calls.load(Ordering::SeqCst), 2);
+}
+
+#[tokio::test]
+async fn test_cache_key_includes_scheme() {
+    let service =
+        CacheLayer::new().layer(service_fn(|_ctx: Context<()>, req: Request| async move {
+            let body = match req.uri().scheme_str() {
+                Some("https") => "secure",
+                _ => "plain",
+            };
+            Ok::<_, Infallible>(response(body, &[(header::CACHE_CONTROL, "max-age=60")]))
+        }));
+
+    let https_request = || {
+        Request::builder()
+            .uri("https://example.com/hello")
+            .body(Body::empty())
+            .unwrap()
+    };
+
+    for _ in 0..2 {
+        assert_eq!(
+            serve(&service, request(Method::GET, "/hello")).await,
+            (StatusCode::OK, "plain".to_owned())
+        );
+        assert_eq!(
+            serve(&service, https_request()).await,
+            (StatusCode::OK, "secure".to_owned())
+        );
+    }
+}
+
+#[tokio::test]
+async fn test_cache_no_store() {
+    let calls = Arc::new(AtomicUsize::new(0));
+    let service = CacheLayer::new().layer(service_fn({
+        let calls = calls.clone();
+        move |_ctx: Context<()>, req: Request| {
+            let calls = calls.clone();
+            async move {
+                calls.fetch_add(1, Ordering::SeqCst);
+                let cache_control = match req.uri().path() {
+                    "/no-store" => "no-store, max-age=60",
+                    "/private" => "private, max-age=60",
+                    _ => "max-age=60",
+                };
+                Ok::<_, Infallible>(response("hello", &[(header::CACHE_CONTROL, cache_control)]))
+            }
+        }
+    }));
+
+    for path in ["/no-store", "/private"] {
+        for _ in 0..2 {
+            serve(&service, request(Method::GET, path)).await;
+        }
+    }
+    assert_eq!(calls.load(Ordering::SeqCst), 4);
+
+    // requests can refuse to be stored as well
+    let mut req = request(Method::GET, "/hello");
+    req.headers_mut()
+        .insert(header::CACHE_CONTROL, HeaderValue::from_static("no-store"));
+    serve(&service, req).await;
+    serve(&service, request(Method::GET, "/hello")).await;
+    assert_eq!(calls.load(Ordering::SeqCst), 6);
+}
+
+#[tokio::test]
+async fn test_cache_vary() {
+    let calls = Arc::new(AtomicUsize::new(0));
+    let service = CacheLayer::new().layer(service_fn({
+        let calls = calls.clone();
+        move |_ctx: Context<()>, req: Request| {
+            let calls = calls.clone();
+            async move {
+                calls.fetch_add(1, Ordering::SeqCst);
+                let body = match req.headers().get(header::ACCEPT_LANGUAGE) {
+                    Some(value) if value == "nl" => "hallo",
+                    _ => "hello",
+                };
+                Ok::<_, Infallible>(response(
+                    body,
+                    &[
+                        (header::CACHE_CONTROL, "max-age=60"),
+                        (header::VARY, "Accept-Language"),
+                    ],
+                ))
+            }
+        }
+    }));
+
+    let request_lang = |lang: Option<&'static str>| {
+        let mut req = request(Method::GET, "/hello");
+        if let Some(lang) = lang {
+            req.headers_mut()
+                .insert(header::ACCEPT_LANGUAGE, HeaderValue::from_static(lang));
+        }
+        req
+    };
+
+    for _ in 0..2 {
+        assert_eq!(serve(&service, request_lang(Some("nl"))).await.1, "hallo");
+        assert_eq!(serve(&service, request_lang(Some("en"))).await.1, "hello");
+        assert_eq!(serve(&service, request_lang(None)).await.1, "hello");
+    }
+    assert_eq!(calls.load(Ordering::SeqCst), 3);
+}
+
+#[tokio::test]
+async fn test_cache_revalidate() {
+    let calls = Arc::new(AtomicUsize::new(0));
+    let service = CacheLayer::new().layer(service_fn({
+        let calls = calls.clone();
+        move |_ctx: Context<()>, req: Request| {
+            let calls = calls.clone();
+            async move {
+                calls.fetch_add(1, Ordering::SeqCst);
+                let res = match req.headers().get(header::IF_NONE_MATCH) {
+                    Some(etag) if etag == "\"v1\"" => {
+                        let mut res = response("", &[(header::ETAG, "\"v1\"")]);
+                        *res.status_mut() = StatusCode::NOT_MODIFIED;
+                        res
+                    }
+                    _ => response(
+                        "hello",
+                        &[
+                            (header::CACHE_CONTROL, "no-cache"),
+                            (header::ETAG, "\"v1\""),
+                        ],
+                    ),
+                };
+                Ok::<_, Infallible>(res)
+            }
+        }
+    }));
+
+    for _ in 0..3 {
+        assert_eq!(
+            serve(&service, request(Method::GET, "/hello")).await,
+            (StatusCode::OK, "hello".to_owned())
+        );
+    }
+    assert_eq!(calls.load(Ordering::SeqCst), 3);
+
+    // conditional requests of the client are answered from the stored response
+    let calls_before = calls.load(Ordering::SeqCst);
+    let mut req = request(Method::GET, "/hello");
+    req.headers_mut()
+        .insert(header::IF_NONE_MATCH, HeaderValue::from_static("\"v1\""));
+    assert_eq!(serve(&service, req).await.0, StatusCode::NOT_MODIFIED);
+    assert_eq!(calls.load(Ordering::SeqCst), calls_before + 1);
+}
+
+#[tokio::test]
+async fn test_cache_stale_while_revalidate() {
+    let calls = Arc::new(AtomicUsize::new(0));
+    let release = Arc::new(tokio::sync::Notify::new());
+    let service = CacheLayer::new().layer(service_fn({
+        let calls = calls.clone();
+        let release = release.clone();
+        move |_ctx: Context<()>, _req: Request| {
+            let calls = calls.clone();
+            let release = release.clone();
+            async move {
+                let call = calls.fetch_add(1, Ordering::SeqCst);
+                if call == 1 {
+                    // block the background revalidation until released
+                    release.notified().await;
+                }
+                let body = if call == 0 { "v1" } else { "v2" };
+                Ok::<_, Infallible>(response(
+                    body,
+                    &[(
+                        header::CACHE_CONTROL,
+                        "max-age=0, stale-while-revalidate=60",
+                    )],
+                ))
+            }
+        }
+    }));
+
+    assert_eq!(
+        serve(&service, request(Method::GET, "/hello")).await,
+        (StatusCode::OK, "v1".to_owned())
+    );
+
+    // the stale response is served without waiting on its revalidation
+    let res = tokio::time::timeout(
+        Duration::from_secs(5),
+        serve(&service, request(Method::GET, "/hello")),
+    )
+    .await
+    .unwrap();
+    assert_eq!(res, (StatusCode::OK, "v1".to_owned()));
+
+    // the revalidated response is stored once the background fetch completes
+    release.notify_one();
+    let mut body = String::new();
+    for _ in 0..100 {
+        body = serve(&service, request(Method::GET, "/hello")).await.1;
+        if body == "v2" {
+            break;
+        }
+        tokio::time::sleep(Duration::from_millis(10)).await;
+    }
+    assert_eq!(body, "v2");
+}
+
+#[tokio::test]
+async fn test_cache_conditional_request_on_fresh_response() {
+    let calls = Arc::new(AtomicUsize::new(0));
+    let service = CacheLayer::new().layer(service_fn({
+        let calls = calls.clone();
+        move |_ctx: Context<()>, _req: Request| {
+            let calls = calls.clone();
+            async move {
+                calls.fetch_add(1, Ordering::SeqCst);
+                Ok::<_, Infallible>(response(
+                    "hello",
+                    &[
+                        (header::CACHE_CONTROL, "max-age=60"),
+                        (header::ETAG, "\"v1\""),
+                    ],
+                ))
+            }
+        }
+    }));
+
+    serve(&service, request(Method::GET, "/hello")).await;
+    let mut req = request(Method::GET, "/hello");
+    req.headers_mut()
+        .insert(header::IF_NONE_MATCH, HeaderValue::from_static("\"v1\""));
+    assert_eq!(
+        serve(&service, req).await,
+        (StatusCode::NOT_MODIFIED, String::new())
+    );
+    assert_eq!(calls.load(Ordering::SeqCst), 1);
+}
+
+#[tokio::test]
+async fn test_cache_invalidated_by_unsafe_method() {
+    let calls = Arc::new(AtomicUsize::new(0));
+    let service = CacheLayer::new().layer(service_fn({
+        let calls = calls.clone();
+        move |_ctx: Context<()>, req: Request| {
+            let calls = calls.clone();
+            async move {
+                if req.method() == Method::GET {
+                    calls.fetch_add(1, Ordering::SeqCst);
+                }
+                Ok::<_, Infallible>(response("hello", &[(header::CACHE_CONTROL, "max-age=60")]))
+            }
+        }
+    }));
+
+    serve(&service, request(Method::GET, "/hello")).await;
+    serve(&service, request(Method::GET, "/hello")).await;
+    assert_eq!(calls.load(Ordering::SeqCst), 1);
+
+    serve(&service, request(Method::POST, "/hello")).await;
+    serve(&service, request(Method::GET, "/hello")).await;
+    assert_eq!(calls.load(Ordering::SeqCst), 2);
+}
+
+#[tokio::test]
+async fn test_cache_only_if_cached() {
+    let service = CacheLayer::new().layer(service_fn(|_ctx: Context<()>, _req: Request| async {
+        Ok::<_, Infallible>(response("hello", &[(header::CACHE_CONTROL, "max-age=60")]))
+    }));
+
+    let only_if_cached = || {
+        let mut req = request(Method::GET, "/hello");
+        req.headers_mut().insert(
+            header::CACHE_CONTROL,
+            HeaderValue::from_static("only-if-cached"),
+        );
+        req
+    };
+
+    assert_eq!(
+        serve(&service, only_if_cached()).await.0,
+        StatusCode::GATEWAY_TIMEOUT
+    );
+    serve(&service, request(Method::GET, "/hello")).await;
+    assert_eq!(
+        serve(&service, only_if_cached()).await,
+        (StatusCode::OK, "hello".to_owned())
+    );
+}
+
+#[tokio::test]
+async fn test_cache_collapses_concurrent_misses() {
+    let calls = Arc::new(AtomicUsize::new(0));
+    let service = CacheLayer::new().layer(service_fn({
+        let calls = calls.clone();
+        move |_ctx: Context<()>, _req: Request| {
+            let calls = calls.clone();
+            async move {
+                calls.fetch_add(1, Ordering::SeqCst);
+                tokio::time::sleep(Duration::from_millis(50)).await;
+                Ok::<_, Infallible>(response("hello", &[(header::CACHE_CONTROL, "max-age=60")]))
+            }
+        }
+    }));
+
+    let handles: Vec<_> = (0..8)
+        .map(|_| {
+            let service = service.clone();
+            tokio::spawn(async move { serve(&service, request(Method::GET, "/hello")).await })
+        })
+        .collect();
+    for handle in handles {
+        assert_eq!(handle.await.unwrap(), (StatusCode::OK, "hello".to_owned()));
+    }
+    assert_eq!(calls.load(Ordering::SeqCst), 1);
+}
+
+#[tokio::test]
+async fn test_cache_does_not_store_large_body() {
+    let calls = Arc::new(AtomicUsize::new(0));
+    let service = CacheLayer::new().with_max_body_size(4).layer(service_fn({
+        let calls = calls.clone();
+        move |_ctx: Context<()>, _req: Request| {
+            let calls = calls.clone();
+            async move {
+                calls.fetch_add(1, Ordering::SeqCst);
+                Ok::<_, Infallible>(response("hello", &[(header::CACHE_CONTROL, "max-age=60")]))
+            }
+        }
+    }));
+
+    for _ in 0..2 {
+        assert_eq!(
+            serve(&service, request(Method::GET, "/hello")).await,
+            (StatusCode::OK, "hello".to_owned())
+        );
+    }
+    assert_eq!(calls.load(Ordering::SeqCst), 2);
+}
+
+#[tokio::test]
+async fn test_memory_storage_evicts_least_recently_used() {
+    let storage = MemoryStorage::with_shards(10, 1);
+    storage
+        .insert("aaaa".to_owned(), CacheEntry::default())
+        .await;
+    storage
+        .insert("bbbb".to_owned(), CacheEntry::default())
+        .await;
+    assert_eq!(storage.len(), 2);
+
+    assert!(storage.get("aaaa").await.is_some());
+    storage
+        .insert("cccc".to_owned(), CacheEntry::default())
+        .await;
+    assert_eq!(storage.len(), 2);
+    assert_eq!(storage.size(), 8);
+    assert!(storage.get("aaaa").await.is_some());
+    assert!(storage.get("bbbb").await.is_none());
+    assert!(storage.get("cccc").await.is_some());
+
+    // entries larger than the budget are never stored
+    storage
+        .insert("too large to be stored".to_owned(), CacheEntry::default())
+        .await;
+    assert!(storage.get("too large to be stored").await.is_none());
+
+    storage.remove("aaaa").await;
+    assert_eq!(storage.len(), 1);
+    storage.clear();
+    assert!(storage.is_empty());
+}
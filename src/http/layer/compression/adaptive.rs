@@ -0,0 +1,157 @@
+use super::CompressionLevel;
+use std::sync::{
+    atomic::{AtomicUsize, Ordering},
+    Arc,
+};
+
+/// Adapts the compression quality used by the [`Compression`] middleware
+/// to the current compression load and the size of the response body.
+///
+/// The load is measured as the amount of response bodies currently
+/// being compressed by the middleware (and its clones):
+///
+/// - above [`Self::new`]'s threshold, or for bodies known to be smaller than
+///   [`Self::with_small_body_size`], the [`Self::with_reduced_quality`]
+///   (default: [`CompressionLevel::Fastest`]) is used instead of the configured quality;
+/// - above [`Self::with_skip_above`], responses are no longer compressed at all,
+///   until enough compressed bodies have been fully streamed or dropped.
+///
+/// This keeps the CPU time spent on compressing (dynamic) responses bounded:
+/// under load, responses get larger rather than slower.
+///
+/// # Example
+///
+/// ```
+/// use rama::http::layer::compression::{AdaptiveQuality, CompressionLayer, CompressionLevel};
+///
+/// let layer = CompressionLayer::new()
+///     .quality(CompressionLevel::Best)
+///     .with_adaptive_quality(AdaptiveQuality::new(64).with_skip_above(256));
+/// # let _ = layer;
+/// ```
+///
+/// [`Compression`]: super::Compression
+#[derive(Debug, Clone)]
+pub struct AdaptiveQuality {
+    reduce_above: usize,
+    skip_above: usize,
+    small_body_size: u64,
+    reduced_quality: CompressionLevel,
+    in_flight: Arc<AtomicUsize>,
+}
+
+/// Decision made by [`AdaptiveQuality`] for a single response.
+pub(super) enum AdaptiveDecision {
+    Compress(CompressionLevel, InFlightGuard),
+    Skip,
+}
+
+impl AdaptiveQuality {
+    /// The default size below which bodies are compressed with the reduced quality.
+    pub const DEFAULT_SMALL_BODY_SIZE: u64 = 1024;
+
+    /// Create a new [`AdaptiveQuality`], using the reduced quality
+    /// once more than `reduce_above` bodies are being compressed concurrently.
+    pub fn new(reduce_above: usize) -> Self {
+        Self {
+            reduce_above,
+            skip_above: usize::MAX,
+            small_body_size: Self::DEFAULT_SMALL_BODY_SIZE,
+            reduced_quality: CompressionLevel::Fastest,
+            in_flight: Arc::new(AtomicUsize::new(0)),
+        }
+    }
+
+    /// Skip compression once more than `skip_above` bodies are being compressed concurrently.
+    ///
+    /// Disabled by default.
+    pub fn with_skip_above(mut self, skip_above: usize) -> Self {
+        self.skip_above = skip_above;
+        self
+    }
+
+    /// Set the body size below which the reduced quality is used, regardless of the load.
+    ///
+    /// Only applies to bodies of which the size is known upfront.
+    pub fn with_small_body_size(mut self, size: u64) -> Self {
+        self.small_body_size = size;
+        self
+    }
+
+    /// Set the quality used under load and for small bodies.
+    pub fn with_reduced_quality(mut self, quality: CompressionLevel) -> Self {
+        self.reduced_quality = quality;
+        self
+    }
+
+    /// Returns the amount of bodies currently being compressed.
+    pub fn in_flight(&self) -> usize {
+        self.in_flight.load(Ordering::Relaxed)
+    }
+
+    pub(super) fn decide(
+        &self,
+        quality: CompressionLevel,
+        body_size: Option<u64>,
+    ) -> AdaptiveDecision {
+        let in_flight = self.in_flight.fetch_add(1, Ordering::Relaxed);
+        let guard = InFlightGuard(self.in_flight.clone());
+
+        if in_flight >= self.skip_above {
+            return AdaptiveDecision::Skip;
+        }
+
+        let quality = if in_flight >= self.reduce_above
+            || body_size.map_or(false, |size| size < self.small_body_size)
+        {
+            self.reduced_quality
+        } else {
+            quality
+        };
+        AdaptiveDecision::Compress(quality, guard)
+    }
+}
+
+/// Counts a body as being compressed, for as long as it is alive.
+#[derive(Debug)]
+pub(super) struct InFlightGuard(Arc<AtomicUsize>);
+
+impl Drop for InFlightGuard {
+    fn drop(&mut self) {
+        self.0.fetch_sub(1, Ordering::Relaxed);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_adaptive_quality_decide() {
+        let adaptive = AdaptiveQuality::new(1).with_skip_above(2);
+
+        let first = match adaptive.decide(CompressionLevel::Best, None) {
+            AdaptiveDecision::Compress(CompressionLevel::Best, guard) => guard,
+            _ => panic!("expected best quality"),
+        };
+        let small = adaptive.decide(CompressionLevel::Best, Some(10));
+        assert!(matches!(
+            small,
+            AdaptiveDecision::Compress(CompressionLevel::Fastest, _)
+        ));
+        assert_eq!(adaptive.in_flight(), 2);
+        assert!(matches!(
+            adaptive.decide(CompressionLevel::Best, None),
+            AdaptiveDecision::Skip
+        ));
+        assert_eq!(adaptive.in_flight(), 2);
+
+        drop(small);
+        drop(first);
+        assert_eq!(adaptive.in_flight(), 0);
+        assert!(matches!(
+            adaptive.decide(CompressionLevel::Best, Some(4096)),
+            AdaptiveDecision::Compress(CompressionLevel::Best, _)
+        ));
+    }
+}
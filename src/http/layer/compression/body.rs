@@ -20,6 +20,8 @@ use std::{
 };
 use tokio_util::io::StreamReader;
 
+use super::adaptive::InFlightGuard;
+use super::cache::CacheFill;
 use super::pin_project_cfg::pin_project_cfg;
 
 pin_project! {
@@ -32,6 +34,8 @@ pin_project! {
     {
         #[pin]
         pub(crate) inner: BodyInner<B>,
+        cache_fill: Option<CacheFill>,
+        in_flight: Option<InFlightGuard>,
     }
 }
 
@@ -44,6 +48,8 @@ where
             inner: BodyInner::Identity {
                 inner: B::default(),
             },
+            cache_fill: None,
+            in_flight: None,
         }
     }
 }
@@ -53,7 +59,23 @@ where
     B: Body,
 {
     pub(crate) fn new(inner: BodyInner<B>) -> Self {
-        Self { inner }
+        Self {
+            inner,
+            cache_fill: None,
+            in_flight: None,
+        }
+    }
+
+    /// Copy the compressed data into the cache once the body is complete.
+    pub(super) fn with_cache_fill(mut self, cache_fill: Option<CacheFill>) -> Self {
+        self.cache_fill = cache_fill;
+        self
+    }
+
+    /// Count this body as being compressed for as long as it is alive.
+    pub(super) fn with_in_flight_guard(mut self, guard: Option<InFlightGuard>) -> Self {
+        self.in_flight = guard;
+        self
     }
 }
 
@@ -91,6 +113,9 @@ pin_project_cfg! {
             #[pin]
             inner: B,
         },
+        Cached {
+            data: Option<Bytes>,
+        },
     }
 }
 
@@ -114,6 +139,10 @@ impl<B: Body> BodyInner<B> {
     pub(crate) fn identity(inner: B) -> Self {
         Self::Identity { inner }
     }
+
+    pub(crate) fn cached(data: Bytes) -> Self {
+        Self::Cached { data: Some(data) }
+    }
 }
 
 impl<B> Body for CompressionBody<B>
@@ -128,7 +157,8 @@ where
         self: Pin<&mut Self>,
         cx: &mut Context<'_>,
     ) -> Poll<Option<Result<Frame<Self::Data>, Self::Error>>> {
-        match self.project().inner.project() {
+        let this = self.project();
+        let result = ready!(match this.inner.project() {
             BodyInnerProj::Gzip { inner } => inner.poll_frame(cx),
             BodyInnerProj::Deflate { inner } => inner.poll_frame(cx),
             BodyInnerProj::Brotli { inner } => inner.poll_frame(cx),
@@ -141,7 +171,32 @@ where
                 Some(Err(err)) => Poll::Ready(Some(Err(err.into()))),
                 None => Poll::Ready(None),
             },
+            BodyInnerProj::Cached { data } => Poll::Ready(data.take().map(Frame::data).map(Ok)),
+        });
+
+        match &result {
+            Some(Ok(frame)) => {
+                if let Some(cache_fill) = this.cache_fill.as_mut() {
+                    // bodies with trailers are not cached
+                    let cacheable = frame.data_ref().map_or(false, |data| cache_fill.push(data));
+                    if !cacheable {
+                        *this.cache_fill = None;
+                    }
+                }
+            }
+            Some(Err(_)) => {
+                *this.cache_fill = None;
+                *this.in_flight = None;
+            }
+            None => {
+                if let Some(cache_fill) = this.cache_fill.take() {
+                    cache_fill.finish();
+                }
+                *this.in_flight = None;
+            }
         }
+
+        Poll::Ready(result)
     }
 }
 
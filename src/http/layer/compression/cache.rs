@@ -0,0 +1,191 @@
+use crate::http::layer::util::content_encoding::Encoding;
+use crate::http::{header, HeaderMap, HeaderValue, Uri};
+use crate::utils::lru::LruCache;
+use bytes::{Bytes, BytesMut};
+use parking_lot::Mutex;
+use std::{fmt, sync::Arc};
+
+/// A bounded in-memory cache of compressed response bodies,
+/// to be used by the [`Compression`] middleware.
+///
+/// Responses are cached by request [`Uri`], strong `ETag` and encoding.
+/// Responses without a strong `ETag` are never cached, as nothing guarantees
+/// that two such responses have identical bodies.
+///
+/// When the inner service returns a response for which a compressed body is cached,
+/// its body is dropped without being read, and the cached compressed body is
+/// returned instead. Otherwise the response is compressed as usual, copying the
+/// compressed bytes into the cache once the body is fully streamed.
+///
+/// Only bodies whose compressed size is at most [`Self::with_max_entry_size`]
+/// bytes are cached, and the cache holds at most [`Self::with_capacity`] bodies
+/// and [`Self::with_max_size`] bytes, evicting the least recently used bodies
+/// to make room for a new one.
+///
+/// Cloning the cache shares its entries.
+///
+/// # Example
+///
+/// ```
+/// use rama::http::layer::compression::{CompressionCache, CompressionLayer};
+///
+/// let layer = CompressionLayer::new().with_cache(CompressionCache::new().with_capacity(512));
+/// # let _ = layer;
+/// ```
+///
+/// [`Compression`]: super::Compression
+#[derive(Clone)]
+pub struct CompressionCache {
+    max_entry_size: usize,
+    bodies: Arc<Mutex<LruCache<CacheKey, Bytes>>>,
+}
+
+#[derive(Clone, Debug, PartialEq, Eq, Hash)]
+pub(super) struct CacheKey {
+    uri: Uri,
+    etag: HeaderValue,
+    encoding: Encoding,
+}
+
+impl CacheKey {
+    /// Create the key for a response with the given headers,
+    /// in case it has a strong `ETag`.
+    pub(super) fn new(uri: Uri, headers: &HeaderMap, encoding: Encoding) -> Option<Self> {
+        let etag = headers.get(header::ETAG)?;
+        if etag.as_bytes().starts_with(b"W/") {
+            return None;
+        }
+        Some(Self {
+            uri,
+            etag: etag.clone(),
+            encoding,
+        })
+    }
+}
+
+impl CompressionCache {
+    /// The default maximum amount of cached bodies.
+    pub const DEFAULT_CAPACITY: usize = 1024;
+    /// The default maximum amount of bytes cached.
+    pub const DEFAULT_MAX_SIZE: usize = 32 * 1024 * 1024;
+    /// The default maximum size of a single cached compressed body.
+    pub const DEFAULT_MAX_ENTRY_SIZE: usize = 256 * 1024;
+
+    /// Create a new [`CompressionCache`].
+    pub fn new() -> Self {
+        Self {
+            max_entry_size: Self::DEFAULT_MAX_ENTRY_SIZE,
+            bodies: Arc::new(Mutex::new(LruCache::new(
+                Self::DEFAULT_CAPACITY,
+                Self::DEFAULT_MAX_SIZE,
+            ))),
+        }
+    }
+
+    /// Set the maximum amount of cached bodies.
+    pub fn with_capacity(self, capacity: usize) -> Self {
+        self.bodies.lock().set_capacity(capacity.max(1));
+        self
+    }
+
+    /// Set the maximum amount of bytes cached, over all bodies.
+    pub fn with_max_size(self, max_size: usize) -> Self {
+        self.bodies.lock().set_max_size(max_size);
+        self
+    }
+
+    /// Set the maximum size of a single compressed body to be cached.
+    pub fn with_max_entry_size(mut self, max_entry_size: usize) -> Self {
+        self.max_entry_size = max_entry_size;
+        self
+    }
+
+    /// Returns the amount of currently cached bodies.
+    pub fn len(&self) -> usize {
+        self.bodies.lock().len()
+    }
+
+    /// Returns `true` if no bodies are currently cached.
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Returns the amount of bytes currently cached.
+    pub fn size(&self) -> usize {
+        self.bodies.lock().size()
+    }
+
+    /// Remove all cached bodies.
+    pub fn clear(&self) {
+        self.bodies.lock().clear();
+    }
+
+    pub(super) fn get(&self, key: &CacheKey) -> Option<Bytes> {
+        self.bodies.lock().get(key).cloned()
+    }
+
+    /// Start collecting a compressed body to be cached for the given key.
+    pub(super) fn fill(&self, key: CacheKey) -> CacheFill {
+        CacheFill {
+            cache: self.clone(),
+            key,
+            buf: BytesMut::new(),
+        }
+    }
+
+    fn insert(&self, key: CacheKey, body: Bytes) {
+        if body.len() > self.max_entry_size {
+            return;
+        }
+        let size = body.len();
+        self.bodies.lock().insert(key, body, size);
+    }
+}
+
+impl Default for CompressionCache {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl fmt::Debug for CompressionCache {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("CompressionCache")
+            .field("max_entry_size", &self.max_entry_size)
+            .field("bodies", &*self.bodies.lock())
+            .finish()
+    }
+}
+
+/// Collects the frames of a compressed body,
+/// to be inserted in the [`CompressionCache`] once the body is complete.
+pub(super) struct CacheFill {
+    cache: CompressionCache,
+    key: CacheKey,
+    buf: BytesMut,
+}
+
+impl CacheFill {
+    /// Append compressed data, returns `false` in case the body became too large to be cached.
+    pub(super) fn push(&mut self, data: &[u8]) -> bool {
+        if self.buf.len() + data.len() > self.cache.max_entry_size {
+            return false;
+        }
+        self.buf.extend_from_slice(data);
+        true
+    }
+
+    /// Insert the complete compressed body in the cache.
+    pub(super) fn finish(self) {
+        self.cache.insert(self.key, self.buf.freeze());
+    }
+}
+
+impl fmt::Debug for CacheFill {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("CacheFill")
+            .field("key", &self.key)
+            .field("len", &self.buf.len())
+            .finish()
+    }
+}
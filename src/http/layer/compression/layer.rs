@@ -1,5 +1,5 @@
 use super::predicate::DefaultPredicate;
-use super::{Compression, Predicate};
+use super::{AdaptiveQuality, Compression, CompressionCache, Predicate};
 use crate::http::layer::util::compression::{AcceptEncoding, CompressionLevel};
 use crate::service::Layer;
 
@@ -14,6 +14,8 @@ pub struct CompressionLayer<P = DefaultPredicate> {
     accept: AcceptEncoding,
     predicate: P,
     quality: CompressionLevel,
+    cache: Option<CompressionCache>,
+    adaptive: Option<AdaptiveQuality>,
 }
 
 impl<S, P> Layer<S> for CompressionLayer<P>
@@ -28,6 +30,8 @@ where
             accept: self.accept,
             predicate: self.predicate.clone(),
             quality: self.quality,
+            cache: self.cache.clone(),
+            adaptive: self.adaptive.clone(),
         }
     }
 }
@@ -68,6 +72,22 @@ impl CompressionLayer {
         self
     }
 
+    /// Cache the compressed bodies of responses with a strong `ETag`.
+    ///
+    /// See [`Compression::with_cache`] for more details.
+    pub fn with_cache(mut self, cache: CompressionCache) -> Self {
+        self.cache = Some(cache);
+        self
+    }
+
+    /// Adapt the compression quality to the compression load and body size.
+    ///
+    /// See [`Compression::with_adaptive_quality`] for more details.
+    pub fn with_adaptive_quality(mut self, adaptive: AdaptiveQuality) -> Self {
+        self.adaptive = Some(adaptive);
+        self
+    }
+
     /// Disables the gzip encoding.
     ///
     /// This method is available even if the `gzip` crate feature is disabled.
@@ -111,6 +131,8 @@ impl CompressionLayer {
             accept: self.accept,
             predicate,
             quality: self.quality,
+            cache: self.cache,
+            adaptive: self.adaptive,
         }
     }
 }
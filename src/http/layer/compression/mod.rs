@@ -74,14 +74,18 @@
 
 pub mod predicate;
 
+mod adaptive;
 mod body;
+mod cache;
 mod layer;
 mod pin_project_cfg;
 mod service;
 
 #[doc(inline)]
 pub use self::{
+    adaptive::AdaptiveQuality,
     body::CompressionBody,
+    cache::CompressionCache,
     layer::CompressionLayer,
     predicate::{DefaultPredicate, Predicate},
     service::Compression,
@@ -97,7 +101,8 @@ mod tests {
 
     use crate::http::dep::http_body_util::BodyExt;
     use crate::http::header::{
-        ACCEPT_ENCODING, ACCEPT_RANGES, CONTENT_ENCODING, CONTENT_RANGE, CONTENT_TYPE, RANGE,
+        ACCEPT_ENCODING, ACCEPT_RANGES, CONTENT_ENCODING, CONTENT_LENGTH, CONTENT_RANGE,
+        CONTENT_TYPE, ETAG, RANGE,
     };
     use crate::http::{Body, HeaderValue, Request, Response};
     use crate::service::{service_fn, Context, Service};
@@ -489,4 +494,91 @@ mod tests {
         assert_eq!(headers[CONTENT_ENCODING], "gzip");
         assert_eq!(decompressed, "Hello, World!");
     }
+
+    #[tokio::test]
+    async fn compressed_body_is_cached_by_etag() {
+        let calls = Arc::new(std::sync::atomic::AtomicUsize::new(0));
+        let svc_calls = calls.clone();
+        let svc = service_fn(move |_: Request| {
+            let etag = if svc_calls.fetch_add(1, std::sync::atomic::Ordering::SeqCst) < 3 {
+                "\"v1\""
+            } else {
+                "\"v2\""
+            };
+            async move {
+                let mut res = Response::new(Body::from(format!("Hello, World! {etag}")));
+                res.headers_mut()
+                    .insert(ETAG, HeaderValue::from_static(etag));
+                Ok::<_, std::io::Error>(res)
+            }
+        });
+        let cache = CompressionCache::new();
+        let svc = Compression::new(svc)
+            .compress_when(Always)
+            .with_cache(cache.clone());
+
+        let mut bodies = Vec::new();
+        for _ in 0..4 {
+            let req = Request::builder()
+                .header(ACCEPT_ENCODING, "gzip")
+                .body(Body::empty())
+                .unwrap();
+            let res = svc.serve(Context::default(), req).await.unwrap();
+            assert_eq!(res.headers()[CONTENT_ENCODING], "gzip");
+            let compressed_data = res.into_body().collect().await.unwrap().to_bytes();
+
+            let mut decoder = GzDecoder::new(&compressed_data[..]);
+            let mut decompressed = String::new();
+            decoder.read_to_string(&mut decompressed).unwrap();
+            bodies.push((compressed_data, decompressed));
+        }
+
+        assert_eq!(bodies[0], bodies[1]);
+        assert_eq!(bodies[0], bodies[2]);
+        assert_eq!(bodies[2].1, "Hello, World! \"v1\"");
+        assert_eq!(bodies[3].1, "Hello, World! \"v2\"");
+        assert_eq!(cache.len(), 2);
+
+        let req = Request::builder()
+            .header(ACCEPT_ENCODING, "gzip")
+            .body(Body::empty())
+            .unwrap();
+        let res = svc.serve(Context::default(), req).await.unwrap();
+        assert_eq!(res.headers()[CONTENT_LENGTH], bodies[3].0.len().to_string());
+    }
+
+    #[tokio::test]
+    async fn adaptive_quality_skips_compression_under_load() {
+        let svc = service_fn(handle);
+        let adaptive = AdaptiveQuality::new(0).with_skip_above(1);
+        let svc = Compression::new(svc)
+            .compress_when(Always)
+            .with_adaptive_quality(adaptive.clone());
+
+        let req = || {
+            Request::builder()
+                .header(ACCEPT_ENCODING, "gzip")
+                .body(Body::empty())
+                .unwrap()
+        };
+
+        let first = svc.serve(Context::default(), req()).await.unwrap();
+        assert_eq!(first.headers()[CONTENT_ENCODING], "gzip");
+        assert_eq!(adaptive.in_flight(), 1);
+
+        let second = svc.serve(Context::default(), req()).await.unwrap();
+        assert!(!second.headers().contains_key(CONTENT_ENCODING));
+        let collected = second.into_body().collect().await.unwrap().to_bytes();
+        assert_eq!(collected, "Hello, World!");
+
+        let compressed_data = first.into_body().collect().await.unwrap().to_bytes();
+        let mut decoder = GzDecoder::new(&compressed_data[..]);
+        let mut decompressed = String::new();
+        decoder.read_to_string(&mut decompressed).unwrap();
+        assert_eq!(decompressed, "Hello, World!");
+        assert_eq!(adaptive.in_flight(), 0);
+
+        let third = svc.serve(Context::default(), req()).await.unwrap();
+        assert_eq!(third.headers()[CONTENT_ENCODING], "gzip");
+    }
 }
@@ -1,11 +1,13 @@
+use super::adaptive::AdaptiveDecision;
 use super::body::BodyInner;
+use super::cache::CacheKey;
 use super::predicate::{DefaultPredicate, Predicate};
 use super::CompressionBody;
-use super::CompressionLevel;
+use super::{AdaptiveQuality, CompressionCache, CompressionLevel};
 use crate::http::dep::http_body::Body;
 use crate::http::layer::util::compression::WrapBody;
 use crate::http::layer::util::{compression::AcceptEncoding, content_encoding::Encoding};
-use crate::http::{header, Request, Response};
+use crate::http::{header, Method, Request, Response, StatusCode};
 use crate::service::{Context, Service};
 
 /// Compress response bodies of the underlying service.
@@ -14,12 +16,14 @@ use crate::service::{Context, Service};
 /// `Content-Encoding` header to responses.
 ///
 /// See the [module docs](crate::http::layer::compression) for more details.
-#[derive(Clone, Copy)]
+#[derive(Clone)]
 pub struct Compression<S, P = DefaultPredicate> {
     pub(crate) inner: S,
     pub(crate) accept: AcceptEncoding,
     pub(crate) predicate: P,
     pub(crate) quality: CompressionLevel,
+    pub(crate) cache: Option<CompressionCache>,
+    pub(crate) adaptive: Option<AdaptiveQuality>,
 }
 
 impl<S, P> std::fmt::Debug for Compression<S, P>
@@ -31,6 +35,8 @@ where
             .field("inner", &self.inner)
             .field("accept", &self.accept)
             .field("quality", &self.quality)
+            .field("cache", &self.cache)
+            .field("adaptive", &self.adaptive)
             .finish()
     }
 }
@@ -43,6 +49,8 @@ impl<S> Compression<S, DefaultPredicate> {
             accept: AcceptEncoding::default(),
             predicate: DefaultPredicate::default(),
             quality: CompressionLevel::default(),
+            cache: None,
+            adaptive: None,
         }
     }
 }
@@ -80,6 +88,25 @@ impl<S, P> Compression<S, P> {
         self
     }
 
+    /// Cache the compressed bodies of responses with a strong `ETag`
+    /// in the given [`CompressionCache`], such that identical responses
+    /// are only compressed once.
+    ///
+    /// Disabled by default.
+    pub fn with_cache(mut self, cache: CompressionCache) -> Self {
+        self.cache = Some(cache);
+        self
+    }
+
+    /// Adapt the compression quality to the compression load and body size,
+    /// as configured by the given [`AdaptiveQuality`].
+    ///
+    /// Disabled by default.
+    pub fn with_adaptive_quality(mut self, adaptive: AdaptiveQuality) -> Self {
+        self.adaptive = Some(adaptive);
+        self
+    }
+
     /// Disables the gzip encoding.
     ///
     /// This method is available even if the `gzip` crate feature is disabled.
@@ -156,6 +183,8 @@ impl<S, P> Compression<S, P> {
             accept: self.accept,
             predicate,
             quality: self.quality,
+            cache: self.cache,
+            adaptive: self.adaptive,
         }
     }
 }
@@ -182,6 +211,14 @@ where
     ) -> Result<Self::Response, Self::Error> {
         let encoding = Encoding::from_headers(req.headers(), self.accept);
 
+        // only clone the uri in case the response might be served from or stored in the cache
+        let cache_uri = match &self.cache {
+            Some(_) if encoding != Encoding::Identity && req.method() == Method::GET => {
+                Some(req.uri().clone())
+            }
+            _ => None,
+        };
+
         let res = self.inner.serve(ctx, req).await?;
 
         // never recompress responses that are already compressed
@@ -198,6 +235,50 @@ where
                 .append(header::VARY, header::ACCEPT_ENCODING.into());
         }
 
+        let cache_key = match (should_compress, cache_uri) {
+            (true, Some(uri)) if parts.status == StatusCode::OK => {
+                CacheKey::new(uri, &parts.headers, encoding)
+            }
+            _ => None,
+        };
+        if let Some((cache, key)) = self.cache.as_ref().zip(cache_key.as_ref()) {
+            if let Some(data) = cache.get(key) {
+                parts.headers.remove(header::ACCEPT_RANGES);
+                parts
+                    .headers
+                    .insert(header::CONTENT_LENGTH, data.len().into());
+                parts
+                    .headers
+                    .insert(header::CONTENT_ENCODING, encoding.into_header_value());
+                return Ok(Response::from_parts(
+                    parts,
+                    CompressionBody::new(BodyInner::cached(data)),
+                ));
+            }
+        }
+
+        let (quality, in_flight) = match (should_compress, encoding, &self.adaptive) {
+            (true, encoding, Some(adaptive)) if encoding != Encoding::Identity => {
+                let body_size = body.size_hint().exact().or_else(|| {
+                    parts
+                        .headers
+                        .get(header::CONTENT_LENGTH)
+                        .and_then(|value| value.to_str().ok())
+                        .and_then(|value| value.parse().ok())
+                });
+                match adaptive.decide(self.quality, body_size) {
+                    AdaptiveDecision::Compress(quality, guard) => (quality, Some(guard)),
+                    AdaptiveDecision::Skip => {
+                        return Ok(Response::from_parts(
+                            parts,
+                            CompressionBody::new(BodyInner::identity(body)),
+                        ));
+                    }
+                }
+            }
+            _ => (self.quality, None),
+        };
+
         let body = match (should_compress, encoding) {
             // if compression is _not_ supported or the client doesn't accept it
             (false, _) | (_, Encoding::Identity) => {
@@ -208,16 +289,16 @@ where
             }
 
             (_, Encoding::Gzip) => {
-                CompressionBody::new(BodyInner::gzip(WrapBody::new(body, self.quality)))
+                CompressionBody::new(BodyInner::gzip(WrapBody::new(body, quality)))
             }
             (_, Encoding::Deflate) => {
-                CompressionBody::new(BodyInner::deflate(WrapBody::new(body, self.quality)))
+                CompressionBody::new(BodyInner::deflate(WrapBody::new(body, quality)))
             }
             (_, Encoding::Brotli) => {
-                CompressionBody::new(BodyInner::brotli(WrapBody::new(body, self.quality)))
+                CompressionBody::new(BodyInner::brotli(WrapBody::new(body, quality)))
             }
             (_, Encoding::Zstd) => {
-                CompressionBody::new(BodyInner::zstd(WrapBody::new(body, self.quality)))
+                CompressionBody::new(BodyInner::zstd(WrapBody::new(body, quality)))
             }
             #[allow(unreachable_patterns)]
             (true, _) => {
@@ -242,6 +323,15 @@ where
             }
         };
 
+        let body = body
+            .with_cache_fill(
+                self.cache
+                    .as_ref()
+                    .zip(cache_key)
+                    .map(|(cache, key)| cache.fill(key)),
+            )
+            .with_in_flight_guard(in_flight);
+
         parts.headers.remove(header::ACCEPT_RANGES);
         parts.headers.remove(header::CONTENT_LENGTH);
 
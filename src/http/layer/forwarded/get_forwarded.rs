@@ -3,7 +3,7 @@ use crate::http::headers::{
 };
 use crate::net::forwarded::ForwardedElement;
 use crate::{
-    http::Request,
+    http::{HeaderMap, HeaderName, Request},
     net::forwarded::Forwarded,
     service::{Context, Layer, Service},
 };
@@ -27,6 +27,11 @@ use std::marker::PhantomData;
 ///   case one header has less elements then the other, that the combination down the line
 ///   will not be accurate.
 ///
+/// The header values are stored as-is (without copying them) in the [`Forwarded`]
+/// extension, and only parsed once its chain is first inspected, e.g. by [`Forwarded::client_ip`].
+/// As such the extension is added as soon as a header is present, and is [empty](Forwarded::is_empty)
+/// in case none of its values turn out to be valid.
+///
 /// The following headers are supported by default:
 ///
 /// - [`GetForwardedHeadersLayer::forwarded`]: The standard [`Forwarded`] header [`RFC 7239`](https://tools.ietf.org/html/rfc7239).
@@ -247,40 +252,36 @@ macro_rules! get_forwarded_service_for_tuple {
                 mut ctx: Context<State>,
                 req: Request<Body>,
             ) -> impl Future<Output = Result<Self::Response, Self::Error>> + Send + '_ {
-                let mut forwarded_elements: Vec<ForwardedElement> = Vec::with_capacity(1);
-
-                $(
-                    if let Some($ty) = req.headers().typed_get::<$ty>() {
-                        let mut iter = $ty.into_iter();
-                        for element in forwarded_elements.iter_mut() {
-                            let other = iter.next();
-                            match other {
-                                Some(other) => {
-                                    element.merge(other);
+                fn parse<$($ty: ForwardHeader,)*>(headers: &HeaderMap) -> Vec<ForwardedElement> {
+                    let mut forwarded_elements: Vec<ForwardedElement> = Vec::with_capacity(1);
+
+                    $(
+                        if let Some($ty) = headers.typed_get::<$ty>() {
+                            let mut iter = $ty.into_iter();
+                            for element in forwarded_elements.iter_mut() {
+                                let other = iter.next();
+                                match other {
+                                    Some(other) => {
+                                        element.merge(other);
+                                    }
+                                    None => break,
                                 }
-                                None => break,
+                            }
+                            for other in iter {
+                                forwarded_elements.push(other);
                             }
                         }
-                        for other in iter {
-                            forwarded_elements.push(other);
-                        }
-                    }
-                )*
+                    )*
 
-                if !forwarded_elements.is_empty() {
-                    match ctx.get_mut::<Forwarded>() {
-                        Some(ref mut f) => {
-                            f.extend(forwarded_elements);
-                        }
-                        None => {
-                            let mut it = forwarded_elements.into_iter();
-                            let mut forwarded = Forwarded::new(it.next().unwrap());
-                            forwarded.extend(it);
-                            ctx.insert(forwarded);
-                        }
-                    }
+                    forwarded_elements
                 }
 
+                let mut headers = HeaderMap::new();
+                $(
+                    copy_header_values(req.headers(), $ty::name(), &mut headers);
+                )*
+                insert_forwarded_headers(&mut ctx, headers, parse::<$($ty,)*>);
+
                 self.inner.serve(ctx, req)
             }
         }
@@ -302,30 +303,47 @@ where
         mut ctx: Context<State>,
         req: Request<Body>,
     ) -> impl Future<Output = Result<Self::Response, Self::Error>> + Send + '_ {
-        let mut forwarded_elements: Vec<ForwardedElement> = Vec::with_capacity(1);
-
-        if let Some(header) = req.headers().typed_get::<H>() {
-            forwarded_elements.extend(header);
+        fn parse<H: ForwardHeader>(headers: &HeaderMap) -> Vec<ForwardedElement> {
+            headers
+                .typed_get::<H>()
+                .map(|header| header.into_iter().collect())
+                .unwrap_or_default()
         }
 
-        if !forwarded_elements.is_empty() {
-            match ctx.get_mut::<Forwarded>() {
-                Some(ref mut f) => {
-                    f.extend(forwarded_elements);
-                }
-                None => {
-                    let mut it = forwarded_elements.into_iter();
-                    let mut forwarded = Forwarded::new(it.next().unwrap());
-                    forwarded.extend(it);
-                    ctx.insert(forwarded);
-                }
-            }
-        }
+        let mut headers = HeaderMap::new();
+        copy_header_values(req.headers(), H::name(), &mut headers);
+        insert_forwarded_headers(&mut ctx, headers, parse::<H>);
 
         self.inner.serve(ctx, req)
     }
 }
 
+/// Copy the values of the given header, which are reference counted.
+fn copy_header_values(from: &HeaderMap, name: &HeaderName, to: &mut HeaderMap) {
+    for value in from.get_all(name) {
+        to.append(name.clone(), value.clone());
+    }
+}
+
+/// Add the forwarded elements to be parsed from the given headers
+/// to the [`Forwarded`] extension, in case any header is present,
+/// even if it turns out to contain no (valid) elements.
+fn insert_forwarded_headers<State>(
+    ctx: &mut Context<State>,
+    headers: HeaderMap,
+    parse: fn(&HeaderMap) -> Vec<ForwardedElement>,
+) {
+    if headers.is_empty() {
+        return;
+    }
+    match ctx.get_mut::<Forwarded>() {
+        Some(forwarded) => forwarded.extend_lazy(headers, parse),
+        None => {
+            ctx.insert(Forwarded::lazy(headers, parse));
+        }
+    }
+}
+
 all_the_tuples_no_last_special_case!(get_forwarded_service_for_tuple);
 
 #[cfg(test)]
@@ -418,6 +436,27 @@ mod tests {
         service.serve(Context::default(), req).await.unwrap();
     }
 
+    #[tokio::test]
+    async fn test_get_forwarded_header_invalid() {
+        let service = ServiceBuilder::new()
+            .layer(GetForwardedHeadersLayer::forwarded())
+            .service_fn(|ctx: Context<()>, _| async move {
+                let forwarded = ctx.get::<Forwarded>().unwrap();
+                assert!(forwarded.is_empty());
+                assert!(forwarded.iter().next().is_none());
+                assert!(forwarded.client_ip().is_none());
+                assert!(forwarded.client_proto().is_none());
+                Ok::<_, Infallible>(())
+            });
+
+        let req = Request::builder()
+            .header("Forwarded", "for=;proto=???")
+            .body(())
+            .unwrap();
+
+        service.serve(Context::default(), req).await.unwrap();
+    }
+
     #[tokio::test]
     async fn test_get_forwarded_header_via() {
         let service = ServiceBuilder::new()
@@ -1,6 +1,4 @@
-use crate::http::headers::{
-    ForwardHeader, HeaderMapExt, Via, XForwardedFor, XForwardedHost, XForwardedProto,
-};
+use crate::http::headers::{ForwardHeader, Via, XForwardedFor, XForwardedHost, XForwardedProto};
 use crate::http::{get_request_context, Request};
 use crate::net::address::Domain;
 use crate::net::forwarded::{Forwarded, ForwardedElement, NodeId};
@@ -275,7 +273,6 @@ where
     ) -> impl Future<Output = Result<Self::Response, Self::Error>> + Send + '_ {
         let mut peer_addr: Option<SocketAddr> =
             ctx.get::<SocketInfo>().map(|socket| *socket.peer_addr());
-        let forwarded: Option<Forwarded> = ctx.get().cloned();
         let request_ctx = get_request_context!(ctx, req);
 
         let mut forwarded_element = ForwardedElement::forwarded_by(self.by_node.clone());
@@ -292,19 +289,13 @@ where
             forwarded_element.set_forwarded_proto(forwarded_proto);
         }
 
-        let forwarded = match forwarded {
-            None => Some(Forwarded::new(forwarded_element)),
-            Some(mut forwarded) => {
-                forwarded.append(forwarded_element);
-                Some(forwarded)
-            }
-        };
-
-        if let Some(forwarded) = forwarded {
-            if let Some(header) = H::try_from_forwarded(forwarded.iter()) {
-                req.headers_mut().typed_insert(header);
-            }
-        }
+        // borrow the chain already known instead of cloning it
+        let chain = ctx
+            .get::<Forwarded>()
+            .into_iter()
+            .flat_map(Forwarded::iter)
+            .chain(std::iter::once(&forwarded_element));
+        H::insert_forwarded(req.headers_mut(), chain);
 
         self.inner.serve(ctx, req)
     }
@@ -328,7 +319,6 @@ macro_rules! set_forwarded_service_for_tuple {
                 mut ctx: Context<State>,
                 mut req: Request<Body>,
             ) -> impl Future<Output = Result<Self::Response, Self::Error>> + Send + '_ {
-                let forwarded: Option<Forwarded> = ctx.get().cloned();
                 let request_ctx = get_request_context!(ctx, req);
 
                 let mut forwarded_element = ForwardedElement::forwarded_by(self.by_node.clone());
@@ -345,21 +335,15 @@ macro_rules! set_forwarded_service_for_tuple {
                     forwarded_element.set_forwarded_proto(forwarded_proto);
                 }
 
-                let forwarded = match forwarded {
-                    None => Some(Forwarded::new(forwarded_element)),
-                    Some(mut forwarded) => {
-                        forwarded.append(forwarded_element);
-                        Some(forwarded)
-                    }
-                };
-
-                if let Some(forwarded) = forwarded {
-                    $(
-                        if let Some(header) = $ty::try_from_forwarded(forwarded.iter()) {
-                            req.headers_mut().typed_insert(header);
-                        }
-                    )*
-                }
+                // borrow the chain already known instead of cloning it
+                let forwarded = ctx.get::<Forwarded>();
+                $(
+                    let chain = forwarded
+                        .into_iter()
+                        .flat_map(Forwarded::iter)
+                        .chain(std::iter::once(&forwarded_element));
+                    $ty::insert_forwarded(req.headers_mut(), chain);
+                )*
 
                 self.inner.serve(ctx, req)
             }
@@ -18,6 +18,7 @@
 
 pub mod auth;
 pub mod body_limit;
+pub mod cache;
 pub mod catch_panic;
 pub mod classify;
 pub mod cors;
@@ -5,27 +5,28 @@
 use crate::telemetry::opentelemetry::{
     global,
     metrics::{Histogram, Meter, Unit, UpDownCounter},
-    semantic_conventions, KeyValue,
+    semantic_conventions, KeyValue, StringValue, Value,
 };
 use crate::{
     http::{
         self, get_request_context,
         headers::{HeaderMapExt, UserAgent},
+        matcher::{PathMatcher, PathRouter},
         IntoResponse, Request, Response,
     },
-    net::stream::SocketInfo,
+    net::{stream::SocketInfo, Protocol},
     service::{Context, Layer, Service},
 };
 use headers::ContentLength;
-use std::{fmt, sync::Arc, time::SystemTime};
+use std::{fmt, sync::Arc, time::Instant};
 
 // Follows the experimental semantic conventions for HTTP metrics:
 // https://github.com/open-telemetry/opentelemetry-specification/blob/main/specification/metrics/semantic_conventions/http-metrics.md
 
 use semantic_conventions::trace::{
     CLIENT_ADDRESS, CLIENT_PORT, HTTP_REQUEST_BODY_SIZE, HTTP_REQUEST_METHOD,
-    HTTP_RESPONSE_BODY_SIZE, HTTP_RESPONSE_STATUS_CODE, NETWORK_PROTOCOL_VERSION, SERVER_ADDRESS,
-    SERVER_PORT, URL_PATH, URL_QUERY, URL_SCHEME, USER_AGENT_ORIGINAL,
+    HTTP_RESPONSE_BODY_SIZE, HTTP_RESPONSE_STATUS_CODE, HTTP_ROUTE, NETWORK_PROTOCOL_VERSION,
+    SERVER_ADDRESS, SERVER_PORT, URL_PATH, URL_QUERY, URL_SCHEME, USER_AGENT_ORIGINAL,
 };
 
 const HTTP_SERVER_DURATION: &str = "http.server.duration";
@@ -89,10 +90,51 @@ impl Metrics {
     }
 }
 
+#[derive(Debug, Clone)]
+/// The policy of which attributes are recorded for the metrics of a request.
+///
+/// Attributes with an unbounded cardinality (e.g. the client address or the path)
+/// are opt-in, as each distinct value results in a new time series.
+struct AttributePolicy {
+    client_address: bool,
+    url_path: bool,
+    url_query: bool,
+    user_agent: bool,
+    server_address: bool,
+    routes: Option<RouteTemplates>,
+}
+
+impl Default for AttributePolicy {
+    fn default() -> Self {
+        Self {
+            client_address: false,
+            url_path: false,
+            url_query: false,
+            user_agent: false,
+            server_address: true,
+            routes: None,
+        }
+    }
+}
+
+#[derive(Debug, Clone)]
+/// The route templates used to label a request with the route it matches,
+/// rather than the raw path.
+struct RouteTemplates {
+    router: PathRouter,
+    templates: Vec<StringValue>,
+}
+
 #[derive(Debug, Clone)]
 /// A layer that records http server metrics using OpenTelemetry.
+///
+/// By default only attributes with a bounded cardinality are recorded,
+/// with the attributes with an unbounded cardinality being opt-in
+/// (e.g. [`Self::with_client_address`] and [`Self::with_url_path`]).
+/// Use [`Self::with_routes`] to label requests with the route they match instead.
 pub struct RequestMetricsLayer {
     metrics: Arc<Metrics>,
+    attributes: Arc<AttributePolicy>,
 }
 
 impl RequestMetricsLayer {
@@ -102,8 +144,64 @@ impl RequestMetricsLayer {
         let metrics = Metrics::new(meter);
         Self {
             metrics: Arc::new(metrics),
+            attributes: Arc::new(AttributePolicy::default()),
         }
     }
+
+    /// Record the address and port of the client,
+    /// as found in the [`SocketInfo`] of the connection.
+    pub fn with_client_address(mut self, include: bool) -> Self {
+        Arc::make_mut(&mut self.attributes).client_address = include;
+        self
+    }
+
+    /// Record the (raw) path of the request.
+    pub fn with_url_path(mut self, include: bool) -> Self {
+        Arc::make_mut(&mut self.attributes).url_path = include;
+        self
+    }
+
+    /// Record the (raw) query of the request.
+    pub fn with_url_query(mut self, include: bool) -> Self {
+        Arc::make_mut(&mut self.attributes).url_query = include;
+        self
+    }
+
+    /// Record the user agent of the request.
+    pub fn with_user_agent(mut self, include: bool) -> Self {
+        Arc::make_mut(&mut self.attributes).user_agent = include;
+        self
+    }
+
+    /// Record the host and port of the server the request is for (enabled by default).
+    pub fn with_server_address(mut self, include: bool) -> Self {
+        Arc::make_mut(&mut self.attributes).server_address = include;
+        self
+    }
+
+    /// Record the route a request matches as the `http.route` attribute,
+    /// using the first of the given [`PathMatcher`] templates (e.g. `/users/:id`)
+    /// to match the path of the request.
+    ///
+    /// Requests not matching any of the templates do not have this attribute.
+    pub fn with_routes<I, T>(mut self, templates: I) -> Self
+    where
+        I: IntoIterator<Item = T>,
+        T: AsRef<str>,
+    {
+        let mut router = PathRouter::new();
+        let templates = templates
+            .into_iter()
+            .enumerate()
+            .map(|(id, template)| {
+                let template = template.as_ref();
+                router.insert(&PathMatcher::new(template), None, id);
+                StringValue::from(Arc::<str>::from(template))
+            })
+            .collect();
+        Arc::make_mut(&mut self.attributes).routes = Some(RouteTemplates { router, templates });
+        self
+    }
 }
 
 impl Default for RequestMetricsLayer {
@@ -129,6 +227,7 @@ impl<S> Layer<S> for RequestMetricsLayer {
         RequestMetricsService {
             inner,
             metrics: self.metrics.clone(),
+            attributes: self.attributes.clone(),
         }
     }
 }
@@ -137,6 +236,7 @@ impl<S> Layer<S> for RequestMetricsLayer {
 pub struct RequestMetricsService<S> {
     inner: S,
     metrics: Arc<Metrics>,
+    attributes: Arc<AttributePolicy>,
 }
 
 impl<S> RequestMetricsService<S> {
@@ -153,6 +253,7 @@ impl<S: fmt::Debug> fmt::Debug for RequestMetricsService<S> {
         f.debug_struct("RequestMetricsService")
             .field("inner", &self.inner)
             .field("metrics", &self.metrics)
+            .field("attributes", &self.attributes)
             .finish()
     }
 }
@@ -162,6 +263,7 @@ impl<S: Clone> Clone for RequestMetricsService<S> {
         Self {
             inner: self.inner.clone(),
             metrics: self.metrics.clone(),
+            attributes: self.attributes.clone(),
         }
     }
 }
@@ -181,12 +283,12 @@ where
         mut ctx: Context<State>,
         req: Request<Body>,
     ) -> Result<Self::Response, Self::Error> {
-        let mut attributes: Vec<KeyValue> = compute_attributes(&mut ctx, &req);
+        let mut attributes: Vec<KeyValue> = compute_attributes(&self.attributes, &mut ctx, &req);
 
         self.metrics.http_server_active_requests.add(1, &attributes);
 
         // used to compute the duration of the request
-        let timer = SystemTime::now();
+        let timer = Instant::now();
 
         let result = self.inner.serve(ctx, req).await;
         self.metrics
@@ -209,10 +311,9 @@ where
                     ));
                 }
 
-                self.metrics.http_server_duration.record(
-                    timer.elapsed().map(|t| t.as_secs_f64()).unwrap_or_default(),
-                    &attributes,
-                );
+                self.metrics
+                    .http_server_duration
+                    .record(timer.elapsed().as_secs_f64(), &attributes);
 
                 Ok(res)
             }
@@ -221,39 +322,66 @@ where
     }
 }
 
-fn compute_attributes<State, Body>(ctx: &mut Context<State>, req: &Request<Body>) -> Vec<KeyValue> {
-    let mut attributes = Vec::with_capacity(12);
+fn compute_attributes<State, Body>(
+    policy: &AttributePolicy,
+    ctx: &mut Context<State>,
+    req: &Request<Body>,
+) -> Vec<KeyValue> {
+    // room for all attributes that can be recorded, including the response ones
+    let mut attributes = Vec::with_capacity(14);
 
     // client info
-    if let Some(socket_info) = ctx.get::<SocketInfo>() {
-        let peer_addr = socket_info.peer_addr();
-        attributes.push(KeyValue::new(CLIENT_ADDRESS, peer_addr.ip().to_string()));
-        attributes.push(KeyValue::new(CLIENT_PORT, peer_addr.port() as i64));
+    if policy.client_address {
+        if let Some(socket_info) = ctx.get::<SocketInfo>() {
+            let peer_addr = socket_info.peer_addr();
+            attributes.push(KeyValue::new(CLIENT_ADDRESS, peer_addr.ip().to_string()));
+            attributes.push(KeyValue::new(CLIENT_PORT, peer_addr.port() as i64));
+        }
     }
 
     // server info
     let request_ctx = get_request_context!(*ctx, *req);
-    if let Some(authority) = request_ctx.authority.as_ref() {
-        attributes.push(KeyValue::new(SERVER_ADDRESS, authority.host().to_string()));
-        attributes.push(KeyValue::new(SERVER_PORT, authority.port() as i64));
+    if policy.server_address {
+        if let Some(authority) = request_ctx.authority.as_ref() {
+            attributes.push(KeyValue::new(SERVER_ADDRESS, authority.host().to_string()));
+            attributes.push(KeyValue::new(SERVER_PORT, authority.port() as i64));
+        }
     }
 
     // Request Info
     let uri = req.uri();
-    match uri.path() {
-        "" | "/" => (),
-        path => attributes.push(KeyValue::new(URL_PATH, path.to_owned())),
+    if let Some(routes) = policy.routes.as_ref() {
+        if let Some(route) = routes.router.find(uri.path(), None) {
+            attributes.push(KeyValue::new(
+                HTTP_ROUTE,
+                Value::String(routes.templates[route.id()].clone()),
+            ));
+        }
     }
-    match uri.query() {
-        Some("") | None => (),
-        Some(query) => attributes.push(KeyValue::new(URL_QUERY, query.to_owned())),
+    if policy.url_path {
+        match uri.path() {
+            "" | "/" => (),
+            path => attributes.push(KeyValue::new(URL_PATH, path.to_owned())),
+        }
+    }
+    if policy.url_query {
+        match uri.query() {
+            Some("") | None => (),
+            Some(query) => attributes.push(KeyValue::new(URL_QUERY, query.to_owned())),
+        }
     }
-    attributes.push(KeyValue::new(URL_SCHEME, request_ctx.protocol.to_string()));
+    attributes.push(KeyValue::new(
+        URL_SCHEME,
+        scheme_value(&request_ctx.protocol),
+    ));
 
     // Common attrs (Request Info)
     // <https://github.com/open-telemetry/semantic-conventions/blob/v1.21.0/docs/http/http-spans.md#common-attributes>
 
-    attributes.push(KeyValue::new(HTTP_REQUEST_METHOD, req.method().to_string()));
+    attributes.push(KeyValue::new(
+        HTTP_REQUEST_METHOD,
+        method_value(req.method()),
+    ));
     if let Some(http_version) = match request_ctx.http_version {
         http::Version::HTTP_09 => Some("0.9"),
         http::Version::HTTP_10 => Some("1.0"),
@@ -265,8 +393,10 @@ fn compute_attributes<State, Body>(ctx: &mut Context<State>, req: &Request<Body>
         attributes.push(KeyValue::new(NETWORK_PROTOCOL_VERSION, http_version));
     }
 
-    if let Some(ua) = req.headers().typed_get::<UserAgent>() {
-        attributes.push(KeyValue::new(USER_AGENT_ORIGINAL, ua.to_string()));
+    if policy.user_agent {
+        if let Some(ua) = req.headers().typed_get::<UserAgent>() {
+            attributes.push(KeyValue::new(USER_AGENT_ORIGINAL, ua.to_string()));
+        }
     }
 
     if let Some(content_length) = req.headers().typed_get::<ContentLength>() {
@@ -278,3 +408,99 @@ fn compute_attributes<State, Body>(ctx: &mut Context<State>, req: &Request<Body>
 
     attributes
 }
+
+/// The (static) attribute value for the scheme of the request,
+/// only allocating for custom protocols.
+fn scheme_value(protocol: &Protocol) -> Value {
+    match protocol.as_str() {
+        "http" => "http".into(),
+        "https" => "https".into(),
+        "ws" => "ws".into(),
+        "wss" => "wss".into(),
+        other => other.to_owned().into(),
+    }
+}
+
+/// The (static) attribute value for the method of the request,
+/// using `_OTHER` for non-standard methods as to bound its cardinality,
+/// as defined by the semantic conventions.
+fn method_value(method: &http::Method) -> &'static str {
+    match method.as_str() {
+        "GET" => "GET",
+        "HEAD" => "HEAD",
+        "POST" => "POST",
+        "PUT" => "PUT",
+        "DELETE" => "DELETE",
+        "CONNECT" => "CONNECT",
+        "OPTIONS" => "OPTIONS",
+        "TRACE" => "TRACE",
+        "PATCH" => "PATCH",
+        _ => "_OTHER",
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn attribute_keys(policy: &AttributePolicy, uri: &str) -> Vec<(String, String)> {
+        let mut ctx = Context::default();
+        ctx.insert(SocketInfo::new(None, "127.0.0.1:8080".parse().unwrap()));
+        let req = Request::builder()
+            .method("PURGE")
+            .uri(uri)
+            .header("user-agent", "rama")
+            .body(())
+            .unwrap();
+        compute_attributes(policy, &mut ctx, &req)
+            .into_iter()
+            .map(|kv| (kv.key.as_str().to_owned(), kv.value.to_string()))
+            .collect()
+    }
+
+    #[test]
+    fn test_default_attributes_bounded() {
+        let attributes = attribute_keys(
+            &AttributePolicy::default(),
+            "http://example.com/users/42?foo=bar",
+        );
+        assert_eq!(
+            attributes,
+            vec![
+                (SERVER_ADDRESS.to_owned(), "example.com".to_owned()),
+                (SERVER_PORT.to_owned(), "80".to_owned()),
+                (URL_SCHEME.to_owned(), "http".to_owned()),
+                (HTTP_REQUEST_METHOD.to_owned(), "_OTHER".to_owned()),
+                (NETWORK_PROTOCOL_VERSION.to_owned(), "1.1".to_owned()),
+            ]
+        );
+    }
+
+    #[test]
+    fn test_opt_in_attributes() {
+        let layer = RequestMetricsLayer::new()
+            .with_client_address(true)
+            .with_url_path(true)
+            .with_url_query(true)
+            .with_user_agent(true)
+            .with_server_address(false)
+            .with_routes(["/users", "/users/:id"]);
+        let attributes = attribute_keys(&layer.attributes, "http://example.com/users/42?foo=bar");
+        let keys: Vec<_> = attributes.iter().map(|(key, _)| key.as_str()).collect();
+        assert_eq!(
+            keys,
+            vec![
+                CLIENT_ADDRESS,
+                CLIENT_PORT,
+                HTTP_ROUTE,
+                URL_PATH,
+                URL_QUERY,
+                URL_SCHEME,
+                HTTP_REQUEST_METHOD,
+                NETWORK_PROTOCOL_VERSION,
+                USER_AGENT_ORIGINAL,
+            ]
+        );
+        assert_eq!(attributes[2].1, "/users/:id");
+    }
+}
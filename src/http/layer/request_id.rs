@@ -61,6 +61,7 @@ use crate::http::{
     Request, Response,
 };
 use crate::service::{Context, Layer, Service};
+use std::cell::Cell;
 use uuid::Uuid;
 
 pub(crate) const X_REQUEST_ID: &str = "x-request-id";
@@ -317,17 +318,57 @@ where
     }
 }
 
-/// A [`MakeRequestId`] that generates `UUID`s.
+/// A [`MakeRequestId`] that generates (version 4) `UUID`s.
+///
+/// The random bits are drawn from a fast per-thread `xoshiro256++` generator,
+/// rather than drawing from the OS random source for every request. Its 256 bit
+/// state is seeded once per thread with the random bits of two OS generated v4 `UUID`s,
+/// such that the sequences of different threads (and processes) do not overlap in practice.
+/// The ids should however not be relied upon as unguessable secrets.
 #[derive(Debug, Clone, Copy, Default)]
 pub struct MakeRequestUuid;
 
 impl MakeRequestId for MakeRequestUuid {
     fn make_request_id<B>(&self, _request: &Request<B>) -> Option<RequestId> {
-        let request_id = Uuid::new_v4().to_string().parse().unwrap();
+        let uuid = uuid::Builder::from_random_bytes(random_uuid_bytes()).into_uuid();
+        let mut buffer = Uuid::encode_buffer();
+        let request_id = HeaderValue::from_str(uuid.hyphenated().encode_lower(&mut buffer))
+            .expect("hyphenated uuid to be a valid header value");
         Some(RequestId::new(request_id))
     }
 }
 
+/// Returns 16 random bytes drawn from a per-thread `xoshiro256++` generator.
+fn random_uuid_bytes() -> [u8; 16] {
+    thread_local! {
+        static STATE: Cell<[u64; 4]> = Cell::new({
+            let (a, b) = Uuid::new_v4().as_u64_pair();
+            let (c, d) = Uuid::new_v4().as_u64_pair();
+            [a, b, c, d]
+        });
+    }
+
+    STATE.with(|state| {
+        let high = xoshiro256pp(state) as u128;
+        let low = xoshiro256pp(state) as u128;
+        (high << 64 | low).to_be_bytes()
+    })
+}
+
+fn xoshiro256pp(state: &Cell<[u64; 4]>) -> u64 {
+    let mut s = state.get();
+    let result = s[0].wrapping_add(s[3]).rotate_left(23).wrapping_add(s[0]);
+    let t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = s[3].rotate_left(45);
+    state.set(s);
+    result
+}
+
 #[cfg(test)]
 mod tests {
     use crate::http::layer::set_header;
@@ -422,4 +463,18 @@ mod tests {
         let id = res.headers_mut().remove("x-request-id").unwrap();
         id.to_str().unwrap().parse::<Uuid>().unwrap();
     }
+
+    #[test]
+    fn make_request_uuid_unique_v4() {
+        let req = Request::new(());
+        let ids: std::collections::HashSet<_> = (0..10_000)
+            .map(|_| {
+                let id = MakeRequestUuid.make_request_id(&req).unwrap();
+                let uuid = id.header_value().to_str().unwrap().parse::<Uuid>().unwrap();
+                assert_eq!(uuid.get_version(), Some(uuid::Version::Random));
+                uuid
+            })
+            .collect();
+        assert_eq!(ids.len(), 10_000);
+    }
 }
@@ -0,0 +1,147 @@
+use std::sync::{
+    atomic::{AtomicU64, Ordering},
+    Arc,
+};
+
+/// Scale of the token balance, allowing for fractional token ratios.
+const TOKEN_SCALE: u64 = 1000;
+
+/// A shared budget limiting the amount of retries,
+/// in proportion to the amount of successful requests.
+///
+/// This is the retry throttling strategy of gRPC: the budget starts
+/// with [`Self::with_max_tokens`] tokens, every failed attempt withdraws a token
+/// and every successful attempt deposits [`Self::with_token_ratio`] tokens,
+/// never exceeding the maximum. Retries are only allowed for as long as more than
+/// half of the maximum tokens are left.
+///
+/// As such, once the upstream starts failing, at most about half of the maximum tokens
+/// are spent on retries, after which requests are retried at a rate of at most
+/// the token ratio times the amount of successful requests. This prevents an
+/// upstream brown-out from turning into a retry storm which multiplies its load.
+///
+/// The budget is lock-free and cloning it shares its balance, such that a single
+/// budget can be used by the [`ManagedPolicy`] of all services calling the same upstream,
+/// as well as the [`Hedge`] middleware.
+///
+/// # Example
+///
+/// ```
+/// use rama::http::layer::retry::{ManagedPolicy, RetryBudget, RetryLayer};
+///
+/// let budget = RetryBudget::new().with_max_tokens(20).with_token_ratio(0.2);
+/// let layer = RetryLayer::new(ManagedPolicy::default().with_budget(budget));
+/// # let _ = layer;
+/// ```
+///
+/// [`ManagedPolicy`]: super::ManagedPolicy
+/// [`Hedge`]: super::Hedge
+#[derive(Debug, Clone)]
+pub struct RetryBudget {
+    balance: Arc<AtomicU64>,
+    max: u64,
+    deposit: u64,
+}
+
+impl RetryBudget {
+    /// The default maximum amount of tokens.
+    pub const DEFAULT_MAX_TOKENS: u32 = 100;
+    /// The default amount of tokens deposited for every successful attempt.
+    pub const DEFAULT_TOKEN_RATIO: f64 = 0.1;
+
+    /// Create a new [`RetryBudget`].
+    pub fn new() -> Self {
+        let max = Self::DEFAULT_MAX_TOKENS as u64 * TOKEN_SCALE;
+        Self {
+            balance: Arc::new(AtomicU64::new(max)),
+            max,
+            deposit: (Self::DEFAULT_TOKEN_RATIO * TOKEN_SCALE as f64) as u64,
+        }
+    }
+
+    /// Set the maximum amount of tokens of the budget, which is also its initial balance.
+    ///
+    /// Note that this resets the balance of all clones of this budget.
+    pub fn with_max_tokens(mut self, max_tokens: u32) -> Self {
+        self.max = max_tokens.max(1) as u64 * TOKEN_SCALE;
+        self.balance.store(self.max, Ordering::Relaxed);
+        self
+    }
+
+    /// Set the amount of tokens deposited for every successful attempt.
+    ///
+    /// The ratio is clamped to the `[0.001, 1]` range.
+    pub fn with_token_ratio(mut self, ratio: f64) -> Self {
+        self.deposit = (ratio.clamp(0.001, 1.0) * TOKEN_SCALE as f64) as u64;
+        self
+    }
+
+    /// Returns the amount of tokens currently left.
+    pub fn tokens(&self) -> f64 {
+        self.balance.load(Ordering::Relaxed) as f64 / TOKEN_SCALE as f64
+    }
+
+    /// Deposit tokens for a successful attempt.
+    pub fn deposit(&self) {
+        let _ = self
+            .balance
+            .fetch_update(Ordering::Relaxed, Ordering::Relaxed, |balance| {
+                (balance < self.max).then(|| (balance + self.deposit).min(self.max))
+            });
+    }
+
+    /// Withdraw a token for a failed attempt,
+    /// returning `true` in case it can be retried.
+    pub fn withdraw(&self) -> bool {
+        let previous = self
+            .balance
+            .fetch_update(Ordering::Relaxed, Ordering::Relaxed, |balance| {
+                Some(balance.saturating_sub(TOKEN_SCALE))
+            })
+            .unwrap_or_else(|balance| balance);
+        let balance = previous.saturating_sub(TOKEN_SCALE);
+        balance > self.max / 2
+    }
+}
+
+impl Default for RetryBudget {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_retry_budget() {
+        let budget = RetryBudget::new().with_max_tokens(10).with_token_ratio(0.5);
+        assert_eq!(budget.tokens(), 10.0);
+
+        // only retries while more than half of the tokens are left
+        for _ in 0..4 {
+            assert!(budget.withdraw());
+        }
+        assert!(!budget.withdraw());
+        assert!(!budget.clone().withdraw());
+        assert_eq!(budget.tokens(), 4.0);
+
+        // successful attempts refill the budget
+        for _ in 0..4 {
+            budget.deposit();
+        }
+        assert_eq!(budget.tokens(), 6.0);
+        assert!(!budget.withdraw());
+        for _ in 0..4 {
+            budget.deposit();
+        }
+        assert!(budget.withdraw());
+
+        // never exceeding the maximum
+        for _ in 0..100 {
+            budget.deposit();
+        }
+        assert_eq!(budget.tokens(), 10.0);
+    }
+}
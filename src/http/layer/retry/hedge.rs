@@ -0,0 +1,394 @@
+//! Middleware for hedging slow requests.
+//!
+//! See [`Hedge`] for more details.
+
+use super::{managed::DoNotRetry, RetryBody, RetryBudget, RetryError, RetryErrorKind};
+use crate::error::BoxError;
+use crate::http::dep::http_body::Body as HttpBody;
+use crate::http::dep::http_body_util::BodyExt;
+use crate::http::Request;
+use crate::service::{Context, Layer, Service};
+use crate::utils::latency::LatencyHistogram;
+use std::time::{Duration, Instant};
+
+/// Hedge slow requests by sending a second attempt of the request,
+/// in case the first attempt did not complete within the observed
+/// latency quantile (the p95 by default).
+///
+/// The attempt which completes first is returned, and the other attempt is cancelled.
+/// In case the attempt which completes first failed, the other attempt is awaited instead,
+/// such that an error is only returned in case both attempts failed.
+/// This keeps slow upstreams from setting the tail latency, at the cost of
+/// sending the slowest requests twice. Requests are only hedged once
+/// [`HedgeLayer::with_min_samples`] latencies are observed.
+///
+/// Only the latencies of successful attempts are observed. In case the hedged attempt wins,
+/// the time the first attempt was in flight is observed as well, as a lower bound of its latency,
+/// such that the slow requests keep counting towards the hedge delay.
+///
+/// Only requests with an idempotent method are hedged, and never requests
+/// with [`DoNotRetry`] in their [`Context`]. A [`RetryBudget`] can be
+/// added using [`HedgeLayer::with_budget`] to limit the amount of hedged requests
+/// in proportion to the amount of successful ones.
+///
+/// The latencies are shared by all services created by the same [`HedgeLayer`]
+/// (and their clones).
+///
+/// [`DoNotRetry`]: super::managed::DoNotRetry
+pub struct Hedge<S> {
+    inner: S,
+    config: HedgeConfig,
+}
+
+#[derive(Debug, Clone)]
+struct HedgeConfig {
+    latency: LatencyHistogram,
+    quantile: f64,
+    min_samples: u64,
+    max_delay: Option<Duration>,
+    budget: Option<RetryBudget>,
+}
+
+impl<S: std::fmt::Debug> std::fmt::Debug for Hedge<S> {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("Hedge")
+            .field("inner", &self.inner)
+            .field("config", &self.config)
+            .finish()
+    }
+}
+
+impl<S: Clone> Clone for Hedge<S> {
+    fn clone(&self) -> Self {
+        Hedge {
+            inner: self.inner.clone(),
+            config: self.config.clone(),
+        }
+    }
+}
+
+impl<S> Hedge<S> {
+    /// Hedge requests of the inner service, using the default configuration.
+    ///
+    /// See [`HedgeLayer`] to configure the hedging.
+    pub fn new(service: S) -> Self {
+        HedgeLayer::new().layer(service)
+    }
+
+    define_inner_service_accessors!();
+
+    /// Returns the delay after which a request is to be hedged, if at all.
+    fn hedge_delay(&self) -> Option<Duration> {
+        let delay = self
+            .config
+            .latency
+            .quantile_with_min_samples(self.config.quantile, self.config.min_samples)?;
+        Some(match self.config.max_delay {
+            Some(max_delay) => delay.min(max_delay),
+            None => delay,
+        })
+    }
+
+    /// Record the latency of the attempt started at `start`, in case it succeeded.
+    fn record<T, E>(&self, start: Instant, result: Result<T, E>) -> Result<T, RetryError>
+    where
+        E: Into<BoxError>,
+    {
+        match result {
+            Ok(response) => {
+                self.config.latency.record(start.elapsed());
+                if let Some(budget) = &self.config.budget {
+                    budget.deposit();
+                }
+                Ok(response)
+            }
+            Err(err) => Err(RetryError {
+                kind: RetryErrorKind::Service,
+                inner: Some(err.into()),
+            }),
+        }
+    }
+}
+
+impl<S, State, Body> Service<State, Request<Body>> for Hedge<S>
+where
+    S: Service<State, Request<RetryBody>>,
+    S::Error: Into<BoxError>,
+    State: Send + Sync + 'static,
+    Body: HttpBody + Send + 'static,
+    Body::Data: Send + 'static,
+    Body::Error: Into<BoxError>,
+{
+    type Response = S::Response;
+    type Error = RetryError;
+
+    async fn serve(
+        &self,
+        ctx: Context<State>,
+        request: Request<Body>,
+    ) -> Result<Self::Response, Self::Error> {
+        // consume body so we can clone the request if needed
+        let (parts, body) = request.into_parts();
+        let body = body.collect().await.map_err(|e| RetryError {
+            kind: RetryErrorKind::BodyConsume,
+            inner: Some(e.into()),
+        })?;
+        let request = Request::from_parts(parts, RetryBody::new(body.to_bytes()));
+
+        let delay = if ctx.contains::<DoNotRetry>() || !request.method().is_idempotent() {
+            None
+        } else {
+            self.hedge_delay()
+        };
+
+        let start = Instant::now();
+        let Some(delay) = delay else {
+            let result = self.inner.serve(ctx, request).await;
+            return self.record(start, result);
+        };
+
+        let (hedge_ctx, hedge_request) = (ctx.clone(), request.clone());
+        let primary = self.inner.serve(ctx, request);
+        tokio::pin!(primary);
+
+        tokio::select! {
+            result = &mut primary => return self.record(start, result),
+            _ = tokio::time::sleep(delay) => (),
+        }
+
+        if let Some(budget) = &self.config.budget {
+            if !budget.withdraw() {
+                tracing::debug!("retry budget exhausted: not hedging request");
+                let result = primary.await;
+                return self.record(start, result);
+            }
+        }
+
+        tracing::trace!("hedging request after {delay:?}");
+        let hedge_start = Instant::now();
+        let hedge = self.inner.serve(hedge_ctx, hedge_request);
+        tokio::pin!(hedge);
+
+        // the attempt that loses the race is cancelled by dropping it,
+        // unless the winner failed, in which case the other attempt is awaited
+        tokio::select! {
+            result = &mut primary => match self.record(start, result) {
+                Ok(response) => Ok(response),
+                Err(_) => {
+                    tracing::trace!("first attempt failed: awaiting hedged attempt");
+                    let result = hedge.await;
+                    self.record(hedge_start, result)
+                }
+            },
+            result = &mut hedge => match self.record(hedge_start, result) {
+                Ok(response) => {
+                    // the cancelled first attempt took at least this long
+                    self.config.latency.record(start.elapsed());
+                    Ok(response)
+                }
+                Err(_) => {
+                    tracing::trace!("hedged attempt failed: awaiting first attempt");
+                    let result = primary.await;
+                    self.record(start, result)
+                }
+            },
+        }
+    }
+}
+
+/// Layer to hedge slow requests.
+///
+/// See [`Hedge`] for more details.
+#[derive(Debug, Clone)]
+pub struct HedgeLayer {
+    config: HedgeConfig,
+}
+
+impl HedgeLayer {
+    /// The default latency quantile after which requests are hedged.
+    pub const DEFAULT_QUANTILE: f64 = 0.95;
+    /// The default amount of latencies to observe before requests are hedged.
+    pub const DEFAULT_MIN_SAMPLES: u64 = 20;
+
+    /// Create a new [`HedgeLayer`].
+    pub fn new() -> Self {
+        Self {
+            config: HedgeConfig {
+                latency: LatencyHistogram::new(),
+                quantile: Self::DEFAULT_QUANTILE,
+                min_samples: Self::DEFAULT_MIN_SAMPLES,
+                max_delay: None,
+                budget: None,
+            },
+        }
+    }
+
+    /// Set the latency quantile after which requests are hedged (e.g. `0.95` for the p95).
+    pub fn with_quantile(mut self, quantile: f64) -> Self {
+        self.config.quantile = quantile.clamp(0.0, 1.0);
+        self
+    }
+
+    /// Set the amount of latencies to observe before requests are hedged.
+    pub fn with_min_samples(mut self, min_samples: u64) -> Self {
+        self.config.min_samples = min_samples;
+        self
+    }
+
+    /// Set the maximum delay after which requests are hedged,
+    /// regardless of the observed latencies.
+    pub fn with_max_delay(mut self, max_delay: Duration) -> Self {
+        self.config.max_delay = Some(max_delay);
+        self
+    }
+
+    /// Set the [`LatencyHistogram`] used to observe the latencies,
+    /// e.g. to share it with other services.
+    pub fn with_latency_histogram(mut self, latency: LatencyHistogram) -> Self {
+        self.config.latency = latency;
+        self
+    }
+
+    /// Add a [`RetryBudget`], to limit the amount of hedged requests
+    /// in proportion to the amount of successful requests.
+    pub fn with_budget(mut self, budget: RetryBudget) -> Self {
+        self.config.budget = Some(budget);
+        self
+    }
+}
+
+impl Default for HedgeLayer {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl<S> Layer<S> for HedgeLayer {
+    type Service = Hedge<S>;
+
+    fn layer(&self, inner: S) -> Self::Service {
+        Hedge {
+            inner,
+            config: self.config.clone(),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{
+        http::{Body, BodyExtractExt, IntoResponse, Response},
+        service::service_fn,
+    };
+    use std::{
+        convert::Infallible,
+        sync::{
+            atomic::{AtomicUsize, Ordering},
+            Arc,
+        },
+    };
+
+    #[tokio::test]
+    async fn test_hedge_slow_request() {
+        let attempts = Arc::new(AtomicUsize::new(0));
+        let latency = LatencyHistogram::new();
+        let service = HedgeLayer::new()
+            .with_min_samples(5)
+            .with_latency_histogram(latency.clone())
+            .layer(service_fn({
+                let attempts = attempts.clone();
+                move |_ctx: Context<()>, req: Request<RetryBody>| {
+                    let attempts = attempts.clone();
+                    async move {
+                        let attempt = attempts.fetch_add(1, Ordering::SeqCst);
+                        if req.uri().path() == "/slow" && attempt % 2 == 1 {
+                            tokio::time::sleep(Duration::from_secs(60)).await;
+                        }
+                        Ok::<_, Infallible>(format!("attempt {attempt}").into_response())
+                    }
+                }
+            }));
+
+        fn request(path: &str) -> Request {
+            Request::builder()
+                .uri(format!("http://example.com{path}"))
+                .body(Body::empty())
+                .unwrap()
+        }
+
+        async fn serve(
+            service: &impl Service<(), Request, Response = Response, Error = RetryError>,
+            path: &str,
+        ) -> String {
+            let res = service.serve(Context::default(), request(path)).await;
+            res.unwrap().try_into_string().await.unwrap()
+        }
+
+        // no hedging until enough latencies are observed
+        for attempt in 0..5 {
+            assert_eq!(serve(&service, "/fast").await, format!("attempt {attempt}"));
+        }
+        assert_eq!(attempts.load(Ordering::SeqCst), 5);
+
+        // the second attempt of the slow request completes first
+        let body = tokio::time::timeout(Duration::from_secs(5), serve(&service, "/slow"))
+            .await
+            .unwrap();
+        assert_eq!(body, "attempt 6");
+        assert_eq!(attempts.load(Ordering::SeqCst), 7);
+        // both the hedged attempt and the (lower bound of the) cancelled first attempt
+        assert_eq!(latency.count(), 7);
+    }
+
+    #[tokio::test]
+    async fn test_hedge_failed_attempt_awaits_other() {
+        let attempts = Arc::new(AtomicUsize::new(0));
+        let latency = LatencyHistogram::new();
+        let service = HedgeLayer::new()
+            .with_min_samples(5)
+            .with_latency_histogram(latency.clone())
+            .layer(service_fn({
+                let attempts = attempts.clone();
+                move |_ctx: Context<()>, req: Request<RetryBody>| {
+                    let attempts = attempts.clone();
+                    async move {
+                        let attempt = attempts.fetch_add(1, Ordering::SeqCst);
+                        if req.uri().path() == "/flaky" {
+                            if attempt % 2 == 1 {
+                                tokio::time::sleep(Duration::from_millis(50)).await;
+                                return Err(std::io::Error::other("flaky"));
+                            }
+                            tokio::time::sleep(Duration::from_millis(200)).await;
+                        }
+                        Ok(format!("attempt {attempt}").into_response())
+                    }
+                }
+            }));
+
+        for _ in 0..5 {
+            let req = Request::builder()
+                .uri("http://example.com/fast")
+                .body(Body::empty())
+                .unwrap();
+            service.serve(Context::default(), req).await.unwrap();
+        }
+
+        // the first attempt fails before the hedged attempt succeeds
+        let req = Request::builder()
+            .uri("http://example.com/flaky")
+            .body(Body::empty())
+            .unwrap();
+        let res = tokio::time::timeout(
+            Duration::from_secs(5),
+            service.serve(Context::default(), req),
+        )
+        .await
+        .unwrap()
+        .unwrap();
+        assert_eq!(res.try_into_string().await.unwrap(), "attempt 6");
+        assert_eq!(attempts.load(Ordering::SeqCst), 7);
+        // the latency of the failed attempt is not observed
+        assert_eq!(latency.count(), 6);
+    }
+}
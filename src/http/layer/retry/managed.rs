@@ -4,7 +4,7 @@
 //!
 //! [`Policy`]: super::Policy
 
-use super::{Policy, PolicyResult, RetryBody};
+use super::{Policy, PolicyResult, RetryBody, RetryBudget};
 use crate::{
     http::{Request, Response},
     service::Context,
@@ -28,10 +28,14 @@ pub struct DoNotRetry;
 /// [`DoNotRetry`] can be added to the [`Context`] of a [`Request`]
 /// to signal that the request should not be retried, regardless
 /// of the retry functionality defined.
+///
+/// A [`RetryBudget`] can be added using [`ManagedPolicy::with_budget`]
+/// to limit the amount of retries in proportion to the amount of successful requests.
 pub struct ManagedPolicy<B = Undefined, C = Undefined, R = Undefined> {
     backoff: B,
     clone: C,
     retry: R,
+    budget: Option<RetryBudget>,
 }
 
 impl<B, C, R, State, Response, Error> Policy<State, Response, Error> for ManagedPolicy<B, C, R>
@@ -55,6 +59,20 @@ where
         }
 
         let (ctx, result, retry) = self.retry.retry(ctx, result).await;
+        let retry = match &self.budget {
+            Some(budget) if retry => {
+                let allowed = budget.withdraw();
+                if !allowed {
+                    tracing::debug!("retry budget exhausted: aborting retry");
+                }
+                allowed
+            }
+            Some(budget) => {
+                budget.deposit();
+                false
+            }
+            None => retry,
+        };
         if retry && self.backoff.next_backoff().await {
             PolicyResult::Retry { ctx, req }
         } else {
@@ -87,6 +105,7 @@ where
             .field("backoff", &self.backoff)
             .field("clone", &self.clone)
             .field("retry", &self.retry)
+            .field("budget", &self.budget)
             .finish()
     }
 }
@@ -102,6 +121,7 @@ where
             backoff: self.backoff.clone(),
             clone: self.clone.clone(),
             retry: self.retry.clone(),
+            budget: self.budget.clone(),
         }
     }
 }
@@ -112,6 +132,7 @@ impl Default for ManagedPolicy<Undefined, Undefined, Undefined> {
             backoff: Undefined,
             clone: Undefined,
             retry: Undefined,
+            budget: None,
         }
     }
 }
@@ -134,6 +155,7 @@ impl<C, R> ManagedPolicy<Undefined, C, R> {
             backoff,
             clone: self.clone,
             retry: self.retry,
+            budget: self.budget,
         }
     }
 }
@@ -146,6 +168,7 @@ impl<B, R> ManagedPolicy<B, Undefined, R> {
             backoff: self.backoff,
             clone,
             retry: self.retry,
+            budget: self.budget,
         }
     }
 }
@@ -158,10 +181,23 @@ impl<B, C> ManagedPolicy<B, C, Undefined> {
             backoff: self.backoff,
             clone: self.clone,
             retry,
+            budget: self.budget,
         }
     }
 }
 
+impl<B, C, R> ManagedPolicy<B, C, R> {
+    /// add a [`RetryBudget`] to this [`ManagedPolicy`],
+    /// to limit the amount of retries in proportion to the amount of successful requests.
+    ///
+    /// The budget is shared by all clones of this policy,
+    /// and can be shared with other policies as well.
+    pub fn with_budget(mut self, budget: RetryBudget) -> Self {
+        self.budget = Some(budget);
+        self
+    }
+}
+
 /// A trait that is used to umbrella-cover all possible
 /// implementation kinds for the retry rule functionality.
 pub trait RetryRule<S, R, E>: private::Sealed<(S, R, E)> + Send + Sync + 'static {
@@ -552,4 +588,34 @@ mod tests {
         .await;
         assert_retry(Context::default(), req, Err(()), &policy).await;
     }
+
+    #[tokio::test]
+    async fn test_policy_with_budget() {
+        let req = Request::builder()
+            .method("GET")
+            .uri("http://example.com")
+            .body(RetryBody::empty())
+            .unwrap();
+
+        let budget = RetryBudget::new().with_max_tokens(4).with_token_ratio(1.0);
+        let policy = ManagedPolicy::default().with_budget(budget.clone());
+
+        // only retries while more than half of the tokens are left
+        assert_retry(Context::default(), req.clone(), Err(()), &policy).await;
+        assert_abort(Context::default(), req.clone(), Err(()), &policy).await;
+        assert_eq!(budget.tokens(), 2.0);
+
+        // successful requests refill the budget
+        for _ in 0..2 {
+            assert_abort(
+                Context::default(),
+                req.clone(),
+                Ok(StatusCode::OK.into_response()),
+                &policy,
+            )
+            .await;
+        }
+        assert_eq!(budget.tokens(), 4.0);
+        assert_retry(Context::default(), req, Err(()), &policy).await;
+    }
 }
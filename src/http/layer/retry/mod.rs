@@ -16,6 +16,13 @@ pub use body::RetryBody;
 pub mod managed;
 pub use managed::ManagedPolicy;
 
+mod budget;
+#[doc(inline)]
+pub use budget::RetryBudget;
+
+pub mod hedge;
+pub use hedge::{Hedge, HedgeLayer};
+
 #[cfg(test)]
 mod tests;
 
@@ -0,0 +1,404 @@
+use super::{BidirectionalMessage, BidirectionalWriter, RequestWriter, ResponseWriter, WriterMode};
+use crate::http::dep::http_body::Body as _;
+use crate::http::io::{write_http_request, write_http_response};
+use crate::http::{HeaderMap, Request, Response};
+use crate::rt::Executor;
+use parking_lot::Mutex;
+use std::{
+    collections::VecDeque,
+    fmt,
+    sync::{
+        atomic::{AtomicU64, AtomicUsize, Ordering},
+        Arc,
+    },
+};
+use tokio::{
+    io::{AsyncWrite, AsyncWriteExt},
+    sync::Notify,
+};
+
+/// Rough estimate of the memory used by a message, on top of its headers and body.
+const MESSAGE_OVERHEAD: usize = 256;
+
+/// What a [`BatchSender`] does with a message which does not fit in its memory budget.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum OverflowPolicy {
+    /// Drop the new message, keeping the messages already queued.
+    DropNewest,
+    /// Drop the oldest queued messages until the new message fits.
+    DropOldest,
+    /// Once more than half of the budget is in use, only keep one in every `n` messages,
+    /// dropping the new message in case it still does not fit.
+    Sample(u32),
+}
+
+/// The sender of a [`BidirectionalWriter`] which queues messages
+/// within a fixed memory budget, to be written in batches.
+///
+/// Sending a message never waits for the writer: in case the message
+/// does not fit in the budget, the [`OverflowPolicy`] decides which message(s) are dropped.
+/// The budget includes the messages of the batch currently being written,
+/// such that the memory used is bounded even when the writer is slow.
+///
+/// Created using [`BidirectionalWriter::batched`].
+pub struct BatchSender {
+    queue: Arc<BatchQueue>,
+}
+
+struct BatchQueue {
+    state: Mutex<BatchQueueState>,
+    notify: Notify,
+    max_bytes: usize,
+    policy: OverflowPolicy,
+    dropped: AtomicU64,
+    senders: AtomicUsize,
+}
+
+#[derive(Default)]
+struct BatchQueueState {
+    messages: VecDeque<(BidirectionalMessage, usize)>,
+    /// bytes used by the queued messages and the batch being written
+    bytes: usize,
+    sampled: u64,
+    closed: bool,
+}
+
+impl BatchSender {
+    fn new(max_bytes: usize, policy: OverflowPolicy) -> Self {
+        Self {
+            queue: Arc::new(BatchQueue {
+                state: Mutex::new(BatchQueueState::default()),
+                notify: Notify::new(),
+                max_bytes,
+                policy,
+                dropped: AtomicU64::new(0),
+                senders: AtomicUsize::new(1),
+            }),
+        }
+    }
+
+    /// Returns the amount of messages dropped so far, as they did not fit in the budget.
+    pub fn dropped(&self) -> u64 {
+        self.queue.dropped.load(Ordering::Relaxed)
+    }
+
+    /// Returns the amount of bytes of the budget currently in use.
+    pub fn used_bytes(&self) -> usize {
+        self.queue.state.lock().bytes
+    }
+
+    fn send(&self, msg: BidirectionalMessage) {
+        let size = estimated_size(&msg);
+        if self.queue.push(msg, size) {
+            self.queue.notify.notify_one();
+        }
+    }
+}
+
+impl Clone for BatchSender {
+    fn clone(&self) -> Self {
+        self.queue.senders.fetch_add(1, Ordering::Relaxed);
+        Self {
+            queue: self.queue.clone(),
+        }
+    }
+}
+
+impl Drop for BatchSender {
+    fn drop(&mut self) {
+        if self.queue.senders.fetch_sub(1, Ordering::AcqRel) == 1 {
+            self.queue.state.lock().closed = true;
+            self.queue.notify.notify_one();
+        }
+    }
+}
+
+impl fmt::Debug for BatchSender {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("BatchSender")
+            .field("max_bytes", &self.queue.max_bytes)
+            .field("policy", &self.queue.policy)
+            .field("used_bytes", &self.used_bytes())
+            .field("dropped", &self.dropped())
+            .finish()
+    }
+}
+
+impl BatchQueue {
+    /// Queue the message according to the overflow policy,
+    /// returns `false` in case it was dropped.
+    fn push(&self, msg: BidirectionalMessage, size: usize) -> bool {
+        let mut state = self.state.lock();
+
+        if size > self.max_bytes {
+            self.dropped.fetch_add(1, Ordering::Relaxed);
+            return false;
+        }
+
+        match self.policy {
+            OverflowPolicy::DropNewest => (),
+            OverflowPolicy::DropOldest => {
+                while state.bytes + size > self.max_bytes {
+                    match state.messages.pop_front() {
+                        Some((_, dropped_size)) => {
+                            state.bytes -= dropped_size;
+                            self.dropped.fetch_add(1, Ordering::Relaxed);
+                        }
+                        // the remaining bytes are used by the batch being written
+                        None => break,
+                    }
+                }
+            }
+            OverflowPolicy::Sample(n) => {
+                if state.bytes > self.max_bytes / 2 {
+                    state.sampled += 1;
+                    if state.sampled % n.max(1) as u64 != 0 {
+                        self.dropped.fetch_add(1, Ordering::Relaxed);
+                        return false;
+                    }
+                }
+            }
+        }
+
+        if state.bytes + size > self.max_bytes {
+            self.dropped.fetch_add(1, Ordering::Relaxed);
+            return false;
+        }
+
+        state.bytes += size;
+        state.messages.push_back((msg, size));
+        true
+    }
+
+    /// Wait for the next batch of messages, returns `None` once all senders are dropped
+    /// and all messages are taken.
+    async fn next_batch(&self) -> Option<(VecDeque<(BidirectionalMessage, usize)>, usize)> {
+        loop {
+            {
+                let mut state = self.state.lock();
+                if !state.messages.is_empty() {
+                    let batch = std::mem::take(&mut state.messages);
+                    let bytes = batch.iter().map(|(_, size)| size).sum();
+                    return Some((batch, bytes));
+                }
+                if state.closed {
+                    return None;
+                }
+            }
+            self.notify.notified().await;
+        }
+    }
+
+    /// Release the budget used by a written batch.
+    fn release(&self, bytes: usize) {
+        self.state.lock().bytes -= bytes;
+    }
+}
+
+fn estimated_size(msg: &BidirectionalMessage) -> usize {
+    fn headers_size(headers: &HeaderMap) -> usize {
+        headers
+            .iter()
+            .map(|(name, value)| name.as_str().len() + value.len() + 4)
+            .sum()
+    }
+
+    let (headers, size_hint) = match msg {
+        BidirectionalMessage::Request(req) => (req.headers(), req.body().size_hint()),
+        BidirectionalMessage::Response(res) => (res.headers(), res.body().size_hint()),
+    };
+    let body_size = size_hint.upper().unwrap_or_else(|| size_hint.lower());
+    MESSAGE_OVERHEAD + headers_size(headers) + body_size as usize
+}
+
+fn mode_flags(mode: Option<WriterMode>) -> (bool, bool) {
+    match mode {
+        Some(WriterMode::All) => (true, true),
+        Some(WriterMode::Headers) => (true, false),
+        Some(WriterMode::Body) => (false, true),
+        None => (false, false),
+    }
+}
+
+impl BidirectionalWriter<BatchSender> {
+    /// Create a new [`BidirectionalWriter`] with a custom writer,
+    /// queueing requests and responses within a budget of `max_bytes`.
+    ///
+    /// All messages queued by the time the writer is ready are rendered together
+    /// and written to the writer at once, followed by a single flush.
+    /// Messages which do not fit in the budget are dropped according to the given
+    /// [`OverflowPolicy`], instead of waiting for the writer. The amount of dropped
+    /// messages is available via [`BatchSender::dropped`] and logged as a warning.
+    pub fn batched<W>(
+        executor: &Executor,
+        mut writer: W,
+        max_bytes: usize,
+        policy: OverflowPolicy,
+        request_mode: Option<WriterMode>,
+        response_mode: Option<WriterMode>,
+    ) -> Self
+    where
+        W: AsyncWrite + Unpin + Send + Sync + 'static,
+    {
+        let sender = BatchSender::new(max_bytes, policy);
+        let queue = sender.queue.clone();
+
+        let (write_request_headers, write_request_body) = mode_flags(request_mode);
+        let (write_response_headers, write_response_body) = mode_flags(response_mode);
+
+        executor.spawn_task(async move {
+            let mut buf = Vec::new();
+            let mut reported_dropped = 0;
+
+            while let Some((batch, bytes)) = queue.next_batch().await {
+                buf.clear();
+                for (msg, _) in batch {
+                    match msg {
+                        BidirectionalMessage::Request(req) => {
+                            if let Err(err) = write_http_request(
+                                &mut buf,
+                                req,
+                                write_request_headers,
+                                write_request_body,
+                            )
+                            .await
+                            {
+                                tracing::error!(err = %err, "failed to write http request to batch")
+                            }
+                        }
+                        BidirectionalMessage::Response(res) => {
+                            if let Err(err) = write_http_response(
+                                &mut buf,
+                                res,
+                                write_response_headers,
+                                write_response_body,
+                            )
+                            .await
+                            {
+                                tracing::error!(err = %err, "failed to write http response to batch")
+                            }
+                        }
+                    }
+                    buf.extend_from_slice(b"\r\n");
+                }
+
+                if let Err(err) = writer.write_all(&buf).await {
+                    tracing::error!(err = %err, "failed to write batch to writer")
+                } else if let Err(err) = writer.flush().await {
+                    tracing::error!(err = %err, "failed to flush writer")
+                }
+                queue.release(bytes);
+
+                let dropped = queue.dropped.load(Ordering::Relaxed);
+                if dropped > reported_dropped {
+                    tracing::warn!(
+                        dropped = dropped - reported_dropped,
+                        total_dropped = dropped,
+                        "traffic writer dropped messages exceeding its memory budget"
+                    );
+                    reported_dropped = dropped;
+                }
+            }
+        });
+
+        Self { sender }
+    }
+
+    /// Returns the amount of messages dropped so far, as they did not fit in the budget.
+    pub fn dropped(&self) -> u64 {
+        self.sender.dropped()
+    }
+}
+
+impl RequestWriter for BidirectionalWriter<BatchSender> {
+    async fn write_request(&self, req: Request) {
+        self.sender.send(BidirectionalMessage::Request(req))
+    }
+}
+
+impl ResponseWriter for BidirectionalWriter<BatchSender> {
+    async fn write_response(&self, res: Response) {
+        self.sender.send(BidirectionalMessage::Response(res))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::http::Body;
+    use tokio::io::AsyncReadExt;
+
+    fn request(path: &'static str) -> BidirectionalMessage {
+        BidirectionalMessage::Request(Request::builder().uri(path).body(Body::empty()).unwrap())
+    }
+
+    #[test]
+    fn test_batch_queue_overflow_policies() {
+        let size = estimated_size(&request("/a"));
+
+        let sender = BatchSender::new(size * 2, OverflowPolicy::DropNewest);
+        assert!(sender.queue.push(request("/a"), size));
+        assert!(sender.queue.push(request("/b"), size));
+        assert!(!sender.queue.push(request("/c"), size));
+        assert_eq!(sender.dropped(), 1);
+        assert_eq!(sender.used_bytes(), size * 2);
+
+        let sender = BatchSender::new(size * 2, OverflowPolicy::DropOldest);
+        assert!(sender.queue.push(request("/a"), size));
+        assert!(sender.queue.push(request("/b"), size));
+        assert!(sender.queue.push(request("/c"), size));
+        assert_eq!(sender.dropped(), 1);
+        let paths: Vec<_> = sender
+            .queue
+            .state
+            .lock()
+            .messages
+            .iter()
+            .map(|(msg, _)| match msg {
+                BidirectionalMessage::Request(req) => req.uri().path().to_owned(),
+                BidirectionalMessage::Response(_) => unreachable!(),
+            })
+            .collect();
+        assert_eq!(paths, ["/b", "/c"]);
+
+        let sender = BatchSender::new(size * 4, OverflowPolicy::Sample(2));
+        for _ in 0..3 {
+            assert!(sender.queue.push(request("/a"), size));
+        }
+        // above half of the budget: only one in two messages is kept
+        assert!(!sender.queue.push(request("/a"), size));
+        assert!(sender.queue.push(request("/a"), size));
+        assert!(!sender.queue.push(request("/a"), size));
+        assert!(!sender.queue.push(request("/a"), size));
+        assert_eq!(sender.dropped(), 3);
+
+        let sender = BatchSender::new(size - 1, OverflowPolicy::DropOldest);
+        assert!(!sender.queue.push(request("/a"), size));
+        assert_eq!(sender.dropped(), 1);
+        assert_eq!(sender.used_bytes(), 0);
+    }
+
+    #[tokio::test]
+    async fn test_batched_writer() {
+        let (client, mut server) = tokio::io::duplex(1024);
+        let writer = BidirectionalWriter::batched(
+            &Executor::default(),
+            client,
+            64 * 1024,
+            OverflowPolicy::DropOldest,
+            Some(WriterMode::Body),
+            Some(WriterMode::Body),
+        );
+
+        writer.write_request(Request::new(Body::from("ping"))).await;
+        writer
+            .write_response(Response::new(Body::from("pong")))
+            .await;
+        assert_eq!(writer.dropped(), 0);
+        drop(writer);
+
+        let mut output = String::new();
+        server.read_to_string(&mut output).await.unwrap();
+        assert_eq!(output, "\r\nping\r\n\r\npong\r\n");
+    }
+}
@@ -14,6 +14,10 @@ use tokio::{
     sync::mpsc::{channel, unbounded_channel, Sender, UnboundedSender},
 };
 
+mod batch;
+#[doc(inline)]
+pub use batch::{BatchSender, OverflowPolicy};
+
 mod request;
 #[doc(inline)]
 pub use request::{DoNotWriteRequest, RequestWriter, RequestWriterLayer, RequestWriterService};
@@ -0,0 +1,360 @@
+use crate::{
+    error::{ErrorContext, OpaqueError},
+    http::{Request, RequestContext},
+    net::address::{Domain, Host},
+    service::{context::Extensions, Context},
+};
+use std::{borrow::Cow, collections::HashMap, fmt, path::Path, sync::Arc};
+
+#[derive(Clone)]
+/// Matcher based on whether or not the (sub)domain of the request's URI
+/// is part of a (large) set of domains.
+///
+/// The domains are compiled into a trie of their reversed labels,
+/// such that matching a host costs one lookup per label of that host,
+/// regardless of the amount of domains in the set. This makes it the matcher
+/// of choice for large allow and block lists, instead of combining
+/// many [`DomainMatcher`]s into a single [`HttpMatcher::any`].
+///
+/// Each entry of the set is one of:
+///
+/// - `example.com`: matches `example.com` and all its subdomains,
+///   the same as a [`DomainMatcher`] would;
+/// - `*.example.com`: matches only the subdomains of `example.com`.
+///
+/// Domains are matched case-insensitive and without their trailing dot (if any).
+///
+/// Besides requests, the matcher can also be used for streams,
+/// in which case it matches on the authority of the [`RequestContext`]
+/// found in the [`Context`], if any. Use [`Self::matches_host`]
+/// or [`Self::matches_domain`] to match outside of a [`Matcher`],
+/// e.g. as part of a [`ProxyDB`] predicate.
+///
+/// Cloning the matcher shares the compiled set.
+///
+/// # Example
+///
+/// ```
+/// use rama::http::matcher::DomainSetMatcher;
+/// use rama::net::address::Domain;
+///
+/// let matcher: DomainSetMatcher = "
+///     # ads
+///     ads.example.com
+///     *.tracker.example
+/// "
+/// .parse()
+/// .unwrap();
+///
+/// assert!(matcher.matches_domain(&Domain::from_static("ads.example.com")));
+/// assert!(matcher.matches_domain(&Domain::from_static("eu.ads.example.com")));
+/// assert!(matcher.matches_domain(&Domain::from_static("foo.tracker.example")));
+/// assert!(!matcher.matches_domain(&Domain::from_static("tracker.example")));
+/// assert!(!matcher.matches_domain(&Domain::from_static("example.com")));
+/// ```
+///
+/// [`DomainMatcher`]: super::DomainMatcher
+/// [`HttpMatcher::any`]: super::HttpMatcher::any
+/// [`Matcher`]: crate::service::Matcher
+/// [`ProxyDB`]: crate::proxy::ProxyDB
+pub struct DomainSetMatcher {
+    trie: Arc<DomainTrie>,
+}
+
+#[derive(Debug)]
+struct DomainTrie {
+    nodes: Vec<Node>,
+    len: usize,
+}
+
+#[derive(Debug, Default)]
+struct Node {
+    children: HashMap<Box<str>, usize>,
+    /// matches the domain of this node itself
+    domain: bool,
+    /// matches all subdomains of the domain of this node
+    subdomains: bool,
+}
+
+impl DomainTrie {
+    fn new() -> Self {
+        Self {
+            nodes: vec![Node::default()],
+            len: 0,
+        }
+    }
+
+    fn insert(&mut self, domain: &str, subdomains_only: bool) {
+        let mut index = 0;
+        for label in domain.trim_matches('.').rsplit('.') {
+            let label = label.to_ascii_lowercase().into_boxed_str();
+            index = match self.nodes[index].children.get(&label) {
+                Some(child) => *child,
+                None => {
+                    let child = self.nodes.len();
+                    self.nodes.push(Node::default());
+                    self.nodes[index].children.insert(label, child);
+                    child
+                }
+            };
+        }
+
+        let node = &mut self.nodes[index];
+        if !node.subdomains {
+            self.len += 1;
+        }
+        node.subdomains = true;
+        node.domain |= !subdomains_only;
+    }
+
+    fn contains(&self, domain: &str) -> bool {
+        let mut labels = domain.trim_matches('.').rsplit('.').peekable();
+        let mut node = &self.nodes[0];
+        while let Some(label) = labels.next() {
+            // only allocate in the rare case the label isn't lowercase already
+            let label = if label.bytes().any(|b| b.is_ascii_uppercase()) {
+                Cow::Owned(label.to_ascii_lowercase())
+            } else {
+                Cow::Borrowed(label)
+            };
+            node = match node.children.get(label.as_ref()) {
+                Some(child) => &self.nodes[*child],
+                None => return false,
+            };
+            if labels.peek().is_some() {
+                if node.subdomains {
+                    return true;
+                }
+            } else {
+                return node.domain;
+            }
+        }
+        false
+    }
+}
+
+impl DomainSetMatcher {
+    /// Create a new [`DomainSetMatcher`] from the given domains,
+    /// each matching itself and all its subdomains.
+    pub fn new(domains: impl IntoIterator<Item = Domain>) -> Self {
+        domains.into_iter().collect()
+    }
+
+    /// Create a new [`DomainSetMatcher`] from the given domains,
+    /// each matching only their subdomains.
+    pub fn subdomains(domains: impl IntoIterator<Item = Domain>) -> Self {
+        let mut trie = DomainTrie::new();
+        for domain in domains {
+            trie.insert(domain.as_str(), true);
+        }
+        Self {
+            trie: Arc::new(trie),
+        }
+    }
+
+    /// Create a new [`DomainSetMatcher`] from the file at the given path.
+    ///
+    /// See [`Self::from_str`] for the expected format.
+    ///
+    /// [`Self::from_str`]: std::str::FromStr::from_str
+    pub fn from_file(path: impl AsRef<Path>) -> Result<Self, OpaqueError> {
+        let path = path.as_ref();
+        std::fs::read_to_string(path)
+            .with_context(|| format!("read domain set file '{}'", path.display()))?
+            .parse()
+    }
+
+    /// Returns the amount of distinct domains in the set.
+    pub fn len(&self) -> usize {
+        self.trie.len
+    }
+
+    /// Returns `true` if the set has no entries.
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Returns `true` if the given [`Domain`] matches an entry of the set.
+    pub fn matches_domain(&self, domain: &Domain) -> bool {
+        self.trie.contains(domain.as_str())
+    }
+
+    /// Returns `true` if the given [`Host`] is a domain matching an entry of the set.
+    pub fn matches_host(&self, host: &Host) -> bool {
+        match host {
+            Host::Name(domain) => self.matches_domain(domain),
+            Host::Address(_) => false,
+        }
+    }
+}
+
+impl FromIterator<Domain> for DomainSetMatcher {
+    fn from_iter<T: IntoIterator<Item = Domain>>(iter: T) -> Self {
+        let mut trie = DomainTrie::new();
+        for domain in iter {
+            trie.insert(domain.as_str(), false);
+        }
+        Self {
+            trie: Arc::new(trie),
+        }
+    }
+}
+
+impl std::str::FromStr for DomainSetMatcher {
+    type Err = OpaqueError;
+
+    /// Parse a [`DomainSetMatcher`] from a list of domains, one per line.
+    ///
+    /// Empty lines and lines starting with a `#` are ignored,
+    /// and a domain prefixed with `*.` matches only its subdomains.
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        let mut trie = DomainTrie::new();
+        for (index, line) in s.lines().enumerate() {
+            let line = line.trim();
+            if line.is_empty() || line.starts_with('#') {
+                continue;
+            }
+            let (domain, subdomains_only) = match line.strip_prefix("*.") {
+                Some(domain) => (domain, true),
+                None => (line, false),
+            };
+            let domain: Domain = domain
+                .parse()
+                .with_context(|| format!("parse domain on line {}", index + 1))?;
+            trie.insert(domain.as_str(), subdomains_only);
+        }
+        Ok(Self {
+            trie: Arc::new(trie),
+        })
+    }
+}
+
+impl fmt::Debug for DomainSetMatcher {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("DomainSetMatcher")
+            .field("len", &self.len())
+            .finish()
+    }
+}
+
+impl<State, Body> crate::service::Matcher<State, Request<Body>> for DomainSetMatcher {
+    fn matches(
+        &self,
+        _ext: Option<&mut Extensions>,
+        ctx: &Context<State>,
+        req: &Request<Body>,
+    ) -> bool {
+        match ctx.get::<RequestContext>() {
+            Some(req_ctx) => req_ctx
+                .authority
+                .as_ref()
+                .map(|authority| self.matches_host(authority.host()))
+                .unwrap_or_default(),
+            None => RequestContext::from((ctx, req))
+                .authority
+                .map(|authority| self.matches_host(authority.host()))
+                .unwrap_or_default(),
+        }
+    }
+}
+
+impl<State, Socket> crate::service::Matcher<State, Socket> for DomainSetMatcher
+where
+    Socket: crate::net::stream::Socket,
+{
+    fn matches(
+        &self,
+        _ext: Option<&mut Extensions>,
+        ctx: &Context<State>,
+        _stream: &Socket,
+    ) -> bool {
+        ctx.get::<RequestContext>()
+            .and_then(|req_ctx| req_ctx.authority.as_ref())
+            .map(|authority| self.matches_host(authority.host()))
+            .unwrap_or_default()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::service::Matcher;
+
+    #[test]
+    fn test_domain_set_matches_domain() {
+        let matcher = DomainSetMatcher::new([
+            Domain::from_static("example.com"),
+            Domain::from_static("Foo.Org."),
+        ]);
+        assert_eq!(matcher.len(), 2);
+
+        for (domain, expected) in [
+            ("example.com", true),
+            ("EXAMPLE.com.", true),
+            ("www.example.com", true),
+            ("a.b.example.com", true),
+            ("example.org", false),
+            ("notexample.com", false),
+            ("com", false),
+            ("foo.org", true),
+            ("bar.foo.org", true),
+        ] {
+            assert_eq!(
+                matcher.matches_domain(&domain.parse().unwrap()),
+                expected,
+                "domain: {domain}"
+            );
+        }
+    }
+
+    #[test]
+    fn test_domain_set_subdomains_only() {
+        let matcher = DomainSetMatcher::subdomains([Domain::from_static("example.com")]);
+        assert!(!matcher.matches_domain(&Domain::from_static("example.com")));
+        assert!(matcher.matches_domain(&Domain::from_static("www.example.com")));
+    }
+
+    #[test]
+    fn test_domain_set_from_str() {
+        let matcher: DomainSetMatcher = "
+            # comment
+            example.com
+
+            *.example.org
+            *.example.com
+        "
+        .parse()
+        .unwrap();
+        assert_eq!(matcher.len(), 2);
+        assert!(matcher.matches_domain(&Domain::from_static("example.com")));
+        assert!(matcher.matches_domain(&Domain::from_static("www.example.com")));
+        assert!(!matcher.matches_domain(&Domain::from_static("example.org")));
+        assert!(matcher.matches_domain(&Domain::from_static("www.example.org")));
+        assert!(!matcher.matches_host(&Host::Address("127.0.0.1".parse().unwrap())));
+
+        assert!("example.com\ninvalid..domain"
+            .parse::<DomainSetMatcher>()
+            .is_err());
+    }
+
+    #[test]
+    fn test_domain_set_matcher_request() {
+        let matcher = DomainSetMatcher::new([Domain::from_static("example.com")]);
+
+        let req = Request::builder()
+            .uri("http://www.example.com/foo")
+            .body(())
+            .unwrap();
+        assert!(matcher.matches(None, &Context::default(), &req));
+
+        let req = Request::builder()
+            .uri("http://example.org/foo")
+            .body(())
+            .unwrap();
+        assert!(!matcher.matches(None, &Context::default(), &req));
+
+        let mut ctx = Context::default();
+        ctx.insert(RequestContext::from((&ctx, &req)));
+        assert!(!matcher.matches(None, &ctx, &req));
+    }
+}
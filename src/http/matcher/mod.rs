@@ -21,6 +21,10 @@ mod domain;
 #[doc(inline)]
 pub use domain::DomainMatcher;
 
+mod domain_set;
+#[doc(inline)]
+pub use domain_set::DomainSetMatcher;
+
 pub mod uri;
 pub use uri::UriMatcher;
 
@@ -29,6 +33,7 @@ mod version;
 pub use version::VersionMatcher;
 
 mod path;
+pub(crate) use path::PathRouter;
 #[doc(inline)]
 pub use path::{PathMatcher, UriParams, UriParamsDeserializeError};
 
@@ -70,6 +75,8 @@ pub enum HttpMatcherKind<State, Body> {
     Path(PathMatcher),
     /// [`DomainMatcher`], a matcher based on the (sub)domain of the request's URI.
     Domain(DomainMatcher),
+    /// [`DomainSetMatcher`], a matcher based on the (sub)domain of the request's URI being part of a set of domains.
+    DomainSet(DomainSetMatcher),
     /// [`VersionMatcher`], a matcher based on the HTTP version of the request.
     Version(VersionMatcher),
     /// zero or more [`HttpMatcher`]s that at least one needs to match in order for the matcher to return `true`.
@@ -93,6 +100,7 @@ impl<State, Body> Clone for HttpMatcherKind<State, Body> {
             Self::Method(inner) => Self::Method(*inner),
             Self::Path(inner) => Self::Path(inner.clone()),
             Self::Domain(inner) => Self::Domain(inner.clone()),
+            Self::DomainSet(inner) => Self::DomainSet(inner.clone()),
             Self::Version(inner) => Self::Version(*inner),
             Self::Any(inner) => Self::Any(inner.clone()),
             Self::Uri(inner) => Self::Uri(inner.clone()),
@@ -110,6 +118,7 @@ impl<State, Body> fmt::Debug for HttpMatcherKind<State, Body> {
             Self::Method(inner) => f.debug_tuple("Method").field(inner).finish(),
             Self::Path(inner) => f.debug_tuple("Path").field(inner).finish(),
             Self::Domain(inner) => f.debug_tuple("Domain").field(inner).finish(),
+            Self::DomainSet(inner) => f.debug_tuple("DomainSet").field(inner).finish(),
             Self::Version(inner) => f.debug_tuple("Version").field(inner).finish(),
             Self::Any(inner) => f.debug_tuple("Any").field(inner).finish(),
             Self::Uri(inner) => f.debug_tuple("Uri").field(inner).finish(),
@@ -367,6 +376,28 @@ impl<State, Body> HttpMatcher<State, Body> {
         self.or(Self::domain(domain))
     }
 
+    /// Create a [`DomainSetMatcher`] matcher.
+    pub fn domain_set(domains: DomainSetMatcher) -> Self {
+        Self {
+            kind: HttpMatcherKind::DomainSet(domains),
+            negate: false,
+        }
+    }
+
+    /// Create a [`DomainSetMatcher`] matcher to also match on top of the existing set of [`HttpMatcher`] matchers.
+    ///
+    /// See [`DomainSetMatcher`] for more information.
+    pub fn and_domain_set(self, domains: DomainSetMatcher) -> Self {
+        self.and(Self::domain_set(domains))
+    }
+
+    /// Create a [`DomainSetMatcher`] matcher to match as an alternative to the existing set of [`HttpMatcher`] matchers.
+    ///
+    /// See [`DomainSetMatcher`] for more information.
+    pub fn or_domain_set(self, domains: DomainSetMatcher) -> Self {
+        self.or(Self::domain_set(domains))
+    }
+
     /// Create a [`VersionMatcher`] matcher.
     pub fn version(version: VersionMatcher) -> Self {
         Self {
@@ -691,6 +722,7 @@ where
             HttpMatcherKind::Method(method) => method.matches(ext, ctx, req),
             HttpMatcherKind::Path(path) => path.matches(ext, ctx, req),
             HttpMatcherKind::Domain(domain) => domain.matches(ext, ctx, req),
+            HttpMatcherKind::DomainSet(domains) => domains.matches(ext, ctx, req),
             HttpMatcherKind::Version(version) => version.matches(ext, ctx, req),
             HttpMatcherKind::Uri(uri) => uri.matches(ext, ctx, req),
             HttpMatcherKind::Header(header) => header.matches(ext, ctx, req),
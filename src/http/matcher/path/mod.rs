@@ -6,6 +6,9 @@ use std::collections::HashMap;
 
 mod de;
 
+mod router;
+pub(crate) use router::PathRouter;
+
 #[derive(Debug, Clone, Default)]
 /// parameters that are inserted in the [`Context`],
 /// in case the [`PathMatcher`] found a match for the given [`Request`].
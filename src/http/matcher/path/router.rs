@@ -0,0 +1,334 @@
+//! A tree of path segments used to find the first matching route for a path,
+//! without having to try every [`PathMatcher`] in turn.
+
+use super::{PathFragment, PathMatcher, PathMatcherKind, UriParams};
+use crate::http::matcher::MethodMatcher;
+use std::{borrow::Cow, collections::HashMap};
+
+#[derive(Debug, Clone, Default)]
+/// A radix tree over the (lowercase) segments of [`PathMatcher`] paths.
+///
+/// Each route is identified by an id, with the lowest id winning
+/// in case multiple routes match the same path, which allows the tree
+/// to respect the order in which routes were defined.
+pub(crate) struct PathRouter {
+    root: Node,
+}
+
+#[derive(Debug, Clone)]
+struct Node {
+    literals: HashMap<String, Node>,
+    params: Vec<(String, Node)>,
+    /// routes which end at this node
+    routes: Vec<Route>,
+    /// routes which end with a glob following this node
+    globs: Vec<Route>,
+    /// lowest route id found in this node or any of its children,
+    /// used to skip subtrees which cannot improve the match found so far
+    min_id: usize,
+}
+
+impl Default for Node {
+    fn default() -> Self {
+        Self {
+            literals: HashMap::new(),
+            params: Vec::new(),
+            routes: Vec::new(),
+            globs: Vec::new(),
+            min_id: usize::MAX,
+        }
+    }
+}
+
+#[derive(Debug, Clone, Copy)]
+struct Route {
+    id: usize,
+    /// methods matched by this route, `None` matching any method
+    methods: Option<MethodMatcher>,
+}
+
+impl Route {
+    fn matches(&self, method: Option<MethodMatcher>) -> bool {
+        match (self.methods, method) {
+            (None, _) => true,
+            (Some(methods), Some(method)) => methods.contains(method),
+            (Some(_), None) => false,
+        }
+    }
+}
+
+#[derive(Debug, Clone)]
+/// A route found by the [`PathRouter`] for a given path.
+///
+/// The captured values borrow from the path,
+/// and are only turned into [`UriParams`] once the match is used.
+pub(crate) struct RouteMatch<'r, 'p> {
+    id: usize,
+    params: Vec<(&'r str, &'p str)>,
+    glob: Option<&'p str>,
+}
+
+impl<'r, 'p> RouteMatch<'r, 'p> {
+    /// The id of the route that matched.
+    pub(crate) fn id(&self) -> usize {
+        self.id
+    }
+
+    /// Create the [`UriParams`] for the values captured by this match.
+    pub(crate) fn into_uri_params(self) -> UriParams {
+        let mut params = UriParams::default();
+        for (name, segment) in self.params {
+            let value = percent_encoding::percent_decode(segment.as_bytes())
+                .decode_utf8()
+                .map(|s| s.to_string())
+                .unwrap_or_else(|_| segment.to_owned());
+            params.insert(name.to_owned(), value);
+        }
+        if let Some(glob) = self.glob {
+            params.glob = Some(format!("/{}", glob));
+        }
+        params
+    }
+}
+
+impl PathRouter {
+    /// Create a new empty [`PathRouter`].
+    pub(crate) fn new() -> Self {
+        Self::default()
+    }
+
+    /// Insert a route for the given [`PathMatcher`] and methods (`None` for any method).
+    pub(crate) fn insert(
+        &mut self,
+        matcher: &PathMatcher,
+        methods: Option<MethodMatcher>,
+        id: usize,
+    ) {
+        let route = Route { id, methods };
+        let mut node = &mut self.root;
+        node.min_id = node.min_id.min(id);
+
+        match &matcher.kind {
+            PathMatcherKind::Literal(literal) => {
+                for segment in literal.split('/') {
+                    node = node.literals.entry(segment.to_owned()).or_default();
+                    node.min_id = node.min_id.min(id);
+                }
+                node.routes.push(route);
+            }
+            PathMatcherKind::FragmentList(fragments) => {
+                for fragment in fragments {
+                    node = match fragment {
+                        PathFragment::Literal(literal) => {
+                            node.literals.entry(literal.clone()).or_default()
+                        }
+                        PathFragment::Param(name) => {
+                            let index = match node.params.iter().position(|(n, _)| n == name) {
+                                Some(index) => index,
+                                None => {
+                                    node.params.push((name.clone(), Node::default()));
+                                    node.params.len() - 1
+                                }
+                            };
+                            &mut node.params[index].1
+                        }
+                        PathFragment::Glob => {
+                            // a glob is always the last fragment
+                            node.globs.push(route);
+                            return;
+                        }
+                    };
+                    node.min_id = node.min_id.min(id);
+                }
+                node.routes.push(route);
+            }
+        }
+    }
+
+    /// Find the route with the lowest id that matches the given path and method.
+    ///
+    /// The semantics are those of [`PathMatcher`], combined with a [`MethodMatcher`].
+    pub(crate) fn find<'r, 'p>(
+        &'r self,
+        path: &'p str,
+        method: Option<MethodMatcher>,
+    ) -> Option<RouteMatch<'r, 'p>> {
+        let path = path.trim().trim_matches('/');
+        let mut best = None;
+        let mut params = Vec::new();
+        find_in(&self.root, Some(path), method, &mut params, &mut best);
+        best
+    }
+}
+
+fn find_in<'r, 'p>(
+    node: &'r Node,
+    rest: Option<&'p str>,
+    method: Option<MethodMatcher>,
+    params: &mut Vec<(&'r str, &'p str)>,
+    best: &mut Option<RouteMatch<'r, 'p>>,
+) {
+    if best
+        .as_ref()
+        .map(|m| m.id <= node.min_id)
+        .unwrap_or_default()
+    {
+        return;
+    }
+
+    let rest = match rest {
+        Some(rest) => rest,
+        None => {
+            record(&node.routes, method, params, None, best);
+            return;
+        }
+    };
+
+    record(&node.globs, method, params, Some(rest), best);
+
+    let (segment, tail) = match rest.split_once('/') {
+        Some((segment, tail)) => (segment, Some(tail)),
+        None => (rest, None),
+    };
+
+    let literal = if segment.bytes().any(|b| b.is_ascii_uppercase()) {
+        Cow::Owned(segment.to_ascii_lowercase())
+    } else {
+        Cow::Borrowed(segment)
+    };
+    if let Some(child) = node.literals.get(literal.as_ref()) {
+        find_in(child, tail, method, params, best);
+    }
+
+    if !segment.is_empty() {
+        for (name, child) in &node.params {
+            params.push((name.as_str(), segment));
+            find_in(child, tail, method, params, best);
+            params.pop();
+        }
+    }
+}
+
+fn record<'r, 'p>(
+    routes: &[Route],
+    method: Option<MethodMatcher>,
+    params: &[(&'r str, &'p str)],
+    glob: Option<&'p str>,
+    best: &mut Option<RouteMatch<'r, 'p>>,
+) {
+    let id = match routes
+        .iter()
+        .filter(|route| route.matches(method))
+        .map(|route| route.id)
+        .min()
+    {
+        Some(id) => id,
+        None => return,
+    };
+    if best.as_ref().map(|m| m.id < id).unwrap_or_default() {
+        return;
+    }
+    *best = Some(RouteMatch {
+        id,
+        params: params.to_vec(),
+        glob,
+    });
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn router(paths: &[(&str, Option<MethodMatcher>)]) -> PathRouter {
+        let mut router = PathRouter::new();
+        for (id, (path, methods)) in paths.iter().enumerate() {
+            router.insert(&PathMatcher::new(path), *methods, id);
+        }
+        router
+    }
+
+    #[test]
+    fn test_router_same_as_path_matcher() {
+        let paths = [
+            "/",
+            "/foo",
+            "/foo/bar",
+            "/*foo",
+            "/foo/*bar/baz",
+            "/:foo",
+            "/*",
+            "/person/:name/age",
+            "/book/:title/author",
+            "/book/:title/author/:index",
+            "/assets/*",
+            "/assets/:local/*",
+            "/assets/:local/css/*",
+        ];
+        let requests = [
+            "",
+            "/",
+            "/foo",
+            "/FOO/",
+            "/foo/bar",
+            "/foo/*bar/baz",
+            "/person/glen%20dc/age",
+            "/book/oxford-dictionary",
+            "/book/oxford-dictionary/author",
+            "/book/oxford-dictionary/author/0",
+            "/book/oxford-dictionary/author/birthdate",
+            "/assets",
+            "/assets/css/reset.css",
+            "/assets/eu/css/reset.css",
+            "/unknown/path",
+        ];
+
+        // every path as the single route, so the router has to agree with the matcher
+        for path in paths {
+            let matcher = PathMatcher::new(path);
+            let router = router(&[(path, None)]);
+            for request in requests {
+                let expected = matcher.matches_path(request);
+                let result = router
+                    .find(request, Some(MethodMatcher::GET))
+                    .map(RouteMatch::into_uri_params);
+                match (result, expected) {
+                    (None, None) => (),
+                    (Some(result), Some(expected)) => {
+                        assert_eq!(result.params, expected.params, "{path} <> {request}");
+                        assert_eq!(result.glob, expected.glob, "{path} <> {request}");
+                    }
+                    (result, expected) => {
+                        panic!("{path} <> {request}: {result:?} != {expected:?}")
+                    }
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_router_lowest_id_wins() {
+        let router = router(&[
+            ("/assets/*", None),
+            ("/assets/style.css", None),
+            ("/api/:version", Some(MethodMatcher::POST)),
+            ("/api/v1", Some(MethodMatcher::GET)),
+            ("/api/:version", Some(MethodMatcher::GET)),
+        ]);
+
+        let found = router.find("/assets/style.css", None).unwrap();
+        assert_eq!(found.id(), 0);
+
+        let found = router.find("/api/v1", Some(MethodMatcher::GET)).unwrap();
+        assert_eq!(found.id(), 3);
+
+        let found = router.find("/api/v2", Some(MethodMatcher::GET)).unwrap();
+        assert_eq!(found.id(), 4);
+        assert_eq!(found.into_uri_params().get("version"), Some("v2"));
+
+        let found = router.find("/api/v1", Some(MethodMatcher::POST)).unwrap();
+        assert_eq!(found.id(), 2);
+
+        assert!(router.find("/api/v1", Some(MethodMatcher::PUT)).is_none());
+        assert!(router.find("/api/v1", None).is_none());
+    }
+}
@@ -9,10 +9,11 @@ use crate::utils::future::Fuse;
 use hyper::server::conn::http1::Builder as Http1Builder;
 use hyper::server::conn::http2::Builder as Http2Builder;
 use hyper_util::{rt::TokioIo, server::conn::auto::Builder as AutoBuilder};
+use std::any::Any;
 use std::convert::Infallible;
 use std::error::Error;
 use std::pin::pin;
-use tokio::select;
+use tokio::{net::TcpStream, select};
 
 /// A utility trait to allow any of the hyper server builders to be used
 /// in the same way to (http) serve a connection.
@@ -44,29 +45,9 @@ impl HyperConnServer for Http1Builder {
         S: Service<State, Request, Response = Response, Error = Infallible>,
         Response: IntoResponse + Send + 'static,
     {
-        let stream = TokioIo::new(Box::pin(io));
-        let guard = ctx.guard().cloned();
-        let service = HyperService::new(ctx, service);
-
-        let mut conn = pin!(self.serve_connection(stream, service).with_upgrades());
-
-        if let Some(guard) = guard {
-            let mut cancelled_fut = pin!(Fuse::new(guard.cancelled()));
-
-            loop {
-                select! {
-                    _ = cancelled_fut.as_mut() => {
-                        tracing::trace!("signal received: initiate graceful shutdown");
-                        conn.as_mut().graceful_shutdown();
-                    }
-                    result = conn.as_mut() => {
-                        tracing::trace!("connection finished");
-                        return map_hyper_result(result);
-                    }
-                }
-            }
-        } else {
-            map_hyper_result(conn.await)
+        match try_downcast::<_, TcpStream>(io) {
+            Ok(stream) => serve_http1(self, ctx, TokioIo::new(stream), service).await,
+            Err(io) => serve_http1(self, ctx, TokioIo::new(Box::pin(io)), service).await,
         }
     }
 }
@@ -85,29 +66,9 @@ impl HyperConnServer for Http2Builder<Executor> {
         S: Service<State, Request, Response = Response, Error = Infallible>,
         Response: IntoResponse + Send + 'static,
     {
-        let stream = TokioIo::new(Box::pin(io));
-        let guard = ctx.guard().cloned();
-        let service = HyperService::new(ctx, service);
-
-        let mut conn = pin!(self.serve_connection(stream, service));
-
-        if let Some(guard) = guard {
-            let mut cancelled_fut = pin!(Fuse::new(guard.cancelled()));
-
-            loop {
-                select! {
-                    _ = cancelled_fut.as_mut() => {
-                        tracing::trace!("signal received: initiate graceful shutdown");
-                        conn.as_mut().graceful_shutdown();
-                    }
-                    result = conn.as_mut() => {
-                        tracing::trace!("connection finished");
-                        return map_hyper_result(result);
-                    }
-                }
-            }
-        } else {
-            map_hyper_result(conn.await)
+        match try_downcast::<_, TcpStream>(io) {
+            Ok(stream) => serve_http2(self, ctx, TokioIo::new(stream), service).await,
+            Err(io) => serve_http2(self, ctx, TokioIo::new(Box::pin(io)), service).await,
         }
     }
 }
@@ -126,30 +87,134 @@ impl HyperConnServer for AutoBuilder<Executor> {
         S: Service<State, Request, Response = Response, Error = Infallible>,
         Response: IntoResponse + Send + 'static,
     {
-        let stream = TokioIo::new(Box::pin(io));
-        let guard = ctx.guard().cloned();
-        let service = HyperService::new(ctx, service);
+        match try_downcast::<_, TcpStream>(io) {
+            Ok(stream) => serve_auto(self, ctx, TokioIo::new(stream), service).await,
+            Err(io) => serve_auto(self, ctx, TokioIo::new(Box::pin(io)), service).await,
+        }
+    }
+}
 
-        let mut conn = pin!(self.serve_connection_with_upgrades(stream, service));
+/// Serve the (`Unpin`) stream as an http/1 connection.
+async fn serve_http1<IO, State, S, Response>(
+    builder: &Http1Builder,
+    ctx: Context<State>,
+    stream: TokioIo<IO>,
+    service: S,
+) -> HttpServeResult
+where
+    IO: Stream + Unpin,
+    State: Send + Sync + 'static,
+    S: Service<State, Request, Response = Response, Error = Infallible>,
+    Response: IntoResponse + Send + 'static,
+{
+    let guard = ctx.guard().cloned();
+    let service = HyperService::new(ctx, service);
 
-        if let Some(guard) = guard {
-            let mut cancelled_fut = pin!(Fuse::new(guard.cancelled()));
+    let mut conn = pin!(builder.serve_connection(stream, service).with_upgrades());
 
-            loop {
-                select! {
-                    _ = cancelled_fut.as_mut() => {
-                        tracing::trace!("signal received: nop: graceful shutdown not supported for auto builder");
-                        conn.as_mut().graceful_shutdown();
-                    }
-                    result = conn.as_mut() => {
-                        tracing::trace!("connection finished");
-                        return map_boxed_hyper_result(result);
-                    }
+    if let Some(guard) = guard {
+        let mut cancelled_fut = pin!(Fuse::new(guard.cancelled()));
+
+        loop {
+            select! {
+                _ = cancelled_fut.as_mut() => {
+                    tracing::trace!("signal received: initiate graceful shutdown");
+                    conn.as_mut().graceful_shutdown();
+                }
+                result = conn.as_mut() => {
+                    tracing::trace!("connection finished");
+                    return map_hyper_result(result);
+                }
+            }
+        }
+    } else {
+        map_hyper_result(conn.await)
+    }
+}
+
+/// Serve the (`Unpin`) stream as an http/2 connection.
+async fn serve_http2<IO, State, S, Response>(
+    builder: &Http2Builder<Executor>,
+    ctx: Context<State>,
+    stream: TokioIo<IO>,
+    service: S,
+) -> HttpServeResult
+where
+    IO: Stream + Unpin,
+    State: Send + Sync + 'static,
+    S: Service<State, Request, Response = Response, Error = Infallible>,
+    Response: IntoResponse + Send + 'static,
+{
+    let guard = ctx.guard().cloned();
+    let service = HyperService::new(ctx, service);
+
+    let mut conn = pin!(builder.serve_connection(stream, service));
+
+    if let Some(guard) = guard {
+        let mut cancelled_fut = pin!(Fuse::new(guard.cancelled()));
+
+        loop {
+            select! {
+                _ = cancelled_fut.as_mut() => {
+                    tracing::trace!("signal received: initiate graceful shutdown");
+                    conn.as_mut().graceful_shutdown();
+                }
+                result = conn.as_mut() => {
+                    tracing::trace!("connection finished");
+                    return map_hyper_result(result);
+                }
+            }
+        }
+    } else {
+        map_hyper_result(conn.await)
+    }
+}
+
+/// Serve the (`Unpin`) stream as an http/1 or http/2 (auto-detected) connection.
+async fn serve_auto<IO, State, S, Response>(
+    builder: &AutoBuilder<Executor>,
+    ctx: Context<State>,
+    stream: TokioIo<IO>,
+    service: S,
+) -> HttpServeResult
+where
+    IO: Stream + Unpin,
+    State: Send + Sync + 'static,
+    S: Service<State, Request, Response = Response, Error = Infallible>,
+    Response: IntoResponse + Send + 'static,
+{
+    let guard = ctx.guard().cloned();
+    let service = HyperService::new(ctx, service);
+
+    let mut conn = pin!(builder.serve_connection_with_upgrades(stream, service));
+
+    if let Some(guard) = guard {
+        let mut cancelled_fut = pin!(Fuse::new(guard.cancelled()));
+
+        loop {
+            select! {
+                _ = cancelled_fut.as_mut() => {
+                    tracing::trace!("signal received: nop: graceful shutdown not supported for auto builder");
+                    conn.as_mut().graceful_shutdown();
+                }
+                result = conn.as_mut() => {
+                    tracing::trace!("connection finished");
+                    return map_boxed_hyper_result(result);
                 }
             }
-        } else {
-            map_boxed_hyper_result(conn.await)
         }
+    } else {
+        map_boxed_hyper_result(conn.await)
+    }
+}
+
+/// Returns the value as `U` in case it is of that (concrete) type,
+/// allowing to skip pinning it on the heap for types which are known to be `Unpin`.
+fn try_downcast<T: 'static, U: 'static>(value: T) -> Result<U, T> {
+    let mut value = Some(value);
+    match (&mut value as &mut dyn Any).downcast_mut::<Option<U>>() {
+        Some(value) => Ok(value.take().expect("downcast value to be present")),
+        None => Err(value.expect("value to be present")),
     }
 }
 
@@ -17,7 +17,7 @@ mod serve_file;
 
 #[doc(inline)]
 pub use self::{
-    serve_dir::{DefaultServeDirFallback, ServeDir},
+    serve_dir::{DefaultServeDirFallback, ServeDir, ServeDirCache},
     serve_file::ServeFile,
 };
 
@@ -0,0 +1,271 @@
+use super::open_file::{FileOpened, FileRequestExtent};
+use crate::http::layer::util::content_encoding::{Encoding, QValue};
+use crate::http::HeaderValue;
+use crate::utils::lru::LruCache;
+use bytes::Bytes;
+use parking_lot::Mutex;
+use std::{
+    fmt,
+    fs::Metadata,
+    io,
+    path::PathBuf,
+    sync::Arc,
+    time::{Duration, Instant},
+};
+use tokio::io::AsyncReadExt;
+
+/// A bounded in-memory cache of files served by [`ServeDir`] or [`ServeFile`].
+///
+/// Files are cached by requested path (including a trailing slash) and negotiated encodings,
+/// storing the contents of the (possibly precompressed) variant that was served,
+/// together with its metadata, `Content-Type` and `Content-Encoding`.
+/// A cached request is served without opening, reading or probing
+/// any (precompressed) file, including `HEAD`, range and conditional requests.
+///
+/// An entry is revalidated by comparing the modification time and length
+/// of the served file at most once per [`Self::with_revalidate_interval`],
+/// and dropped in case it changed or no longer exists. Precompressed variants
+/// added after a path was cached are only used once its entry is evicted
+/// or the cache is [cleared](Self::clear).
+///
+/// Only files of at most [`Self::with_max_file_size`] bytes are cached,
+/// and the cache holds at most [`Self::with_capacity`] entries
+/// and [`Self::with_max_size`] bytes, evicting the least recently used
+/// entries to make room for a new one.
+///
+/// Cloning the cache shares its entries.
+///
+/// # Example
+///
+/// ```
+/// use rama::http::service::fs::{ServeDir, ServeDirCache};
+/// use std::time::Duration;
+///
+/// let svc = ServeDir::new("assets").precompressed_br().with_cache(
+///     ServeDirCache::new()
+///         .with_max_file_size(256 * 1024)
+///         .with_revalidate_interval(Duration::from_secs(1)),
+/// );
+/// # let _ = svc;
+/// ```
+///
+/// [`ServeDir`]: crate::http::service::fs::ServeDir
+/// [`ServeFile`]: crate::http::service::fs::ServeFile
+#[derive(Clone)]
+pub struct ServeDirCache {
+    config: CacheConfig,
+    entries: Arc<Mutex<LruCache<CacheKey, CacheEntry>>>,
+}
+
+#[derive(Clone, Copy, Debug)]
+struct CacheConfig {
+    max_file_size: u64,
+    revalidate_interval: Duration,
+}
+
+struct CacheEntry {
+    file: Arc<CachedFile>,
+    last_checked: Instant,
+}
+
+#[derive(Clone, Debug, PartialEq, Eq, Hash)]
+pub(super) struct CacheKey {
+    pub(super) path: PathBuf,
+    /// whether the requested path ends with a slash, which is dropped from [`Self::path`],
+    /// as a directory is only served (its `index.html`) when requested with a trailing slash
+    pub(super) trailing_slash: bool,
+    pub(super) negotiated_encodings: Vec<(Encoding, QValue)>,
+}
+
+/// A file cached by the [`ServeDirCache`].
+pub(super) struct CachedFile {
+    /// path of the served file, including the extension of the precompressed variant
+    path: PathBuf,
+    pub(super) contents: Bytes,
+    pub(super) metadata: Metadata,
+    pub(super) mime_header_value: HeaderValue,
+    pub(super) maybe_encoding: Option<Encoding>,
+}
+
+impl ServeDirCache {
+    /// The default maximum amount of cached entries.
+    pub const DEFAULT_CAPACITY: usize = 4096;
+    /// The default maximum amount of bytes cached.
+    pub const DEFAULT_MAX_SIZE: usize = 64 * 1024 * 1024;
+    /// The default maximum size of a single cached file.
+    pub const DEFAULT_MAX_FILE_SIZE: u64 = 1024 * 1024;
+
+    /// Create a new [`ServeDirCache`].
+    ///
+    /// By default the cached files are revalidated for every request.
+    pub fn new() -> Self {
+        Self {
+            config: CacheConfig {
+                max_file_size: Self::DEFAULT_MAX_FILE_SIZE,
+                revalidate_interval: Duration::ZERO,
+            },
+            entries: Arc::new(Mutex::new(LruCache::new(
+                Self::DEFAULT_CAPACITY,
+                Self::DEFAULT_MAX_SIZE,
+            ))),
+        }
+    }
+
+    /// Set the maximum amount of cached entries.
+    pub fn with_capacity(self, capacity: usize) -> Self {
+        self.entries.lock().set_capacity(capacity.max(1));
+        self
+    }
+
+    /// Set the maximum amount of bytes cached, over all entries.
+    pub fn with_max_size(self, max_size: usize) -> Self {
+        self.entries.lock().set_max_size(max_size);
+        self
+    }
+
+    /// Set the maximum size of a single file to be cached.
+    ///
+    /// Larger files are served from the file system as usual.
+    pub fn with_max_file_size(mut self, max_file_size: u64) -> Self {
+        self.config.max_file_size = max_file_size;
+        self
+    }
+
+    /// Set the interval at which a cached file is compared
+    /// against the file on disk, at most once per interval.
+    ///
+    /// Within this interval cached files are served without any file system access,
+    /// at the cost of serving a changed file for at most the duration of the interval.
+    pub fn with_revalidate_interval(mut self, interval: Duration) -> Self {
+        self.config.revalidate_interval = interval;
+        self
+    }
+
+    /// Returns the amount of currently cached entries.
+    pub fn len(&self) -> usize {
+        self.entries.lock().len()
+    }
+
+    /// Returns `true` if no entries are currently cached.
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Returns the amount of bytes currently cached.
+    pub fn size(&self) -> usize {
+        self.entries.lock().size()
+    }
+
+    /// Remove all cached entries.
+    pub fn clear(&self) {
+        self.entries.lock().clear();
+    }
+
+    /// Get the cached file for the given key, if any and still valid.
+    pub(super) async fn get(&self, key: &CacheKey) -> Option<Arc<CachedFile>> {
+        let (file, needs_check) = {
+            let mut entries = self.entries.lock();
+            let entry = entries.get(key)?;
+            (
+                entry.file.clone(),
+                entry.last_checked.elapsed() >= self.config.revalidate_interval,
+            )
+        };
+
+        if !needs_check {
+            return Some(file);
+        }
+
+        let unchanged = match tokio::fs::metadata(&file.path).await {
+            Ok(metadata) => {
+                metadata.len() == file.metadata.len()
+                    && metadata.modified().ok() == file.metadata.modified().ok()
+            }
+            Err(_) => false,
+        };
+
+        let mut entries = self.entries.lock();
+        match entries.peek_mut(key) {
+            // the entry might have been replaced while checking the file
+            Some(entry) if Arc::ptr_eq(&entry.file, &file) => {
+                if unchanged {
+                    entry.last_checked = Instant::now();
+                } else {
+                    entries.remove(key);
+                }
+            }
+            _ => (),
+        }
+
+        unchanged.then_some(file)
+    }
+
+    /// Read the opened file into the cache, in case it is eligible to be cached,
+    /// such that the response is served from its cached contents.
+    pub(super) async fn fill(&self, key: CacheKey, output: &mut FileOpened) -> io::Result<()> {
+        if output.maybe_range.is_some() {
+            // the file is already seeked to the start of the range
+            return Ok(());
+        }
+        let len = match &output.extent {
+            FileRequestExtent::Full(_, metadata) => metadata.len(),
+            _ => return Ok(()),
+        };
+        if len > self.config.max_file_size || len as usize > self.entries.lock().max_size() {
+            return Ok(());
+        }
+
+        let (mut file, metadata) = match std::mem::replace(
+            &mut output.extent,
+            FileRequestExtent::Buffered(Bytes::new()),
+        ) {
+            FileRequestExtent::Full(file, metadata) => (file, metadata),
+            _ => unreachable!(),
+        };
+
+        let mut buf = Vec::with_capacity(len as usize);
+        file.read_to_end(&mut buf).await?;
+        let contents = Bytes::from(buf);
+        output.extent = FileRequestExtent::Buffered(contents.clone());
+
+        if contents.len() as u64 != metadata.len() {
+            // file was modified while reading it, serve it but do not cache it
+            return Ok(());
+        }
+
+        let file = Arc::new(CachedFile {
+            path: output.path.clone(),
+            contents,
+            metadata,
+            mime_header_value: output.mime_header_value.clone(),
+            maybe_encoding: output.maybe_encoding,
+        });
+        self.insert(key, file);
+
+        Ok(())
+    }
+
+    fn insert(&self, key: CacheKey, file: Arc<CachedFile>) {
+        let size = file.contents.len();
+        let entry = CacheEntry {
+            file,
+            last_checked: Instant::now(),
+        };
+        self.entries.lock().insert(key, entry, size);
+    }
+}
+
+impl Default for ServeDirCache {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl fmt::Debug for ServeDirCache {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("ServeDirCache")
+            .field("config", &self.config)
+            .field("entries", &*self.entries.lock())
+            .finish()
+    }
+}
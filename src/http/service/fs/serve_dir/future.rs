@@ -112,10 +112,19 @@ where
         .map(Body::new))
 }
 
+enum ResponseContents {
+    File(tokio::fs::File),
+    Buffered(Bytes),
+}
+
 fn build_response(output: FileOpened) -> Response {
-    let (maybe_file, size) = match output.extent {
-        FileRequestExtent::Full(file, meta) => (Some(file), meta.len()),
+    let (maybe_contents, size) = match output.extent {
+        FileRequestExtent::Full(file, meta) => (Some(ResponseContents::File(file)), meta.len()),
         FileRequestExtent::Head(meta) => (None, meta.len()),
+        FileRequestExtent::Buffered(bytes) => {
+            let size = bytes.len() as u64;
+            (Some(ResponseContents::Buffered(bytes)), size)
+        }
     };
 
     let mut builder = Response::builder()
@@ -145,18 +154,22 @@ fn build_response(output: FileOpened) -> Response {
                         )))
                         .unwrap()
                 } else {
-                    let body = if let Some(file) = maybe_file {
-                        let range_size = range.end() - range.start() + 1;
-                        Body::new(
-                            AsyncReadBody::with_capacity_limited(
-                                file,
-                                output.chunk_size,
-                                range_size,
+                    let body = match maybe_contents {
+                        Some(ResponseContents::File(file)) => {
+                            let range_size = range.end() - range.start() + 1;
+                            Body::new(
+                                AsyncReadBody::with_capacity_limited(
+                                    file,
+                                    output.chunk_size,
+                                    range_size,
+                                )
+                                .boxed(),
                             )
-                            .boxed(),
-                        )
-                    } else {
-                        empty_body()
+                        }
+                        Some(ResponseContents::Buffered(bytes)) => body_from_bytes(
+                            bytes.slice(*range.start() as usize..=*range.end() as usize),
+                        ),
+                        None => empty_body(),
                     };
 
                     builder
@@ -188,10 +201,12 @@ fn build_response(output: FileOpened) -> Response {
 
         // Not a range request
         None => {
-            let body = if let Some(file) = maybe_file {
-                Body::new(AsyncReadBody::with_capacity(file, output.chunk_size).boxed())
-            } else {
-                empty_body()
+            let body = match maybe_contents {
+                Some(ResponseContents::File(file)) => {
+                    Body::new(AsyncReadBody::with_capacity(file, output.chunk_size).boxed())
+                }
+                Some(ResponseContents::Buffered(bytes)) => body_from_bytes(bytes),
+                None => empty_body(),
             };
 
             builder
@@ -12,6 +12,7 @@ use std::{
     path::{Component, Path, PathBuf},
 };
 
+mod cache;
 pub(crate) mod future;
 mod headers;
 mod open_file;
@@ -19,6 +20,11 @@ mod open_file;
 #[cfg(test)]
 mod tests;
 
+#[doc(inline)]
+pub use cache::ServeDirCache;
+
+use cache::CacheKey;
+
 // default capacity 64KiB
 const DEFAULT_CAPACITY: usize = 65536;
 
@@ -73,6 +79,7 @@ pub struct ServeDir<F = DefaultServeDirFallback> {
     variant: ServeVariant,
     fallback: Option<F>,
     call_fallback_on_method_not_allowed: bool,
+    cache: Option<ServeDirCache>,
 }
 
 impl ServeDir<DefaultServeDirFallback> {
@@ -93,6 +100,7 @@ impl ServeDir<DefaultServeDirFallback> {
             },
             fallback: None,
             call_fallback_on_method_not_allowed: false,
+            cache: None,
         }
     }
 
@@ -107,6 +115,7 @@ impl ServeDir<DefaultServeDirFallback> {
             variant: ServeVariant::SingleFile { mime },
             fallback: None,
             call_fallback_on_method_not_allowed: false,
+            cache: None,
         }
     }
 }
@@ -137,6 +146,15 @@ impl<F> ServeDir<F> {
         self
     }
 
+    /// Serve files from the given in-memory [`ServeDirCache`],
+    /// reading eligible files into it the first time they are requested.
+    ///
+    /// Disabled by default.
+    pub fn with_cache(mut self, cache: ServeDirCache) -> Self {
+        self.cache = Some(cache);
+        self
+    }
+
     /// Informs the service that it should also look for a precompressed gzip
     /// version of _any_ file in the directory.
     ///
@@ -254,6 +272,7 @@ impl<F> ServeDir<F> {
             variant: self.variant,
             fallback: Some(new_fallback),
             call_fallback_on_method_not_allowed: self.call_fallback_on_method_not_allowed,
+            cache: self.cache,
         }
     }
 
@@ -441,15 +460,44 @@ impl<F> ServeDir<F> {
 
         let variant = self.variant.clone();
 
-        let open_file_result = open_file::open_file(
+        let Some(cache) = self.cache.as_ref() else {
+            let open_file_result = open_file::open_file(
+                variant,
+                path_to_file,
+                req,
+                negotiated_encodings,
+                range_header,
+                buf_chunk_size,
+            )
+            .await;
+
+            return future::consume_open_file_result(open_file_result, fallback_and_request).await;
+        };
+
+        let key = CacheKey {
+            path: path_to_file,
+            trailing_slash: req.uri().path().ends_with('/'),
+            negotiated_encodings,
+        };
+        if let Some(file) = cache.get(&key).await {
+            let output = open_file::open_cached_file(&file, &req, range_header, buf_chunk_size);
+            return future::consume_open_file_result(Ok(output), fallback_and_request).await;
+        }
+
+        let mut open_file_result = open_file::open_file(
             variant,
-            path_to_file,
+            key.path.clone(),
             req,
-            negotiated_encodings,
+            key.negotiated_encodings.clone(),
             range_header,
             buf_chunk_size,
         )
         .await;
+        if let Ok(open_file::OpenFileOutput::FileOpened(output)) = open_file_result.as_mut() {
+            if let Err(err) = cache.fill(key, output).await {
+                open_file_result = Err(err);
+            }
+        }
 
         future::consume_open_file_result(open_file_result, fallback_and_request).await
     }
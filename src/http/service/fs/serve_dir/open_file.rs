@@ -1,9 +1,11 @@
 use super::{
+    cache::CachedFile,
     headers::{IfModifiedSince, IfUnmodifiedSince, LastModified},
     ServeVariant,
 };
 use crate::http::layer::util::content_encoding::{Encoding, QValue};
 use crate::http::{header, HeaderValue, Method, Request, Uri};
+use bytes::Bytes;
 use http_range_header::RangeUnsatisfiableError;
 use std::{
     ffi::OsStr,
@@ -29,11 +31,14 @@ pub(super) struct FileOpened {
     pub(super) maybe_encoding: Option<Encoding>,
     pub(super) maybe_range: Option<Result<Vec<RangeInclusive<u64>>, RangeUnsatisfiableError>>,
     pub(super) last_modified: Option<LastModified>,
+    /// path of the opened file, including the extension of the precompressed variant
+    pub(super) path: PathBuf,
 }
 
 pub(super) enum FileRequestExtent {
     Full(File, Metadata),
     Head(Metadata),
+    Buffered(Bytes),
 }
 
 pub(super) async fn open_file(
@@ -83,7 +88,7 @@ pub(super) async fn open_file(
     };
 
     if req.method() == Method::HEAD {
-        let (meta, maybe_encoding) =
+        let (meta, maybe_encoding, path) =
             file_metadata_with_fallback(path_to_file, negotiated_encodings).await?;
 
         let last_modified = meta.modified().ok().map(LastModified::from);
@@ -104,9 +109,10 @@ pub(super) async fn open_file(
             maybe_encoding,
             maybe_range,
             last_modified,
+            path,
         })))
     } else {
-        let (mut file, maybe_encoding) =
+        let (mut file, maybe_encoding, path) =
             open_file_with_fallback(path_to_file, negotiated_encodings).await?;
         let meta = file.metadata().await?;
         let last_modified = meta.modified().ok().map(LastModified::from);
@@ -134,10 +140,57 @@ pub(super) async fn open_file(
             maybe_encoding,
             maybe_range,
             last_modified,
+            path,
         })))
     }
 }
 
+/// Same as [`open_file`], but for a file previously cached,
+/// such that no file system access is required.
+pub(super) fn open_cached_file(
+    file: &CachedFile,
+    req: &Request,
+    range_header: Option<String>,
+    buf_chunk_size: usize,
+) -> OpenFileOutput {
+    let if_unmodified_since = req
+        .headers()
+        .get(header::IF_UNMODIFIED_SINCE)
+        .and_then(IfUnmodifiedSince::from_header_value);
+
+    let if_modified_since = req
+        .headers()
+        .get(header::IF_MODIFIED_SINCE)
+        .and_then(IfModifiedSince::from_header_value);
+
+    let last_modified = file.metadata.modified().ok().map(LastModified::from);
+    if let Some(output) = check_modified_headers(
+        last_modified.as_ref(),
+        if_unmodified_since,
+        if_modified_since,
+    ) {
+        return output;
+    }
+
+    let maybe_range = try_parse_range(range_header.as_deref(), file.metadata.len());
+
+    let extent = if req.method() == Method::HEAD {
+        FileRequestExtent::Head(file.metadata.clone())
+    } else {
+        FileRequestExtent::Buffered(file.contents.clone())
+    };
+
+    OpenFileOutput::FileOpened(Box::new(FileOpened {
+        extent,
+        chunk_size: buf_chunk_size,
+        mime_header_value: file.mime_header_value.clone(),
+        maybe_encoding: file.maybe_encoding,
+        maybe_range,
+        last_modified,
+        path: PathBuf::new(),
+    }))
+}
+
 fn check_modified_headers(
     modified: Option<&LastModified>,
     if_unmodified_since: Option<IfUnmodifiedSince>,
@@ -200,7 +253,7 @@ fn preferred_encoding(
 async fn open_file_with_fallback(
     mut path: PathBuf,
     mut negotiated_encoding: Vec<(Encoding, QValue)>,
-) -> io::Result<(File, Option<Encoding>)> {
+) -> io::Result<(File, Option<Encoding>, PathBuf)> {
     let (file, encoding) = loop {
         // Get the preferred encoding among the negotiated ones.
         let encoding = preferred_encoding(&mut path, &negotiated_encoding);
@@ -218,7 +271,7 @@ async fn open_file_with_fallback(
             (Err(err), _) => return Err(err),
         };
     };
-    Ok((file, encoding))
+    Ok((file, encoding, path))
 }
 
 // Attempts to get the file metadata with any of the possible negotiated_encodings in the
@@ -227,7 +280,7 @@ async fn open_file_with_fallback(
 async fn file_metadata_with_fallback(
     mut path: PathBuf,
     mut negotiated_encoding: Vec<(Encoding, QValue)>,
-) -> io::Result<(Metadata, Option<Encoding>)> {
+) -> io::Result<(Metadata, Option<Encoding>, PathBuf)> {
     let (file, encoding) = loop {
         // Get the preferred encoding among the negotiated ones.
         let encoding = preferred_encoding(&mut path, &negotiated_encoding);
@@ -245,7 +298,7 @@ async fn file_metadata_with_fallback(
             (Err(err), _) => return Err(err),
         };
     };
-    Ok((file, encoding))
+    Ok((file, encoding, path))
 }
 
 async fn maybe_redirect_or_append_path(
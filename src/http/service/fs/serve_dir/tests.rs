@@ -1,7 +1,7 @@
 use crate::http::dep::http_body::Body as HttpBody;
 use crate::http::dep::http_body_util::BodyExt;
 use crate::http::header::ALLOW;
-use crate::http::service::fs::{ServeDir, ServeFile};
+use crate::http::service::fs::{ServeDir, ServeDirCache, ServeFile};
 use crate::http::Body;
 use crate::http::{header, Method, Response};
 use crate::http::{Request, StatusCode};
@@ -778,3 +778,152 @@ async fn calls_fallback_on_invalid_paths() {
 
     assert_eq!(res.headers()["from-fallback"], "1");
 }
+
+#[tokio::test]
+async fn cached_precompressed_gzip() {
+    let cache = ServeDirCache::new();
+    let svc = ServeDir::new("./test-files")
+        .precompressed_gzip()
+        .with_cache(cache.clone());
+
+    for _ in 0..2 {
+        let req = Request::builder()
+            .uri("/precompressed.txt")
+            .header("Accept-Encoding", "gzip")
+            .body(Body::empty())
+            .unwrap();
+        let res = svc.serve(Context::default(), req).await.unwrap();
+
+        assert_eq!(res.status(), StatusCode::OK);
+        assert_eq!(res.headers()["content-type"], "text/plain");
+        assert_eq!(res.headers()["content-encoding"], "gzip");
+        assert!(res.headers().contains_key(header::LAST_MODIFIED));
+
+        let body = res.into_body().collect().await.unwrap().to_bytes();
+        let mut decoder = GzDecoder::new(&body[..]);
+        let mut decompressed = String::new();
+        decoder.read_to_string(&mut decompressed).unwrap();
+        assert!(decompressed.starts_with("\"This is a test file!\""));
+    }
+    assert_eq!(cache.len(), 1);
+
+    // other negotiated encodings are cached separately
+    let req = Request::builder()
+        .uri("/precompressed.txt")
+        .body(Body::empty())
+        .unwrap();
+    let res = svc.serve(Context::default(), req).await.unwrap();
+    assert!(res.headers().get("content-encoding").is_none());
+    let body = body_into_text(res.into_body()).await;
+    assert!(body.starts_with("\"This is a test file!\""));
+    assert_eq!(cache.len(), 2);
+}
+
+#[tokio::test]
+async fn cached_head_and_range_request() {
+    let cache = ServeDirCache::new();
+    let svc = ServeDir::new(".").with_cache(cache.clone());
+
+    let req = Request::builder()
+        .uri("/README.md")
+        .body(Body::empty())
+        .unwrap();
+    let res = svc.serve(Context::default(), req).await.unwrap();
+    assert_eq!(res.status(), StatusCode::OK);
+    let file_contents = std::fs::read("./README.md").unwrap();
+    assert_eq!(
+        res.into_body().collect().await.unwrap().to_bytes(),
+        file_contents
+    );
+    assert_eq!(cache.len(), 1);
+    assert_eq!(cache.size(), file_contents.len());
+
+    let req = Request::builder()
+        .uri("/README.md")
+        .method(Method::HEAD)
+        .body(Body::empty())
+        .unwrap();
+    let res = svc.serve(Context::default(), req).await.unwrap();
+    assert_eq!(res.status(), StatusCode::OK);
+    assert_eq!(res.headers()["content-type"], "text/markdown");
+    assert_eq!(
+        res.headers()["content-length"],
+        file_contents.len().to_string()
+    );
+    assert!(res.into_body().frame().await.is_none());
+
+    let req = Request::builder()
+        .uri("/README.md")
+        .header("Range", "bytes=9-1023")
+        .body(Body::empty())
+        .unwrap();
+    let res = svc.serve(Context::default(), req).await.unwrap();
+    assert_eq!(res.status(), StatusCode::PARTIAL_CONTENT);
+    assert_eq!(res.headers()["content-length"], "1015");
+    let body = res.into_body().collect().await.unwrap().to_bytes();
+    assert_eq!(body, file_contents[9..=1023]);
+}
+
+#[tokio::test]
+async fn cached_file_revalidated() {
+    let dir = std::env::temp_dir().join(format!("rama-serve-dir-cache-{}", std::process::id()));
+    std::fs::create_dir_all(&dir).unwrap();
+    std::fs::write(dir.join("file.txt"), "hello").unwrap();
+
+    let cache = ServeDirCache::new().with_max_file_size(8);
+    let svc = ServeDir::new(&dir).with_cache(cache.clone());
+
+    let get = |uri: &'static str| {
+        let svc = svc.clone();
+        async move {
+            let req = Request::builder().uri(uri).body(Body::empty()).unwrap();
+            let res = svc.serve(Context::default(), req).await.unwrap();
+            (res.status(), body_into_text(res.into_body()).await)
+        }
+    };
+
+    assert_eq!(get("/file.txt").await, (StatusCode::OK, "hello".to_owned()));
+    assert_eq!(cache.len(), 1);
+
+    std::fs::write(dir.join("file.txt"), "hello world").unwrap();
+    assert_eq!(
+        get("/file.txt").await,
+        (StatusCode::OK, "hello world".to_owned())
+    );
+    // too large to be cached
+    assert!(cache.is_empty());
+
+    std::fs::write(dir.join("file.txt"), "bye").unwrap();
+    assert_eq!(get("/file.txt").await, (StatusCode::OK, "bye".to_owned()));
+    assert_eq!(cache.len(), 1);
+
+    std::fs::remove_file(dir.join("file.txt")).unwrap();
+    assert_eq!(get("/file.txt").await.0, StatusCode::NOT_FOUND);
+    assert!(cache.is_empty());
+
+    std::fs::remove_dir_all(&dir).unwrap();
+}
+
+#[tokio::test]
+async fn cached_index_html_does_not_skip_redirect() {
+    let cache = ServeDirCache::new();
+    let svc = ServeDir::new(".").with_cache(cache.clone());
+
+    let req = Request::builder()
+        .uri("/test-files/")
+        .body(Body::empty())
+        .unwrap();
+    let res = svc.serve(Context::default(), req).await.unwrap();
+    assert_eq!(res.status(), StatusCode::OK);
+    assert_eq!(res.headers()["content-type"], "text/html");
+    assert_eq!(cache.len(), 1);
+
+    let req = Request::builder()
+        .uri("/test-files")
+        .body(Body::empty())
+        .unwrap();
+    let res = svc.serve(Context::default(), req).await.unwrap();
+    assert_eq!(res.status(), StatusCode::TEMPORARY_REDIRECT);
+    assert_eq!(res.headers()[http::header::LOCATION], "/test-files/");
+    assert_eq!(cache.len(), 1);
+}
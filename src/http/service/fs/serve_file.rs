@@ -1,6 +1,6 @@
 //! Service that serves a file.
 
-use super::ServeDir;
+use super::{ServeDir, ServeDirCache};
 use crate::http::dep::{mime::Mime, mime_guess};
 use crate::http::{HeaderValue, Request, Response};
 use crate::service::{Context, Service};
@@ -102,6 +102,13 @@ impl ServeFile {
         Self(self.0.with_buf_chunk_size(chunk_size))
     }
 
+    /// Serve the file from the given in-memory [`ServeDirCache`].
+    ///
+    /// See [`ServeDir::with_cache`] for more details.
+    pub fn with_cache(self, cache: ServeDirCache) -> Self {
+        Self(self.0.with_cache(cache))
+    }
+
     /// Call the service and get a future that contains any `std::io::Error` that might have
     /// happened.
     ///
@@ -1,7 +1,7 @@
 use super::{endpoint::Endpoint, IntoEndpointService};
 use crate::{
     http::{
-        matcher::{HttpMatcher, UriParams},
+        matcher::{HttpMatcher, MethodMatcher, PathMatcher, PathRouter, UriParams},
         service::fs::ServeDir,
         Body, IntoResponse, Request, Response, StatusCode, Uri,
     },
@@ -12,12 +12,22 @@ use std::{convert::Infallible, future::Future, marker::PhantomData, sync::Arc};
 
 /// A basic web service that can be used to serve HTTP requests.
 ///
+/// Routes added using a method and path (e.g. [`WebService::get`]), [`WebService::nest`]
+/// and [`WebService::dir`] are compiled into a tree of path segments,
+/// such that a request is matched against all of them in a single pass.
+/// Routes added using a generic matcher ([`WebService::on`]) are tried in turn,
+/// but only when they were added before the route found in that tree.
+/// Either way, the first route added that matches the request is used.
+///
 /// Note that this service boxes all the internal services, so it is not as efficient as it could be.
 /// For those locations where you need do not desire the convenience over performance,
 /// you can instead use a tuple of `(M, S)` tuples, where M is a matcher and S is a service,
 /// e.g. `((MethodMatcher::GET, service_a), (MethodMatcher::POST, service_b), service_fallback)`.
 pub struct WebService<State> {
     endpoints: Vec<Arc<Endpoint<State>>>,
+    router: Arc<PathRouter>,
+    /// indices of the endpoints that are not part of the router, in ascending order
+    matchers: Vec<usize>,
     not_found: Arc<BoxService<State, Request, Response, Infallible>>,
     _phantom: PhantomData<State>,
 }
@@ -32,6 +42,8 @@ impl<State> Clone for WebService<State> {
     fn clone(&self) -> Self {
         Self {
             endpoints: self.endpoints.clone(),
+            router: self.router.clone(),
+            matchers: self.matchers.clone(),
             not_found: self.not_found.clone(),
             _phantom: PhantomData,
         }
@@ -46,6 +58,8 @@ where
     pub(crate) fn new() -> Self {
         Self {
             endpoints: Vec::new(),
+            router: Arc::new(PathRouter::new()),
+            matchers: Vec::new(),
             not_found: Arc::new(
                 service_fn(|| async { Ok(StatusCode::NOT_FOUND.into_response()) }).boxed(),
             ),
@@ -59,7 +73,7 @@ where
         I: IntoEndpointService<State, T>,
     {
         let matcher = HttpMatcher::method_get().and_path(path);
-        self.on(matcher, service)
+        self.route(Some(MethodMatcher::GET), path, matcher, service)
     }
 
     /// add a POST route to the web service, using the given service.
@@ -68,7 +82,7 @@ where
         I: IntoEndpointService<State, T>,
     {
         let matcher = HttpMatcher::method_post().and_path(path);
-        self.on(matcher, service)
+        self.route(Some(MethodMatcher::POST), path, matcher, service)
     }
 
     /// add a PUT route to the web service, using the given service.
@@ -77,7 +91,7 @@ where
         I: IntoEndpointService<State, T>,
     {
         let matcher = HttpMatcher::method_put().and_path(path);
-        self.on(matcher, service)
+        self.route(Some(MethodMatcher::PUT), path, matcher, service)
     }
 
     /// add a DELETE route to the web service, using the given service.
@@ -86,7 +100,7 @@ where
         I: IntoEndpointService<State, T>,
     {
         let matcher = HttpMatcher::method_delete().and_path(path);
-        self.on(matcher, service)
+        self.route(Some(MethodMatcher::DELETE), path, matcher, service)
     }
 
     /// add a PATCH route to the web service, using the given service.
@@ -95,7 +109,7 @@ where
         I: IntoEndpointService<State, T>,
     {
         let matcher = HttpMatcher::method_patch().and_path(path);
-        self.on(matcher, service)
+        self.route(Some(MethodMatcher::PATCH), path, matcher, service)
     }
 
     /// add a HEAD route to the web service, using the given service.
@@ -104,7 +118,7 @@ where
         I: IntoEndpointService<State, T>,
     {
         let matcher = HttpMatcher::method_head().and_path(path);
-        self.on(matcher, service)
+        self.route(Some(MethodMatcher::HEAD), path, matcher, service)
     }
 
     /// add a OPTIONS route to the web service, using the given service.
@@ -113,7 +127,7 @@ where
         I: IntoEndpointService<State, T>,
     {
         let matcher = HttpMatcher::method_options().and_path(path);
-        self.on(matcher, service)
+        self.route(Some(MethodMatcher::OPTIONS), path, matcher, service)
     }
 
     /// add a TRACE route to the web service, using the given service.
@@ -122,7 +136,7 @@ where
         I: IntoEndpointService<State, T>,
     {
         let matcher = HttpMatcher::method_trace().and_path(path);
-        self.on(matcher, service)
+        self.route(Some(MethodMatcher::TRACE), path, matcher, service)
     }
 
     /// nest a web service under the given path.
@@ -133,9 +147,9 @@ where
         I: IntoEndpointService<State, T>,
     {
         let prefix = format!("{}/*", prefix.trim_end_matches(['/', '*']));
-        let matcher = HttpMatcher::path(prefix);
+        let matcher = HttpMatcher::path(&prefix);
         let service = NestedService(service.into_endpoint_service());
-        self.on(matcher, service)
+        self.route(None, &prefix, matcher, service)
     }
 
     /// serve the given directory under the given path.
@@ -146,6 +160,34 @@ where
 
     /// add a route to the web service which matches the given matcher, using the given service.
     pub fn on<I, T>(mut self, matcher: HttpMatcher<State, Body>, service: I) -> Self
+    where
+        I: IntoEndpointService<State, T>,
+    {
+        self.matchers.push(self.endpoints.len());
+        self.push_endpoint(matcher, service)
+    }
+
+    /// add a route for the given methods (any method if `None`) and path,
+    /// which is matched using the router instead of the given matcher.
+    fn route<I, T>(
+        mut self,
+        methods: Option<MethodMatcher>,
+        path: &str,
+        matcher: HttpMatcher<State, Body>,
+        service: I,
+    ) -> Self
+    where
+        I: IntoEndpointService<State, T>,
+    {
+        Arc::make_mut(&mut self.router).insert(
+            &PathMatcher::new(path),
+            methods,
+            self.endpoints.len(),
+        );
+        self.push_endpoint(matcher, service)
+    }
+
+    fn push_endpoint<I, T>(mut self, matcher: HttpMatcher<State, Body>, service: I) -> Self
     where
         I: IntoEndpointService<State, T>,
     {
@@ -227,8 +269,20 @@ where
         mut ctx: Context<State>,
         req: Request,
     ) -> Result<Self::Response, Self::Error> {
+        let method = MethodMatcher::try_from(req.method()).ok();
+        let route = self.router.find(req.uri().path(), method);
+
         let mut ext = Extensions::new();
-        for endpoint in &self.endpoints {
+        for &index in &self.matchers {
+            if route
+                .as_ref()
+                .map(|route| route.id() < index)
+                .unwrap_or_default()
+            {
+                // the routed endpoint was added first, and thus takes precedence
+                break;
+            }
+            let endpoint = &self.endpoints[index];
             if endpoint.matcher.matches(Some(&mut ext), &ctx, &req) {
                 // insert the extensions that might be generated by the matcher(s) into the context
                 ctx.extend(ext);
@@ -237,6 +291,13 @@ where
             // clear the extensions for the next matcher
             ext.clear();
         }
+
+        if let Some(route) = route {
+            let endpoint = &self.endpoints[route.id()];
+            ctx.insert(route.into_uri_params());
+            return endpoint.service.serve(ctx, req).await;
+        }
+
         self.not_found.serve(ctx, req).await
     }
 }
@@ -491,6 +552,49 @@ mod test {
         assert_eq!(body, "<h1>Hello, World!</h1>");
     }
 
+    #[tokio::test]
+    async fn test_web_service_route_order() {
+        let svc = WebService::new()
+            .get("/api/:version", "first")
+            .on(HttpMatcher::path("/api/v2"), "second")
+            .get("/api/v2", "third")
+            .on(HttpMatcher::method_post(), "fourth");
+
+        let res = get_response(&svc, "https://www.test.io/api/v1").await;
+        assert_eq!(res.status(), StatusCode::OK);
+        let body = res.into_body().collect().await.unwrap().to_bytes();
+        assert_eq!(body, "first");
+
+        let res = post_response(&svc, "https://www.test.io/api/v2").await;
+        assert_eq!(res.status(), StatusCode::OK);
+        let body = res.into_body().collect().await.unwrap().to_bytes();
+        assert_eq!(body, "second");
+
+        let res = post_response(&svc, "https://www.test.io/api").await;
+        assert_eq!(res.status(), StatusCode::OK);
+        let body = res.into_body().collect().await.unwrap().to_bytes();
+        assert_eq!(body, "fourth");
+
+        let res = get_response(&svc, "https://www.test.io/api").await;
+        assert_eq!(res.status(), StatusCode::NOT_FOUND);
+    }
+
+    #[tokio::test]
+    async fn test_web_service_uri_params() {
+        let svc = WebService::new().get("/book/:title", |ctx: Context<()>| async move {
+            ctx.get::<UriParams>()
+                .unwrap()
+                .get("title")
+                .unwrap()
+                .to_owned()
+        });
+
+        let res = get_response(&svc, "https://www.test.io/BOOK/oxford%20dictionary").await;
+        assert_eq!(res.status(), StatusCode::OK);
+        let body = res.into_body().collect().await.unwrap().to_bytes();
+        assert_eq!(body, "oxford dictionary");
+    }
+
     #[tokio::test]
     async fn test_matcher_service_tuples() {
         let svc = match_service! {
@@ -4,8 +4,9 @@
 
 use crate::error::OpaqueError;
 use crate::http::headers::Header;
-use crate::http::HeaderValue;
+use crate::http::{HeaderMap, HeaderValue};
 use std::net::IpAddr;
+use std::sync::OnceLock;
 use std::{fmt, net::SocketAddr};
 
 mod obfuscated;
@@ -28,7 +29,7 @@ mod version;
 #[doc(inline)]
 pub use version::ForwardedVersion;
 
-#[derive(Debug, Clone, PartialEq, Eq)]
+#[derive(Clone)]
 /// Forwarding information stored as a chain.
 ///
 /// This extension (which can be stored and modified via the [`Context`])
@@ -36,12 +37,39 @@ pub use version::ForwardedVersion;
 /// host used by the user, by which proxy it was forwarded, what was the intended
 /// protocol (e.g. https), etc...
 ///
+/// The elements added by the [`GetForwardedHeadersLayer`] are kept as the raw
+/// header values, and only parsed once the chain is first inspected.
+/// A [`Forwarded`] created that way is [empty](Self::is_empty) in case
+/// none of those values are valid, while any other [`Forwarded`] has at least one element.
+///
 /// RFC: <https://datatracker.ietf.org/doc/html/rfc7239>
 ///
 /// [`Context`]: crate::service::Context
+/// [`GetForwardedHeadersLayer`]: crate::http::layer::forwarded::GetForwardedHeadersLayer
 pub struct Forwarded {
-    first: ForwardedElement,
-    others: Vec<ForwardedElement>,
+    elements: Vec<ForwardedElement>,
+    /// elements following `elements`, parsed from the headers on first use
+    pending: Option<PendingElements>,
+}
+
+#[derive(Clone)]
+struct PendingElements {
+    headers: HeaderMap,
+    parse: fn(&HeaderMap) -> Vec<ForwardedElement>,
+    parsed: OnceLock<Vec<ForwardedElement>>,
+}
+
+impl PendingElements {
+    fn get(&self) -> &[ForwardedElement] {
+        self.parsed.get_or_init(|| (self.parse)(&self.headers))
+    }
+
+    fn into_vec(self) -> Vec<ForwardedElement> {
+        match self.parsed.into_inner() {
+            Some(elements) => elements,
+            None => (self.parse)(&self.headers),
+        }
+    }
 }
 
 impl Forwarded {
@@ -49,18 +77,59 @@ impl Forwarded {
     /// as the client Element (the first element).
     pub fn new(element: ForwardedElement) -> Self {
         Self {
-            first: element,
-            others: Vec::new(),
+            elements: vec![element],
+            pending: None,
+        }
+    }
+
+    /// Create a [`Forwarded`] extension for the elements
+    /// to be parsed from the given headers on first use.
+    pub(crate) fn lazy(headers: HeaderMap, parse: fn(&HeaderMap) -> Vec<ForwardedElement>) -> Self {
+        Self {
+            elements: Vec::new(),
+            pending: Some(PendingElements {
+                headers,
+                parse,
+                parsed: OnceLock::new(),
+            }),
         }
     }
 
+    /// Extend this [`Forwarded`] context with the elements
+    /// to be parsed from the given headers on first use.
+    pub(crate) fn extend_lazy(
+        &mut self,
+        headers: HeaderMap,
+        parse: fn(&HeaderMap) -> Vec<ForwardedElement>,
+    ) {
+        self.resolve();
+        self.pending = Some(PendingElements {
+            headers,
+            parse,
+            parsed: OnceLock::new(),
+        });
+    }
+
+    /// Parse the pending elements, if any, such that the chain can be modified.
+    fn resolve(&mut self) {
+        if let Some(pending) = self.pending.take() {
+            self.elements.extend(pending.into_vec());
+        }
+    }
+
+    fn first(&self) -> Option<&ForwardedElement> {
+        self.elements
+            .first()
+            .or_else(|| self.pending.as_ref()?.get().first())
+    }
+
     /// Return the client host of this [`Forwarded`] context,
     /// if there is one defined.
     ///
     /// It is assumed that only the first element can be
     /// described as client information.
     pub fn client_host(&self) -> Option<&ForwardedAuthority> {
-        self.first.ref_forwarded_host()
+        self.first()?.ref_forwarded_host()
     }
 
     /// Return the client [`SocketAddr`] of this [`Forwarded`] context,
@@ -69,7 +138,7 @@ impl Forwarded {
     /// You can try to fallback to [`Self::client_ip`],
     /// in case this method returns `None`.
     pub fn client_socket_addr(&self) -> Option<SocketAddr> {
-        self.first
+        self.first()?
             .ref_forwarded_for()
             .and_then(|node| match (node.ip(), node.port()) {
                 (Some(ip), Some(port)) => Some((ip, port).into()),
@@ -80,7 +149,9 @@ impl Forwarded {
     /// Return the client port of this [`Forwarded`] context,
     /// if there is one defined.
     pub fn client_port(&self) -> Option<u16> {
-        self.first.ref_forwarded_for().and_then(|node| node.port())
+        self.first()?
+            .ref_forwarded_for()
+            .and_then(|node| node.port())
     }
 
     /// Return the client Ip of this [`Forwarded`] context,
@@ -92,47 +163,79 @@ impl Forwarded {
     /// It is assumed that only the first element can be
     /// described as client information.
     pub fn client_ip(&self) -> Option<IpAddr> {
-        self.first.ref_forwarded_for().and_then(|node| node.ip())
+        self.first()?.ref_forwarded_for().and_then(|node| node.ip())
     }
 
     /// Return the client protocol of this [`Forwarded`] context,
     /// if there is one defined.
     pub fn client_proto(&self) -> Option<ForwardedProtocol> {
-        self.first.ref_forwarded_proto()
+        self.first()?.ref_forwarded_proto()
     }
 
     /// Return the client protocol version of this [`Forwarded`] context,
     /// if there is one defined.
     pub fn client_version(&self) -> Option<ForwardedVersion> {
-        self.first.ref_forwarded_version()
+        self.first()?.ref_forwarded_version()
+    }
+
+    /// Returns `true` in case this [`Forwarded`] context has no elements,
+    /// which is only possible for the headers added by the [`GetForwardedHeadersLayer`]
+    /// in case none of them contain a valid element.
+    ///
+    /// [`GetForwardedHeadersLayer`]: crate::http::layer::forwarded::GetForwardedHeadersLayer
+    pub fn is_empty(&self) -> bool {
+        self.first().is_none()
     }
 
     /// Append a [`ForwardedElement`] to this [`Forwarded`] context.
     pub fn append(&mut self, element: ForwardedElement) -> &mut Self {
-        self.others.push(element);
+        self.resolve();
+        self.elements.push(element);
         self
     }
 
     /// Extend this [`Forwarded`] context with the given [`ForwardedElement`]s.
     pub fn extend(&mut self, elements: impl IntoIterator<Item = ForwardedElement>) -> &mut Self {
-        self.others.extend(elements);
+        self.resolve();
+        self.elements.extend(elements);
         self
     }
 
     /// Iterate over the [`ForwardedElement`]s in this [`Forwarded`] context.
     pub fn iter(&self) -> impl Iterator<Item = &ForwardedElement> {
-        std::iter::once(&self.first).chain(self.others.iter())
+        self.elements
+            .iter()
+            .chain(self.pending.iter().flat_map(PendingElements::get))
+    }
+
+    fn from_parsed((first, others): (ForwardedElement, Vec<ForwardedElement>)) -> Self {
+        let mut forwarded = Self::new(first);
+        forwarded.elements.extend(others);
+        forwarded
     }
 }
 
 impl IntoIterator for Forwarded {
     type Item = ForwardedElement;
-    type IntoIter =
-        std::iter::Chain<std::iter::Once<ForwardedElement>, std::vec::IntoIter<ForwardedElement>>;
+    type IntoIter = std::vec::IntoIter<ForwardedElement>;
 
-    fn into_iter(self) -> Self::IntoIter {
-        let iter = self.others.into_iter();
-        std::iter::once(self.first).chain(iter)
+    fn into_iter(mut self) -> Self::IntoIter {
+        self.resolve();
+        self.elements.into_iter()
+    }
+}
+
+impl PartialEq for Forwarded {
+    fn eq(&self, other: &Self) -> bool {
+        self.iter().eq(other.iter())
+    }
+}
+
+impl Eq for Forwarded {}
+
+impl fmt::Debug for Forwarded {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_list().entries(self.iter()).finish()
     }
 }
 
@@ -145,9 +248,11 @@ impl From<ForwardedElement> for Forwarded {
 
 impl fmt::Display for Forwarded {
     fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
-        self.first.fmt(f)?;
-        for other in &self.others {
-            write!(f, ",{other}")?;
+        for (index, element) in self.iter().enumerate() {
+            if index > 0 {
+                f.write_str(",")?;
+            }
+            element.fmt(f)?;
         }
         Ok(())
     }
@@ -157,8 +262,7 @@ impl std::str::FromStr for Forwarded {
     type Err = OpaqueError;
 
     fn from_str(s: &str) -> Result<Self, Self::Err> {
-        let (first, others) = element::parse_one_plus_forwarded_elements(s.as_bytes())?;
-        Ok(Forwarded { first, others })
+        element::parse_one_plus_forwarded_elements(s.as_bytes()).map(Forwarded::from_parsed)
     }
 }
 
@@ -166,8 +270,7 @@ impl TryFrom<String> for Forwarded {
     type Error = OpaqueError;
 
     fn try_from(s: String) -> Result<Self, Self::Error> {
-        let (first, others) = element::parse_one_plus_forwarded_elements(s.as_bytes())?;
-        Ok(Forwarded { first, others })
+        element::parse_one_plus_forwarded_elements(s.as_bytes()).map(Forwarded::from_parsed)
     }
 }
 
@@ -175,8 +278,7 @@ impl TryFrom<&str> for Forwarded {
     type Error = OpaqueError;
 
     fn try_from(s: &str) -> Result<Self, Self::Error> {
-        let (first, others) = element::parse_one_plus_forwarded_elements(s.as_bytes())?;
-        Ok(Forwarded { first, others })
+        element::parse_one_plus_forwarded_elements(s.as_bytes()).map(Forwarded::from_parsed)
     }
 }
 
@@ -184,8 +286,7 @@ impl TryFrom<HeaderValue> for Forwarded {
     type Error = OpaqueError;
 
     fn try_from(header: HeaderValue) -> Result<Self, Self::Error> {
-        let (first, others) = element::parse_one_plus_forwarded_elements(header.as_bytes())?;
-        Ok(Forwarded { first, others })
+        element::parse_one_plus_forwarded_elements(header.as_bytes()).map(Forwarded::from_parsed)
     }
 }
 
@@ -193,8 +294,7 @@ impl TryFrom<&HeaderValue> for Forwarded {
     type Error = OpaqueError;
 
     fn try_from(header: &HeaderValue) -> Result<Self, Self::Error> {
-        let (first, others) = element::parse_one_plus_forwarded_elements(header.as_bytes())?;
-        Ok(Forwarded { first, others })
+        element::parse_one_plus_forwarded_elements(header.as_bytes()).map(Forwarded::from_parsed)
     }
 }
 
@@ -202,8 +302,7 @@ impl TryFrom<Vec<u8>> for Forwarded {
     type Error = OpaqueError;
 
     fn try_from(bytes: Vec<u8>) -> Result<Self, Self::Error> {
-        let (first, others) = element::parse_one_plus_forwarded_elements(bytes.as_ref())?;
-        Ok(Forwarded { first, others })
+        element::parse_one_plus_forwarded_elements(bytes.as_ref()).map(Forwarded::from_parsed)
     }
 }
 
@@ -211,8 +310,7 @@ impl TryFrom<&[u8]> for Forwarded {
     type Error = OpaqueError;
 
     fn try_from(bytes: &[u8]) -> Result<Self, Self::Error> {
-        let (first, others) = element::parse_one_plus_forwarded_elements(bytes)?;
-        Ok(Forwarded { first, others })
+        element::parse_one_plus_forwarded_elements(bytes).map(Forwarded::from_parsed)
     }
 }
 
@@ -253,9 +351,7 @@ impl Header for Forwarded {
     }
 
     fn encode<E: Extend<HeaderValue>>(&self, values: &mut E) {
-        let s = self.to_string();
-
-        let value = HeaderValue::from_str(&s)
+        let value = HeaderValue::try_from(self.to_string())
             .expect("Forwarded extension should always result in a valid header value");
 
         values.extend(std::iter::once(value));
@@ -267,6 +363,12 @@ mod tests {
     use super::*;
     use crate::net::address::Host;
 
+    fn forwarded(first: ForwardedElement, others: Vec<ForwardedElement>) -> Forwarded {
+        let mut forwarded = Forwarded::new(first);
+        forwarded.extend(others);
+        forwarded
+    }
+
     #[test]
     fn test_forwarded_parse_invalid() {
         for s in [
@@ -297,106 +399,104 @@ mod tests {
         for (s, expected) in [
             (
                 r##"for="_gazonk""##,
-                Forwarded {
-                    first: ForwardedElement::forwarded_for(NodeId::try_from("_gazonk").unwrap()),
-                    others: Vec::new(),
-                },
+                forwarded(
+                    ForwardedElement::forwarded_for(NodeId::try_from("_gazonk").unwrap()),
+                    Vec::new(),
+                ),
             ),
             (
                 r##"for=192.0.2.43, for=198.51.100.17"##,
-                Forwarded {
-                    first: ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
-                    others: vec![ForwardedElement::forwarded_for(
+                forwarded(
+                    ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
+                    vec![ForwardedElement::forwarded_for(
                         NodeId::try_from("198.51.100.17").unwrap(),
                     )],
-                },
+                ),
             ),
             (
                 r##"for=192.0.2.43,for=198.51.100.17"##,
-                Forwarded {
-                    first: ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
-                    others: vec![ForwardedElement::forwarded_for(
+                forwarded(
+                    ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
+                    vec![ForwardedElement::forwarded_for(
                         NodeId::try_from("198.51.100.17").unwrap(),
                     )],
-                },
+                ),
             ),
             (
                 r##"for=192.0.2.43,for=198.51.100.17,for=127.0.0.1"##,
-                Forwarded {
-                    first: ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
-                    others: vec![
+                forwarded(
+                    ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
+                    vec![
                         ForwardedElement::forwarded_for(NodeId::try_from("198.51.100.17").unwrap()),
                         ForwardedElement::forwarded_for(NodeId::try_from("127.0.0.1").unwrap()),
                     ],
-                },
+                ),
             ),
             (
                 r##"for=192.0.2.43,for=198.51.100.17,for=unknown"##,
-                Forwarded {
-                    first: ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
-                    others: vec![
+                forwarded(
+                    ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
+                    vec![
                         ForwardedElement::forwarded_for(NodeId::try_from("198.51.100.17").unwrap()),
                         ForwardedElement::forwarded_for(NodeId::try_from("unknown").unwrap()),
                     ],
-                },
+                ),
             ),
             (
                 r##"for=192.0.2.43,for="[2001:db8:cafe::17]",for=unknown"##,
-                Forwarded {
-                    first: ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
-                    others: vec![
+                forwarded(
+                    ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
+                    vec![
                         ForwardedElement::forwarded_for(
                             NodeId::try_from("[2001:db8:cafe::17]").unwrap(),
                         ),
                         ForwardedElement::forwarded_for(NodeId::try_from("unknown").unwrap()),
                     ],
-                },
+                ),
             ),
             (
                 r##"for=192.0.2.43, for="[2001:db8:cafe::17]", for=unknown"##,
-                Forwarded {
-                    first: ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
-                    others: vec![
+                forwarded(
+                    ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
+                    vec![
                         ForwardedElement::forwarded_for(
                             NodeId::try_from("[2001:db8:cafe::17]").unwrap(),
                         ),
                         ForwardedElement::forwarded_for(NodeId::try_from("unknown").unwrap()),
                     ],
-                },
+                ),
             ),
             (
                 r##"for=192.0.2.43, for="[2001:db8:cafe::17]:4000", for=unknown"##,
-                Forwarded {
-                    first: ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
-                    others: vec![
+                forwarded(
+                    ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
+                    vec![
                         ForwardedElement::forwarded_for(
                             NodeId::try_from("[2001:db8:cafe::17]:4000").unwrap(),
                         ),
                         ForwardedElement::forwarded_for(NodeId::try_from("unknown").unwrap()),
                     ],
-                },
+                ),
             ),
             (
                 r##"for=192.0.2.43,for=198.51.100.17;by=203.0.113.60;proto=http;host=example.com"##,
-                Forwarded {
-                    first: ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
-                    others: vec![ForwardedElement::try_from(
+                forwarded(
+                    ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43").unwrap()),
+                    vec![ForwardedElement::try_from(
                         "for=198.51.100.17;by=203.0.113.60;proto=http;host=example.com",
                     )
                     .unwrap()],
-                },
+                ),
             ),
             (
                 r##"for="192.0.2.43:4000",for=198.51.100.17;by=203.0.113.60;proto=http;host=example.com"##,
-                Forwarded {
-                    first: ForwardedElement::forwarded_for(
-                        NodeId::try_from("192.0.2.43:4000").unwrap(),
-                    ),
-                    others: vec![ForwardedElement::try_from(
+                forwarded(
+                    ForwardedElement::forwarded_for(NodeId::try_from("192.0.2.43:4000").unwrap()),
+                    vec![ForwardedElement::try_from(
                         "for=198.51.100.17;by=203.0.113.60;proto=http;host=example.com",
                     )
                     .unwrap()],
-                },
+                ),
             ),
         ] {
             let element = match Forwarded::try_from(s) {
@@ -407,6 +507,58 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_forwarded_lazy() {
+        use crate::http::header::FORWARDED;
+        use std::sync::atomic::{AtomicUsize, Ordering};
+
+        static PARSED: AtomicUsize = AtomicUsize::new(0);
+
+        fn parse(headers: &HeaderMap) -> Vec<ForwardedElement> {
+            PARSED.fetch_add(1, Ordering::SeqCst);
+            headers
+                .get_all(FORWARDED)
+                .iter()
+                .filter_map(|value| Forwarded::try_from(value).ok())
+                .flatten()
+                .collect()
+        }
+
+        let mut headers = HeaderMap::new();
+        headers.insert(
+            FORWARDED,
+            HeaderValue::from_static("for=192.0.2.43,for=198.51.100.17"),
+        );
+
+        // the client element is known, the pending elements are not parsed
+        let mut forwarded = Forwarded::new(ForwardedElement::forwarded_for(
+            NodeId::try_from("127.0.0.1").unwrap(),
+        ));
+        forwarded.extend_lazy(headers.clone(), parse);
+        assert_eq!(forwarded.client_ip(), Some(IpAddr::from([127, 0, 0, 1])));
+        assert_eq!(PARSED.load(Ordering::SeqCst), 0);
+
+        // the pending elements are parsed once, on first use
+        let mut forwarded = Forwarded::lazy(headers, parse);
+        assert_eq!(PARSED.load(Ordering::SeqCst), 0);
+        assert_eq!(forwarded.client_ip(), Some(IpAddr::from([192, 0, 2, 43])));
+        assert_eq!(forwarded.iter().count(), 2);
+        assert_eq!(PARSED.load(Ordering::SeqCst), 1);
+
+        forwarded.append(ForwardedElement::forwarded_for(
+            NodeId::try_from("127.0.0.1").unwrap(),
+        ));
+        assert_eq!(PARSED.load(Ordering::SeqCst), 1);
+        assert_eq!(
+            forwarded,
+            Forwarded::try_from("for=192.0.2.43,for=198.51.100.17,for=127.0.0.1").unwrap()
+        );
+        assert_eq!(
+            forwarded.to_string(),
+            "for=192.0.2.43,for=198.51.100.17,for=127.0.0.1"
+        );
+    }
+
     #[test]
     fn test_forwarded_client_authority() {
         for (s, expected) in [
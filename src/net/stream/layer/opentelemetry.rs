@@ -8,7 +8,7 @@ use crate::telemetry::opentelemetry::{
     semantic_conventions, KeyValue,
 };
 use crate::{
-    net::stream::SocketInfo,
+    net::stream::{layer::BytesRWTrackerHandle, SocketInfo},
     service::{Context, Layer, Service},
 };
 use std::{fmt, sync::Arc, time::SystemTime};
@@ -17,12 +17,20 @@ use semantic_conventions::trace::{CLIENT_ADDRESS, CLIENT_PORT, NETWORK_TRANSPORT
 
 const NETWORK_CONNECTION_DURATION: &str = "network.server.connection_duration";
 const NETWORK_SERVER_ACTIVE_CONNECTIONS: &str = "network.server.active_connections";
+const NETWORK_SERVER_TIME_TO_FIRST_BYTE: &str = "network.server.time_to_first_byte";
+const NETWORK_SERVER_MAX_IDLE_TIME: &str = "network.server.max_idle_time";
+const NETWORK_SERVER_READ_THROUGHPUT: &str = "network.server.read_throughput";
+const NETWORK_SERVER_WRITE_THROUGHPUT: &str = "network.server.write_throughput";
 
 /// Records network server metrics
 #[derive(Clone, Debug)]
 struct Metrics {
     network_connection_duration: Histogram<f64>,
     network_active_connections: UpDownCounter<i64>,
+    network_time_to_first_byte: Histogram<f64>,
+    network_max_idle_time: Histogram<f64>,
+    network_read_throughput: Histogram<f64>,
+    network_write_throughput: Histogram<f64>,
 }
 
 impl Metrics {
@@ -41,15 +49,85 @@ impl Metrics {
             )
             .init();
 
+        let network_time_to_first_byte = meter
+            .f64_histogram(NETWORK_SERVER_TIME_TO_FIRST_BYTE)
+            .with_description(
+                "Measures the time until the first byte is read from inbound network connections.",
+            )
+            .with_unit(Unit::new("s"))
+            .init();
+
+        let network_max_idle_time = meter
+            .f64_histogram(NETWORK_SERVER_MAX_IDLE_TIME)
+            .with_description(
+                "Measures the longest time inbound network connections had no reads or writes.",
+            )
+            .with_unit(Unit::new("s"))
+            .init();
+
+        let network_read_throughput = meter
+            .f64_histogram(NETWORK_SERVER_READ_THROUGHPUT)
+            .with_description(
+                "Measures the bytes per second read from inbound network connections.",
+            )
+            .with_unit(Unit::new("By/s"))
+            .init();
+
+        let network_write_throughput = meter
+            .f64_histogram(NETWORK_SERVER_WRITE_THROUGHPUT)
+            .with_description(
+                "Measures the bytes per second written to inbound network connections.",
+            )
+            .with_unit(Unit::new("By/s"))
+            .init();
+
         Metrics {
             network_connection_duration,
             network_active_connections,
+            network_time_to_first_byte,
+            network_max_idle_time,
+            network_read_throughput,
+            network_write_throughput,
+        }
+    }
+}
+
+impl Metrics {
+    /// Record the traffic metrics of a closed connection, as tracked by the given handle.
+    fn record_traffic(&self, tracker: &BytesRWTrackerHandle, attributes: &[KeyValue]) {
+        if tracker.tracks_timing() {
+            if let Some(ttfb) = tracker.time_to_first_byte() {
+                self.network_time_to_first_byte
+                    .record(ttfb.as_secs_f64(), attributes);
+            }
+
+            // the idle time until the connection was closed counts as well
+            let max_idle = tracker.max_idle().max(tracker.idle());
+            self.network_max_idle_time
+                .record(max_idle.as_secs_f64(), attributes);
+        }
+
+        let elapsed = tracker.elapsed().as_secs_f64();
+        if elapsed > 0.0 {
+            self.network_read_throughput
+                .record(tracker.read() as f64 / elapsed, attributes);
+            self.network_write_throughput
+                .record(tracker.written() as f64 / elapsed, attributes);
         }
     }
 }
 
 #[derive(Debug, Clone)]
 /// A layer that records network server metrics using OpenTelemetry.
+///
+/// In case a [`BytesRWTrackerHandle`] is found in the [`Context`],
+/// e.g. by having a [`BytesTrackerLayer`] wrap this layer, it also records
+/// the read and write throughput of each connection, once it is closed,
+/// as well as the time to first byte and the longest idle time
+/// in case the tracker tracks timing (see [`BytesTrackerLayer::with_timing`]).
+///
+/// [`BytesTrackerLayer`]: crate::net::stream::layer::BytesTrackerLayer
+/// [`BytesTrackerLayer::with_timing`]: crate::net::stream::layer::BytesTrackerLayer::with_timing
 pub struct NetworkMetricsLayer {
     metrics: Arc<Metrics>,
 }
@@ -131,6 +209,7 @@ where
         stream: Stream,
     ) -> Result<Self::Response, Self::Error> {
         let attributes: Vec<KeyValue> = compute_attributes(&ctx);
+        let tracker = ctx.get::<BytesRWTrackerHandle>().cloned();
 
         self.metrics.network_active_connections.add(1, &attributes);
 
@@ -140,6 +219,10 @@ where
         let result = self.inner.serve(ctx, stream).await;
         self.metrics.network_active_connections.add(-1, &attributes);
 
+        if let Some(tracker) = tracker {
+            self.metrics.record_traffic(&tracker, &attributes);
+        }
+
         match result {
             Ok(res) => {
                 self.metrics.network_connection_duration.record(
@@ -13,10 +13,11 @@ use std::{
     io,
     pin::Pin,
     sync::{
-        atomic::{AtomicUsize, Ordering},
+        atomic::{AtomicU64, AtomicUsize, Ordering},
         Arc,
     },
     task::{Context, Poll},
+    time::{Duration, Instant},
 };
 
 use tokio::io::{AsyncRead, AsyncWrite, ReadBuf};
@@ -31,16 +32,47 @@ pin_project! {
     /// to get the number of bytes read and/or written even though the [`BytesRWTracker`]
     /// is consumed by a protocol consumer.
     ///
+    /// Optionally (see [`BytesRWTracker::new_timed`]) it also tracks the timing
+    /// of the stream activity, such as the time to the first byte read and the longest
+    /// time the stream was idle. This is opt-in as it reads the clock for each read or write.
+    ///
+    /// The tracker is the only one updating these stats, so it keeps its own copy
+    /// and only publishes it to the handles (using plain stores),
+    /// avoiding an atomic read-modify-write operation for each read or write.
+    ///
     /// [`AsyncRead`]: crate::net::stream::AsyncRead
     /// [`AsyncWrite`]: crate::net::stream::AsyncWrite
     #[derive(Debug)]
     pub struct BytesRWTracker<S> {
-        read: Arc<AtomicUsize>,
-        written: Arc<AtomicUsize>,
+        read: usize,
+        written: usize,
+        last_activity: Duration,
+        max_idle: Duration,
+        stats: Arc<TrackerStats>,
         #[pin]
         stream: S,
     }
 }
+
+#[derive(Debug)]
+/// The stats of a [`BytesRWTracker`] shared with its [`BytesRWTrackerHandle`]s.
+struct TrackerStats {
+    created: Instant,
+    timing: bool,
+    read: AtomicUsize,
+    written: AtomicUsize,
+    /// nanoseconds since creation of the first read, or `u64::MAX` if nothing was read yet
+    first_read: AtomicU64,
+    /// nanoseconds since creation of the last read or write
+    last_activity: AtomicU64,
+    /// longest time in nanoseconds between two reads and/or writes
+    max_idle: AtomicU64,
+}
+
+fn duration_to_nanos(duration: Duration) -> u64 {
+    duration.as_nanos().try_into().unwrap_or(u64::MAX - 1)
+}
+
 impl<S> BytesRWTracker<S> {
     /// Create a new [`BytesRWTracker`] that wraps the
     /// given [`AsyncRead`] and/or [`AsyncWrite`].
@@ -48,21 +80,48 @@ impl<S> BytesRWTracker<S> {
     /// [`AsyncRead`]: crate::net::stream::AsyncRead
     /// [`AsyncWrite`]: crate::net::stream::AsyncWrite
     pub fn new(stream: S) -> Self {
+        Self::with_stats(stream, false)
+    }
+
+    /// Create a new [`BytesRWTracker`] that wraps the
+    /// given [`AsyncRead`] and/or [`AsyncWrite`],
+    /// and which also tracks the timing of the stream activity.
+    ///
+    /// This reads the clock for each read or write.
+    ///
+    /// [`AsyncRead`]: crate::net::stream::AsyncRead
+    /// [`AsyncWrite`]: crate::net::stream::AsyncWrite
+    pub fn new_timed(stream: S) -> Self {
+        Self::with_stats(stream, true)
+    }
+
+    fn with_stats(stream: S, timing: bool) -> Self {
         Self {
-            read: Arc::new(AtomicUsize::new(0)),
-            written: Arc::new(AtomicUsize::new(0)),
+            read: 0,
+            written: 0,
+            last_activity: Duration::ZERO,
+            max_idle: Duration::ZERO,
+            stats: Arc::new(TrackerStats {
+                created: Instant::now(),
+                timing,
+                read: AtomicUsize::new(0),
+                written: AtomicUsize::new(0),
+                first_read: AtomicU64::new(u64::MAX),
+                last_activity: AtomicU64::new(0),
+                max_idle: AtomicU64::new(0),
+            }),
             stream,
         }
     }
 
     /// Get the number of bytes read (so far).
     pub fn read(&self) -> usize {
-        self.read.load(Ordering::SeqCst)
+        self.read
     }
 
     /// Get the number of bytes written (so far).
     pub fn written(&self) -> usize {
-        self.written.load(Ordering::SeqCst)
+        self.written
     }
 
     /// Get a [`BytesRWTrackerHandle`] that can be used to get the number of bytes
@@ -70,8 +129,7 @@ impl<S> BytesRWTracker<S> {
     /// consumer in a later stage.
     pub fn handle(&self) -> BytesRWTrackerHandle {
         BytesRWTrackerHandle {
-            read: self.read.clone(),
-            written: self.written.clone(),
+            stats: self.stats.clone(),
         }
     }
 
@@ -89,6 +147,27 @@ impl<S> BytesRWTracker<S> {
     }
 }
 
+/// Record the activity of the stream, returning the time since its creation.
+fn record_activity(
+    stats: &TrackerStats,
+    last_activity: &mut Duration,
+    max_idle: &mut Duration,
+) -> Duration {
+    let now = stats.created.elapsed();
+    let idle = now.saturating_sub(*last_activity);
+    if idle > *max_idle {
+        *max_idle = idle;
+        stats
+            .max_idle
+            .store(duration_to_nanos(idle), Ordering::Relaxed);
+    }
+    *last_activity = now;
+    stats
+        .last_activity
+        .store(duration_to_nanos(now), Ordering::Relaxed);
+    now
+}
+
 impl<S> AsyncRead for BytesRWTracker<S>
 where
     S: AsyncRead,
@@ -106,7 +185,16 @@ where
             match new_size.cmp(&size) {
                 std::cmp::Ordering::Greater => {
                     let bytes_read = new_size - size;
-                    this.read.fetch_add(bytes_read, Ordering::SeqCst);
+                    if this.stats.timing {
+                        let now = record_activity(this.stats, this.last_activity, this.max_idle);
+                        if *this.read == 0 {
+                            this.stats
+                                .first_read
+                                .store(duration_to_nanos(now), Ordering::Relaxed);
+                        }
+                    }
+                    *this.read += bytes_read;
+                    this.stats.read.store(*this.read, Ordering::Release);
                 }
                 std::cmp::Ordering::Less => {
                     tracing::error!(
@@ -133,7 +221,11 @@ where
         let this = self.as_mut().project();
         let res: Poll<Result<usize, io::Error>> = this.stream.poll_write(cx, buf);
         if let Poll::Ready(Ok(bytes_written)) = res {
-            this.written.fetch_add(bytes_written, Ordering::SeqCst);
+            if this.stats.timing {
+                record_activity(this.stats, this.last_activity, this.max_idle);
+            }
+            *this.written += bytes_written;
+            this.stats.written.store(*this.written, Ordering::Release);
         }
         res
     }
@@ -154,7 +246,11 @@ where
         let this = self.as_mut().project();
         let res: Poll<Result<usize, io::Error>> = this.stream.poll_write_vectored(cx, bufs);
         if let Poll::Ready(Ok(bytes_written)) = res {
-            this.written.fetch_add(bytes_written, Ordering::SeqCst);
+            if this.stats.timing {
+                record_activity(this.stats, this.last_activity, this.max_idle);
+            }
+            *this.written += bytes_written;
+            this.stats.written.store(*this.written, Ordering::Release);
         }
         res
     }
@@ -169,19 +265,61 @@ where
 /// consumer.
 #[derive(Debug, Clone)]
 pub struct BytesRWTrackerHandle {
-    read: Arc<AtomicUsize>,
-    written: Arc<AtomicUsize>,
+    stats: Arc<TrackerStats>,
 }
 
 impl BytesRWTrackerHandle {
     /// Get the number of bytes read (so far).
     pub fn read(&self) -> usize {
-        self.read.load(Ordering::SeqCst)
+        self.stats.read.load(Ordering::Acquire)
     }
 
     /// Get the number of bytes written (so far).
     pub fn written(&self) -> usize {
-        self.written.load(Ordering::SeqCst)
+        self.stats.written.load(Ordering::Acquire)
+    }
+
+    /// Get the time since the tracker was created,
+    /// which is typically when the connection was accepted.
+    pub fn elapsed(&self) -> Duration {
+        self.stats.created.elapsed()
+    }
+
+    /// Returns `true` in case the tracker tracks the timing of the stream activity,
+    /// see [`BytesTrackerLayer::with_timing`].
+    ///
+    /// [`BytesTrackerLayer::with_timing`]: crate::net::stream::layer::BytesTrackerLayer::with_timing
+    pub fn tracks_timing(&self) -> bool {
+        self.stats.timing
+    }
+
+    /// Get the time it took, since the tracker was created,
+    /// for the first byte to be read, if anything was read (so far).
+    ///
+    /// Always `None` in case the tracker does not track timing.
+    pub fn time_to_first_byte(&self) -> Option<Duration> {
+        match self.stats.first_read.load(Ordering::Relaxed) {
+            u64::MAX => None,
+            nanos => Some(Duration::from_nanos(nanos)),
+        }
+    }
+
+    /// Get the time since the last read or write,
+    /// or since the tracker was created if nothing was read or written (so far).
+    ///
+    /// Always the time since creation in case the tracker does not track timing.
+    pub fn idle(&self) -> Duration {
+        let last_activity = Duration::from_nanos(self.stats.last_activity.load(Ordering::Relaxed));
+        self.elapsed().saturating_sub(last_activity)
+    }
+
+    /// Get the longest time (so far) between two reads and/or writes,
+    /// including the time until the first read or write.
+    ///
+    /// The current idle time is not included, see [`Self::idle`] for that.
+    /// Always zero in case the tracker does not track timing.
+    pub fn max_idle(&self) -> Duration {
+        Duration::from_nanos(self.stats.max_idle.load(Ordering::Relaxed))
     }
 }
 
@@ -275,6 +413,47 @@ mod tests {
         assert_eq!(tracker.written(), 9);
     }
 
+    #[tokio::test]
+    async fn test_timing_tracker() {
+        let stream = Builder::new()
+            .wait(Duration::from_millis(20))
+            .read(b"foo")
+            .write(b"bar")
+            .build();
+
+        let mut tracker = BytesRWTracker::new_timed(stream);
+        let handle = tracker.handle();
+        assert!(handle.time_to_first_byte().is_none());
+
+        let mut buf = [0u8; 3];
+        tracker.read_exact(&mut buf).await.unwrap();
+        let ttfb = handle.time_to_first_byte().unwrap();
+        assert!(ttfb >= Duration::from_millis(20));
+        assert!(handle.max_idle() >= Duration::from_millis(20));
+
+        tracker.write_all(b"bar").await.unwrap();
+        assert_eq!(handle.time_to_first_byte(), Some(ttfb));
+        assert!(handle.elapsed() >= ttfb);
+        assert!(handle.idle() <= handle.elapsed());
+    }
+
+    #[tokio::test]
+    async fn test_timing_tracker_disabled() {
+        let stream = Builder::new().read(b"foo").write(b"bar").build();
+
+        let mut tracker = BytesRWTracker::new(stream);
+        let handle = tracker.handle();
+        assert!(!handle.tracks_timing());
+
+        let mut buf = [0u8; 3];
+        tracker.read_exact(&mut buf).await.unwrap();
+        tracker.write_all(b"bar").await.unwrap();
+        assert_eq!(handle.read(), 3);
+        assert_eq!(handle.written(), 3);
+        assert!(handle.time_to_first_byte().is_none());
+        assert_eq!(handle.max_idle(), Duration::ZERO);
+    }
+
     #[tokio::test]
     async fn test_rw_handle_tracker() {
         let stream = Builder::new()
@@ -11,11 +11,15 @@ pub use bytes::BytesRWTrackerHandle;
 
 /// A [`Service`] that wraps a [`Service`]'s input IO [`Stream`] with an atomic R/W tracker.
 ///
+/// The timing of the stream activity is only tracked when enabled
+/// using [`BytesTrackerService::with_timing`].
+///
 /// [`Service`]: crate::service::Service
 /// [`Stream`]: crate::net::stream::Stream
 #[derive(Debug)]
 pub struct BytesTrackerService<S> {
     inner: S,
+    timing: bool,
 }
 
 impl<S> BytesTrackerService<S> {
@@ -23,7 +27,18 @@ impl<S> BytesTrackerService<S> {
     ///
     /// See [`BytesTrackerService`] for more information.
     pub fn new(inner: S) -> Self {
-        Self { inner }
+        Self {
+            inner,
+            timing: false,
+        }
+    }
+
+    /// Set whether to track the timing of the stream activity,
+    /// such as the time to first byte and the longest idle time,
+    /// at the cost of reading the clock for each read or write.
+    pub fn with_timing(mut self, timing: bool) -> Self {
+        self.timing = timing;
+        self
     }
 
     define_inner_service_accessors!();
@@ -36,6 +51,7 @@ where
     fn clone(&self) -> Self {
         Self {
             inner: self.inner.clone(),
+            timing: self.timing,
         }
     }
 }
@@ -54,7 +70,11 @@ where
         mut ctx: Context<State>,
         stream: IO,
     ) -> impl Future<Output = Result<Self::Response, Self::Error>> + Send + '_ {
-        let tracked_stream = BytesRWTracker::new(stream);
+        let tracked_stream = if self.timing {
+            BytesRWTracker::new_timed(stream)
+        } else {
+            BytesRWTracker::new(stream)
+        };
         let handle = tracked_stream.handle();
         ctx.insert(handle);
         self.inner.serve(ctx, tracked_stream)
@@ -63,17 +83,30 @@ where
 
 /// A [`Layer`] that wraps a [`Service`]'s input IO [`Stream`] with an atomic R/W tracker.
 ///
+/// The timing of the stream activity is only tracked when enabled
+/// using [`BytesTrackerLayer::with_timing`].
+///
 /// [`Layer`]: crate::service::Layer
 /// [`Service`]: crate::service::Service
 /// [`Stream`]: crate::net::stream::Stream
 #[derive(Debug, Clone)]
 #[non_exhaustive]
-pub struct BytesTrackerLayer;
+pub struct BytesTrackerLayer {
+    timing: bool,
+}
 
 impl BytesTrackerLayer {
     /// Create a new [`BytesTrackerLayer`].
     pub fn new() -> Self {
-        Self
+        Self { timing: false }
+    }
+
+    /// Set whether to track the timing of the stream activity,
+    /// such as the time to first byte and the longest idle time,
+    /// at the cost of reading the clock for each read or write.
+    pub fn with_timing(mut self, timing: bool) -> Self {
+        self.timing = timing;
+        self
     }
 }
 
@@ -87,6 +120,9 @@ impl<S> Layer<S> for BytesTrackerLayer {
     type Service = BytesTrackerService<S>;
 
     fn layer(&self, inner: S) -> Self::Service {
-        BytesTrackerService { inner }
+        BytesTrackerService {
+            inner,
+            timing: self.timing,
+        }
     }
 }
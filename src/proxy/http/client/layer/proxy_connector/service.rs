@@ -12,15 +12,22 @@ use crate::{
         user::ProxyCredential,
         Protocol,
     },
+    proxy::{Proxy, ProxyStats},
     service::{Context, Service},
     tls::HttpsTunnel,
 };
-use std::fmt;
+use std::{fmt, time::Instant};
 
 /// A connector which can be used to establish a connection over an HTTP Proxy.
 ///
 /// This behaviour is optional and only triggered in case there
 /// is a [`ProxyAddress`] found in the [`Context`].
+///
+/// In case the [`Context`] also contains the selected [`Proxy`] and [`ProxyStats`],
+/// as inserted by the [`ProxyDBService`], the latency or failure
+/// of establishing the connection is recorded in those stats.
+///
+/// [`ProxyDBService`]: crate::proxy::layer::ProxyDBService
 pub struct HttpProxyConnectorService<S> {
     inner: S,
     required: bool,
@@ -80,11 +87,42 @@ where
 
     async fn serve(
         &self,
-        mut ctx: Context<State>,
+        ctx: Context<State>,
         req: Request<Body>,
     ) -> Result<Self::Response, Self::Error> {
         let address = ctx.get::<ProxyAddress>().cloned();
 
+        let stats = match (ctx.get::<ProxyStats>(), ctx.get::<Proxy>()) {
+            (Some(stats), Some(proxy)) if address.is_some() => {
+                Some((stats.clone(), proxy.id.clone(), Instant::now()))
+            }
+            _ => None,
+        };
+        let result = self.connect(ctx, req, address).await;
+        if let Some((stats, id, start)) = stats {
+            match &result {
+                Ok(_) => stats.record_success(&id, start.elapsed()),
+                Err(_) => stats.record_failure(&id),
+            }
+        }
+        result
+    }
+}
+
+impl<S> HttpProxyConnectorService<S> {
+    async fn connect<State, Body, T>(
+        &self,
+        mut ctx: Context<State>,
+        req: Request<Body>,
+        address: Option<ProxyAddress>,
+    ) -> Result<EstablishedClientConnection<T, Body, State>, BoxError>
+    where
+        S: Service<State, Request<Body>, Response = EstablishedClientConnection<T, Body, State>>,
+        T: Stream + Unpin,
+        S::Error: Into<BoxError>,
+        State: Send + Sync + 'static,
+        Body: Send + 'static,
+    {
         // in case the provider gave us a proxy info, we insert it into the context
         if let Some(address) = &address {
             ctx.insert(address.clone());
@@ -18,7 +18,7 @@ const NEWLINE: &str = "\n";
 const CARRIAGE_RETURN: char = '\r';
 
 /// The maximum length of a header in bytes.
-const MAX_LENGTH: usize = 107;
+pub(crate) const MAX_LENGTH: usize = 107;
 /// The total number of parts in the header.
 const PARTS: usize = 7;
 
@@ -9,11 +9,12 @@ mod model;
 pub use crate::proxy::pp::protocol::ip::{IPv4, IPv6};
 pub use builder::{Builder, WriteToHeader, Writer};
 pub use error::ParseError;
+pub(crate) use model::MINIMUM_LENGTH;
+use model::MINIMUM_TLV_LENGTH;
 pub use model::{
     AddressFamily, Addresses, Command, Header, Protocol, Type, TypeLengthValue, TypeLengthValues,
     Unix, Version, PROTOCOL_PREFIX,
 };
-use model::{MINIMUM_LENGTH, MINIMUM_TLV_LENGTH};
 use std::borrow::Cow;
 use std::net::{Ipv4Addr, Ipv6Addr};
 
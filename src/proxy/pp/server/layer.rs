@@ -1,17 +1,18 @@
-use std::net::SocketAddr;
+use std::{io, net::SocketAddr};
 
+use super::{stream::MAX_LEFTOVER, HaProxyStream};
 use crate::{
     error::BoxError,
     http::headers::Forwarded,
-    net::{
-        forwarded::ForwardedElement,
-        stream::{ChainReader, HeapReader, Stream},
-    },
+    net::{forwarded::ForwardedElement, stream::Stream},
     proxy::pp::protocol::{v1, v2, HeaderResult, PartialResult},
     service::{Context, Layer, Service},
 };
 use tokio::io::AsyncReadExt;
 
+/// The maximum length of a header accepted by the [`HaProxyService`].
+const MAX_HEADER_LENGTH: usize = 512;
+
 /// Layer to decode the HaProxy Protocol
 #[derive(Debug, Default, Clone)]
 #[non_exhaustive]
@@ -36,6 +37,12 @@ impl<S> Layer<S> for HaProxyLayer {
 ///
 /// This service will decode the HaProxy Protocol header and pass the decoded
 /// information to the inner service.
+///
+/// The header is decoded incrementally using a fixed buffer on the stack,
+/// never reading past the end of a v2 header, as its length is known upfront.
+/// The stream is passed to the inner service as a [`HaProxyStream`],
+/// which only has to replay the few bytes that might have been read
+/// past the end of a v1 header.
 #[derive(Debug, Clone)]
 pub struct HaProxyService<S> {
     inner: S,
@@ -51,10 +58,7 @@ impl<S> HaProxyService<S> {
 impl<State, S, IO> Service<State, IO> for HaProxyService<S>
 where
     State: Send + Sync + 'static,
-    S: Service<
-        State,
-        tokio::io::Join<ChainReader<HeapReader, tokio::io::ReadHalf<IO>>, tokio::io::WriteHalf<IO>>,
-    >,
+    S: Service<State, HaProxyStream<IO>>,
     S::Error: Into<BoxError>,
     IO: Stream + Unpin,
 {
@@ -66,16 +70,42 @@ where
         mut ctx: Context<State>,
         mut stream: IO,
     ) -> Result<Self::Response, Self::Error> {
-        let mut buffer = [0; 512];
+        let mut buffer = [0; MAX_HEADER_LENGTH];
         let mut read = 0;
+        // the fixed part of a v2 header, which is enough to tell both versions apart,
+        // no v1 header being shorter than it (except for an "unknown" one)
+        let mut limit = v2::MINIMUM_LENGTH;
         let header = loop {
-            read += stream.read(&mut buffer[read..]).await?;
+            let n = stream.read(&mut buffer[read..limit]).await?;
+            if n == 0 {
+                return Err(io::Error::new(
+                    io::ErrorKind::UnexpectedEof,
+                    "stream closed before HaProxy header was complete",
+                )
+                .into());
+            }
+            read += n;
 
             let header = HeaderResult::parse(&buffer[..read]);
             if header.is_complete() {
                 break header;
             }
 
+            if read == limit {
+                limit = if buffer.starts_with(v2::PROTOCOL_PREFIX) {
+                    v2::MINIMUM_LENGTH + u16::from_be_bytes([buffer[14], buffer[15]]) as usize
+                } else {
+                    v1::MAX_LENGTH
+                };
+                if limit <= read || limit > MAX_HEADER_LENGTH {
+                    return Err(io::Error::new(
+                        io::ErrorKind::InvalidData,
+                        "HaProxy header too long",
+                    )
+                    .into());
+                }
+            }
+
             tracing::debug!("Incomplete header. Read {} bytes so far.", read);
         };
 
@@ -153,10 +183,8 @@ where
         };
 
         // put back the data that is read too much
-        let (r, w) = tokio::io::split(stream);
-        let mem: HeapReader = buffer[consumed..read].into();
-        let r = ChainReader::new(mem, r);
-        let stream = tokio::io::join(r, w);
+        debug_assert!(read - consumed <= MAX_LEFTOVER);
+        let stream = HaProxyStream::new(stream, &buffer[consumed..read]);
 
         // read the rest of the data
         match self.inner.serve(ctx, stream).await {
@@ -165,3 +193,82 @@ where
         }
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{
+        proxy::pp::protocol::v2::{Builder, Command, IPv4, Protocol, Version},
+        service::service_fn,
+    };
+    use std::net::Ipv4Addr;
+    use tokio::io::AsyncWriteExt;
+
+    async fn serve_haproxy(input: Vec<u8>) -> Result<(Option<SocketAddr>, String), BoxError> {
+        let (mut client, server) = tokio::io::duplex(1024);
+        client.write_all(&input).await.unwrap();
+        client.shutdown().await.unwrap();
+
+        let service = HaProxyService::new(service_fn(
+            |ctx: Context<()>, mut stream: HaProxyStream<tokio::io::DuplexStream>| async move {
+                let mut data = String::new();
+                stream.read_to_string(&mut data).await.unwrap();
+                let addr = ctx
+                    .get::<Forwarded>()
+                    .and_then(|forwarded| forwarded.client_socket_addr());
+                Ok::<_, std::convert::Infallible>((addr, data))
+            },
+        ));
+        service.serve(Context::default(), server).await
+    }
+
+    #[tokio::test]
+    async fn test_haproxy_v1() {
+        let (addr, data) = serve_haproxy(
+            b"PROXY TCP4 192.168.0.1 192.168.0.11 56324 443\r\nGET / HTTP/1.1\r\n\r\n".to_vec(),
+        )
+        .await
+        .unwrap();
+        assert_eq!(addr, Some("192.168.0.1:56324".parse().unwrap()));
+        assert_eq!(data, "GET / HTTP/1.1\r\n\r\n");
+    }
+
+    #[tokio::test]
+    async fn test_haproxy_v1_unknown() {
+        let (addr, data) = serve_haproxy(b"PROXY UNKNOWN\r\nhello".to_vec())
+            .await
+            .unwrap();
+        assert_eq!(addr, None);
+        assert_eq!(data, "hello");
+    }
+
+    #[tokio::test]
+    async fn test_haproxy_v2() {
+        let mut input = Builder::with_addresses(
+            Version::Two | Command::Proxy,
+            Protocol::Stream,
+            IPv4::new(
+                Ipv4Addr::new(127, 0, 0, 1),
+                Ipv4Addr::new(192, 168, 1, 1),
+                80,
+                443,
+            ),
+        )
+        .write_tlv(0x05, [1, 2, 3].as_slice())
+        .unwrap()
+        .build()
+        .unwrap();
+        input.extend_from_slice(b"hello");
+
+        let (addr, data) = serve_haproxy(input).await.unwrap();
+        assert_eq!(addr, Some("127.0.0.1:80".parse().unwrap()));
+        assert_eq!(data, "hello");
+    }
+
+    #[tokio::test]
+    async fn test_haproxy_incomplete() {
+        assert!(serve_haproxy(b"PROXY TCP4 192.168.0.1".to_vec())
+            .await
+            .is_err());
+    }
+}
@@ -5,3 +5,7 @@
 mod layer;
 #[doc(inline)]
 pub use layer::{HaProxyLayer, HaProxyService};
+
+mod stream;
+#[doc(inline)]
+pub use stream::HaProxyStream;
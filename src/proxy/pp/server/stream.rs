@@ -0,0 +1,164 @@
+use crate::proxy::pp::protocol::v1;
+use pin_project_lite::pin_project;
+use std::{
+    fmt,
+    pin::Pin,
+    task::{Context, Poll},
+};
+use tokio::io::{self, AsyncRead, AsyncWrite, ReadBuf};
+
+/// The maximum amount of bytes that can be read past the HaProxy header.
+///
+/// Only a v1 header can be followed by bytes read too much,
+/// as the length of a v2 header is known upfront.
+pub(super) const MAX_LEFTOVER: usize = v1::MAX_LENGTH;
+
+pin_project! {
+    /// A stream which had a HaProxy Protocol header decoded by the [`HaProxyService`].
+    ///
+    /// Any bytes read past the header (possible for a v1 header only)
+    /// are kept in a small inline buffer and returned first when reading,
+    /// after which reads and writes go directly to the original stream.
+    ///
+    /// [`HaProxyService`]: crate::proxy::pp::server::HaProxyService
+    pub struct HaProxyStream<IO> {
+        #[pin]
+        inner: IO,
+        leftover: [u8; MAX_LEFTOVER],
+        start: usize,
+        end: usize,
+    }
+}
+
+impl<IO> HaProxyStream<IO> {
+    /// Create a new [`HaProxyStream`] for the given stream,
+    /// with the bytes already read from it past the header.
+    ///
+    /// # Panics
+    ///
+    /// Panics in case more than [`MAX_LEFTOVER`] leftover bytes are given.
+    pub(super) fn new(inner: IO, leftover: &[u8]) -> Self {
+        let mut buffer = [0; MAX_LEFTOVER];
+        buffer[..leftover.len()].copy_from_slice(leftover);
+        Self {
+            inner,
+            leftover: buffer,
+            start: 0,
+            end: leftover.len(),
+        }
+    }
+
+    /// Returns the bytes read past the header which are not yet read from this stream.
+    pub fn leftover(&self) -> &[u8] {
+        &self.leftover[self.start..self.end]
+    }
+
+    /// Gets a reference to the original stream.
+    pub fn get_ref(&self) -> &IO {
+        &self.inner
+    }
+
+    /// Gets a mutable reference to the original stream.
+    ///
+    /// Care should be taken not to read from the original stream
+    /// while there are still [`Self::leftover`] bytes.
+    pub fn get_mut(&mut self) -> &mut IO {
+        &mut self.inner
+    }
+
+    /// Returns the original stream, in case there are no [`Self::leftover`] bytes,
+    /// or this stream itself otherwise.
+    pub fn try_into_inner(self) -> Result<IO, Self> {
+        if self.start == self.end {
+            Ok(self.inner)
+        } else {
+            Err(self)
+        }
+    }
+}
+
+impl<IO: fmt::Debug> fmt::Debug for HaProxyStream<IO> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("HaProxyStream")
+            .field("inner", &self.inner)
+            .field("leftover", &self.leftover())
+            .finish()
+    }
+}
+
+impl<IO: AsyncRead> AsyncRead for HaProxyStream<IO> {
+    fn poll_read(
+        self: Pin<&mut Self>,
+        cx: &mut Context<'_>,
+        buf: &mut ReadBuf<'_>,
+    ) -> Poll<io::Result<()>> {
+        let me = self.project();
+
+        if *me.start < *me.end {
+            let n = buf.remaining().min(*me.end - *me.start);
+            buf.put_slice(&me.leftover[*me.start..*me.start + n]);
+            *me.start += n;
+            return Poll::Ready(Ok(()));
+        }
+
+        me.inner.poll_read(cx, buf)
+    }
+}
+
+impl<IO: AsyncWrite> AsyncWrite for HaProxyStream<IO> {
+    fn poll_write(
+        self: Pin<&mut Self>,
+        cx: &mut Context<'_>,
+        buf: &[u8],
+    ) -> Poll<io::Result<usize>> {
+        self.project().inner.poll_write(cx, buf)
+    }
+
+    fn poll_flush(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<io::Result<()>> {
+        self.project().inner.poll_flush(cx)
+    }
+
+    fn poll_shutdown(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<io::Result<()>> {
+        self.project().inner.poll_shutdown(cx)
+    }
+
+    fn poll_write_vectored(
+        self: Pin<&mut Self>,
+        cx: &mut Context<'_>,
+        bufs: &[io::IoSlice<'_>],
+    ) -> Poll<io::Result<usize>> {
+        self.project().inner.poll_write_vectored(cx, bufs)
+    }
+
+    fn is_write_vectored(&self) -> bool {
+        self.inner.is_write_vectored()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tokio::io::{AsyncReadExt, AsyncWriteExt};
+
+    #[tokio::test]
+    async fn test_haproxy_stream_leftover_first() {
+        let (mut client, server) = tokio::io::duplex(64);
+        let mut stream = HaProxyStream::new(server, b"hello ");
+        assert_eq!(stream.leftover(), b"hello ");
+
+        client.write_all(b"world").await.unwrap();
+        client.shutdown().await.unwrap();
+
+        let mut buf = [0; 3];
+        stream.read_exact(&mut buf).await.unwrap();
+        assert_eq!(&buf, b"hel");
+        assert_eq!(stream.leftover(), b"lo ");
+
+        let mut stream = stream.try_into_inner().unwrap_err();
+
+        let mut data = String::new();
+        stream.read_to_string(&mut data).await.unwrap();
+        assert_eq!(data, "lo world");
+        assert!(stream.try_into_inner().is_ok());
+    }
+}
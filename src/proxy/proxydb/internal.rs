@@ -4,10 +4,10 @@ use crate::{
     net::{address::ProxyAddress, user::ProxyCredential},
     utils::str::NonEmptyString,
 };
-use std::path::Path;
+use std::{collections::HashMap, path::Path};
 use tokio::{
     fs::File,
-    io::{AsyncBufReadExt, BufReader, Lines},
+    io::{AsyncBufReadExt, BufReader},
 };
 use venndb::VennDB;
 
@@ -128,59 +128,109 @@ impl Proxy {
 #[derive(Debug)]
 /// A CSV Reader that can be used to create a [`MemoryProxyDB`] from a CSV file or raw data.
 ///
+/// Rows are read into a reused buffer, and the string filters
+/// (pool, country, city and carrier) are interned while reading,
+/// such that proxies sharing the same value also share the same allocation.
+/// This keeps both the load time and memory usage down for large proxy lists.
+///
 /// [`MemoryProxyDB`]: crate::proxy::proxydb::MemoryProxyDB
 pub struct ProxyCsvRowReader {
     data: ProxyCsvRowReaderData,
+    interner: StringFilterInterner,
 }
 
 impl ProxyCsvRowReader {
     /// Create a new [`ProxyCsvRowReader`] from the given CSV file.
     pub async fn open(path: impl AsRef<Path>) -> Result<Self, ProxyCsvRowReaderError> {
         let file = tokio::fs::File::open(path).await?;
-        let reader = BufReader::new(file);
-        let lines = reader.lines();
         Ok(ProxyCsvRowReader {
-            data: ProxyCsvRowReaderData::File(lines),
+            data: ProxyCsvRowReaderData::File {
+                reader: BufReader::new(file),
+                line: String::new(),
+            },
+            interner: StringFilterInterner::default(),
         })
     }
 
     /// Create a new [`ProxyCsvRowReader`] from the given CSV data.
     pub fn raw(data: impl AsRef<str>) -> Self {
-        let lines: Vec<_> = data.as_ref().lines().rev().map(str::to_owned).collect();
         ProxyCsvRowReader {
-            data: ProxyCsvRowReaderData::Raw(lines),
+            data: ProxyCsvRowReaderData::Raw {
+                data: data.as_ref().to_owned(),
+                offset: 0,
+            },
+            interner: StringFilterInterner::default(),
         }
     }
 
     /// Read the next row from the CSV file.
     pub async fn next(&mut self) -> Result<Option<Proxy>, ProxyCsvRowReaderError> {
-        match &mut self.data {
-            ProxyCsvRowReaderData::File(lines) => {
-                let line = lines.next_line().await?;
-                match line {
-                    Some(line) => Ok(Some(match parse_csv_row(&line) {
-                        Some(proxy) => proxy,
-                        None => {
-                            return Err(ProxyCsvRowReaderError {
-                                kind: ProxyCsvRowReaderErrorKind::InvalidRow(line),
-                            });
-                        }
-                    })),
-                    None => Ok(None),
+        let line = match &mut self.data {
+            ProxyCsvRowReaderData::File { reader, line } => {
+                line.clear();
+                if reader.read_line(line).await? == 0 {
+                    return Ok(None);
                 }
+                trim_line_ending(line)
             }
-            ProxyCsvRowReaderData::Raw(lines) => match lines.pop() {
-                Some(line) => Ok(Some(match parse_csv_row(&line) {
-                    Some(proxy) => proxy,
+            ProxyCsvRowReaderData::Raw { data, offset } => {
+                let rest = &data[*offset..];
+                if rest.is_empty() {
+                    return Ok(None);
+                }
+                let line = match rest.find('\n') {
+                    Some(index) => {
+                        *offset += index + 1;
+                        &rest[..index + 1]
+                    }
                     None => {
-                        return Err(ProxyCsvRowReaderError {
-                            kind: ProxyCsvRowReaderErrorKind::InvalidRow(line),
-                        });
+                        *offset = data.len();
+                        rest
                     }
-                })),
-                None => Ok(None),
-            },
+                };
+                trim_line_ending(line)
+            }
+        };
+
+        match parse_csv_row_interned(line, &mut self.interner) {
+            Some(proxy) => Ok(Some(proxy)),
+            None => Err(ProxyCsvRowReaderError {
+                kind: ProxyCsvRowReaderErrorKind::InvalidRow(line.to_owned()),
+            }),
+        }
+    }
+}
+
+/// Strip the (`\n` or `\r\n`) line ending of a line, if any.
+fn trim_line_ending(line: &str) -> &str {
+    let line = line.strip_suffix('\n').unwrap_or(line);
+    line.strip_suffix('\r').unwrap_or(line)
+}
+
+#[derive(Debug, Default)]
+/// Interns the [`StringFilter`] values read from CSV rows,
+/// such that the same raw value is only normalized and allocated once.
+struct StringFilterInterner {
+    values: HashMap<String, StringFilter>,
+}
+
+impl StringFilterInterner {
+    /// Maximum amount of distinct values that are interned,
+    /// to bound the memory used for columns with (mostly) unique values.
+    const MAX_VALUES: usize = 64 * 1024;
+
+    fn intern(&mut self, value: &str) -> Option<StringFilter> {
+        if value.is_empty() {
+            return None;
+        }
+        if let Some(filter) = self.values.get(value) {
+            return Some(filter.clone());
+        }
+        let filter = StringFilter::from(value);
+        if self.values.len() < Self::MAX_VALUES {
+            self.values.insert(value.to_owned(), filter.clone());
         }
+        Some(filter)
     }
 }
 
@@ -190,7 +240,12 @@ fn strip_csv_quotes(p: &str) -> &str {
         .unwrap_or(p)
 }
 
+#[cfg(test)]
 fn parse_csv_row(row: &str) -> Option<Proxy> {
+    parse_csv_row_interned(row, &mut StringFilterInterner::default())
+}
+
+fn parse_csv_row_interned(row: &str, interner: &mut StringFilterInterner) -> Option<Proxy> {
     let mut iter = row.split(',').map(strip_csv_quotes);
 
     let id = iter.next().and_then(|s| s.try_into().ok())?;
@@ -211,10 +266,10 @@ fn parse_csv_row(row: &str) -> Option<Proxy> {
             ProxyAddress::try_from(s).ok()
         }
     })?;
-    let pool_id = parse_csv_opt_string_filter(iter.next()?);
-    let country = parse_csv_opt_string_filter(iter.next()?);
-    let city = parse_csv_opt_string_filter(iter.next()?);
-    let carrier = parse_csv_opt_string_filter(iter.next()?);
+    let pool_id = interner.intern(iter.next()?);
+    let country = interner.intern(iter.next()?);
+    let city = interner.intern(iter.next()?);
+    let carrier = interner.intern(iter.next()?);
 
     // support header format or cleartext format
     if let Some(value) = iter.next() {
@@ -258,6 +313,7 @@ fn parse_csv_bool(value: &str) -> Option<bool> {
     }
 }
 
+#[cfg(test)]
 fn parse_csv_opt_string_filter(value: &str) -> Option<StringFilter> {
     if value.is_empty() {
         None
@@ -268,8 +324,14 @@ fn parse_csv_opt_string_filter(value: &str) -> Option<StringFilter> {
 
 #[derive(Debug)]
 enum ProxyCsvRowReaderData {
-    File(Lines<BufReader<File>>),
-    Raw(Vec<String>),
+    File {
+        reader: BufReader<File>,
+        line: String,
+    },
+    Raw {
+        data: String,
+        offset: usize,
+    },
 }
 
 #[derive(Debug)]
@@ -579,6 +641,29 @@ mod tests {
         assert!(reader.next().await.unwrap().is_none());
     }
 
+    #[tokio::test]
+    async fn test_proxy_csv_row_reader_crlf_interned() {
+        let mut reader = ProxyCsvRowReader::raw(
+            "id1,1,,1,,1,,,authority,pool,US,,\r\nid2,1,,1,,1,,,authority,pool,us,,carrier\r\n",
+        );
+
+        let first = reader.next().await.unwrap().unwrap();
+        assert_eq!(first.id, "id1");
+        assert_eq!(first.carrier, None);
+
+        let second = reader.next().await.unwrap().unwrap();
+        assert_eq!(second.id, "id2");
+        assert_eq!(second.carrier, Some("carrier".into()));
+
+        // same raw values share the same allocation
+        let (a, b) = (first.pool_id.unwrap(), second.pool_id.unwrap());
+        assert_eq!(a.inner().as_ptr(), b.inner().as_ptr());
+        // different raw values can still be equal once normalized
+        assert_eq!(first.country, second.country);
+
+        assert!(reader.next().await.unwrap().is_none());
+    }
+
     #[tokio::test]
     async fn test_proxy_csv_row_reader_failure_empty_data() {
         let mut reader = ProxyCsvRowReader::raw("");
@@ -93,7 +93,7 @@ use crate::{
     service::{Context, Layer, Service},
 };
 
-use super::{Proxy, ProxyDB, ProxyFilter};
+use super::{Proxy, ProxyDB, ProxyFilter, ProxyStats};
 
 #[derive(Debug)]
 /// A [`Service`] which selects a [`Proxy`] based on the given [`Context`].
@@ -103,11 +103,18 @@ use super::{Proxy, ProxyDB, ProxyFilter};
 ///
 /// A predicate can be used to provide additional filtering on the found proxies,
 /// that otherwise did match the used [`ProxyFilter`].
+///
+/// In case [`ProxyStats`] are configured, the selected [`Proxy`] is tracked as in use
+/// for as long as the inner [`Service`] is serving, and the stats are inserted in the [`Context`],
+/// such that the [`HttpProxyConnectorService`] can record the outcome of connecting via the proxy.
+///
+/// [`HttpProxyConnectorService`]: crate::proxy::http::client::layer::HttpProxyConnectorService
 pub struct ProxyDBService<S, D, P = ()> {
     inner: S,
     db: D,
     mode: ProxySelectMode,
     predicate: P,
+    stats: Option<ProxyStats>,
 }
 
 #[derive(Debug, Clone, Default)]
@@ -199,6 +206,7 @@ where
             db: self.db.clone(),
             mode: self.mode.clone(),
             predicate: self.predicate.clone(),
+            stats: self.stats.clone(),
         }
     }
 }
@@ -214,6 +222,7 @@ impl<S, D> ProxyDBService<S, D> {
             db,
             mode,
             predicate: (),
+            stats: None,
         }
     }
 
@@ -231,8 +240,18 @@ impl<S, D, P> ProxyDBService<S, D, P> {
             db,
             mode,
             predicate,
+            stats: None,
         }
     }
+
+    /// Track the selected proxies using the given [`ProxyStats`],
+    /// typically the stats of the [`ProxyDB`] (e.g. [`MemoryProxyDB::stats`]).
+    ///
+    /// [`MemoryProxyDB::stats`]: crate::proxy::MemoryProxyDB::stats
+    pub fn with_stats(mut self, stats: ProxyStats) -> Self {
+        self.stats = Some(stats);
+        self
+    }
 }
 
 impl<S, D, State, Body> Service<State, Request<Body>> for ProxyDBService<S, D>
@@ -268,6 +287,7 @@ where
             }
         };
 
+        let mut _stats_guard = None;
         if let Some(filter) = maybe_filter {
             let req_ctx = get_request_context!(ctx, req);
             let proxy = self
@@ -275,6 +295,10 @@ where
                 .get_proxy(req_ctx.clone(), filter)
                 .await
                 .map_err(ProxySelectError::ProxyDBError)?;
+            if let Some(stats) = &self.stats {
+                _stats_guard = Some(stats.track(&proxy.id));
+                ctx.insert(stats.clone());
+            }
             ctx.insert(proxy);
         }
 
@@ -316,6 +340,7 @@ where
             }
         };
 
+        let mut _stats_guard = None;
         if let Some(filter) = maybe_filter {
             let req_ctx = get_request_context!(ctx, req);
             let proxy = self
@@ -323,6 +348,10 @@ where
                 .get_proxy_if(req_ctx.clone(), filter, self.predicate.clone())
                 .await
                 .map_err(ProxySelectError::ProxyDBError)?;
+            if let Some(stats) = &self.stats {
+                _stats_guard = Some(stats.track(&proxy.id));
+                ctx.insert(stats.clone());
+            }
             ctx.insert(proxy);
         }
 
@@ -342,6 +371,7 @@ pub struct ProxyDBLayer<D, P = ()> {
     db: D,
     mode: ProxySelectMode,
     predicate: P,
+    stats: Option<ProxyStats>,
 }
 
 impl<D, P> Clone for ProxyDBLayer<D, P>
@@ -354,6 +384,7 @@ where
             db: self.db.clone(),
             mode: self.mode.clone(),
             predicate: self.predicate.clone(),
+            stats: self.stats.clone(),
         }
     }
 }
@@ -368,6 +399,7 @@ impl<D> ProxyDBLayer<D> {
             db,
             mode,
             predicate: (),
+            stats: None,
         }
     }
 }
@@ -382,8 +414,16 @@ impl<D, P> ProxyDBLayer<D, P> {
             db,
             mode,
             predicate,
+            stats: None,
         }
     }
+
+    /// Track the selected proxies using the given [`ProxyStats`],
+    /// see [`ProxyDBService::with_stats`] for more information.
+    pub fn with_stats(mut self, stats: ProxyStats) -> Self {
+        self.stats = Some(stats);
+        self
+    }
 }
 
 impl<S, D, P> Layer<S> for ProxyDBLayer<D, P>
@@ -394,12 +434,13 @@ where
     type Service = ProxyDBService<S, D, P>;
 
     fn layer(&self, inner: S) -> Self::Service {
-        ProxyDBService::with_predicate(
+        ProxyDBService {
             inner,
-            self.db.clone(),
-            self.mode.clone(),
-            self.predicate.clone(),
-        )
+            db: self.db.clone(),
+            mode: self.mode.clone(),
+            predicate: self.predicate.clone(),
+            stats: self.stats.clone(),
+        }
     }
 }
 
@@ -15,6 +15,14 @@ mod str;
 #[doc(inline)]
 pub use str::StringFilter;
 
+mod select;
+#[doc(inline)]
+pub use select::{ProxySelectStrategy, ProxyStats, ProxyStatsGuard, ProxyStatsSnapshot};
+
+mod reload;
+#[doc(inline)]
+pub use reload::ReloadableProxyDB;
+
 #[derive(Debug, Default, Clone, Deserialize, PartialEq, Eq, Hash)]
 /// Filter to select a specific kind of proxy.
 ///
@@ -122,9 +130,14 @@ where
 }
 
 /// A fast in-memory ProxyDatabase that is the default choice for Rama.
+///
+/// Proxies matching a [`ProxyFilter`] are selected according to the
+/// [`ProxySelectStrategy`], which is uniformly random by default.
 #[derive(Debug)]
 pub struct MemoryProxyDB {
     data: internal::ProxyDB,
+    strategy: ProxySelectStrategy,
+    stats: ProxyStats,
 }
 
 impl MemoryProxyDB {
@@ -139,6 +152,8 @@ impl MemoryProxyDB {
                     MemoryProxyDBInsertError::invalid_proxy(err.into_input())
                 }
             })?,
+            strategy: ProxySelectStrategy::default(),
+            stats: ProxyStats::new(),
         })
     }
 
@@ -156,9 +171,35 @@ impl MemoryProxyDB {
                     MemoryProxyDBInsertError::invalid_proxy(err.into_input())
                 }
             })?,
+            strategy: ProxySelectStrategy::default(),
+            stats: ProxyStats::new(),
         })
     }
 
+    /// Set the [`ProxySelectStrategy`] used to select a proxy
+    /// among all proxies matching the [`ProxyFilter`].
+    pub fn with_select_strategy(mut self, strategy: ProxySelectStrategy) -> Self {
+        self.strategy = strategy;
+        self
+    }
+
+    /// Use the given [`ProxyStats`] to select proxies,
+    /// e.g. to share the statistics between multiple databases.
+    pub fn with_stats(mut self, stats: ProxyStats) -> Self {
+        self.stats = stats;
+        self
+    }
+
+    /// Return the [`ProxyStats`] used by this database.
+    ///
+    /// Pass these to [`ProxyDBLayer::with_stats`] such that they are updated
+    /// with the load, latency and failures of the selected proxies.
+    ///
+    /// [`ProxyDBLayer::with_stats`]: crate::proxy::layer::ProxyDBLayer::with_stats
+    pub fn stats(&self) -> &ProxyStats {
+        &self.stats
+    }
+
     /// Return the number of proxies in the database.
     pub fn len(&self) -> usize {
         self.data.len()
@@ -169,24 +210,26 @@ impl MemoryProxyDB {
         self.data.is_empty()
     }
 
+    /// Create the query for the given filter, borrowing it such that it
+    /// does not need to be cloned, as the filter values are cheap to clone.
     fn query_from_filter(
         &self,
-        ctx: RequestContext,
-        filter: ProxyFilter,
+        ctx: &RequestContext,
+        filter: &ProxyFilter,
     ) -> internal::ProxyDBQuery {
         let mut query = self.data.query();
 
-        for pool_id in filter.pool_id.into_iter().flatten() {
-            query.pool_id(pool_id);
+        for pool_id in filter.pool_id.iter().flatten() {
+            query.pool_id(pool_id.clone());
         }
-        for country in filter.country.into_iter().flatten() {
-            query.country(country);
+        for country in filter.country.iter().flatten() {
+            query.country(country.clone());
         }
-        for city in filter.city.into_iter().flatten() {
-            query.city(city);
+        for city in filter.city.iter().flatten() {
+            query.city(city.clone());
         }
-        for carrier in filter.carrier.into_iter().flatten() {
-            query.carrier(carrier);
+        for carrier in filter.carrier.iter().flatten() {
+            query.carrier(carrier.clone());
         }
 
         if let Some(value) = filter.datacenter {
@@ -230,8 +273,12 @@ impl ProxyDB for MemoryProxyDB {
                 }
             },
             None => {
-                let query = self.query_from_filter(ctx, filter.clone());
-                match query.execute().map(|result| result.any()) {
+                let query = self.query_from_filter(&ctx, &filter);
+                match query.execute().and_then(|result| {
+                    select::select(self.strategy, &self.stats, &filter, result.iter(), || {
+                        result.any()
+                    })
+                }) {
                     None => Err(MemoryProxyDBQueryError::not_found()),
                     Some(proxy) => Ok(combine_proxy_filter(proxy, filter)),
                 }
@@ -257,12 +304,15 @@ impl ProxyDB for MemoryProxyDB {
                 }
             },
             None => {
-                let query = self.query_from_filter(ctx, filter.clone());
+                let query = self.query_from_filter(&ctx, &filter);
                 match query
                     .execute()
                     .and_then(|result| result.filter(predicate))
-                    .map(|result| result.any())
-                {
+                    .and_then(|result| {
+                        select::select(self.strategy, &self.stats, &filter, result.iter(), || {
+                            result.any()
+                        })
+                    }) {
                     None => Err(MemoryProxyDBQueryError::not_found()),
                     Some(proxy) => Ok(combine_proxy_filter(proxy, filter)),
                 }
@@ -0,0 +1,159 @@
+use super::{Proxy, ProxyDB, ProxyFilter};
+use crate::http::RequestContext;
+use parking_lot::RwLock;
+use std::{fmt, future::Future, sync::Arc};
+
+/// A [`ProxyDB`] which can be swapped for a new version at runtime,
+/// e.g. to reload a proxy list without restarting the service using it.
+///
+/// Each lookup only holds the lock for as long as it takes to clone
+/// the [`Arc`] of the current database, after which the lookup
+/// runs against that version. Lookups in-flight during a swap
+/// therefore keep using the previous version, while new lookups
+/// immediately use the new one.
+///
+/// The new database is expected to be fully built (e.g. using the
+/// [`ProxyCsvRowReader`]) before it is stored, such that the cost of a reload
+/// is never paid on the request path. The previous version is returned by
+/// [`Self::store`], allowing it to be dropped there rather than on a request task.
+///
+/// # Example
+///
+/// ```
+/// use rama::proxy::{MemoryProxyDB, ProxyCsvRowReader, ReloadableProxyDB};
+///
+/// # #[tokio::main]
+/// # async fn main() {
+/// let db = ReloadableProxyDB::new(MemoryProxyDB::try_from_rows(vec![]).unwrap());
+///
+/// let mut reader = ProxyCsvRowReader::raw("id,1,,1,,1,,,authority,,,,");
+/// let mut rows = Vec::new();
+/// while let Some(proxy) = reader.next().await.unwrap() {
+///     rows.push(proxy);
+/// }
+///
+/// // keep the stats of the previous version, if any
+/// let stats = db.load().stats().clone();
+/// let previous =
+///     db.store(MemoryProxyDB::try_from_rows(rows).unwrap().with_stats(stats));
+///
+/// assert!(previous.is_empty());
+/// assert_eq!(db.load().len(), 1);
+/// # }
+/// ```
+///
+/// [`ProxyCsvRowReader`]: crate::proxy::ProxyCsvRowReader
+pub struct ReloadableProxyDB<D> {
+    current: Arc<RwLock<Arc<D>>>,
+}
+
+impl<D> ReloadableProxyDB<D> {
+    /// Create a new [`ReloadableProxyDB`] starting from the given database.
+    pub fn new(db: D) -> Self {
+        Self {
+            current: Arc::new(RwLock::new(Arc::new(db))),
+        }
+    }
+
+    /// Get the current version of the database.
+    pub fn load(&self) -> Arc<D> {
+        self.current.read().clone()
+    }
+
+    /// Replace the current version of the database with the given one,
+    /// returning the previous version.
+    pub fn store(&self, db: D) -> Arc<D> {
+        let db = Arc::new(db);
+        std::mem::replace(&mut *self.current.write(), db)
+    }
+}
+
+impl<D> Clone for ReloadableProxyDB<D> {
+    fn clone(&self) -> Self {
+        Self {
+            current: self.current.clone(),
+        }
+    }
+}
+
+impl<D: fmt::Debug> fmt::Debug for ReloadableProxyDB<D> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("ReloadableProxyDB")
+            .field("current", &self.load())
+            .finish()
+    }
+}
+
+impl<D> ProxyDB for ReloadableProxyDB<D>
+where
+    D: ProxyDB,
+{
+    type Error = D::Error;
+
+    fn get_proxy(
+        &self,
+        ctx: RequestContext,
+        filter: ProxyFilter,
+    ) -> impl Future<Output = Result<Proxy, Self::Error>> + Send + '_ {
+        let db = self.load();
+        async move { db.get_proxy(ctx, filter).await }
+    }
+
+    fn get_proxy_if(
+        &self,
+        ctx: RequestContext,
+        filter: ProxyFilter,
+        predicate: impl Fn(&Proxy) -> bool + Send + Sync + 'static,
+    ) -> impl Future<Output = Result<Proxy, Self::Error>> + Send + '_ {
+        let db = self.load();
+        async move { db.get_proxy_if(ctx, filter, predicate).await }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{
+        http::Version,
+        net::Protocol,
+        proxy::{MemoryProxyDB, ProxyCsvRowReader},
+    };
+
+    async fn memory_db(csv: &str) -> MemoryProxyDB {
+        let mut reader = ProxyCsvRowReader::raw(csv);
+        let mut rows = Vec::new();
+        while let Some(proxy) = reader.next().await.unwrap() {
+            rows.push(proxy);
+        }
+        MemoryProxyDB::try_from_rows(rows).unwrap()
+    }
+
+    fn ctx() -> RequestContext {
+        RequestContext {
+            http_version: Version::HTTP_11,
+            protocol: Protocol::HTTP,
+            authority: Some("example.com".try_into().unwrap()),
+        }
+    }
+
+    #[tokio::test]
+    async fn test_reloadable_proxy_db_swap() {
+        let db = ReloadableProxyDB::new(memory_db("old,1,,1,,1,,,authority,,,,").await);
+        let clone = db.clone();
+
+        let proxy = db.get_proxy(ctx(), ProxyFilter::default()).await.unwrap();
+        assert_eq!(proxy.id, "old");
+
+        let previous = clone.store(memory_db("new,1,,1,,1,,,authority,,,,").await);
+        assert_eq!(previous.len(), 1);
+
+        let proxy = db.get_proxy(ctx(), ProxyFilter::default()).await.unwrap();
+        assert_eq!(proxy.id, "new");
+
+        let proxy = db
+            .get_proxy_if(ctx(), ProxyFilter::default(), |proxy| proxy.id == "new")
+            .await
+            .unwrap();
+        assert_eq!(proxy.id, "new");
+    }
+}
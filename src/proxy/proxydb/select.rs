@@ -0,0 +1,416 @@
+use super::{Proxy, ProxyFilter};
+use crate::utils::{
+    rng::{HasherRng, Rng},
+    str::NonEmptyString,
+};
+use parking_lot::RwLock;
+use std::{
+    cmp,
+    collections::{hash_map::DefaultHasher, HashMap},
+    fmt,
+    hash::{Hash, Hasher},
+    sync::{
+        atomic::{AtomicU64, AtomicUsize, Ordering},
+        Arc,
+    },
+    time::Duration,
+};
+
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Hash)]
+/// The strategy used by the [`MemoryProxyDB`] to select a [`Proxy`]
+/// among all proxies that match the given [`ProxyFilter`].
+///
+/// All strategies but [`ProxySelectStrategy::Random`] make use of the
+/// live [`ProxyStats`] of the [`MemoryProxyDB`], which are updated
+/// by the [`ProxyDBService`] (load) and [`HttpProxyConnectorService`] (latency and failures),
+/// in case the former was configured with those stats using [`ProxyDBLayer::with_stats`].
+///
+/// [`MemoryProxyDB`]: super::MemoryProxyDB
+/// [`ProxyDBService`]: super::layer::ProxyDBService
+/// [`ProxyDBLayer::with_stats`]: super::layer::ProxyDBLayer::with_stats
+/// [`HttpProxyConnectorService`]: crate::proxy::http::client::layer::HttpProxyConnectorService
+pub enum ProxySelectStrategy {
+    #[default]
+    /// Select a random proxy, uniformly.
+    Random,
+    /// Select the proxy with the least amount of active requests,
+    /// preferring healthy proxies in case of a tie.
+    LeastConnections,
+    /// Select the best of two random proxies (power of two choices),
+    /// with the cost of a proxy being its EWMA latency weighted by its load and failure rate.
+    LeastLatency,
+    /// Select a proxy using weighted rendezvous hashing of the [`ProxyFilter`],
+    /// such that the same filter maps to the same proxy for as long as it is available,
+    /// with healthier proxies getting a higher weight.
+    ///
+    /// Useful for sticky sessions, as the [`ProxyFilter`] is typically derived
+    /// from the proxy username labels or headers of the client.
+    Rendezvous,
+}
+
+/// Live statistics of proxies, keyed by the [`Proxy`] id.
+///
+/// Cheap to clone, as all clones share the same statistics.
+#[derive(Clone, Default)]
+pub struct ProxyStats {
+    entries: Arc<RwLock<StatsEntries>>,
+}
+
+type StatsEntries = HashMap<NonEmptyString, Arc<ProxyStatsEntry>>;
+
+#[derive(Default)]
+struct ProxyStatsEntry {
+    active: AtomicUsize,
+    /// EWMA of the latency in microseconds, stored as f64 bits, 0 if unknown
+    latency: AtomicU64,
+    /// EWMA of the failure rate in `[0, 1]`, stored as f64 bits
+    failure_rate: AtomicU64,
+}
+
+/// Smoothing factor of the latency EWMA.
+const LATENCY_DECAY: f64 = 0.2;
+/// Smoothing factor of the failure rate EWMA.
+const FAILURE_DECAY: f64 = 0.1;
+
+impl fmt::Debug for ProxyStats {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("ProxyStats")
+            .field("proxies", &self.entries.read().len())
+            .finish()
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq)]
+/// A snapshot of the [`ProxyStats`] of a single [`Proxy`].
+pub struct ProxyStatsSnapshot {
+    /// The amount of requests currently using the proxy.
+    pub active: usize,
+    /// The EWMA latency of establishing a connection via the proxy,
+    /// `None` in case no connection was established yet.
+    pub latency: Option<Duration>,
+    /// The EWMA failure rate, between `0` and `1`, of establishing a connection via the proxy.
+    pub failure_rate: f64,
+}
+
+impl ProxyStats {
+    /// Create a new empty [`ProxyStats`].
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    fn entry(&self, id: &NonEmptyString) -> Arc<ProxyStatsEntry> {
+        if let Some(entry) = self.entries.read().get(id) {
+            return entry.clone();
+        }
+        self.entries.write().entry(id.clone()).or_default().clone()
+    }
+
+    /// Track the proxy with the given id as being in use,
+    /// until the returned guard is dropped.
+    pub fn track(&self, id: &NonEmptyString) -> ProxyStatsGuard {
+        let entry = self.entry(id);
+        entry.active.fetch_add(1, Ordering::Relaxed);
+        ProxyStatsGuard { entry }
+    }
+
+    /// Record a connection established via the proxy with the given id,
+    /// which took the given duration to establish.
+    pub fn record_success(&self, id: &NonEmptyString, latency: Duration) {
+        let entry = self.entry(id);
+        let latency = latency.as_secs_f64() * 1_000_000.0;
+        update_f64(&entry.latency, |current| {
+            if current == 0.0 {
+                latency
+            } else {
+                current + LATENCY_DECAY * (latency - current)
+            }
+        });
+        update_f64(&entry.failure_rate, |current| {
+            current - FAILURE_DECAY * current
+        });
+    }
+
+    /// Record a failed attempt to establish a connection via the proxy with the given id.
+    pub fn record_failure(&self, id: &NonEmptyString) {
+        let entry = self.entry(id);
+        update_f64(&entry.failure_rate, |current| {
+            current + FAILURE_DECAY * (1.0 - current)
+        });
+    }
+
+    /// Return a snapshot of the statistics of the proxy with the given id,
+    /// if any were recorded.
+    pub fn get(&self, id: &NonEmptyString) -> Option<ProxyStatsSnapshot> {
+        let entries = self.entries.read();
+        let entry = entries.get(id)?;
+        Some(snapshot(entry))
+    }
+}
+
+fn snapshot_or_default(entries: &StatsEntries, id: &NonEmptyString) -> ProxyStatsSnapshot {
+    match entries.get(id) {
+        Some(entry) => snapshot(entry),
+        None => ProxyStatsSnapshot {
+            active: 0,
+            latency: None,
+            failure_rate: 0.0,
+        },
+    }
+}
+
+fn snapshot(entry: &ProxyStatsEntry) -> ProxyStatsSnapshot {
+    let latency = f64::from_bits(entry.latency.load(Ordering::Relaxed));
+    ProxyStatsSnapshot {
+        active: entry.active.load(Ordering::Relaxed),
+        latency: (latency > 0.0).then(|| Duration::from_secs_f64(latency / 1_000_000.0)),
+        failure_rate: f64::from_bits(entry.failure_rate.load(Ordering::Relaxed)),
+    }
+}
+
+fn update_f64(value: &AtomicU64, f: impl Fn(f64) -> f64) {
+    let _ = value.fetch_update(Ordering::Relaxed, Ordering::Relaxed, |bits| {
+        Some(f(f64::from_bits(bits)).to_bits())
+    });
+}
+
+/// Guard returned by [`ProxyStats::track`],
+/// marking the proxy as no longer in use when dropped.
+pub struct ProxyStatsGuard {
+    entry: Arc<ProxyStatsEntry>,
+}
+
+impl fmt::Debug for ProxyStatsGuard {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("ProxyStatsGuard")
+            .field("stats", &snapshot(&self.entry))
+            .finish()
+    }
+}
+
+impl Drop for ProxyStatsGuard {
+    fn drop(&mut self) {
+        self.entry.active.fetch_sub(1, Ordering::Relaxed);
+    }
+}
+
+impl ProxyStatsSnapshot {
+    /// weight between `0` (exclusive) and `1` expressing how healthy the proxy is
+    fn health(&self) -> f64 {
+        (1.0 - self.failure_rate).max(0.01)
+    }
+
+    fn latency_cost(&self) -> f64 {
+        let latency = self
+            .latency
+            .map(|latency| latency.as_secs_f64() * 1_000.0)
+            .unwrap_or_default();
+        (latency + 1.0) * (self.active as f64 + 1.0) / self.health()
+    }
+}
+
+/// Select a proxy from the given candidates using the given strategy.
+///
+/// The [`ProxySelectStrategy::Random`] and [`ProxySelectStrategy::LeastLatency`]
+/// strategies only draw from `any`, which returns a random candidate,
+/// while the other strategies visit all candidates once, without collecting them.
+pub(super) fn select<'a>(
+    strategy: ProxySelectStrategy,
+    stats: &ProxyStats,
+    filter: &ProxyFilter,
+    candidates: impl Iterator<Item = &'a Proxy>,
+    any: impl Fn() -> &'a Proxy,
+) -> Option<&'a Proxy> {
+    match strategy {
+        ProxySelectStrategy::Random => Some(any()),
+        ProxySelectStrategy::LeastConnections => {
+            let entries = stats.entries.read();
+            let mut rng = HasherRng::new();
+            let mut best: Option<(&'a Proxy, ProxyStatsSnapshot)> = None;
+            let mut ties = 0;
+            for proxy in candidates {
+                let snapshot = snapshot_or_default(&entries, &proxy.id);
+                let ordering = match &best {
+                    Some((_, best)) => snapshot
+                        .active
+                        .cmp(&best.active)
+                        .then_with(|| snapshot.failure_rate.total_cmp(&best.failure_rate)),
+                    None => cmp::Ordering::Less,
+                };
+                match ordering {
+                    cmp::Ordering::Less => {
+                        best = Some((proxy, snapshot));
+                        ties = 1;
+                    }
+                    cmp::Ordering::Equal => {
+                        // pick uniformly among ties so they do not always favour the same proxy
+                        ties += 1;
+                        if rng.next_range(0..ties) == 0 {
+                            best = Some((proxy, snapshot));
+                        }
+                    }
+                    cmp::Ordering::Greater => (),
+                }
+            }
+            best.map(|(proxy, _)| proxy)
+        }
+        ProxySelectStrategy::LeastLatency => {
+            let (a, b) = (any(), any());
+            let entries = stats.entries.read();
+            let cost_a = snapshot_or_default(&entries, &a.id).latency_cost();
+            let cost_b = snapshot_or_default(&entries, &b.id).latency_cost();
+            Some(if cost_b < cost_a { b } else { a })
+        }
+        ProxySelectStrategy::Rendezvous => {
+            let mut filter_hasher = DefaultHasher::new();
+            filter.hash(&mut filter_hasher);
+            let entries = stats.entries.read();
+            candidates
+                .map(|proxy| {
+                    let mut hasher = filter_hasher.clone();
+                    proxy.id.hash(&mut hasher);
+                    // map the hash to (0, 1), exclusive on both ends
+                    let u = ((hasher.finish() >> 11) as f64 + 0.5) / (1u64 << 53) as f64;
+                    let weight = snapshot_or_default(&entries, &proxy.id).health();
+                    (proxy, -weight / u.ln())
+                })
+                .max_by(|(_, a), (_, b)| a.total_cmp(b))
+                .map(|(proxy, _)| proxy)
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::cell::Cell;
+
+    fn proxy(id: &'static str) -> Proxy {
+        Proxy {
+            id: NonEmptyString::from_static(id),
+            address: "127.0.0.1:8080".try_into().unwrap(),
+            tcp: true,
+            udp: false,
+            http: true,
+            socks5: false,
+            datacenter: true,
+            residential: false,
+            mobile: false,
+            pool_id: None,
+            country: None,
+            city: None,
+            carrier: None,
+        }
+    }
+
+    /// Select from the given candidates, with `any` cycling through them in order.
+    fn select_from<'a>(
+        strategy: ProxySelectStrategy,
+        stats: &ProxyStats,
+        filter: &ProxyFilter,
+        candidates: &[&'a Proxy],
+    ) -> Option<&'a Proxy> {
+        let next = Cell::new(0);
+        select(strategy, stats, filter, candidates.iter().copied(), || {
+            let index = next.get();
+            next.set(index + 1);
+            candidates[index % candidates.len()]
+        })
+    }
+
+    #[test]
+    fn test_stats_track_and_record() {
+        let stats = ProxyStats::new();
+        let id = NonEmptyString::from_static("a");
+        assert!(stats.get(&id).is_none());
+
+        let guard = stats.track(&id);
+        assert_eq!(stats.get(&id).unwrap().active, 1);
+        drop(guard);
+        assert_eq!(stats.get(&id).unwrap().active, 0);
+
+        stats.record_success(&id, Duration::from_millis(100));
+        let snapshot = stats.get(&id).unwrap();
+        assert_eq!(snapshot.latency, Some(Duration::from_millis(100)));
+        assert_eq!(snapshot.failure_rate, 0.0);
+
+        stats.record_failure(&id);
+        let snapshot = stats.get(&id).unwrap();
+        assert!(snapshot.failure_rate > 0.0 && snapshot.failure_rate < 1.0);
+    }
+
+    #[test]
+    fn test_select_least_connections() {
+        let stats = ProxyStats::new();
+        let (a, b, c) = (proxy("a"), proxy("b"), proxy("c"));
+        let _guards = [stats.track(&a.id), stats.track(&a.id), stats.track(&c.id)];
+
+        for _ in 0..16 {
+            let selected = select_from(
+                ProxySelectStrategy::LeastConnections,
+                &stats,
+                &ProxyFilter::default(),
+                &[&a, &b, &c],
+            )
+            .unwrap();
+            assert_eq!(selected.id, "b");
+        }
+    }
+
+    #[test]
+    fn test_select_least_latency() {
+        let stats = ProxyStats::new();
+        let (a, b) = (proxy("a"), proxy("b"));
+        stats.record_success(&a.id, Duration::from_secs(2));
+        stats.record_success(&b.id, Duration::from_millis(20));
+
+        for candidates in [[&a, &b], [&b, &a]] {
+            let selected = select_from(
+                ProxySelectStrategy::LeastLatency,
+                &stats,
+                &ProxyFilter::default(),
+                &candidates,
+            )
+            .unwrap();
+            assert_eq!(selected.id, "b");
+        }
+    }
+
+    #[test]
+    fn test_select_rendezvous_sticky() {
+        let stats = ProxyStats::new();
+        let proxies: Vec<_> = ["a", "b", "c", "d", "e"].into_iter().map(proxy).collect();
+        let candidates: Vec<_> = proxies.iter().collect();
+        let filter = ProxyFilter {
+            country: Some(vec!["BE".into()]),
+            ..Default::default()
+        };
+
+        let selected = select_from(
+            ProxySelectStrategy::Rendezvous,
+            &stats,
+            &filter,
+            &candidates,
+        )
+        .unwrap();
+        for _ in 0..16 {
+            let again = select_from(
+                ProxySelectStrategy::Rendezvous,
+                &stats,
+                &filter,
+                &candidates,
+            )
+            .unwrap();
+            assert_eq!(selected.id, again.id);
+        }
+
+        // removing another proxy does not move the session
+        let remaining: Vec<_> = candidates
+            .iter()
+            .copied()
+            .filter(|proxy| proxy.id == selected.id || proxy.id != candidates[0].id)
+            .collect();
+        let again =
+            select_from(ProxySelectStrategy::Rendezvous, &stats, &filter, &remaining).unwrap();
+        assert_eq!(selected.id, again.id);
+    }
+}
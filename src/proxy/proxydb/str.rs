@@ -1,5 +1,5 @@
 use serde::{Deserialize, Serialize};
-use std::{convert::Infallible, str::FromStr};
+use std::{convert::Infallible, str::FromStr, sync::Arc};
 use unicode_normalization::UnicodeNormalization;
 
 #[derive(Debug, Clone)]
@@ -10,7 +10,10 @@ use unicode_normalization::UnicodeNormalization;
 /// - trims whitespace
 /// - case-insensitive
 /// - NFC normalizes
-pub struct StringFilter(String);
+///
+/// Cloning is cheap, as the normalized string is shared between clones,
+/// which also allows the same value to be interned across many proxies.
+pub struct StringFilter(Arc<str>);
 
 impl StringFilter {
     /// Create a string filter which will match anything
@@ -20,7 +23,19 @@ impl StringFilter {
 
     /// Create a new string filter.
     pub fn new(value: impl AsRef<str>) -> Self {
-        Self(value.as_ref().trim().to_lowercase().nfc().collect())
+        let value = value.as_ref().trim();
+        if value.is_ascii() {
+            // ascii is already NFC normalized, so skip the (allocating)
+            // unicode normalization for the common case of ascii values,
+            // and lowercase the single copy in place
+            let mut value: Arc<str> = value.into();
+            if let Some(value) = Arc::get_mut(&mut value) {
+                value.make_ascii_lowercase();
+            }
+            Self(value)
+        } else {
+            Self(value.to_lowercase().nfc().collect::<String>().into())
+        }
     }
 
     /// Get the inner string.
@@ -30,13 +45,13 @@ impl StringFilter {
 
     /// Convert the string filter into the inner string.
     pub fn into_inner(self) -> String {
-        self.0
+        self.0.to_string()
     }
 }
 
 impl PartialEq for StringFilter {
     fn eq(&self, other: &Self) -> bool {
-        match (self.0.as_str(), other.0.as_str()) {
+        match (self.inner(), other.inner()) {
             ("*", _) | (_, "*") => true,
             _ => self.0 == other.0,
         }
@@ -73,13 +88,13 @@ impl std::fmt::Display for StringFilter {
 
 impl From<StringFilter> for String {
     fn from(filter: StringFilter) -> Self {
-        filter.0
+        filter.into_inner()
     }
 }
 
 impl From<&StringFilter> for String {
     fn from(filter: &StringFilter) -> Self {
-        filter.0.clone()
+        filter.inner().to_owned()
     }
 }
 
@@ -106,7 +121,7 @@ impl Serialize for StringFilter {
     where
         S: serde::Serializer,
     {
-        self.0.serialize(serializer)
+        self.inner().serialize(serializer)
     }
 }
 
@@ -121,7 +136,7 @@ impl<'de> Deserialize<'de> for StringFilter {
 
 impl venndb::Any for StringFilter {
     fn is_any(&self) -> bool {
-        self.0 == "*"
+        self.inner() == "*"
     }
 }
 
@@ -141,6 +156,20 @@ mod tests {
         assert_eq!(filter, "ÅΩ".into());
     }
 
+    #[test]
+    fn test_string_filter_ascii() {
+        for (input, expected) in [
+            ("us", "us"),
+            (" US ", "us"),
+            ("New-York", "new-york"),
+            ("*", "*"),
+            ("", ""),
+            ("  Zürich", "zürich"),
+        ] {
+            assert_eq!(StringFilter::new(input).inner(), expected, "input: {input}");
+        }
+    }
+
     #[test]
     fn test_string_filter_case_insensitive() {
         let filter = StringFilter::new("Hello World");
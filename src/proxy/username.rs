@@ -49,40 +49,28 @@ impl UsernameLabelParser for ProxyFilterUsernameParser {
                     })
                 }
                 ProxyFilterKey::Pool => {
-                    self.proxy_filter.pool_id = match self.proxy_filter.pool_id.take() {
-                        Some(mut pool_ids) => {
-                            pool_ids.push(label.into());
-                            Some(pool_ids)
-                        }
-                        None => Some(vec![label.into()]),
-                    }
+                    self.proxy_filter
+                        .pool_id
+                        .get_or_insert_with(Vec::new)
+                        .push(label.into());
                 }
                 ProxyFilterKey::Country => {
-                    self.proxy_filter.country = match self.proxy_filter.country.take() {
-                        Some(mut countries) => {
-                            countries.push(label.into());
-                            Some(countries)
-                        }
-                        None => Some(vec![label.into()]),
-                    }
+                    self.proxy_filter
+                        .country
+                        .get_or_insert_with(Vec::new)
+                        .push(label.into());
                 }
                 ProxyFilterKey::City => {
-                    self.proxy_filter.city = match self.proxy_filter.city.take() {
-                        Some(mut cities) => {
-                            cities.push(label.into());
-                            Some(cities)
-                        }
-                        None => Some(vec![label.into()]),
-                    }
+                    self.proxy_filter
+                        .city
+                        .get_or_insert_with(Vec::new)
+                        .push(label.into());
                 }
                 ProxyFilterKey::Carrier => {
-                    self.proxy_filter.carrier = match self.proxy_filter.carrier.take() {
-                        Some(mut carriers) => {
-                            carriers.push(label.into());
-                            Some(carriers)
-                        }
-                        None => Some(vec![label.into()]),
-                    }
+                    self.proxy_filter
+                        .carrier
+                        .get_or_insert_with(Vec::new)
+                        .push(label.into());
                 }
             },
             None => {
@@ -1,29 +1,39 @@
 use std::any::{Any, TypeId};
-use std::collections::HashMap;
 use std::fmt;
-use std::hash::{BuildHasherDefault, Hasher};
+use std::sync::Arc;
 
-type AnyMap = HashMap<TypeId, Box<dyn AnyClone + Send + Sync>, BuildHasherDefault<IdHasher>>;
+// Most contexts only ever hold a handful of extensions,
+// so a linear scan over a small vector of entries is cheaper than hashing,
+// and the first allocation is sized such that it is usually the only one.
+const INITIAL_CAPACITY: usize = 8;
 
-// With TypeIds as keys, there's no need to hash them. They are already hashes
-// themselves, coming from the compiler. The IdHasher just holds the u64 of
-// the TypeId, and then returns it, instead of doing any bit fiddling.
-#[derive(Default)]
-struct IdHasher(u64);
+type AnyValue = Arc<dyn AnyClone + Send + Sync>;
 
-impl Hasher for IdHasher {
-    fn write(&mut self, _: &[u8]) {
-        unreachable!("TypeId calls write_u64");
+#[derive(Clone)]
+struct Entry {
+    id: TypeId,
+    value: AnyValue,
+}
+
+impl Entry {
+    fn new<T: Clone + Send + Sync + 'static>(val: T) -> Self {
+        Self {
+            id: TypeId::of::<T>(),
+            value: Arc::new(val),
+        }
     }
 
-    #[inline]
-    fn write_u64(&mut self, id: u64) {
-        self.0 = id;
+    fn get_mut<T: 'static>(&mut self) -> Option<&mut T> {
+        if Arc::get_mut(&mut self.value).is_none() {
+            // value is shared with a clone of the extensions, copy it on write
+            self.value = (*self.value).clone_arc();
+        }
+        Arc::get_mut(&mut self.value).and_then(|value| value.as_any_mut().downcast_mut())
     }
 
-    #[inline]
-    fn finish(&self) -> u64 {
-        self.0
+    fn into_inner<T: Clone + Send + Sync + 'static>(self) -> Option<T> {
+        let value = self.value.into_any_arc().downcast::<T>().ok()?;
+        Some(Arc::try_unwrap(value).unwrap_or_else(|value| (*value).clone()))
     }
 }
 
@@ -31,18 +41,46 @@ impl Hasher for IdHasher {
 ///
 /// `Extensions` can be used by `Request` and `Response` to store
 /// extra data derived from the underlying protocol.
+///
+/// Cloning `Extensions` is cheap: the clone shares the stored values
+/// with the original, until either of them is modified (copy-on-write).
+/// For example the extensions of a connection's [`Context`] are shared
+/// by the [`Context`] of each request served over that connection,
+/// with only the extensions modified for a request being copied.
+///
+/// [`Context`]: crate::service::Context
 #[derive(Clone, Default)]
 pub struct Extensions {
-    // If extensions are never used, no need to carry around an empty HashMap.
+    // If extensions are never used, no need to carry around an empty Vec.
     // That's 3 words. Instead, this is only 1 word.
-    map: Option<Box<AnyMap>>,
+    entries: Option<Arc<Vec<Entry>>>,
 }
 
 impl Extensions {
     /// Create an empty `Extensions`.
     #[inline]
     pub fn new() -> Extensions {
-        Extensions { map: None }
+        Extensions { entries: None }
+    }
+
+    fn entries_mut(&mut self) -> &mut Vec<Entry> {
+        Arc::make_mut(
+            self.entries
+                .get_or_insert_with(|| Arc::new(Vec::with_capacity(INITIAL_CAPACITY))),
+        )
+    }
+
+    fn position(&self, id: TypeId) -> Option<usize> {
+        self.entries
+            .as_ref()
+            .and_then(|entries| entries.iter().position(|entry| entry.id == id))
+    }
+
+    fn entry<T: 'static>(&self) -> Option<&Entry> {
+        let id = TypeId::of::<T>();
+        self.entries
+            .as_ref()
+            .and_then(|entries| entries.iter().find(|entry| entry.id == id))
     }
 
     /// Insert a type into this `Extensions`.
@@ -50,50 +88,59 @@ impl Extensions {
     /// If a extension of this type already existed, it will
     /// be returned.
     pub fn insert<T: Clone + Send + Sync + 'static>(&mut self, val: T) -> Option<T> {
-        self.map
-            .get_or_insert_with(Box::default)
-            .insert(TypeId::of::<T>(), Box::new(val))
-            .and_then(|boxed| boxed.into_any().downcast().ok().map(|boxed| *boxed))
+        let entry = Entry::new(val);
+        match self.position(entry.id) {
+            Some(index) => std::mem::replace(&mut self.entries_mut()[index], entry).into_inner(),
+            None => {
+                self.entries_mut().push(entry);
+                None
+            }
+        }
     }
 
     /// Extend these extensions with another Extensions.
     pub fn extend(&mut self, other: Extensions) {
-        if let Some(other_map) = other.map {
-            let map = self.map.get_or_insert_with(Box::default);
-            #[allow(clippy::useless_conversion)]
-            map.extend(other_map.into_iter());
+        let Some(other_entries) = other.entries else {
+            return;
+        };
+        if self.entries.is_none() {
+            self.entries = Some(other_entries);
+            return;
+        }
+        let other_entries = Arc::try_unwrap(other_entries).unwrap_or_else(|e| (*e).clone());
+        for entry in other_entries {
+            match self.position(entry.id) {
+                Some(index) => self.entries_mut()[index] = entry,
+                None => self.entries_mut().push(entry),
+            }
         }
     }
 
     /// Clear the `Extensions` of all inserted extensions.
     pub fn clear(&mut self) {
-        if let Some(map) = self.map.as_mut() {
-            map.clear();
+        if let Some(entries) = self.entries.as_mut() {
+            match Arc::get_mut(entries) {
+                Some(entries) => entries.clear(),
+                None => self.entries = None,
+            }
         }
     }
 
     /// Returns true if the `Extensions` contains the given type.
     pub fn contains<T: Send + Sync + 'static>(&self) -> bool {
-        self.map
-            .as_ref()
-            .map(|map| map.contains_key(&TypeId::of::<T>()))
-            .unwrap_or_default()
+        self.entry::<T>().is_some()
     }
 
     /// Get a shared reference to a type previously inserted on this `Extensions`.
     pub fn get<T: Send + Sync + 'static>(&self) -> Option<&T> {
-        self.map
-            .as_ref()
-            .and_then(|map| map.get(&TypeId::of::<T>()))
-            .and_then(|boxed| (**boxed).as_any().downcast_ref())
+        self.entry::<T>()
+            .and_then(|entry| (*entry.value).as_any().downcast_ref())
     }
 
     /// Get an exclusive reference to a type previously inserted on this `Extensions`.
     pub fn get_mut<T: Send + Sync + 'static>(&mut self) -> Option<&mut T> {
-        self.map
-            .as_mut()
-            .and_then(|map| map.get_mut(&TypeId::of::<T>()))
-            .and_then(|boxed| (**boxed).as_any_mut().downcast_mut())
+        let index = self.position(TypeId::of::<T>())?;
+        self.entries_mut()[index].get_mut()
     }
 
     /// Inserts a value into the map computed from `f` into if it is [`None`],
@@ -102,13 +149,15 @@ impl Extensions {
         &mut self,
         f: impl FnOnce() -> T,
     ) -> &mut T {
-        let map = self.map.get_or_insert_with(Box::default);
-        let entry = map.entry(TypeId::of::<T>());
-        let boxed = entry.or_insert_with(|| Box::new(f()));
-        (**boxed)
-            .as_any_mut()
-            .downcast_mut()
-            .expect("type mismatch")
+        let index = match self.position(TypeId::of::<T>()) {
+            Some(index) => index,
+            None => {
+                let entries = self.entries_mut();
+                entries.push(Entry::new(f()));
+                entries.len() - 1
+            }
+        };
+        self.entries_mut()[index].get_mut().expect("type mismatch")
     }
 
     /// Inserts a value into the map computed by converting `U` into `T` if it is `None`
@@ -118,13 +167,7 @@ impl Extensions {
         T: Send + Sync + Clone + 'static,
         U: Into<T>,
     {
-        let map = self.map.get_or_insert_with(Box::default);
-        let entry = map.entry(TypeId::of::<T>());
-        let boxed = entry.or_insert_with(|| Box::new(src.into()));
-        (**boxed)
-            .as_any_mut()
-            .downcast_mut()
-            .expect("type mismatch")
+        self.get_or_insert_with(|| src.into())
     }
 
     /// Retrieves a value of type `T` from the context.
@@ -149,15 +192,15 @@ impl fmt::Debug for Extensions {
 }
 
 trait AnyClone: Any {
-    fn clone_box(&self) -> Box<dyn AnyClone + Send + Sync>;
+    fn clone_arc(&self) -> AnyValue;
     fn as_any(&self) -> &dyn Any;
     fn as_any_mut(&mut self) -> &mut dyn Any;
-    fn into_any(self: Box<Self>) -> Box<dyn Any>;
+    fn into_any_arc(self: Arc<Self>) -> Arc<dyn Any + Send + Sync>;
 }
 
 impl<T: Clone + Send + Sync + 'static> AnyClone for T {
-    fn clone_box(&self) -> Box<dyn AnyClone + Send + Sync> {
-        Box::new(self.clone())
+    fn clone_arc(&self) -> AnyValue {
+        Arc::new(self.clone())
     }
 
     fn as_any(&self) -> &dyn Any {
@@ -168,17 +211,11 @@ impl<T: Clone + Send + Sync + 'static> AnyClone for T {
         self
     }
 
-    fn into_any(self: Box<Self>) -> Box<dyn Any> {
+    fn into_any_arc(self: Arc<Self>) -> Arc<dyn Any + Send + Sync> {
         self
     }
 }
 
-impl Clone for Box<dyn AnyClone + Send + Sync> {
-    fn clone(&self) -> Self {
-        (**self).clone_box()
-    }
-}
-
 #[test]
 fn test_extensions() {
     #[derive(Clone, Debug, PartialEq, Eq, Hash)]
@@ -214,3 +251,41 @@ fn test_extensions() {
     assert_eq!(extensions2.get::<i32>(), None);
     assert_eq!(extensions2.get::<MyType>(), None);
 }
+
+#[test]
+fn test_extensions_copy_on_write() {
+    #[derive(Clone, Debug, PartialEq, Eq)]
+    struct MyType(i32);
+
+    let mut extensions = Extensions::new();
+    extensions.insert(MyType(1));
+    extensions.insert(5i32);
+
+    let mut clone = extensions.clone();
+    clone.get_mut::<MyType>().unwrap().0 = 2;
+    clone.insert(true);
+    assert_eq!(clone.insert(6i32), Some(5));
+
+    assert_eq!(extensions.get(), Some(&MyType(1)));
+    assert_eq!(extensions.get(), Some(&5i32));
+    assert!(!extensions.contains::<bool>());
+    assert_eq!(clone.get(), Some(&MyType(2)));
+    assert_eq!(clone.get(), Some(&6i32));
+    assert_eq!(clone.get(), Some(&true));
+
+    *extensions.get_or_insert_with(|| MyType(0)) = MyType(3);
+    assert_eq!(extensions.get(), Some(&MyType(3)));
+    assert_eq!(clone.get(), Some(&MyType(2)));
+
+    let mut other = Extensions::new();
+    other.insert(false);
+    other.insert(7i32);
+    extensions.extend(other);
+    assert_eq!(extensions.get(), Some(&false));
+    assert_eq!(extensions.get(), Some(&7i32));
+    assert_eq!(extensions.get(), Some(&MyType(3)));
+
+    clone.clear();
+    assert!(!clone.contains::<MyType>());
+    assert_eq!(extensions.get(), Some(&MyType(3)));
+}
@@ -0,0 +1,301 @@
+use super::concurrent::{try_increment, ConcurrentTracker, LimitReached};
+use parking_lot::Mutex;
+use std::{
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Arc,
+    },
+    time::{Duration, Instant},
+};
+
+/// A [`ConcurrentTracker`] of which the concurrency limit adapts itself
+/// to the observed latency of the requests, to be used with a [`ConcurrentPolicy`].
+///
+/// The limit is estimated using the gradient between the long-term (baseline)
+/// and short-term (recent) average latency, similar to the `Gradient2` limit
+/// of Netflix' `concurrency-limits`:
+///
+/// - while the recent latency stays within a tolerance of the baseline,
+///   the limit grows by about the square root of the limit,
+///   for as long as the requests actually use the limit;
+/// - once requests start queueing in the service and its latency rises,
+///   the limit shrinks in proportion to the latency increase.
+///
+/// Requests exceeding the limit are rejected right away with [`LimitReached`],
+/// rather than being queued, such that an overloaded service sheds load early
+/// (e.g. map it to a `503 Service Unavailable` response) instead of collapsing.
+///
+/// The limit is checked lock-free, and a latency is only sampled in case
+/// no other request is updating the limit at the same time.
+/// Cloning the tracker shares its limit.
+///
+/// # Example
+///
+/// ```
+/// use rama::service::layer::{LimitLayer, limit::policy::{AdaptiveLimit, ConcurrentPolicy}};
+///
+/// let layer = LimitLayer::new(ConcurrentPolicy::new(
+///     AdaptiveLimit::new().with_min_limit(4).with_max_limit(512),
+/// ));
+/// # let _ = layer;
+/// ```
+///
+/// [`ConcurrentPolicy`]: super::ConcurrentPolicy
+#[derive(Debug, Clone)]
+pub struct AdaptiveLimit {
+    config: AdaptiveConfig,
+    state: Arc<AdaptiveState>,
+}
+
+#[derive(Debug, Clone, Copy)]
+struct AdaptiveConfig {
+    min_limit: usize,
+    max_limit: usize,
+    smoothing: f64,
+    tolerance: f64,
+}
+
+#[derive(Debug)]
+struct AdaptiveState {
+    limit: AtomicUsize,
+    in_flight: AtomicUsize,
+    estimator: Mutex<Estimator>,
+}
+
+#[derive(Debug)]
+struct Estimator {
+    limit: f64,
+    /// long-term average latency, in seconds
+    long_rtt: f64,
+    /// short-term average latency, in seconds
+    short_rtt: f64,
+}
+
+/// Weight of a new sample in the long-term (baseline) average latency.
+const LONG_RTT_WEIGHT: f64 = 2.0 / 601.0;
+/// Weight of a new sample in the short-term (recent) average latency.
+const SHORT_RTT_WEIGHT: f64 = 2.0 / 11.0;
+
+impl AdaptiveLimit {
+    /// The default initial limit.
+    pub const DEFAULT_INITIAL_LIMIT: usize = 20;
+    /// The default minimum limit.
+    pub const DEFAULT_MIN_LIMIT: usize = 1;
+    /// The default maximum limit.
+    pub const DEFAULT_MAX_LIMIT: usize = 1000;
+
+    /// Create a new [`AdaptiveLimit`].
+    pub fn new() -> Self {
+        Self {
+            config: AdaptiveConfig {
+                min_limit: Self::DEFAULT_MIN_LIMIT,
+                max_limit: Self::DEFAULT_MAX_LIMIT,
+                smoothing: 0.2,
+                tolerance: 1.5,
+            },
+            state: Arc::new(AdaptiveState {
+                limit: AtomicUsize::new(Self::DEFAULT_INITIAL_LIMIT),
+                in_flight: AtomicUsize::new(0),
+                estimator: Mutex::new(Estimator {
+                    limit: Self::DEFAULT_INITIAL_LIMIT as f64,
+                    long_rtt: 0.0,
+                    short_rtt: 0.0,
+                }),
+            }),
+        }
+    }
+
+    /// Set the initial limit, used until latencies are observed.
+    ///
+    /// Note that this resets the limit of all clones of this tracker.
+    pub fn with_initial_limit(self, limit: usize) -> Self {
+        let limit = limit.clamp(self.config.min_limit, self.config.max_limit);
+        self.state.limit.store(limit, Ordering::Relaxed);
+        self.state.estimator.lock().limit = limit as f64;
+        self
+    }
+
+    /// Set the minimum limit, which the limit never shrinks below.
+    pub fn with_min_limit(mut self, limit: usize) -> Self {
+        self.config.min_limit = limit.max(1);
+        self.config.max_limit = self.config.max_limit.max(self.config.min_limit);
+        self.clamp_limit()
+    }
+
+    /// Set the maximum limit, which the limit never grows beyond.
+    pub fn with_max_limit(mut self, limit: usize) -> Self {
+        self.config.max_limit = limit.max(1);
+        self.config.min_limit = self.config.min_limit.min(self.config.max_limit);
+        self.clamp_limit()
+    }
+
+    /// Set the factor (clamped to `[0.01, 1]`) at which the limit moves towards a new estimate,
+    /// with higher values reacting faster to latency changes. Defaults to `0.2`.
+    pub fn with_smoothing(mut self, smoothing: f64) -> Self {
+        self.config.smoothing = smoothing.clamp(0.01, 1.0);
+        self
+    }
+
+    /// Set the factor (at least `1`) by which the recent latency can exceed the baseline
+    /// latency before the limit starts shrinking. Defaults to `1.5`.
+    pub fn with_tolerance(mut self, tolerance: f64) -> Self {
+        self.config.tolerance = tolerance.max(1.0);
+        self
+    }
+
+    /// Returns the current concurrency limit.
+    pub fn limit(&self) -> usize {
+        self.state.limit.load(Ordering::Relaxed)
+    }
+
+    /// Returns the amount of requests currently tracked.
+    pub fn current(&self) -> usize {
+        self.state.in_flight.load(Ordering::Relaxed)
+    }
+
+    fn clamp_limit(self) -> Self {
+        let limit = self.limit();
+        self.with_initial_limit(limit)
+    }
+
+    /// Update the limit using the latency of a completed request,
+    /// which completed while `in_flight` requests were tracked (including itself).
+    fn sample(&self, rtt: Duration, in_flight: usize) {
+        let Some(mut estimator) = self.state.estimator.try_lock() else {
+            // another request is updating the limit, skip this sample
+            return;
+        };
+
+        let rtt = rtt.as_secs_f64().max(1e-6);
+        if estimator.long_rtt == 0.0 {
+            estimator.long_rtt = rtt;
+            estimator.short_rtt = rtt;
+        } else {
+            estimator.long_rtt += (rtt - estimator.long_rtt) * LONG_RTT_WEIGHT;
+            estimator.short_rtt += (rtt - estimator.short_rtt) * SHORT_RTT_WEIGHT;
+        }
+
+        // recover faster once the latency drops back after an overload,
+        // by pulling the baseline towards the recent latency
+        if estimator.long_rtt / estimator.short_rtt > 2.0 {
+            estimator.long_rtt *= 0.95;
+        }
+
+        let gradient =
+            (self.config.tolerance * estimator.long_rtt / estimator.short_rtt).clamp(0.5, 1.0);
+
+        // do not grow the limit based on latencies of requests that do not use the limit
+        if gradient >= 1.0 && (in_flight as f64) < estimator.limit / 2.0 {
+            return;
+        }
+
+        let target = estimator.limit * gradient + estimator.limit.sqrt();
+        let limit = (estimator.limit * (1.0 - self.config.smoothing)
+            + target * self.config.smoothing)
+            .clamp(self.config.min_limit as f64, self.config.max_limit as f64);
+
+        estimator.limit = limit;
+        self.state.limit.store(limit as usize, Ordering::Relaxed);
+    }
+}
+
+impl Default for AdaptiveLimit {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl ConcurrentTracker for AdaptiveLimit {
+    type Guard = AdaptiveLimitGuard;
+    type Error = LimitReached;
+
+    fn try_access(&self) -> Result<Self::Guard, Self::Error> {
+        if try_increment(&self.state.in_flight, self.limit()) {
+            Ok(AdaptiveLimitGuard {
+                limit: self.clone(),
+                start: Instant::now(),
+            })
+        } else {
+            Err(LimitReached)
+        }
+    }
+}
+
+/// The guard for [`AdaptiveLimit`] that releases the concurrent request limit,
+/// and samples the latency of the request, once dropped.
+#[derive(Debug)]
+pub struct AdaptiveLimitGuard {
+    limit: AdaptiveLimit,
+    start: Instant,
+}
+
+impl Drop for AdaptiveLimitGuard {
+    fn drop(&mut self) {
+        let in_flight = self.limit.state.in_flight.fetch_sub(1, Ordering::Release);
+        self.limit.sample(self.start.elapsed(), in_flight);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const MS: Duration = Duration::from_millis(1);
+
+    #[test]
+    fn adaptive_limit_rejects_above_limit() {
+        let limit = AdaptiveLimit::new().with_initial_limit(2);
+        let guard_1 = limit.try_access().unwrap();
+        let _guard_2 = limit.clone().try_access().unwrap();
+        assert!(limit.try_access().is_err());
+        assert_eq!(limit.current(), 2);
+
+        drop(guard_1);
+        assert!(limit.try_access().is_ok());
+    }
+
+    #[test]
+    fn adaptive_limit_grows_with_stable_latency() {
+        let limit = AdaptiveLimit::new().with_initial_limit(10);
+        for _ in 0..50 {
+            limit.sample(10 * MS, limit.limit());
+        }
+        assert!(limit.limit() > 10, "limit: {}", limit.limit());
+
+        // but not when the limit is not used
+        let grown = limit.limit();
+        for _ in 0..50 {
+            limit.sample(10 * MS, 1);
+        }
+        assert_eq!(limit.limit(), grown);
+    }
+
+    #[test]
+    fn adaptive_limit_shrinks_with_rising_latency() {
+        let limit = AdaptiveLimit::new()
+            .with_initial_limit(100)
+            .with_min_limit(5);
+        for _ in 0..100 {
+            limit.sample(10 * MS, 100);
+        }
+        let stable = limit.limit();
+
+        for _ in 0..50 {
+            limit.sample(100 * MS, stable);
+        }
+        assert!(limit.limit() < stable / 2, "limit: {}", limit.limit());
+        assert!(limit.limit() >= 5);
+    }
+
+    #[test]
+    fn adaptive_limit_bounds() {
+        let limit = AdaptiveLimit::new()
+            .with_initial_limit(2000)
+            .with_max_limit(50);
+        assert_eq!(limit.limit(), 50);
+        for _ in 0..100 {
+            limit.sample(10 * MS, 50);
+        }
+        assert_eq!(limit.limit(), 50);
+    }
+}
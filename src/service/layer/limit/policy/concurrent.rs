@@ -27,8 +27,10 @@
 use super::{Policy, PolicyOutput, PolicyResult};
 use crate::service::Context;
 use crate::utils::backoff::Backoff;
-use parking_lot::Mutex;
-use std::sync::Arc;
+use std::sync::{
+    atomic::{AtomicUsize, Ordering},
+    Arc,
+};
 
 /// A [`Policy`] that limits the number of concurrent requests.
 #[derive(Debug)]
@@ -237,10 +239,14 @@ pub trait ConcurrentTracker: Send + Sync + 'static {
 }
 
 /// The default [`ConcurrentTracker`] that uses a counter to track the concurrent requests.
+///
+/// The counter is a single atomic, updated lock-free.
+/// Use [`ShardedConcurrentCounter`] in case this single counter
+/// becomes a point of contention across many cores.
 #[derive(Debug, Clone)]
 pub struct ConcurrentCounter {
     max: usize,
-    current: Arc<Mutex<usize>>,
+    current: Arc<AtomicUsize>,
 }
 
 impl ConcurrentCounter {
@@ -248,9 +254,14 @@ impl ConcurrentCounter {
     pub fn new(max: usize) -> Self {
         ConcurrentCounter {
             max,
-            current: Arc::new(Mutex::new(0)),
+            current: Arc::new(AtomicUsize::new(0)),
         }
     }
+
+    /// Return the amount of requests currently tracked by this counter.
+    pub fn current(&self) -> usize {
+        self.current.load(Ordering::Relaxed)
+    }
 }
 
 impl ConcurrentTracker for ConcurrentCounter {
@@ -258,9 +269,7 @@ impl ConcurrentTracker for ConcurrentCounter {
     type Error = LimitReached;
 
     fn try_access(&self) -> Result<Self::Guard, Self::Error> {
-        let mut current = self.current.lock();
-        if *current < self.max {
-            *current += 1;
+        if try_increment(&self.current, self.max) {
             Ok(ConcurrentCounterGuard {
                 current: self.current.clone(),
             })
@@ -273,16 +282,119 @@ impl ConcurrentTracker for ConcurrentCounter {
 /// The guard for [`ConcurrentCounter`] that releases the concurrent request limit.
 #[derive(Debug)]
 pub struct ConcurrentCounterGuard {
-    current: Arc<Mutex<usize>>,
+    current: Arc<AtomicUsize>,
 }
 
 impl Drop for ConcurrentCounterGuard {
     fn drop(&mut self) {
-        let mut current = self.current.lock();
-        *current -= 1;
+        self.current.fetch_sub(1, Ordering::Release);
+    }
+}
+
+/// A [`ConcurrentTracker`] that spreads the limit over multiple counters,
+/// each living in its own cache line.
+///
+/// Threads are assigned to a counter (shard), which is used first,
+/// only falling back to the other shards when their own shard is full.
+/// This avoids all cores contending on the same cache line,
+/// at the cost of the limit being approximate: the limit is divided over the shards
+/// (rounded up), so up to `shards - 1` more requests than `max` can be allowed.
+#[derive(Debug, Clone)]
+pub struct ShardedConcurrentCounter {
+    max_per_shard: usize,
+    shards: Arc<[CachePadded<AtomicUsize>]>,
+}
+
+impl ShardedConcurrentCounter {
+    /// Create a new sharded concurrent counter with the given (approximate) maximum limit,
+    /// using one shard per available core.
+    pub fn new(max: usize) -> Self {
+        let shards = std::thread::available_parallelism()
+            .map(usize::from)
+            .unwrap_or(1);
+        Self::with_shards(max, shards)
+    }
+
+    /// Create a new sharded concurrent counter with the given (approximate) maximum limit,
+    /// using the given amount of shards.
+    pub fn with_shards(max: usize, shards: usize) -> Self {
+        let shards = shards.clamp(1, max.max(1));
+        ShardedConcurrentCounter {
+            max_per_shard: max.div_ceil(shards),
+            shards: (0..shards)
+                .map(|_| CachePadded(AtomicUsize::new(0)))
+                .collect(),
+        }
+    }
+
+    /// Return the (approximate) amount of requests currently tracked by this counter.
+    pub fn current(&self) -> usize {
+        self.shards
+            .iter()
+            .map(|shard| shard.0.load(Ordering::Relaxed))
+            .sum()
     }
 }
 
+impl ConcurrentTracker for ShardedConcurrentCounter {
+    type Guard = ShardedConcurrentCounterGuard;
+    type Error = LimitReached;
+
+    fn try_access(&self) -> Result<Self::Guard, Self::Error> {
+        let count = self.shards.len();
+        let home = thread_shard_hint() % count;
+        for offset in 0..count {
+            let index = (home + offset) % count;
+            if try_increment(&self.shards[index].0, self.max_per_shard) {
+                return Ok(ShardedConcurrentCounterGuard {
+                    shards: self.shards.clone(),
+                    index,
+                });
+            }
+        }
+        Err(LimitReached)
+    }
+}
+
+/// The guard for [`ShardedConcurrentCounter`] that releases the concurrent request limit.
+#[derive(Debug)]
+pub struct ShardedConcurrentCounterGuard {
+    shards: Arc<[CachePadded<AtomicUsize>]>,
+    index: usize,
+}
+
+impl Drop for ShardedConcurrentCounterGuard {
+    fn drop(&mut self) {
+        self.shards[self.index].0.fetch_sub(1, Ordering::Release);
+    }
+}
+
+/// Increment the counter if it is below the given maximum,
+/// returning `true` if the counter was incremented.
+pub(super) fn try_increment(counter: &AtomicUsize, max: usize) -> bool {
+    counter
+        .fetch_update(Ordering::Acquire, Ordering::Relaxed, |current| {
+            (current < max).then_some(current + 1)
+        })
+        .is_ok()
+}
+
+/// Returns a stable index for the current thread,
+/// used to assign the thread to a shard.
+fn thread_shard_hint() -> usize {
+    static NEXT: AtomicUsize = AtomicUsize::new(0);
+    thread_local! {
+        static HINT: usize = NEXT.fetch_add(1, Ordering::Relaxed);
+    }
+    HINT.with(|hint| *hint)
+}
+
+#[derive(Debug)]
+#[repr(align(128))]
+/// Aligns the inner value to its own cache line(s),
+/// preventing false sharing between neighbouring values.
+struct CachePadded<T>(T);
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -341,4 +453,37 @@ mod tests {
         drop(guard_1);
         assert_ready(policy.check(Context::default(), ()).await);
     }
+
+    #[tokio::test]
+    async fn concurrent_policy_sharded() {
+        let policy = ConcurrentPolicy::new(ShardedConcurrentCounter::with_shards(4, 2));
+
+        let mut guards = Vec::new();
+        for _ in 0..4 {
+            guards.push(assert_ready(policy.check(Context::default(), ()).await));
+        }
+
+        assert_abort(policy.check(Context::default(), ()).await);
+
+        drop(guards);
+        assert_ready(policy.check(Context::default(), ()).await);
+    }
+
+    #[test]
+    fn sharded_counter_steals_from_other_shards() {
+        let counter = ShardedConcurrentCounter::with_shards(3, 3);
+        let guards: Vec<_> = (0..3).map(|_| counter.try_access().unwrap()).collect();
+        assert_eq!(counter.current(), 3);
+        assert!(counter.try_access().is_err());
+        drop(guards);
+        assert_eq!(counter.current(), 0);
+    }
+
+    #[test]
+    fn sharded_counter_clamps_shards() {
+        let counter = ShardedConcurrentCounter::with_shards(2, 16);
+        let _guard_1 = counter.try_access().unwrap();
+        let _guard_2 = counter.try_access().unwrap();
+        assert!(counter.try_access().is_err());
+    }
 }
@@ -23,6 +23,19 @@
 //! external sockets or you want to rate limit specific domains/paths only for http requests.
 //! See the [`http_rate_limit.rs`] example for a use case.
 //!
+//! # Adaptive Concurrency
+//!
+//! Instead of a fixed limit, the [`ConcurrentPolicy`] can also be used with an [`AdaptiveLimit`],
+//! which raises or lowers the concurrency limit based on the observed latency of the requests,
+//! rejecting requests above the limit right away instead of queueing them.
+//!
+//! # Rate Policies
+//!
+//! Besides limiting the amount of concurrent requests using the [`ConcurrentPolicy`],
+//! you can also limit the rate of requests per key (e.g. client ip, user or header)
+//! using the [`RatePolicy`], with either the [`Gcra`] (token bucket)
+//! or [`SlidingWindow`] algorithm.
+//!
 //! [`Matcher`]: crate::service::Matcher
 //! [`Extensions`]: crate::service::context::Extensions
 //! [`http_listener_hello.rs`]: https://github.com/plabayo/rama/blob/main/examples/http_rate_limit.rs
@@ -33,7 +46,21 @@ use std::{convert::Infallible, sync::Arc};
 
 mod concurrent;
 #[doc(inline)]
-pub use concurrent::{ConcurrentCounter, ConcurrentPolicy, ConcurrentTracker, LimitReached};
+pub use concurrent::{
+    ConcurrentCounter, ConcurrentPolicy, ConcurrentTracker, LimitReached, ShardedConcurrentCounter,
+};
+
+mod adaptive;
+#[doc(inline)]
+pub use adaptive::{AdaptiveLimit, AdaptiveLimitGuard};
+
+mod rate;
+#[doc(inline)]
+pub use rate::{
+    rate_limit_key_fn, ClientIpKey, ExtractRateLimitKey, Gcra, GlobalKey, HeaderKey, RateAlgorithm,
+    RateLimitKey, RateLimitKeyFn, RateLimited, RatePolicy, SlidingWindow, SlidingWindowState,
+    UserIdKey,
+};
 
 mod matcher;
 
@@ -0,0 +1,707 @@
+//! [`Policy`]s that limit the rate of requests, per key.
+//!
+//! See [`RatePolicy`].
+//!
+//! # Examples
+//!
+//! ```
+//! use rama::service::{
+//!     layer::limit::{Limit, policy::{ClientIpKey, Gcra, RatePolicy}},
+//!     Context, Service, service_fn,
+//! };
+//! use std::time::Duration;
+//! # use std::convert::Infallible;
+//!
+//! # #[tokio::main]
+//! # async fn main() {
+//!
+//! let service = service_fn(|_, _| async {
+//!     Ok::<_, Infallible>(())
+//! });
+//! // allow 10 requests per second for each client ip, with bursts of up to 5 requests,
+//! // waiting up to 100ms for a request that arrives too early
+//! let policy = RatePolicy::new(Gcra::per_second(10).with_burst(5), ClientIpKey::new())
+//!     .with_max_wait(Duration::from_millis(100));
+//! let service = Limit::new(service, policy);
+//!
+//! // requests without a client ip are not limited
+//! let response = service.serve(Context::default(), ()).await;
+//! assert!(response.is_ok());
+//! # }
+//! ```
+
+use super::{Policy, PolicyOutput, PolicyResult};
+use crate::http::{HeaderName, HeaderValue, Request};
+use crate::net::{forwarded::Forwarded, stream::SocketInfo, user::UserId};
+use crate::service::Context;
+use crate::utils::lru::LruCache;
+use parking_lot::Mutex;
+use std::{
+    collections::hash_map::RandomState,
+    fmt,
+    hash::{BuildHasher, Hash},
+    net::IpAddr,
+    sync::Arc,
+    time::{Duration, Instant},
+};
+
+/// A [`Policy`] that limits the rate of requests per key,
+/// using the given [`RateAlgorithm`] and [`RateLimitKey`].
+///
+/// Requests for which no key can be extracted are not limited.
+///
+/// When a request arrives too early it is aborted with a [`RateLimited`] error,
+/// unless it is allowed to wait (see [`RatePolicy::with_max_wait`]),
+/// in which case the policy sleeps for the computed delay and signals a
+/// [`PolicyOutput::Retry`], such that the [`Limit`] service checks it again.
+///
+/// The state per key is stored in a sharded map,
+/// where state that no longer has any effect is removed,
+/// and which is bounded in size (see [`RatePolicy::with_max_keys`]),
+/// evicting the state of the least recently seen keys once full.
+///
+/// Cloning a [`RatePolicy`] shares the state between the clones.
+///
+/// [`Limit`]: crate::service::layer::Limit
+pub struct RatePolicy<A: RateAlgorithm, K: RateLimitKey> {
+    algorithm: A,
+    key: K,
+    max_wait: Option<Duration>,
+    store: Arc<KeyedStore<K::Key, A::State>>,
+}
+
+impl<A, K> fmt::Debug for RatePolicy<A, K>
+where
+    A: RateAlgorithm + fmt::Debug,
+    K: RateLimitKey + fmt::Debug,
+{
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("RatePolicy")
+            .field("algorithm", &self.algorithm)
+            .field("key", &self.key)
+            .field("max_wait", &self.max_wait)
+            .field("store", &self.store)
+            .finish()
+    }
+}
+
+impl<A, K> Clone for RatePolicy<A, K>
+where
+    A: RateAlgorithm + Clone,
+    K: RateLimitKey + Clone,
+{
+    fn clone(&self) -> Self {
+        Self {
+            algorithm: self.algorithm.clone(),
+            key: self.key.clone(),
+            max_wait: self.max_wait,
+            store: self.store.clone(),
+        }
+    }
+}
+
+impl<A, K> RatePolicy<A, K>
+where
+    A: RateAlgorithm,
+    K: RateLimitKey,
+{
+    /// The default maximum amount of keys for which state is kept.
+    pub const DEFAULT_MAX_KEYS: usize = 1024 * 1024;
+
+    /// Create a new [`RatePolicy`] using the given algorithm and key.
+    pub fn new(algorithm: A, key: K) -> Self {
+        Self {
+            algorithm,
+            key,
+            max_wait: None,
+            store: Arc::new(KeyedStore::new(Self::DEFAULT_MAX_KEYS)),
+        }
+    }
+
+    /// Allow requests that arrive too early to wait up to the given duration,
+    /// instead of aborting them immediately.
+    pub fn with_max_wait(mut self, max_wait: Duration) -> Self {
+        self.max_wait = Some(max_wait);
+        self
+    }
+
+    /// Set the maximum amount of keys for which state is kept.
+    ///
+    /// Once reached the expired state is dropped, or else the state of the
+    /// least recently seen key, for each new key, so memory remains bounded
+    /// regardless of the amount of keys.
+    pub fn with_max_keys(mut self, max_keys: usize) -> Self {
+        self.store = Arc::new(KeyedStore::new(max_keys));
+        self
+    }
+}
+
+impl<A, K, State, Request> Policy<State, Request> for RatePolicy<A, K>
+where
+    A: RateAlgorithm,
+    K: ExtractRateLimitKey<State, Request>,
+    State: Send + Sync + 'static,
+    Request: Send + 'static,
+{
+    type Guard = ();
+    type Error = RateLimited;
+
+    async fn check(
+        &self,
+        ctx: Context<State>,
+        request: Request,
+    ) -> PolicyResult<State, Request, Self::Guard, Self::Error> {
+        let key = match self.key.extract_key(&ctx, &request) {
+            Some(key) => key,
+            None => {
+                return PolicyResult {
+                    ctx,
+                    request,
+                    output: PolicyOutput::Ready(()),
+                }
+            }
+        };
+
+        let output = match self.store.check(&self.algorithm, key) {
+            Ok(()) => PolicyOutput::Ready(()),
+            Err(retry_after) => match self.max_wait {
+                Some(max_wait) if retry_after <= max_wait => {
+                    tokio::time::sleep(retry_after).await;
+                    PolicyOutput::Retry
+                }
+                _ => PolicyOutput::Abort(RateLimited { retry_after }),
+            },
+        };
+
+        PolicyResult {
+            ctx,
+            request,
+            output,
+        }
+    }
+}
+
+/// The error that indicates the request is aborted,
+/// because it arrived before the rate limit allowed it.
+#[derive(Debug, Clone)]
+pub struct RateLimited {
+    retry_after: Duration,
+}
+
+impl RateLimited {
+    /// The duration after which the request would be allowed.
+    pub fn retry_after(&self) -> Duration {
+        self.retry_after
+    }
+}
+
+impl fmt::Display for RateLimited {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "RateLimited (retry after {:?})", self.retry_after)
+    }
+}
+
+impl std::error::Error for RateLimited {}
+
+/// The algorithm used by a [`RatePolicy`] to decide if a request
+/// is allowed, based on the state kept for its key.
+///
+/// Time is passed as the [`Duration`] elapsed since the creation of the policy,
+/// which keeps the state compact.
+pub trait RateAlgorithm: Send + Sync + 'static {
+    /// The state kept per key.
+    type State: Send + 'static;
+
+    /// Create the (empty) state for a key seen for the first time.
+    fn new_state(&self, now: Duration) -> Self::State;
+
+    /// Check if a request is allowed at the given time, updating the state if it is.
+    ///
+    /// Returns the duration after which the request would be allowed otherwise.
+    fn check(&self, state: &mut Self::State, now: Duration) -> Result<(), Duration>;
+
+    /// Returns the time at which the state no longer has any effect,
+    /// meaning it can be dropped.
+    fn expires_at(&self, state: &Self::State) -> Duration;
+}
+
+#[derive(Debug, Clone)]
+/// A [`RateAlgorithm`] using the Generic Cell Rate Algorithm (GCRA),
+/// which behaves as a token bucket without the need to refill tokens.
+///
+/// The state per key is a single timestamp.
+pub struct Gcra {
+    emission_interval: Duration,
+    burst: u32,
+}
+
+impl Gcra {
+    /// Allow `rate` requests per `period`, evenly spread.
+    ///
+    /// # Panics
+    ///
+    /// Panics if `rate` is zero.
+    pub fn new(rate: u32, period: Duration) -> Self {
+        assert!(rate > 0, "rate has to be greater than zero");
+        Self {
+            emission_interval: period / rate,
+            burst: 1,
+        }
+    }
+
+    /// Allow `rate` requests per second, evenly spread.
+    pub fn per_second(rate: u32) -> Self {
+        Self::new(rate, Duration::from_secs(1))
+    }
+
+    /// Allow `rate` requests per minute, evenly spread.
+    pub fn per_minute(rate: u32) -> Self {
+        Self::new(rate, Duration::from_secs(60))
+    }
+
+    /// Allow bursts of up to `burst` requests at once (minimum 1).
+    pub fn with_burst(mut self, burst: u32) -> Self {
+        self.burst = burst.max(1);
+        self
+    }
+
+    fn tolerance(&self) -> Duration {
+        self.emission_interval * (self.burst - 1)
+    }
+}
+
+impl RateAlgorithm for Gcra {
+    /// The theoretical arrival time of the next request.
+    type State = Duration;
+
+    fn new_state(&self, now: Duration) -> Self::State {
+        now
+    }
+
+    fn check(&self, tat: &mut Self::State, now: Duration) -> Result<(), Duration> {
+        let tat_now = (*tat).max(now);
+        let allow_at = tat_now.saturating_sub(self.tolerance());
+        if now < allow_at {
+            return Err(allow_at - now);
+        }
+        *tat = tat_now + self.emission_interval;
+        Ok(())
+    }
+
+    fn expires_at(&self, tat: &Self::State) -> Duration {
+        *tat
+    }
+}
+
+#[derive(Debug, Clone)]
+/// A [`RateAlgorithm`] allowing `limit` requests per sliding `window`.
+///
+/// The sliding window is approximated by weighing the count of the previous (fixed) window
+/// by how much it still overlaps with the sliding window, which only
+/// requires two counters per key.
+pub struct SlidingWindow {
+    limit: u64,
+    window: Duration,
+}
+
+impl SlidingWindow {
+    /// Allow `limit` requests per sliding `window`.
+    ///
+    /// # Panics
+    ///
+    /// Panics if the `window` is zero.
+    pub fn new(limit: u64, window: Duration) -> Self {
+        assert!(!window.is_zero(), "window has to be greater than zero");
+        Self { limit, window }
+    }
+}
+
+#[derive(Debug, Clone)]
+/// The state kept per key by the [`SlidingWindow`] algorithm.
+pub struct SlidingWindowState {
+    window_index: u64,
+    current: u64,
+    previous: u64,
+}
+
+impl RateAlgorithm for SlidingWindow {
+    type State = SlidingWindowState;
+
+    fn new_state(&self, now: Duration) -> Self::State {
+        SlidingWindowState {
+            window_index: (now.as_nanos() / self.window.as_nanos()) as u64,
+            current: 0,
+            previous: 0,
+        }
+    }
+
+    fn check(&self, state: &mut Self::State, now: Duration) -> Result<(), Duration> {
+        let window_nanos = self.window.as_nanos();
+        let window_index = (now.as_nanos() / window_nanos) as u64;
+
+        if window_index != state.window_index {
+            state.previous = if window_index == state.window_index + 1 {
+                state.current
+            } else {
+                0
+            };
+            state.current = 0;
+            state.window_index = window_index;
+        }
+
+        let elapsed = (now.as_nanos() % window_nanos) as f64 / window_nanos as f64;
+        let estimate = state.previous as f64 * (1.0 - elapsed) + state.current as f64;
+        if estimate + 1.0 > self.limit as f64 {
+            let remaining = self.window.mul_f64(1.0 - elapsed);
+            return Err(if state.current >= self.limit {
+                // nothing can be allowed until the next window starts
+                remaining
+            } else {
+                // wait until enough of the previous window has slid out
+                let needed = (estimate + 1.0 - self.limit as f64) / (state.previous.max(1) as f64);
+                self.window.mul_f64(needed.min(1.0)).min(remaining)
+            });
+        }
+
+        state.current += 1;
+        Ok(())
+    }
+
+    fn expires_at(&self, state: &Self::State) -> Duration {
+        let nanos = (state.window_index as u128 + 2) * self.window.as_nanos();
+        Duration::from_nanos(nanos.min(u64::MAX as u128) as u64)
+    }
+}
+
+/// The kind of key for which the rate is limited by the [`RatePolicy`].
+pub trait RateLimitKey: Send + Sync + 'static {
+    /// The key type.
+    type Key: Hash + Eq + Clone + Send + Sync + 'static;
+}
+
+/// Extracts the [`RateLimitKey::Key`] from a request.
+pub trait ExtractRateLimitKey<State, Request>: RateLimitKey {
+    /// Extract the key from the request, or return `None` to not limit it.
+    fn extract_key(&self, ctx: &Context<State>, req: &Request) -> Option<Self::Key>;
+}
+
+/// Create a [`RateLimitKey`] from a function
+/// that extracts the key from the [`Context`] and request.
+pub fn rate_limit_key_fn<F, Key>(f: F) -> RateLimitKeyFn<F, Key> {
+    RateLimitKeyFn {
+        f,
+        _key: std::marker::PhantomData,
+    }
+}
+
+/// A [`RateLimitKey`] created from a function, see [`rate_limit_key_fn`].
+pub struct RateLimitKeyFn<F, Key> {
+    f: F,
+    _key: std::marker::PhantomData<fn() -> Key>,
+}
+
+impl<F: fmt::Debug, Key> fmt::Debug for RateLimitKeyFn<F, Key> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("RateLimitKeyFn")
+            .field("f", &self.f)
+            .finish()
+    }
+}
+
+impl<F: Clone, Key> Clone for RateLimitKeyFn<F, Key> {
+    fn clone(&self) -> Self {
+        Self {
+            f: self.f.clone(),
+            _key: std::marker::PhantomData,
+        }
+    }
+}
+
+impl<F, Key> RateLimitKey for RateLimitKeyFn<F, Key>
+where
+    F: Send + Sync + 'static,
+    Key: Hash + Eq + Clone + Send + Sync + 'static,
+{
+    type Key = Key;
+}
+
+impl<F, Key, State, Request> ExtractRateLimitKey<State, Request> for RateLimitKeyFn<F, Key>
+where
+    F: Fn(&Context<State>, &Request) -> Option<Key> + Send + Sync + 'static,
+    Key: Hash + Eq + Clone + Send + Sync + 'static,
+{
+    fn extract_key(&self, ctx: &Context<State>, req: &Request) -> Option<Self::Key> {
+        (self.f)(ctx, req)
+    }
+}
+
+#[derive(Debug, Clone, Default)]
+#[non_exhaustive]
+/// A [`RateLimitKey`] that uses the same key for all requests,
+/// limiting the global rate of requests.
+pub struct GlobalKey;
+
+impl GlobalKey {
+    /// Create a new [`GlobalKey`].
+    pub fn new() -> Self {
+        Self
+    }
+}
+
+impl RateLimitKey for GlobalKey {
+    type Key = ();
+}
+
+impl<State, Request> ExtractRateLimitKey<State, Request> for GlobalKey {
+    fn extract_key(&self, _ctx: &Context<State>, _req: &Request) -> Option<Self::Key> {
+        Some(())
+    }
+}
+
+#[derive(Debug, Clone, Default)]
+#[non_exhaustive]
+/// A [`RateLimitKey`] that uses the IP address of the client as key.
+///
+/// The client IP reported by the [`Forwarded`] information is used if available,
+/// falling back to the peer address found in the [`SocketInfo`].
+pub struct ClientIpKey;
+
+impl ClientIpKey {
+    /// Create a new [`ClientIpKey`].
+    pub fn new() -> Self {
+        Self
+    }
+}
+
+impl RateLimitKey for ClientIpKey {
+    type Key = IpAddr;
+}
+
+impl<State, Request> ExtractRateLimitKey<State, Request> for ClientIpKey {
+    fn extract_key(&self, ctx: &Context<State>, _req: &Request) -> Option<Self::Key> {
+        ctx.get::<Forwarded>()
+            .and_then(Forwarded::client_ip)
+            .or_else(|| ctx.get::<SocketInfo>().map(|info| info.peer_addr().ip()))
+    }
+}
+
+#[derive(Debug, Clone, Default)]
+#[non_exhaustive]
+/// A [`RateLimitKey`] that uses the [`UserId`] of the authenticated user as key,
+/// e.g. the username of a proxy user, as inserted by the [`ProxyAuthLayer`].
+///
+/// [`ProxyAuthLayer`]: crate::http::layer::proxy_auth::ProxyAuthLayer
+pub struct UserIdKey;
+
+impl UserIdKey {
+    /// Create a new [`UserIdKey`].
+    pub fn new() -> Self {
+        Self
+    }
+}
+
+impl RateLimitKey for UserIdKey {
+    type Key = UserId;
+}
+
+impl<State, Request> ExtractRateLimitKey<State, Request> for UserIdKey {
+    fn extract_key(&self, ctx: &Context<State>, _req: &Request) -> Option<Self::Key> {
+        ctx.get::<UserId>().cloned()
+    }
+}
+
+#[derive(Debug, Clone)]
+/// A [`RateLimitKey`] that uses the value of a request header as key.
+pub struct HeaderKey {
+    header_name: HeaderName,
+}
+
+impl HeaderKey {
+    /// Create a new [`HeaderKey`] for the given header.
+    pub fn new(header_name: HeaderName) -> Self {
+        Self { header_name }
+    }
+}
+
+impl RateLimitKey for HeaderKey {
+    type Key = HeaderValue;
+}
+
+impl<State, Body> ExtractRateLimitKey<State, Request<Body>> for HeaderKey {
+    fn extract_key(&self, _ctx: &Context<State>, req: &Request<Body>) -> Option<Self::Key> {
+        req.headers().get(&self.header_name).cloned()
+    }
+}
+
+const KEYED_STORE_SHARDS: usize = 64;
+
+/// A sharded map storing the [`RateAlgorithm`] state per key.
+struct KeyedStore<K, S> {
+    epoch: Instant,
+    shards: Box<[Mutex<LruCache<K, S>>]>,
+    hasher: RandomState,
+}
+
+impl<K, S> fmt::Debug for KeyedStore<K, S> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("KeyedStore")
+            .field("shards", &self.shards.len())
+            .field("max_keys_per_shard", &self.shards[0].lock().capacity())
+            .finish()
+    }
+}
+
+impl<K: Hash + Eq + Clone, S> KeyedStore<K, S> {
+    fn new(max_keys: usize) -> Self {
+        let max_keys_per_shard = max_keys.div_ceil(KEYED_STORE_SHARDS).max(1);
+        Self {
+            epoch: Instant::now(),
+            shards: (0..KEYED_STORE_SHARDS)
+                .map(|_| Mutex::new(LruCache::new(max_keys_per_shard, usize::MAX)))
+                .collect(),
+            hasher: RandomState::new(),
+        }
+    }
+
+    fn check<A>(&self, algorithm: &A, key: K) -> Result<(), Duration>
+    where
+        A: RateAlgorithm<State = S>,
+    {
+        let now = self.epoch.elapsed();
+        let index = self.hasher.hash_one(&key) as usize % self.shards.len();
+        let mut shard = self.shards[index].lock();
+
+        if let Some(state) = shard.get(&key) {
+            return algorithm.check(state, now);
+        }
+
+        // drop expired states starting from the least recently seen key,
+        // each state is dropped at most once, keeping this O(1) amortized
+        while shard
+            .peek_lru()
+            .is_some_and(|(_, state)| algorithm.expires_at(state) <= now)
+        {
+            shard.pop_lru();
+        }
+
+        // in case the shard is still full this evicts the least recently seen key
+        let mut state = algorithm.new_state(now);
+        let result = algorithm.check(&mut state, now);
+        shard.insert(key, state, 0);
+        result
+    }
+
+    #[cfg(test)]
+    fn len(&self) -> usize {
+        self.shards.iter().map(|shard| shard.lock().len()).sum()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn ms(n: u64) -> Duration {
+        Duration::from_millis(n)
+    }
+
+    #[test]
+    fn gcra_rate() {
+        let gcra = Gcra::new(10, Duration::from_secs(1));
+        let mut state = gcra.new_state(ms(0));
+        assert!(gcra.check(&mut state, ms(0)).is_ok());
+        assert_eq!(gcra.check(&mut state, ms(0)), Err(ms(100)));
+        assert_eq!(gcra.check(&mut state, ms(50)), Err(ms(50)));
+        assert!(gcra.check(&mut state, ms(100)).is_ok());
+        assert!(gcra.check(&mut state, ms(1000)).is_ok());
+        assert_eq!(gcra.expires_at(&state), ms(1100));
+    }
+
+    #[test]
+    fn gcra_burst() {
+        let gcra = Gcra::new(10, Duration::from_secs(1)).with_burst(3);
+        let mut state = gcra.new_state(ms(0));
+        for _ in 0..3 {
+            assert!(gcra.check(&mut state, ms(0)).is_ok());
+        }
+        assert_eq!(gcra.check(&mut state, ms(0)), Err(ms(100)));
+        assert!(gcra.check(&mut state, ms(100)).is_ok());
+        assert!(gcra.check(&mut state, ms(150)).is_err());
+    }
+
+    #[test]
+    fn sliding_window() {
+        let window = SlidingWindow::new(2, Duration::from_secs(1));
+        let mut state = window.new_state(ms(0));
+        assert!(window.check(&mut state, ms(0)).is_ok());
+        assert!(window.check(&mut state, ms(500)).is_ok());
+        assert_eq!(window.check(&mut state, ms(750)), Err(ms(250)));
+        // previous window still counts for 75%
+        assert!(window.check(&mut state, ms(1250)).is_err());
+        assert!(window.check(&mut state, ms(1500)).is_ok());
+        // two windows later, nothing of the past remains
+        assert!(window.check(&mut state, ms(3000)).is_ok());
+        assert!(window.check(&mut state, ms(3000)).is_ok());
+        assert!(window.check(&mut state, ms(3000)).is_err());
+    }
+
+    #[test]
+    fn keyed_store_bounded() {
+        let gcra = Gcra::per_second(1);
+        let store = KeyedStore::new(1);
+        for key in 0..(KEYED_STORE_SHARDS * 4) {
+            assert!(store.check(&gcra, key).is_ok());
+        }
+        assert!(store.len() <= KEYED_STORE_SHARDS);
+    }
+
+    #[tokio::test]
+    async fn rate_policy_per_key() {
+        let policy = RatePolicy::new(
+            Gcra::per_minute(1),
+            rate_limit_key_fn(|_: &Context<()>, req: &&'static str| Some(*req)),
+        );
+
+        assert!(matches!(
+            policy.check(Context::default(), "a").await.output,
+            PolicyOutput::Ready(())
+        ));
+        assert!(matches!(
+            policy.check(Context::default(), "b").await.output,
+            PolicyOutput::Ready(())
+        ));
+        match policy.check(Context::default(), "a").await.output {
+            PolicyOutput::Abort(err) => assert!(err.retry_after() > Duration::from_secs(59)),
+            _ => panic!("unexpected output, expected abort"),
+        }
+    }
+
+    #[tokio::test]
+    async fn rate_policy_retry_within_max_wait() {
+        let policy = RatePolicy::new(Gcra::new(1, ms(10)), GlobalKey::new()).with_max_wait(ms(50));
+
+        assert!(matches!(
+            policy.check(Context::default(), ()).await.output,
+            PolicyOutput::Ready(())
+        ));
+        assert!(matches!(
+            policy.check(Context::default(), ()).await.output,
+            PolicyOutput::Retry
+        ));
+        assert!(matches!(
+            policy.check(Context::default(), ()).await.output,
+            PolicyOutput::Ready(())
+        ));
+    }
+
+    #[tokio::test]
+    async fn rate_policy_without_key() {
+        let policy = RatePolicy::new(Gcra::per_minute(1), ClientIpKey::new());
+        for _ in 0..3 {
+            assert!(matches!(
+                policy.check(Context::default(), ()).await.output,
+                PolicyOutput::Ready(())
+            ));
+        }
+    }
+}
@@ -1,32 +1,119 @@
 use crate::{
     dns::Dns,
-    error::{ErrorContext, OpaqueError},
+    error::{ErrorContext, ErrorExt, OpaqueError},
     net::address::{Authority, Domain, Host},
     service::Context,
-    utils::combinators::Either,
 };
 use std::{
+    collections::VecDeque,
+    future::Future,
+    io,
     net::{IpAddr, SocketAddr},
-    sync::{
-        atomic::{AtomicBool, Ordering},
-        Arc,
-    },
+    pin::Pin,
+    task::Poll,
     time::Duration,
 };
 use tokio::{
     net::TcpStream,
-    sync::{
-        mpsc::{channel, Sender},
-        Semaphore,
-    },
+    time::{Instant, Sleep},
 };
 
+#[derive(Debug, Clone)]
+/// Configuration of the "Happy Eyeballs" ([RFC 8305]) connect engine used by [`connect`].
+///
+/// Insert it in the [`Context`] to overwrite the default configuration.
+///
+/// [RFC 8305]: https://datatracker.ietf.org/doc/html/rfc8305
+pub struct TcpConnectConfig {
+    attempt_delay: Duration,
+    resolution_delay: Duration,
+    max_concurrent_attempts: usize,
+}
+
+impl Default for TcpConnectConfig {
+    fn default() -> Self {
+        Self {
+            attempt_delay: Self::DEFAULT_ATTEMPT_DELAY,
+            resolution_delay: Self::DEFAULT_RESOLUTION_DELAY,
+            max_concurrent_attempts: Self::DEFAULT_MAX_CONCURRENT_ATTEMPTS,
+        }
+    }
+}
+
+impl TcpConnectConfig {
+    /// The default delay between two connection attempts,
+    /// as recommended by RFC 8305.
+    pub const DEFAULT_ATTEMPT_DELAY: Duration = Duration::from_millis(250);
+
+    /// The minimum delay between two connection attempts, as required by RFC 8305.
+    pub const MIN_ATTEMPT_DELAY: Duration = Duration::from_millis(10);
+
+    /// The default time to wait for the AAAA records once the A records are resolved,
+    /// as recommended by RFC 8305.
+    pub const DEFAULT_RESOLUTION_DELAY: Duration = Duration::from_millis(50);
+
+    /// The default maximum amount of connection attempts racing at the same time.
+    pub const DEFAULT_MAX_CONCURRENT_ATTEMPTS: usize = 4;
+
+    /// Create a new [`TcpConnectConfig`] with the default settings.
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Set the delay after which the next connection attempt is started,
+    /// while the previous attempt(s) are still pending.
+    ///
+    /// The delay is at least [`Self::MIN_ATTEMPT_DELAY`].
+    pub fn with_attempt_delay(mut self, delay: Duration) -> Self {
+        self.attempt_delay = delay.max(Self::MIN_ATTEMPT_DELAY);
+        self
+    }
+
+    /// Set the time to wait for the AAAA records once the A records are resolved,
+    /// before starting to connect over IPv4.
+    pub fn with_resolution_delay(mut self, delay: Duration) -> Self {
+        self.resolution_delay = delay;
+        self
+    }
+
+    /// Set the maximum amount of connection attempts racing at the same time (minimum 1).
+    pub fn with_max_concurrent_attempts(mut self, max: usize) -> Self {
+        self.max_concurrent_attempts = max.max(1);
+        self
+    }
+}
+
+#[derive(Debug, Clone)]
+#[non_exhaustive]
+/// Metrics of an established TCP connection, as returned by [`connect_with_metrics`].
+///
+/// The [`HttpConnector`] inserts these into the [`Context`].
+///
+/// [`HttpConnector`]: crate::tcp::client::service::HttpConnector
+pub struct TcpConnectMetrics {
+    /// Time it took for the first DNS lookup to return addresses,
+    /// `None` if the authority was already an IP address.
+    pub resolve_duration: Option<Duration>,
+    /// Total time it took to establish the connection, including DNS resolution.
+    pub connect_duration: Duration,
+    /// Amount of connection attempts started.
+    pub attempts: usize,
+    /// Amount of connection attempts that failed before one succeeded.
+    pub failed_attempts: usize,
+}
+
 /// Establish a TCP connection for the given authority.
 ///
 /// In the case where the authority is already an IP address, we can directly connect to it.
-/// Otherwise, we'll try to establish a connection with dual-stack parallel connections,
-/// meaning that we'll try to connect to the domain using both IPv4 and IPv6,
-/// with multiple concurrent connection attempts.
+/// Otherwise, we'll try to establish a connection following the "Happy Eyeballs"
+/// algorithm ([RFC 8305]): both IPv6 and IPv4 addresses are resolved concurrently,
+/// and connection attempts are started in an interleaved order of address families,
+/// staggered by an attempt delay. The first connection to succeed is returned,
+/// and all other pending attempts are cancelled.
+///
+/// The algorithm can be configured by inserting a [`TcpConnectConfig`] in the [`Context`].
+///
+/// [RFC 8305]: https://datatracker.ietf.org/doc/html/rfc8305
 pub async fn connect<State>(
     ctx: &Context<State>,
     authority: Authority,
@@ -34,6 +121,24 @@ pub async fn connect<State>(
 where
     State: Send + Sync + 'static,
 {
+    connect_with_metrics(ctx, authority)
+        .await
+        .map(|(stream, addr, _)| (stream, addr))
+}
+
+/// Establish a TCP connection for the given authority,
+/// returning the [`TcpConnectMetrics`] alongside the connection.
+///
+/// See [`connect`] for more information.
+pub async fn connect_with_metrics<State>(
+    ctx: &Context<State>,
+    authority: Authority,
+) -> Result<(TcpStream, SocketAddr, TcpConnectMetrics), OpaqueError>
+where
+    State: Send + Sync + 'static,
+{
+    let start = Instant::now();
+
     let (host, port) = authority.into_parts();
     let domain = match host {
         Host::Name(domain) => domain,
@@ -43,135 +148,362 @@ where
             let stream = TcpStream::connect(&addr)
                 .await
                 .context("establish tcp client connection")?;
-            return Ok((stream, addr));
+            return Ok((
+                stream,
+                addr,
+                TcpConnectMetrics {
+                    resolve_duration: None,
+                    connect_duration: start.elapsed(),
+                    attempts: 1,
+                    failed_attempts: 0,
+                },
+            ));
+        }
+    };
+
+    let default_config;
+    let config = match ctx.get::<TcpConnectConfig>() {
+        Some(config) => config,
+        None => {
+            default_config = TcpConnectConfig::default();
+            &default_config
         }
     };
 
-    //... otherwise we'll try to establish a connection,
-    // with dual-stack parallel connections...
-
-    let (tx, mut rx) = channel(1);
-
-    let connected = Arc::new(AtomicBool::new(false));
-    let sem = Arc::new(Semaphore::new(3));
-
-    // IPv6
-    let ipv6_tx = tx.clone();
-    let ipv6_domain = domain.clone();
-    let ipv6_dns = ctx.dns().clone();
-    let ipv6_connected = connected.clone();
-    let ipv6_sem = sem.clone();
-    ctx.spawn(tcp_connect(
-        ipv6_dns,
-        IpKind::Ipv6,
-        ipv6_domain,
-        port,
-        ipv6_tx,
-        ipv6_connected,
-        ipv6_sem,
-    ));
-
-    // IPv4
-    let ipv4_tx = tx;
-    let ipv4_domain = domain.clone();
-    let ipv4_dns = ctx.dns().clone();
-    let ipv4_connected = connected.clone();
-    let ipv4_sem = sem;
-    ctx.spawn(tcp_connect(
-        ipv4_dns,
-        IpKind::Ipv4,
-        ipv4_domain,
-        port,
-        ipv4_tx,
-        ipv4_connected,
-        ipv4_sem,
-    ));
-
-    // wait for the first connection to succeed,
-    // ignore the rest of the connections (sorry, but not sorry)
-    if let Some((stream, addr)) = rx.recv().await {
-        connected.store(true, Ordering::SeqCst);
-        return Ok((stream, addr));
-    }
-
-    Err(OpaqueError::from_display(format!(
-        "failed to connect to any resolved IP address for {domain} (port {port})"
-    )))
+    HappyEyeballs::new(ctx.dns().clone(), config, domain, port, start).await
 }
 
+type LookupFuture =
+    Pin<Box<dyn Future<Output = (IpKind, Result<Vec<IpAddr>, OpaqueError>)> + Send>>;
+type AttemptFuture = Pin<Box<dyn Future<Output = (SocketAddr, io::Result<TcpStream>)> + Send>>;
+
 #[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash)]
 enum IpKind {
     Ipv4,
     Ipv6,
 }
 
-async fn tcp_connect(
-    dns: Dns,
-    ip_kind: IpKind,
+/// State of a single "Happy Eyeballs" connect, driven within the calling task.
+///
+/// Dropping it cancels all pending lookups and connection attempts.
+struct HappyEyeballs<'a> {
+    config: &'a TcpConnectConfig,
     domain: Domain,
     port: u16,
-    tx: Sender<(TcpStream, SocketAddr)>,
-    connected: Arc<AtomicBool>,
-    sem: Arc<Semaphore>,
-) {
-    let ip_it = match ip_kind {
-        IpKind::Ipv4 => match dns.ipv4_lookup(domain).await {
-            Ok(it) => Either::A(it.map(IpAddr::V4)),
-            Err(err) => {
-                tracing::trace!(err = %err, "[{ip_kind:?}] failed to resolve domain to IPv4 addresses");
-                return;
-            }
-        },
-        IpKind::Ipv6 => match dns.ipv6_lookup(domain).await {
-            Ok(it) => Either::B(it.map(IpAddr::V6)),
+    start: Instant,
+
+    lookups: Vec<LookupFuture>,
+    ipv6: VecDeque<IpAddr>,
+    ipv4: VecDeque<IpAddr>,
+    next_is_ipv6: bool,
+    resolution_deadline: Option<Instant>,
+    resolve_duration: Option<Duration>,
+
+    attempts: Vec<AttemptFuture>,
+    next_attempt_at: Instant,
+    attempt_count: usize,
+    last_error: Option<OpaqueError>,
+
+    timer: Pin<Box<Sleep>>,
+}
+
+impl<'a> HappyEyeballs<'a> {
+    fn new(
+        dns: Dns,
+        config: &'a TcpConnectConfig,
+        domain: Domain,
+        port: u16,
+        start: Instant,
+    ) -> Self {
+        let ipv6_dns = dns.clone();
+        let ipv6_domain = domain.clone();
+        let ipv6_lookup: LookupFuture = Box::pin(async move {
+            let result = ipv6_dns
+                .ipv6_lookup(ipv6_domain)
+                .await
+                .map(|it| it.map(IpAddr::V6).collect());
+            (IpKind::Ipv6, result)
+        });
+
+        let ipv4_domain = domain.clone();
+        let ipv4_lookup: LookupFuture = Box::pin(async move {
+            let result = dns
+                .ipv4_lookup(ipv4_domain)
+                .await
+                .map(|it| it.map(IpAddr::V4).collect());
+            (IpKind::Ipv4, result)
+        });
+
+        Self {
+            config,
+            domain,
+            port,
+            start,
+            lookups: vec![ipv6_lookup, ipv4_lookup],
+            ipv6: VecDeque::new(),
+            ipv4: VecDeque::new(),
+            next_is_ipv6: true,
+            resolution_deadline: None,
+            resolve_duration: None,
+            attempts: Vec::with_capacity(config.max_concurrent_attempts),
+            next_attempt_at: start,
+            attempt_count: 0,
+            last_error: None,
+            timer: Box::pin(tokio::time::sleep_until(start)),
+        }
+    }
+
+    fn on_lookup(&mut self, kind: IpKind, result: Result<Vec<IpAddr>, OpaqueError>) {
+        let addresses = match result {
+            Ok(addresses) => addresses,
             Err(err) => {
-                tracing::trace!(err = %err, "[{ip_kind:?}] failed to resolve domain to IPv6 addresses");
-                return;
+                tracing::trace!(err = %err, "[{kind:?}] failed to resolve domain {}", self.domain);
+                self.last_error = Some(err);
+                Vec::new()
             }
-        },
-    };
-
-    for (index, ip) in ip_it.enumerate() {
-        let addr = (ip, port).into();
+        };
 
-        let sem = sem.clone();
-        let tx = tx.clone();
-        let connected = connected.clone();
+        if !addresses.is_empty() && self.resolve_duration.is_none() {
+            self.resolve_duration = Some(self.start.elapsed());
+        }
 
-        // back off retries exponentially
-        if index > 0 {
-            let delay = match ip_kind {
-                IpKind::Ipv4 => Duration::from_micros((35 * 2 * index) as u64),
-                IpKind::Ipv6 => Duration::from_micros((21 * 2 * index) as u64),
-            };
-            tokio::time::sleep(delay).await;
+        match kind {
+            IpKind::Ipv6 => {
+                self.ipv6.extend(addresses);
+                // no more reason to wait for the AAAA records
+                self.resolution_deadline = None;
+            }
+            IpKind::Ipv4 => {
+                let ipv6_pending = !self.lookups.is_empty();
+                if ipv6_pending && !addresses.is_empty() {
+                    // give the AAAA records a little time,
+                    // as IPv6 is preferred if available
+                    self.resolution_deadline = Some(Instant::now() + self.config.resolution_delay);
+                }
+                self.ipv4.extend(addresses);
+            }
         }
+    }
+
+    /// Pop the next address to connect to,
+    /// interleaving the address families (preferring IPv6).
+    fn next_address(&mut self) -> Option<IpAddr> {
+        let ip = if self.next_is_ipv6 {
+            self.ipv6.pop_front().or_else(|| self.ipv4.pop_front())
+        } else {
+            self.ipv4.pop_front().or_else(|| self.ipv6.pop_front())
+        }?;
+        self.next_is_ipv6 = ip.is_ipv4();
+        Some(ip)
+    }
 
-        if connected.load(Ordering::SeqCst) {
-            tracing::trace!("[{ip_kind:?}] #{index}: abort connect loop to {addr} (connection already established)");
-            return;
+    /// The instant at which the next attempt can be started,
+    /// in case there are addresses left and there is room for another attempt.
+    fn next_attempt_deadline(&self) -> Option<Instant> {
+        if (self.ipv6.is_empty() && self.ipv4.is_empty())
+            || self.attempts.len() >= self.config.max_concurrent_attempts
+        {
+            return None;
         }
+        Some(match self.resolution_deadline {
+            Some(deadline) => deadline.max(self.next_attempt_at),
+            None => self.next_attempt_at,
+        })
+    }
+
+    fn start_attempt(&mut self, ip: IpAddr, now: Instant) {
+        let addr = SocketAddr::new(ip, self.port);
+        self.attempt_count += 1;
+        tracing::trace!(
+            "[{:?}] #{}: tcp connect attempt to {addr}",
+            if ip.is_ipv6() {
+                IpKind::Ipv6
+            } else {
+                IpKind::Ipv4
+            },
+            self.attempt_count,
+        );
+        self.attempts.push(Box::pin(async move {
+            let result = TcpStream::connect(addr).await;
+            (addr, result)
+        }));
+        self.next_attempt_at = now + self.config.attempt_delay;
+    }
+}
+
+impl<'a> Future for HappyEyeballs<'a> {
+    type Output = Result<(TcpStream, SocketAddr, TcpConnectMetrics), OpaqueError>;
+
+    fn poll(self: Pin<&mut Self>, cx: &mut std::task::Context<'_>) -> Poll<Self::Output> {
+        let this = self.get_mut();
 
-        tokio::spawn(async move {
-            let _permit = sem.acquire().await.unwrap();
-            if connected.load(Ordering::SeqCst) {
-                tracing::trace!("[{ip_kind:?}] #{index}: abort spawned attempt to {addr} (connection already established)");
-                return;
+        loop {
+            let mut index = 0;
+            while index < this.lookups.len() {
+                match this.lookups[index].as_mut().poll(cx) {
+                    Poll::Ready((kind, result)) => {
+                        drop(this.lookups.swap_remove(index));
+                        this.on_lookup(kind, result);
+                    }
+                    Poll::Pending => index += 1,
+                }
             }
 
-            tracing::trace!("[{ip_kind:?}] #{index}: tcp connect attempt to {addr}");
+            let mut index = 0;
+            while index < this.attempts.len() {
+                match this.attempts[index].as_mut().poll(cx) {
+                    Poll::Ready((addr, Ok(stream))) => {
+                        tracing::trace!("tcp connection established to {addr}");
+                        let failed_attempts = this.attempt_count - this.attempts.len();
+                        // dropping the remaining attempts cancels them
+                        this.attempts.clear();
+                        this.lookups.clear();
+                        return Poll::Ready(Ok((
+                            stream,
+                            addr,
+                            TcpConnectMetrics {
+                                resolve_duration: this.resolve_duration,
+                                connect_duration: this.start.elapsed(),
+                                attempts: this.attempt_count,
+                                failed_attempts,
+                            },
+                        )));
+                    }
+                    Poll::Ready((addr, Err(err))) => {
+                        tracing::trace!(err = %err, "tcp connect attempt to {addr} failed");
+                        drop(this.attempts.swap_remove(index));
+                        this.last_error = Some(OpaqueError::from_std(err));
+                        // a failed attempt allows the next one to start immediately
+                        this.next_attempt_at = Instant::now();
+                    }
+                    Poll::Pending => index += 1,
+                }
+            }
 
-            match TcpStream::connect(&addr).await {
-                Ok(stream) => {
-                    tracing::trace!("[{ip_kind:?}] #{index}: tcp connection stablished to {addr}");
-                    if let Err(err) = tx.send((stream, addr)).await {
-                        tracing::trace!(err = %err, "[{ip_kind:?}] #{index}: failed to send resolved IP address");
+            let now = Instant::now();
+            match this.next_attempt_deadline() {
+                Some(deadline) if deadline <= now => {
+                    if let Some(ip) = this.next_address() {
+                        this.start_attempt(ip, now);
+                        // poll the new attempt and re-evaluate the state
+                        continue;
                     }
                 }
-                Err(err) => {
-                    tracing::trace!(err = %err, "[{ip_kind:?}] #{index}: tcp connector failed to connect");
+                Some(deadline) => {
+                    this.timer.as_mut().reset(deadline);
+                    if this.timer.as_mut().poll(cx).is_ready() {
+                        continue;
+                    }
                 }
-            };
-        });
+                None => (),
+            }
+
+            if this.lookups.is_empty()
+                && this.attempts.is_empty()
+                && this.ipv6.is_empty()
+                && this.ipv4.is_empty()
+            {
+                let err = OpaqueError::from_display(format!(
+                    "failed to connect to any resolved IP address for {} (port {})",
+                    this.domain, this.port
+                ));
+                return Poll::Ready(Err(match this.last_error.take() {
+                    Some(last_error) => last_error.context(err.to_string()),
+                    None => err,
+                }));
+            }
+
+            return Poll::Pending;
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::net::{Ipv4Addr, Ipv6Addr};
+
+    fn happy_eyeballs(config: &TcpConnectConfig) -> HappyEyeballs<'_> {
+        let mut he = HappyEyeballs::new(
+            Dns::default(),
+            config,
+            Domain::example(),
+            80,
+            Instant::now(),
+        );
+        he.lookups.clear();
+        he
+    }
+
+    #[tokio::test]
+    async fn test_interleave_address_families() {
+        let config = TcpConnectConfig::default();
+        let mut he = happy_eyeballs(&config);
+
+        he.ipv6.extend([
+            IpAddr::V6(Ipv6Addr::LOCALHOST),
+            IpAddr::V6(Ipv6Addr::UNSPECIFIED),
+        ]);
+        he.ipv4.extend([
+            IpAddr::V4(Ipv4Addr::LOCALHOST),
+            IpAddr::V4(Ipv4Addr::UNSPECIFIED),
+            IpAddr::V4(Ipv4Addr::BROADCAST),
+        ]);
+
+        let order: Vec<_> = std::iter::from_fn(|| he.next_address())
+            .map(|ip| ip.is_ipv6())
+            .collect();
+        assert_eq!(order, vec![true, false, true, false, false]);
+    }
+
+    #[tokio::test]
+    async fn test_resolution_delay_when_ipv4_first() {
+        let config = TcpConnectConfig::default();
+        let mut he = happy_eyeballs(&config);
+
+        // pretend the AAAA lookup is still pending
+        he.lookups.push(Box::pin(std::future::pending::<(
+            IpKind,
+            Result<Vec<IpAddr>, OpaqueError>,
+        )>()));
+        he.on_lookup(IpKind::Ipv4, Ok(vec![IpAddr::V4(Ipv4Addr::LOCALHOST)]));
+        let deadline = he.next_attempt_deadline().unwrap();
+        assert!(deadline > Instant::now());
+
+        he.lookups.clear();
+        he.on_lookup(IpKind::Ipv6, Ok(vec![IpAddr::V6(Ipv6Addr::LOCALHOST)]));
+        assert!(he.resolution_deadline.is_none());
+        assert_eq!(he.next_address(), Some(IpAddr::V6(Ipv6Addr::LOCALHOST)));
+    }
+
+    #[test]
+    fn test_config_bounds() {
+        let config = TcpConnectConfig::new()
+            .with_attempt_delay(Duration::ZERO)
+            .with_max_concurrent_attempts(0);
+        assert_eq!(config.attempt_delay, TcpConnectConfig::MIN_ATTEMPT_DELAY);
+        assert_eq!(config.max_concurrent_attempts, 1);
+    }
+
+    #[tokio::test]
+    async fn test_connect_loopback() {
+        let listener = tokio::net::TcpListener::bind("127.0.0.1:0").await.unwrap();
+        let port = listener.local_addr().unwrap().port();
+
+        let mut ctx = Context::default();
+        ctx.dns_mut().insert_overwrite(
+            Domain::from_static("happy.eyeballs"),
+            vec![IpAddr::V4(Ipv4Addr::LOCALHOST)],
+        );
+
+        let (_, addr, metrics) = connect_with_metrics(
+            &ctx,
+            Authority::new(Domain::from_static("happy.eyeballs").into_host(), port),
+        )
+        .await
+        .unwrap();
+        assert_eq!(addr, SocketAddr::new(IpAddr::V4(Ipv4Addr::LOCALHOST), port));
+        assert_eq!(metrics.attempts, 1);
+        assert_eq!(metrics.failed_attempts, 0);
     }
 }
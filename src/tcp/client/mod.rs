@@ -4,4 +4,4 @@ pub mod service;
 
 mod connect;
 #[doc(inline)]
-pub use connect::connect;
+pub use connect::{connect, connect_with_metrics, TcpConnectConfig, TcpConnectMetrics};
@@ -14,6 +14,9 @@ use tokio::net::TcpStream;
 #[non_exhaustive]
 /// A connector which can be used to establish a TCP connection to a server.
 ///
+/// The [`TcpConnectMetrics`] of the established connection are inserted in the [`Context`].
+///
+/// [`TcpConnectMetrics`]: crate::tcp::client::TcpConnectMetrics
 /// [`Request`]: crate::http::Request
 /// [`Uri`]: crate::http::Uri
 /// [`Context`]: crate::service::Context
@@ -49,9 +52,11 @@ where
         req: Request<Body>,
     ) -> Result<Self::Response, Self::Error> {
         if let Some(proxy) = ctx.get::<ProxyAddress>() {
-            let (stream, addr) = tcp::client::connect(&ctx, proxy.authority().clone())
-                .await
-                .context("tcp connector: conncept to proxy")?;
+            let (stream, addr, metrics) =
+                tcp::client::connect_with_metrics(&ctx, proxy.authority().clone())
+                    .await
+                    .context("tcp connector: conncept to proxy")?;
+            ctx.insert(metrics);
             return Ok(EstablishedClientConnection {
                 ctx,
                 req,
@@ -62,9 +67,10 @@ where
         let request_info = get_request_context!(ctx, req);
         match request_info.authority.clone() {
             Some(authority) => {
-                let (stream, addr) = tcp::client::connect(&ctx, authority)
+                let (stream, addr, metrics) = tcp::client::connect_with_metrics(&ctx, authority)
                     .await
                     .context("tcp connector: connect to server")?;
+                ctx.insert(metrics);
                 Ok(EstablishedClientConnection {
                     ctx,
                     req,
@@ -1,6 +1,9 @@
-use std::net::SocketAddr;
+use std::{io, net::SocketAddr};
 
-use tokio::net::TcpStream;
+use tokio::{
+    io::{AsyncRead, AsyncWrite},
+    net::TcpStream,
+};
 
 use crate::{
     net::stream::Stream,
@@ -35,12 +38,23 @@ enum ForwarderKind {
 }
 
 /// A TCP forwarder.
+///
+/// Bytes are relayed in both directions using a buffer per direction,
+/// of [`Forwarder::DEFAULT_BUFFER_SIZE`] bytes unless configured otherwise
+/// using [`Forwarder::with_buffer_size`].
 #[derive(Debug, Clone)]
 pub struct Forwarder {
     kind: ForwarderKind,
+    buffer_size: usize,
 }
 
 impl Forwarder {
+    /// The default size of the buffer used to relay bytes in a single direction.
+    ///
+    /// Equal to the maximum size of a TLS record,
+    /// such that a typical tunneled record is relayed in a single read and write.
+    pub const DEFAULT_BUFFER_SIZE: usize = 16 * 1024;
+
     /// Create a new [`Forwarder::dynamic`] forwarder.
     pub fn new() -> Self {
         Self::dynamic()
@@ -50,6 +64,7 @@ impl Forwarder {
     pub fn target(target: SocketAddr) -> Self {
         Self {
             kind: ForwarderKind::Static(target),
+            buffer_size: Self::DEFAULT_BUFFER_SIZE,
         }
     }
 
@@ -61,8 +76,19 @@ impl Forwarder {
     pub fn dynamic() -> Self {
         Self {
             kind: ForwarderKind::Dynamic,
+            buffer_size: Self::DEFAULT_BUFFER_SIZE,
         }
     }
+
+    /// Set the size of the buffer used to relay bytes in a single direction.
+    ///
+    /// Larger buffers reduce the amount of reads and writes
+    /// for long-lived bulk tunnels, at the cost of memory per connection.
+    /// The size is at least a single byte.
+    pub fn with_buffer_size(mut self, size: usize) -> Self {
+        self.buffer_size = size.max(1);
+        self
+    }
 }
 
 impl Default for Forwarder {
@@ -88,7 +114,7 @@ where
             }
         };
 
-        match tokio::io::copy_bidirectional(&mut source, &mut target).await {
+        match forward_bidirectional(&mut source, &mut target, self.buffer_size).await {
             Ok(_) => Ok(()),
             Err(err) => {
                 if is_connection_error(&err) {
@@ -100,3 +126,58 @@ where
         }
     }
 }
+
+/// Relay bytes in both directions between `a` and `b`,
+/// until both sides are shut down or an error occurs.
+///
+/// A buffer of `buffer_size` bytes is used for each direction,
+/// see [`Forwarder::DEFAULT_BUFFER_SIZE`] for a sensible default.
+/// Returns the amount of bytes copied from `a` to `b` and from `b` to `a`.
+///
+/// This can be used for any pair of streams,
+/// e.g. to relay an upgraded http `CONNECT` request to its target.
+pub async fn forward_bidirectional<A, B>(
+    a: &mut A,
+    b: &mut B,
+    buffer_size: usize,
+) -> io::Result<(u64, u64)>
+where
+    A: AsyncRead + AsyncWrite + Unpin + ?Sized,
+    B: AsyncRead + AsyncWrite + Unpin + ?Sized,
+{
+    let buffer_size = buffer_size.max(1);
+    tokio::io::copy_bidirectional_with_sizes(a, b, buffer_size, buffer_size).await
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tokio::io::{AsyncReadExt, AsyncWriteExt};
+
+    #[tokio::test]
+    async fn test_forward_bidirectional_small_buffer() {
+        let (mut client, mut a) = tokio::io::duplex(1024);
+        let (mut b, mut server) = tokio::io::duplex(1024);
+
+        let forward = tokio::spawn(async move { forward_bidirectional(&mut a, &mut b, 3).await });
+
+        let payload = b"hello from the other side".repeat(16);
+        client.write_all(&payload).await.unwrap();
+        client.shutdown().await.unwrap();
+
+        let mut received = Vec::new();
+        server.read_to_end(&mut received).await.unwrap();
+        assert_eq!(received, payload);
+
+        server.write_all(b"bye").await.unwrap();
+        server.shutdown().await.unwrap();
+
+        let mut received = Vec::new();
+        client.read_to_end(&mut received).await.unwrap();
+        assert_eq!(received, b"bye");
+
+        let (a_to_b, b_to_a) = forward.await.unwrap().unwrap();
+        assert_eq!(a_to_b, payload.len() as u64);
+        assert_eq!(b_to_a, 3);
+    }
+}
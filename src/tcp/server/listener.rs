@@ -8,22 +8,24 @@ use std::future::Future;
 use std::pin::pin;
 use std::sync::Arc;
 use std::{io, net::SocketAddr};
-use tokio::net::{TcpListener as TokioTcpListener, TcpStream, ToSocketAddrs};
+use tokio::net::{TcpListener as TokioTcpListener, TcpSocket, TcpStream, ToSocketAddrs};
+use tokio::task::JoinHandle;
 
 /// Builder for `TcpListener`.
 #[derive(Debug)]
 pub struct TcpListenerBuilder<S> {
     ttl: Option<u32>,
+    backlog: Option<u32>,
+    nodelay: Option<bool>,
+    keepalive: Option<bool>,
+    acceptors: usize,
     state: Arc<S>,
 }
 
 impl TcpListenerBuilder<()> {
     /// Create a new `TcpListenerBuilder` without a state.
     pub fn new() -> Self {
-        Self {
-            ttl: None,
-            state: Arc::new(()),
-        }
+        Self::with_state(())
     }
 }
 
@@ -37,12 +39,19 @@ impl<S> Clone for TcpListenerBuilder<S> {
     fn clone(&self) -> Self {
         Self {
             ttl: self.ttl,
+            backlog: self.backlog,
+            nodelay: self.nodelay,
+            keepalive: self.keepalive,
+            acceptors: self.acceptors,
             state: self.state.clone(),
         }
     }
 }
 
 impl<S> TcpListenerBuilder<S> {
+    /// The maximum number of pending connections used when no backlog is set.
+    pub const DEFAULT_BACKLOG: u32 = 1024;
+
     /// Sets the value for the `IP_TTL` option on this socket.
     ///
     /// This value sets the time-to-live field that is used in every packet sent
@@ -51,6 +60,45 @@ impl<S> TcpListenerBuilder<S> {
         self.ttl = Some(ttl);
         self
     }
+
+    /// Sets the maximum number of pending connections
+    /// that the OS queues for this listener.
+    ///
+    /// Defaults to [`Self::DEFAULT_BACKLOG`].
+    pub fn backlog(&mut self, backlog: u32) -> &mut Self {
+        self.backlog = Some(backlog);
+        self
+    }
+
+    /// Sets the value of the `TCP_NODELAY` option on this socket,
+    /// which is inherited by the accepted connections.
+    ///
+    /// Setting it on the listener saves a syscall for every accepted connection.
+    pub fn nodelay(&mut self, nodelay: bool) -> &mut Self {
+        self.nodelay = Some(nodelay);
+        self
+    }
+
+    /// Sets the value of the `SO_KEEPALIVE` option on this socket,
+    /// which is inherited by the accepted connections.
+    pub fn keepalive(&mut self, keepalive: bool) -> &mut Self {
+        self.keepalive = Some(keepalive);
+        self
+    }
+
+    #[cfg(all(unix, not(any(target_os = "solaris", target_os = "illumos"))))]
+    /// Bind the given amount of sockets to the same address using `SO_REUSEPORT`,
+    /// each with their own accept loop, spawned as a task of its own.
+    ///
+    /// This lets the OS balance incoming connections over the sockets,
+    /// such that accepting connections is no longer bound to a single task.
+    /// A good default is the amount of worker threads of the runtime.
+    ///
+    /// An amount of `0` or `1` disables this mode, which is the default.
+    pub fn reuse_port(&mut self, acceptors: usize) -> &mut Self {
+        self.acceptors = acceptors.max(1);
+        self
+    }
 }
 
 impl<S> TcpListenerBuilder<S>
@@ -61,6 +109,10 @@ where
     pub fn with_state(state: S) -> Self {
         Self {
             ttl: None,
+            backlog: None,
+            nodelay: None,
+            keepalive: None,
+            acceptors: 1,
             state: Arc::new(state),
         }
     }
@@ -73,17 +125,73 @@ where
     /// to this listener. The port allocated can be queried via the `local_addr`
     /// method.
     pub async fn bind<A: ToSocketAddrs>(&self, addr: A) -> io::Result<TcpListener<S>> {
-        let inner = TokioTcpListener::bind(addr).await?;
+        let mut last_err = None;
 
-        if let Some(ttl) = self.ttl {
-            inner.set_ttl(ttl)?;
+        for addr in tokio::net::lookup_host(addr).await? {
+            match self.bind_addr(addr) {
+                Ok(listener) => return Ok(listener),
+                Err(err) => last_err = Some(err),
+            }
         }
 
+        Err(last_err.unwrap_or_else(|| {
+            io::Error::new(
+                io::ErrorKind::InvalidInput,
+                "could not resolve to any address",
+            )
+        }))
+    }
+
+    fn bind_addr(&self, addr: SocketAddr) -> io::Result<TcpListener<S>> {
+        let inner = self.bind_socket(addr)?;
+
+        // bind the other sockets to the same address as the first one,
+        // such that they share the port in case the OS assigned one
+        let addr = inner.local_addr()?;
+        let siblings = (1..self.acceptors)
+            .map(|_| self.bind_socket(addr))
+            .collect::<io::Result<_>>()?;
+
         Ok(TcpListener {
             inner,
+            siblings,
             state: self.state.clone(),
         })
     }
+
+    fn bind_socket(&self, addr: SocketAddr) -> io::Result<TokioTcpListener> {
+        let socket = if addr.is_ipv4() {
+            TcpSocket::new_v4()?
+        } else {
+            TcpSocket::new_v6()?
+        };
+
+        // same as the std (and thus tokio) listener,
+        // on windows this would allow to steal the address of another socket
+        #[cfg(not(windows))]
+        socket.set_reuseaddr(true)?;
+
+        #[cfg(all(unix, not(any(target_os = "solaris", target_os = "illumos"))))]
+        if self.acceptors > 1 {
+            socket.set_reuseport(true)?;
+        }
+
+        if let Some(nodelay) = self.nodelay {
+            socket.set_nodelay(nodelay)?;
+        }
+        if let Some(keepalive) = self.keepalive {
+            socket.set_keepalive(keepalive)?;
+        }
+
+        socket.bind(addr)?;
+        let listener = socket.listen(self.backlog.unwrap_or(Self::DEFAULT_BACKLOG))?;
+
+        if let Some(ttl) = self.ttl {
+            listener.set_ttl(ttl)?;
+        }
+
+        Ok(listener)
+    }
 }
 
 /// A TCP socket server, listening for incoming connections once served
@@ -91,6 +199,8 @@ where
 #[derive(Debug)]
 pub struct TcpListener<S> {
     inner: TokioTcpListener,
+    /// sockets bound to the same address using `SO_REUSEPORT`
+    siblings: Vec<TokioTcpListener>,
     state: Arc<S>,
 }
 
@@ -140,6 +250,12 @@ impl<S> TcpListener<S> {
         self.inner.ttl()
     }
 
+    /// Returns the amount of sockets accepting connections for this listener,
+    /// which is only more than one when bound using [`TcpListenerBuilder::reuse_port`].
+    pub fn acceptors(&self) -> usize {
+        self.siblings.len() + 1
+    }
+
     /// Gets a reference to the listener's state.
     pub fn state(&self) -> &S {
         &self.state
@@ -154,6 +270,10 @@ where
     ///
     /// This method will block the current listener for each incoming connection,
     /// the underlying service can choose to spawn a task to handle the accepted stream.
+    ///
+    /// In case the listener was bound using [`TcpListenerBuilder::reuse_port`],
+    /// the other sockets are each served by an accept loop in a task of their own,
+    /// which are aborted when the future returned by this method is dropped.
     pub async fn serve<S>(self, service: S)
     where
         S: Service<State, TcpStream>,
@@ -161,25 +281,13 @@ where
         let ctx = Context::new(self.state, Executor::new());
         let service = Arc::new(service);
 
-        loop {
-            let (socket, peer_addr) = match self.inner.accept().await {
-                Ok(stream) => stream,
-                Err(err) => {
-                    handle_accept_err(err).await;
-                    continue;
-                }
-            };
-
-            let service = service.clone();
-            let mut ctx = ctx.clone();
-
-            tokio::spawn(async move {
-                let local_addr = socket.local_addr().ok();
-                ctx.insert(SocketInfo::new(local_addr, peer_addr));
-
-                let _ = service.serve(ctx, socket).await;
-            });
-        }
+        let _siblings = AbortOnDrop(
+            self.siblings
+                .into_iter()
+                .map(|listener| tokio::spawn(accept_loop(listener, ctx.clone(), service.clone())))
+                .collect(),
+        );
+        accept_loop(self.inner, ctx, service).await
     }
 
     /// Serve connections from this listener with the given service function.
@@ -208,34 +316,16 @@ where
     {
         let ctx: Context<State> = Context::new(self.state, Executor::graceful(guard.clone()));
         let service = Arc::new(service);
-        let mut cancelled_fut = pin!(guard.cancelled());
 
-        loop {
-            tokio::select! {
-                _ = cancelled_fut.as_mut() => {
-                    tracing::trace!("signal received: initiate graceful shutdown");
-                    break;
-                }
-                result = self.inner.accept() => {
-                    match result {
-                        Ok((socket, peer_addr)) => {
-                            let service = service.clone();
-                            let mut ctx = ctx.clone();
-
-                            guard.spawn_task(async move {
-                                let local_addr = socket.local_addr().ok();
-                                ctx.insert(SocketInfo::new(local_addr, peer_addr));
-
-                                let _ = service.serve(ctx, socket).await;
-                            });
-                        }
-                        Err(err) => {
-                            handle_accept_err(err).await;
-                        }
-                    }
-                }
-            }
+        for listener in self.siblings {
+            guard.spawn_task(accept_loop_graceful(
+                listener,
+                guard.clone(),
+                ctx.clone(),
+                service.clone(),
+            ));
         }
+        accept_loop_graceful(self.inner, guard, ctx, service).await
     }
 
     /// Serve gracefully connections from this listener with the given service function.
@@ -254,6 +344,98 @@ where
     }
 }
 
+/// Aborts the (sibling accept loop) tasks when dropped,
+/// such that they do not outlive the future serving the listener.
+struct AbortOnDrop(Vec<JoinHandle<()>>);
+
+impl Drop for AbortOnDrop {
+    fn drop(&mut self) {
+        for handle in &self.0 {
+            handle.abort();
+        }
+    }
+}
+
+/// The local address to use for the [`SocketInfo`] of accepted connections,
+/// such that it does not have to be looked up for each connection.
+///
+/// Only known upfront if the listener is bound to a specific IP,
+/// as for an unspecified IP it depends on the interface the connection came in on.
+fn known_local_addr(listener: &TokioTcpListener) -> Option<SocketAddr> {
+    listener
+        .local_addr()
+        .ok()
+        .filter(|addr| !addr.ip().is_unspecified())
+}
+
+async fn accept_loop<State, S>(listener: TokioTcpListener, ctx: Context<State>, service: Arc<S>)
+where
+    State: Send + Sync + 'static,
+    S: Service<State, TcpStream>,
+{
+    let known_local_addr = known_local_addr(&listener);
+
+    loop {
+        let (socket, peer_addr) = match listener.accept().await {
+            Ok(stream) => stream,
+            Err(err) => {
+                handle_accept_err(err).await;
+                continue;
+            }
+        };
+
+        let service = service.clone();
+        let mut ctx = ctx.clone();
+
+        tokio::spawn(async move {
+            let local_addr = known_local_addr.or_else(|| socket.local_addr().ok());
+            ctx.insert(SocketInfo::new(local_addr, peer_addr));
+
+            let _ = service.serve(ctx, socket).await;
+        });
+    }
+}
+
+async fn accept_loop_graceful<State, S>(
+    listener: TokioTcpListener,
+    guard: ShutdownGuard,
+    ctx: Context<State>,
+    service: Arc<S>,
+) where
+    State: Send + Sync + 'static,
+    S: Service<State, TcpStream>,
+{
+    let known_local_addr = known_local_addr(&listener);
+    let mut cancelled_fut = pin!(guard.cancelled());
+
+    loop {
+        tokio::select! {
+            _ = cancelled_fut.as_mut() => {
+                tracing::trace!("signal received: initiate graceful shutdown");
+                break;
+            }
+            result = listener.accept() => {
+                match result {
+                    Ok((socket, peer_addr)) => {
+                        let service = service.clone();
+                        let mut ctx = ctx.clone();
+
+                        guard.spawn_task(async move {
+                            let local_addr = known_local_addr.or_else(|| socket.local_addr().ok());
+                            ctx.insert(SocketInfo::new(local_addr, peer_addr));
+
+                            let _ = service.serve(ctx, socket).await;
+                        });
+                    }
+                    Err(err) => {
+                        handle_accept_err(err).await;
+                    }
+                }
+            }
+        }
+    }
+}
+
 async fn handle_accept_err(err: io::Error) {
     if crate::tcp::utils::is_connection_error(&err) {
         tracing::trace!(
@@ -276,3 +458,86 @@ async fn handle_accept_err(err: io::Error) {
         tokio::time::sleep(std::time::Duration::from_secs(1)).await;
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::service::service_fn;
+    use std::convert::Infallible;
+    use tokio::{io::AsyncWriteExt, sync::mpsc};
+
+    #[tokio::test]
+    async fn test_listener_socket_info() {
+        let listener = TcpListener::build()
+            .nodelay(true)
+            .backlog(16)
+            .bind("127.0.0.1:0")
+            .await
+            .unwrap();
+        let addr = listener.local_addr().unwrap();
+        assert_eq!(listener.acceptors(), 1);
+
+        let (tx, mut rx) = mpsc::unbounded_channel();
+        tokio::spawn(
+            listener.serve(service_fn(move |ctx: Context<()>, stream: TcpStream| {
+                let tx = tx.clone();
+                async move {
+                    let info = ctx.get::<SocketInfo>().unwrap();
+                    tx.send((*info.local_addr().unwrap(), stream.nodelay().unwrap()))
+                        .unwrap();
+                    Ok::<_, Infallible>(())
+                }
+            })),
+        );
+
+        let mut stream = TcpStream::connect(addr).await.unwrap();
+        stream.shutdown().await.unwrap();
+        assert_eq!(rx.recv().await.unwrap(), (addr, true));
+    }
+
+    #[cfg(all(unix, not(any(target_os = "solaris", target_os = "illumos"))))]
+    #[tokio::test]
+    async fn test_listener_reuse_port() {
+        let listener = TcpListener::build()
+            .reuse_port(4)
+            .bind("127.0.0.1:0")
+            .await
+            .unwrap();
+        let addr = listener.local_addr().unwrap();
+        assert_eq!(listener.acceptors(), 4);
+
+        let (tx, mut rx) = mpsc::unbounded_channel();
+        let server = tokio::spawn(listener.serve(service_fn(
+            move |ctx: Context<()>, _stream: TcpStream| {
+                let tx = tx.clone();
+                async move {
+                    let info = ctx.get::<SocketInfo>().unwrap();
+                    tx.send(*info.local_addr().unwrap()).unwrap();
+                    Ok::<_, Infallible>(())
+                }
+            },
+        )));
+
+        for _ in 0..16 {
+            let _stream = TcpStream::connect(addr).await.unwrap();
+            assert_eq!(rx.recv().await.unwrap(), addr);
+        }
+
+        // dropping the serve future also stops the sibling accept loops,
+        // closing all sockets bound to the port
+        server.abort();
+        let _ = server.await;
+        let mut refused = false;
+        for _ in 0..100 {
+            if TcpStream::connect(addr).await.is_err() {
+                refused = true;
+                break;
+            }
+            tokio::time::sleep(std::time::Duration::from_millis(10)).await;
+        }
+        assert!(
+            refused,
+            "port still accepting connections after serve was dropped"
+        );
+    }
+}
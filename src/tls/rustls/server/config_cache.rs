@@ -0,0 +1,227 @@
+use super::{IncomingClientHello, ServerConfigProvider, TlsSessionResumption};
+use crate::tls::rustls::dep::rustls::ServerConfig;
+use crate::utils::lru::LruCache;
+use parking_lot::Mutex;
+use std::{fmt, sync::Arc};
+
+/// A [`ServerConfigProvider`] which caches the [`ServerConfig`]
+/// provided by the inner [`ServerConfigProvider`] per server name (SNI).
+///
+/// This avoids having to create a new [`ServerConfig`]
+/// (e.g. generating a certificate on the fly for a MITM proxy)
+/// for each handshake of a client connecting to a server name seen before.
+/// Together with [`Self::with_session_resumption`] it also allows these clients
+/// to resume their session, as rustls only resumes sessions
+/// known to the [`ServerConfig`] used for the handshake.
+///
+/// The cache holds at most [`Self::with_capacity`] server names,
+/// evicting the least recently used one to make room for a new one.
+///
+/// The inner provider is expected to only use the server name
+/// of the [`IncomingClientHello`] to decide which [`ServerConfig`] to provide,
+/// as the other properties of the client hello are not part of the cache key.
+///
+/// # Example
+///
+/// ```
+/// use rama::tls::rustls::server::{
+///     IncomingClientHello, ServerConfigCache, TlsClientConfigHandler, TlsSessionResumption,
+/// };
+///
+/// let resumption = TlsSessionResumption::new().unwrap();
+///
+/// let handler = TlsClientConfigHandler::default().server_config_provider(
+///     ServerConfigCache::new(|client_hello: IncomingClientHello| async move {
+///         // e.g. generate a certificate for the server name of the client hello
+///         let _ = client_hello.server_name;
+///         Ok::<_, std::io::Error>(None)
+///     })
+///     .with_capacity(4096)
+///     .with_session_resumption(resumption),
+/// );
+/// # let _ = handler;
+/// ```
+pub struct ServerConfigCache<P> {
+    provider: P,
+    resumption: Option<TlsSessionResumption>,
+    configs: Mutex<LruCache<Option<String>, Option<Arc<ServerConfig>>>>,
+}
+
+impl<P> ServerConfigCache<P> {
+    /// The default amount of server names cached.
+    pub const DEFAULT_CAPACITY: usize = 1024;
+
+    /// Create a new [`ServerConfigCache`] for the given [`ServerConfigProvider`].
+    pub fn new(provider: P) -> Self {
+        Self {
+            provider,
+            resumption: None,
+            configs: Mutex::new(LruCache::new(Self::DEFAULT_CAPACITY, usize::MAX)),
+        }
+    }
+
+    /// Set the maximum amount of server names cached.
+    pub fn with_capacity(mut self, capacity: usize) -> Self {
+        self.configs.get_mut().set_capacity(capacity.max(1));
+        self
+    }
+
+    /// Configure the provided [`ServerConfig`]s to use the given [`TlsSessionResumption`],
+    /// such that sessions can be resumed across the configs of all server names.
+    ///
+    /// The [`ServerConfig`] is only cloned and modified once,
+    /// when it is inserted into the cache.
+    pub fn with_session_resumption(mut self, resumption: TlsSessionResumption) -> Self {
+        self.resumption = Some(resumption);
+        self
+    }
+
+    /// Returns the amount of server names which are currently cached.
+    pub fn len(&self) -> usize {
+        self.configs.lock().len()
+    }
+
+    /// Returns `true` if no server names are currently cached.
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Remove all cached server configs,
+    /// e.g. because the certificates used by the inner provider were rotated.
+    pub fn clear(&self) {
+        self.configs.lock().clear();
+    }
+
+    fn get(&self, server_name: &Option<String>) -> Option<Option<Arc<ServerConfig>>> {
+        self.configs.lock().get(server_name).cloned()
+    }
+
+    fn insert(&self, server_name: Option<String>, config: Option<Arc<ServerConfig>>) {
+        self.configs.lock().insert(server_name, config, 0);
+    }
+}
+
+impl<P: fmt::Debug> fmt::Debug for ServerConfigCache<P> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("ServerConfigCache")
+            .field("provider", &self.provider)
+            .field("resumption", &self.resumption)
+            .field("configs", &*self.configs.lock())
+            .finish()
+    }
+}
+
+impl<P> ServerConfigProvider for ServerConfigCache<P>
+where
+    P: ServerConfigProvider,
+{
+    async fn get_server_config(
+        &self,
+        client_hello: IncomingClientHello,
+    ) -> Result<Option<Arc<ServerConfig>>, std::io::Error> {
+        let server_name = client_hello.server_name.clone();
+        if let Some(config) = self.get(&server_name) {
+            return Ok(config);
+        }
+
+        let config = self
+            .provider
+            .get_server_config(client_hello)
+            .await?
+            .map(|config| match &self.resumption {
+                Some(resumption) => {
+                    let mut config =
+                        Arc::try_unwrap(config).unwrap_or_else(|config| (*config).clone());
+                    resumption.apply(&mut config);
+                    Arc::new(config)
+                }
+                None => config,
+            });
+
+        self.insert(server_name, config.clone());
+        Ok(config)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::tls::rustls::dep::rustls::server::ResolvesServerCertUsingSni;
+    use std::sync::atomic::{AtomicUsize, Ordering};
+
+    fn client_hello(server_name: Option<&str>) -> IncomingClientHello {
+        IncomingClientHello {
+            server_name: server_name.map(ToOwned::to_owned),
+            signature_schemes: Vec::new(),
+            alpn: None,
+            cipher_suites: Vec::new(),
+        }
+    }
+
+    #[tokio::test]
+    async fn test_server_config_cache() {
+        let calls = Arc::new(AtomicUsize::new(0));
+        let provider_calls = calls.clone();
+        let cache = ServerConfigCache::new(move |client_hello: IncomingClientHello| {
+            provider_calls.fetch_add(1, Ordering::SeqCst);
+            async move {
+                Ok::<_, std::io::Error>(client_hello.server_name.map(|_| {
+                    Arc::new(
+                        ServerConfig::builder()
+                            .with_no_client_auth()
+                            .with_cert_resolver(Arc::new(ResolvesServerCertUsingSni::new())),
+                    )
+                }))
+            }
+        })
+        .with_capacity(2)
+        .with_session_resumption(TlsSessionResumption::new().unwrap());
+
+        let a = cache
+            .get_server_config(client_hello(Some("a.example")))
+            .await
+            .unwrap()
+            .unwrap();
+        assert!(a.ticketer.enabled());
+        let a2 = cache
+            .get_server_config(client_hello(Some("a.example")))
+            .await
+            .unwrap()
+            .unwrap();
+        assert!(Arc::ptr_eq(&a, &a2));
+        assert_eq!(calls.load(Ordering::SeqCst), 1);
+
+        assert!(cache
+            .get_server_config(client_hello(None))
+            .await
+            .unwrap()
+            .is_none());
+        assert!(cache
+            .get_server_config(client_hello(None))
+            .await
+            .unwrap()
+            .is_none());
+        assert_eq!(calls.load(Ordering::SeqCst), 2);
+        assert_eq!(cache.len(), 2);
+
+        // use a, such that the no-SNI entry is the least recently used one
+        cache
+            .get_server_config(client_hello(Some("a.example")))
+            .await
+            .unwrap();
+        cache
+            .get_server_config(client_hello(Some("b.example")))
+            .await
+            .unwrap();
+        assert_eq!(calls.load(Ordering::SeqCst), 3);
+        assert_eq!(cache.len(), 2);
+
+        cache
+            .get_server_config(client_hello(Some("a.example")))
+            .await
+            .unwrap();
+        assert_eq!(calls.load(Ordering::SeqCst), 3);
+        cache.get_server_config(client_hello(None)).await.unwrap();
+        assert_eq!(calls.load(Ordering::SeqCst), 4);
+    }
+}
@@ -1,4 +1,4 @@
-use super::{TlsAcceptorService, TlsClientConfigHandler};
+use super::{TlsAcceptorService, TlsClientConfigHandler, TlsSessionResumption};
 use crate::{service::Layer, tls::rustls::dep::rustls::ServerConfig};
 use std::sync::Arc;
 
@@ -43,6 +43,18 @@ impl<F> TlsAcceptorLayer<TlsClientConfigHandler<F>> {
     }
 }
 
+impl<H> TlsAcceptorLayer<H> {
+    /// Configure the [`ServerConfig`] of this layer to use the given [`TlsSessionResumption`],
+    /// such that returning clients can resume their session instead of doing a full handshake.
+    ///
+    /// Use the same [`TlsSessionResumption`] for all listeners
+    /// which should be able to resume each other's sessions.
+    pub fn with_session_resumption(mut self, resumption: &TlsSessionResumption) -> Self {
+        resumption.apply(Arc::make_mut(&mut self.config));
+        self
+    }
+}
+
 impl<H: Clone, S> Layer<S> for TlsAcceptorLayer<H> {
     type Service = TlsAcceptorService<S, H>;
 
@@ -24,3 +24,11 @@ pub use client_config::{IncomingClientHello, ServerConfigProvider, TlsClientConf
 mod layer;
 #[doc(inline)]
 pub use layer::TlsAcceptorLayer;
+
+mod session;
+#[doc(inline)]
+pub use session::TlsSessionResumption;
+
+mod config_cache;
+#[doc(inline)]
+pub use config_cache::ServerConfigCache;
@@ -0,0 +1,100 @@
+use crate::tls::rustls::dep::rustls::{
+    self,
+    server::{ProducesTickets, ServerSessionMemoryCache, StoresServerSessions},
+    ServerConfig,
+};
+use std::{fmt, sync::Arc};
+
+#[derive(Clone)]
+/// Session resumption state to be shared by [`ServerConfig`]s,
+/// such that returning clients can resume their session
+/// instead of going through a full handshake.
+///
+/// It combines:
+///
+/// - a ticketer (TLS 1.2 session tickets and TLS 1.3 stateless resumption),
+///   which by default encrypts tickets with keys that are rotated every 6 hours;
+/// - a bounded server-side session cache (TLS 1.2 session IDs and
+///   TLS 1.3 stateful resumption), used when no tickets are produced.
+///
+/// Clone it to share the same state across listeners
+/// and per-SNI [`ServerConfig`]s, e.g. using
+/// [`TlsAcceptorLayer::with_session_resumption`] and
+/// [`ServerConfigCache::with_session_resumption`].
+///
+/// [`TlsAcceptorLayer::with_session_resumption`]: crate::tls::rustls::server::TlsAcceptorLayer::with_session_resumption
+/// [`ServerConfigCache::with_session_resumption`]: crate::tls::rustls::server::ServerConfigCache::with_session_resumption
+pub struct TlsSessionResumption {
+    ticketer: Arc<dyn ProducesTickets>,
+    storage: Arc<dyn StoresServerSessions + Send + Sync>,
+}
+
+impl TlsSessionResumption {
+    /// The default amount of sessions stored in the server-side session cache.
+    pub const DEFAULT_SESSION_CACHE_SIZE: usize = 16 * 1024;
+
+    /// Create a new [`TlsSessionResumption`],
+    /// using a rotating ticketer and a session cache of the default size.
+    pub fn new() -> Result<Self, rustls::Error> {
+        Ok(Self {
+            ticketer: rustls::crypto::ring::Ticketer::new()?,
+            storage: ServerSessionMemoryCache::new(Self::DEFAULT_SESSION_CACHE_SIZE),
+        })
+    }
+
+    /// Use the given ticketer, e.g. one which shares its keys across processes.
+    pub fn with_ticketer(mut self, ticketer: Arc<dyn ProducesTickets>) -> Self {
+        self.ticketer = ticketer;
+        self
+    }
+
+    /// Replace the server-side session cache with an in-memory one
+    /// that stores at most the given amount of sessions.
+    pub fn with_session_cache_size(mut self, size: usize) -> Self {
+        self.storage = ServerSessionMemoryCache::new(size);
+        self
+    }
+
+    /// Use the given server-side session storage.
+    pub fn with_session_storage(
+        mut self,
+        storage: Arc<dyn StoresServerSessions + Send + Sync>,
+    ) -> Self {
+        self.storage = storage;
+        self
+    }
+
+    /// Configure the given [`ServerConfig`] to use this session resumption state.
+    pub fn apply(&self, config: &mut ServerConfig) {
+        config.ticketer = self.ticketer.clone();
+        config.session_storage = self.storage.clone();
+    }
+}
+
+impl fmt::Debug for TlsSessionResumption {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("TlsSessionResumption")
+            .field("ticketer", &self.ticketer)
+            .field("storage", &self.storage)
+            .finish()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_session_resumption_apply() {
+        let resumption = TlsSessionResumption::new().unwrap();
+        let mut config = ServerConfig::builder()
+            .with_no_client_auth()
+            .with_cert_resolver(Arc::new(rustls::server::ResolvesServerCertUsingSni::new()));
+        assert!(!config.ticketer.enabled());
+
+        resumption.apply(&mut config);
+        assert!(config.ticketer.enabled());
+        assert!(Arc::ptr_eq(&config.ticketer, &resumption.ticketer));
+        assert!(Arc::ptr_eq(&config.session_storage, &resumption.storage));
+    }
+}
@@ -1,8 +1,5 @@
 use crate::{
-    http::{
-        headers::{self, HeaderMapExt},
-        HeaderName, Request,
-    },
+    http::{header::USER_AGENT, HeaderName, Request},
     service::{Layer, Service},
 };
 use serde::{Deserialize, Serialize};
@@ -106,10 +103,13 @@ where
         mut ctx: crate::service::Context<State>,
         req: Request<Body>,
     ) -> impl Future<Output = Result<Self::Response, Self::Error>> + Send + '_ {
+        // parse the raw header value directly, as the typed header
+        // would only be formatted back into a string
         let mut user_agent = req
             .headers()
-            .typed_get::<headers::UserAgent>()
-            .map(|ua| UserAgent::new(ua.to_string()));
+            .get(USER_AGENT)
+            .and_then(|value| value.to_str().ok())
+            .map(UserAgent::new);
 
         if let Some(overwrites) = self
             .overwrite_header
@@ -39,26 +39,26 @@ pub(crate) fn parse_http_user_agent_header(header: String) -> UserAgent {
         ua
     };
 
-    let (kind, kind_version, maybe_platform) = if let Some(loc) =
-        contains_ignore_ascii_case(ua, "Firefox")
-    {
+    let tokens = Tokens::scan(ua);
+
+    let (kind, kind_version, maybe_platform) = if let Some(loc) = tokens.find(Token::Firefox) {
         let kind = UserAgentKind::Firefox;
         let kind_version = parse_ua_version_firefox_and_chromium(&ua[loc..]);
         (Some(kind), kind_version, None)
-    } else if let Some(loc) = contains_ignore_ascii_case(ua, "Chrom") {
+    } else if let Some(loc) = tokens.find(Token::Chrom) {
         let kind = UserAgentKind::Chromium;
         let kind_version = parse_ua_version_firefox_and_chromium(&ua[loc..]);
         (Some(kind), kind_version, None)
-    } else if contains_ignore_ascii_case(ua, "Safari").is_some() {
-        if let Some(firefox_loc) = contains_ignore_ascii_case(ua, "FxiOS") {
+    } else if tokens.contains(Token::Safari) {
+        if let Some(firefox_loc) = tokens.find(Token::FxiOS) {
             let kind = UserAgentKind::Firefox;
             let kind_version = parse_ua_version_firefox_and_chromium(&ua[firefox_loc..]);
             (Some(kind), kind_version, Some(PlatformKind::IOS))
-        } else if let Some(chrome_loc) = contains_ignore_ascii_case(ua, "CriOS") {
+        } else if let Some(chrome_loc) = tokens.find(Token::CriOS) {
             let kind = UserAgentKind::Chromium;
             let kind_version = parse_ua_version_firefox_and_chromium(&ua[chrome_loc..]);
             (Some(kind), kind_version, Some(PlatformKind::IOS))
-        } else if let Some(chromium_loc) = contains_any_ignore_ascii_case(ua, &["Opera"]) {
+        } else if let Some(chromium_loc) = tokens.find(Token::Opera) {
             let kind = UserAgentKind::Chromium;
             let kind_version = parse_ua_version_firefox_and_chromium(&ua[chromium_loc..]);
             (Some(kind), kind_version, None)
@@ -67,7 +67,7 @@ pub(crate) fn parse_http_user_agent_header(header: String) -> UserAgent {
             let kind_version = parse_ua_version_safari(ua);
             (Some(kind), kind_version, None)
         }
-    } else if contains_any_ignore_ascii_case(ua, &["Mobile", "Phone", "Tablet", "Zune"]).is_some() {
+    } else if tokens.contains_any(&[Token::Mobile, Token::Phone, Token::Tablet, Token::Zune]) {
         return UserAgent {
             header,
             data: UserAgentData::Device(DeviceKind::Mobile),
@@ -75,7 +75,7 @@ pub(crate) fn parse_http_user_agent_header(header: String) -> UserAgent {
             tls_agent_overwrite: None,
             preserve_ua_header: false,
         };
-    } else if contains_ignore_ascii_case(ua, "Desktop").is_some() {
+    } else if tokens.contains(Token::Desktop) {
         return UserAgent {
             header,
             data: UserAgentData::Device(DeviceKind::Desktop),
@@ -90,32 +90,30 @@ pub(crate) fn parse_http_user_agent_header(header: String) -> UserAgent {
     let maybe_platform = match maybe_platform {
         Some(platform) => Some(platform),
         None => {
-            if contains_ignore_ascii_case(ua, "Windows").is_some() {
-                if contains_ignore_ascii_case(ua, "X11").is_some() {
+            if tokens.contains(Token::Windows) {
+                if tokens.contains(Token::X11) {
                     None
                 } else {
                     Some(PlatformKind::Windows)
                 }
-            } else if contains_ignore_ascii_case(ua, "Android").is_some() {
-                if contains_ignore_ascii_case(ua, "iOS").is_some() {
+            } else if tokens.contains(Token::Android) {
+                if tokens.contains(Token::IOS) {
                     Some(PlatformKind::IOS)
                 } else {
                     Some(PlatformKind::Android)
                 }
-            } else if contains_ignore_ascii_case(ua, "Linux").is_some() {
-                if contains_any_ignore_ascii_case(ua, &["Mobile", "UCW"]).is_some() {
+            } else if tokens.contains(Token::Linux) {
+                if tokens.contains_any(&[Token::Mobile, Token::UCW]) {
                     Some(PlatformKind::Android)
                 } else {
                     Some(PlatformKind::Linux)
                 }
-            } else if contains_any_ignore_ascii_case(ua, &["iOS", "iPad", "iPod", "iPhone"])
-                .is_some()
-            {
+            } else if tokens.contains_any(&[Token::IOS, Token::IPad, Token::IPod, Token::IPhone]) {
                 Some(PlatformKind::IOS)
-            } else if contains_ignore_ascii_case(ua, "Mac").is_some() {
+            } else if tokens.contains(Token::Mac) {
                 Some(PlatformKind::MacOS)
-            } else if contains_ignore_ascii_case(ua, "Darwin").is_some() {
-                if contains_ignore_ascii_case(ua, "86").is_some() {
+            } else if tokens.contains(Token::Darwin) {
+                if tokens.contains(Token::X86) {
                     Some(PlatformKind::MacOS)
                 } else {
                     Some(PlatformKind::IOS)
@@ -154,6 +152,135 @@ pub(crate) fn parse_http_user_agent_header(header: String) -> UserAgent {
     }
 }
 
+/// Tokens of interest found in a User Agent string,
+/// matched case-insensitive.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Token {
+    Firefox,
+    Chrom,
+    Safari,
+    FxiOS,
+    CriOS,
+    Opera,
+    Mobile,
+    Phone,
+    Tablet,
+    Zune,
+    Desktop,
+    Windows,
+    X11,
+    Android,
+    IOS,
+    Linux,
+    UCW,
+    IPad,
+    IPod,
+    IPhone,
+    Mac,
+    Darwin,
+    X86,
+}
+
+impl Token {
+    const COUNT: usize = Token::X86 as usize + 1;
+
+    /// The lowercase pattern of the token.
+    fn pattern(self) -> &'static [u8] {
+        match self {
+            Token::Firefox => b"firefox",
+            Token::Chrom => b"chrom",
+            Token::Safari => b"safari",
+            Token::FxiOS => b"fxios",
+            Token::CriOS => b"crios",
+            Token::Opera => b"opera",
+            Token::Mobile => b"mobile",
+            Token::Phone => b"phone",
+            Token::Tablet => b"tablet",
+            Token::Zune => b"zune",
+            Token::Desktop => b"desktop",
+            Token::Windows => b"windows",
+            Token::X11 => b"x11",
+            Token::Android => b"android",
+            Token::IOS => b"ios",
+            Token::Linux => b"linux",
+            Token::UCW => b"ucw",
+            Token::IPad => b"ipad",
+            Token::IPod => b"ipod",
+            Token::IPhone => b"iphone",
+            Token::Mac => b"mac",
+            Token::Darwin => b"darwin",
+            Token::X86 => b"86",
+        }
+    }
+
+    /// The tokens of which the pattern starts with the given lowercase byte.
+    fn candidates(b: u8) -> &'static [Token] {
+        match b {
+            b'8' => &[Token::X86],
+            b'a' => &[Token::Android],
+            b'c' => &[Token::Chrom, Token::CriOS],
+            b'd' => &[Token::Desktop, Token::Darwin],
+            b'f' => &[Token::Firefox, Token::FxiOS],
+            b'i' => &[Token::IOS, Token::IPad, Token::IPod, Token::IPhone],
+            b'l' => &[Token::Linux],
+            b'm' => &[Token::Mobile, Token::Mac],
+            b'o' => &[Token::Opera],
+            b'p' => &[Token::Phone],
+            b's' => &[Token::Safari],
+            b't' => &[Token::Tablet],
+            b'u' => &[Token::UCW],
+            b'w' => &[Token::Windows],
+            b'x' => &[Token::X11],
+            b'z' => &[Token::Zune],
+            _ => &[],
+        }
+    }
+}
+
+/// The first location of every [`Token`] found in a User Agent string.
+///
+/// Found in a single pass over the string, dispatching on the first
+/// byte of each position, instead of searching the string per token.
+struct Tokens {
+    locations: [Option<usize>; Token::COUNT],
+}
+
+impl Tokens {
+    fn scan(ua: &str) -> Self {
+        let mut locations = [None; Token::COUNT];
+        let bytes = ua.as_bytes();
+        for (i, b) in bytes.iter().enumerate() {
+            for &token in Token::candidates(b.to_ascii_lowercase()) {
+                let location = &mut locations[token as usize];
+                if location.is_some() {
+                    continue;
+                }
+                let pattern = token.pattern();
+                if bytes[i..]
+                    .get(..pattern.len())
+                    .map(|s| s.eq_ignore_ascii_case(pattern))
+                    .unwrap_or_default()
+                {
+                    *location = Some(i);
+                }
+            }
+        }
+        Self { locations }
+    }
+
+    fn find(&self, token: Token) -> Option<usize> {
+        self.locations[token as usize]
+    }
+
+    fn contains(&self, token: Token) -> bool {
+        self.find(token).is_some()
+    }
+
+    fn contains_any(&self, tokens: &[Token]) -> bool {
+        tokens.iter().any(|token| self.contains(*token))
+    }
+}
+
 fn parse_ua_version_firefox_and_chromium(ua: &str) -> Option<usize> {
     ua.find('/').and_then(|i| {
         let start = i + 1;
@@ -178,6 +305,8 @@ fn parse_ua_version_safari(ua: &str) -> Option<usize> {
     })
 }
 
+// only used as the reference implementation in the tests of `Tokens::scan`
+#[cfg(test)]
 fn contains_ignore_ascii_case(s: &str, sub: &str) -> Option<usize> {
     let n = sub.len();
     if n > s.len() {
@@ -191,6 +320,7 @@ fn contains_ignore_ascii_case(s: &str, sub: &str) -> Option<usize> {
     })
 }
 
+#[cfg(test)]
 fn contains_any_ignore_ascii_case(s: &str, subs: &[&str]) -> Option<usize> {
     let max = s.len();
     let smallest_length = subs.iter().map(|s| s.len()).min().unwrap_or(0);
@@ -376,6 +506,58 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_tokens_scan() {
+        const TOKENS: [super::Token; super::Token::COUNT] = [
+            super::Token::Firefox,
+            super::Token::Chrom,
+            super::Token::Safari,
+            super::Token::FxiOS,
+            super::Token::CriOS,
+            super::Token::Opera,
+            super::Token::Mobile,
+            super::Token::Phone,
+            super::Token::Tablet,
+            super::Token::Zune,
+            super::Token::Desktop,
+            super::Token::Windows,
+            super::Token::X11,
+            super::Token::Android,
+            super::Token::IOS,
+            super::Token::Linux,
+            super::Token::UCW,
+            super::Token::IPad,
+            super::Token::IPod,
+            super::Token::IPhone,
+            super::Token::Mac,
+            super::Token::Darwin,
+            super::Token::X86,
+        ];
+
+        for ua in [
+            "",
+            "rama/0.2.0",
+            "Mozilla/5.0 (Windows NT 6.1; WOW64; rv:12.0) Gecko/20100101 Firefox/12.0",
+            "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36 OPR/109.0.0.0",
+            "Mozilla/5.0 (iPhone; CPU iPhone OS 17_4_1 like Mac OS X) AppleWebKit/605.1.15 (KHTML, like Gecko) CriOS/124.0.6367.111 Mobile/15E148 Safari/604.1",
+            "Mozilla/5.0 (Linux; U; Android 4.4.2; en-US; HM NOTE 1W Build/KOT49H) AppleWebKit/534.30 (KHTML, like Gecko) Version/4.0 UCBrowser/11.0.5.850 U3/0.8.0 Mobile Safari/534.30",
+            "Zune 4.7 DeskTop Darwin/X86 iPad iPod FxiOS tablet phone windows",
+            "åndroid ÄNDROID android ☃mac",
+        ] {
+            let tokens = super::Tokens::scan(ua);
+            for token in TOKENS {
+                let pattern = std::str::from_utf8(token.pattern()).unwrap();
+                assert_eq!(
+                    tokens.find(token),
+                    super::contains_ignore_ascii_case(ua, pattern),
+                    "token {:?} in '{}'",
+                    token,
+                    ua
+                );
+            }
+        }
+    }
+
     #[test]
     fn test_parse_ua_version_safari() {
         for (test_case, expected_version) in [
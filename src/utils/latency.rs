@@ -1,5 +1,13 @@
 //! latency utilities and common types
 
+use std::{
+    sync::{
+        atomic::{AtomicU64, Ordering},
+        Arc,
+    },
+    time::Duration,
+};
+
 /// The latency unit used to report latencies by various parts of the Rama codebase.
 #[non_exhaustive]
 #[derive(Copy, Clone, Debug)]
@@ -13,3 +21,309 @@ pub enum LatencyUnit {
     /// Use nanoseconds.
     Nanos,
 }
+
+/// Amount of bits used for the buckets per power of two microseconds.
+const SUB_BUCKET_BITS: u32 = 4;
+const SUB_BUCKETS: usize = 1 << SUB_BUCKET_BITS;
+
+/// Amount of buckets of a [`LatencyHistogram`].
+///
+/// Sixteen buckets per power of two microseconds, covering latencies of up to a few hours.
+const BUCKETS: usize = (35 - SUB_BUCKET_BITS as usize) * SUB_BUCKETS;
+
+/// A lock-free histogram of latencies, to estimate latency quantiles (e.g. the p95).
+///
+/// Latencies are recorded with microsecond precision in logarithmic buckets
+/// of about 6% relative width, such that estimated quantiles are at most
+/// that much above the actual latency quantile.
+///
+/// Once [`Self::with_window`] latencies are recorded (1000 by default), all counts are halved,
+/// such that estimated quantiles follow the recently observed latencies.
+/// The [minimum](Self::min) and [maximum](Self::max) are those of all recorded latencies.
+///
+/// Cloning the histogram shares its counts.
+#[derive(Debug, Clone)]
+pub struct LatencyHistogram {
+    inner: Arc<HistogramInner>,
+    window: u64,
+}
+
+#[derive(Debug)]
+struct HistogramInner {
+    buckets: [AtomicU64; BUCKETS],
+    recorded: AtomicU64,
+    /// sum of the counted latencies (in microseconds), halved together with the counts
+    sum: AtomicU64,
+    min: AtomicU64,
+    max: AtomicU64,
+}
+
+impl LatencyHistogram {
+    /// The default amount of latencies recorded before the counts are halved.
+    pub const DEFAULT_WINDOW: u64 = 1000;
+
+    /// Create a new, empty [`LatencyHistogram`].
+    pub fn new() -> Self {
+        Self {
+            inner: Arc::new(HistogramInner {
+                buckets: std::array::from_fn(|_| AtomicU64::new(0)),
+                recorded: AtomicU64::new(0),
+                sum: AtomicU64::new(0),
+                min: AtomicU64::new(u64::MAX),
+                max: AtomicU64::new(0),
+            }),
+            window: Self::DEFAULT_WINDOW,
+        }
+    }
+
+    /// Set the amount of latencies recorded before the counts are halved,
+    /// e.g. `u64::MAX` to count all latencies (such as for a benchmark).
+    pub fn with_window(mut self, window: u64) -> Self {
+        self.window = window.max(1);
+        self
+    }
+
+    /// Record an observed latency.
+    pub fn record(&self, latency: Duration) {
+        let micros = u64::try_from(latency.as_micros()).unwrap_or(u64::MAX);
+        self.inner.buckets[bucket_index(micros)].fetch_add(1, Ordering::Relaxed);
+        self.inner.sum.fetch_add(micros, Ordering::Relaxed);
+        self.inner.min.fetch_min(micros, Ordering::Relaxed);
+        self.inner.max.fetch_max(micros, Ordering::Relaxed);
+
+        if self
+            .inner
+            .recorded
+            .fetch_add(1, Ordering::Relaxed)
+            .saturating_add(1)
+            >= self.window
+        {
+            // racing recordings might be lost while decaying, which is fine for an estimate
+            self.inner.recorded.store(0, Ordering::Relaxed);
+            for counter in self.inner.buckets.iter().chain([&self.inner.sum]) {
+                let _ = counter.fetch_update(Ordering::Relaxed, Ordering::Relaxed, |count| {
+                    Some(count / 2)
+                });
+            }
+        }
+    }
+
+    /// Add the counted latencies of the other histogram to this histogram,
+    /// e.g. to combine the histograms recorded by multiple workers.
+    pub fn merge(&self, other: &Self) {
+        for (bucket, other) in self.inner.buckets.iter().zip(other.inner.buckets.iter()) {
+            bucket.fetch_add(other.load(Ordering::Relaxed), Ordering::Relaxed);
+        }
+        self.inner
+            .sum
+            .fetch_add(other.inner.sum.load(Ordering::Relaxed), Ordering::Relaxed);
+        self.inner
+            .min
+            .fetch_min(other.inner.min.load(Ordering::Relaxed), Ordering::Relaxed);
+        self.inner
+            .max
+            .fetch_max(other.inner.max.load(Ordering::Relaxed), Ordering::Relaxed);
+    }
+
+    /// Returns the amount of latencies currently counted.
+    pub fn count(&self) -> u64 {
+        self.inner
+            .buckets
+            .iter()
+            .map(|bucket| bucket.load(Ordering::Relaxed))
+            .sum()
+    }
+
+    /// Returns the lowest recorded latency, if any.
+    pub fn min(&self) -> Option<Duration> {
+        match self.inner.min.load(Ordering::Relaxed) {
+            u64::MAX if self.inner.max.load(Ordering::Relaxed) == 0 => None,
+            min => Some(Duration::from_micros(min)),
+        }
+    }
+
+    /// Returns the highest recorded latency, if any.
+    pub fn max(&self) -> Option<Duration> {
+        self.min()?;
+        Some(Duration::from_micros(
+            self.inner.max.load(Ordering::Relaxed),
+        ))
+    }
+
+    /// Returns the mean of the counted latencies.
+    ///
+    /// Returns `None` in case no latencies are counted.
+    pub fn mean(&self) -> Option<Duration> {
+        match self.count() {
+            0 => None,
+            count => Some(Duration::from_micros(
+                self.inner.sum.load(Ordering::Relaxed) / count,
+            )),
+        }
+    }
+
+    /// Estimate the standard deviation of the counted latencies.
+    ///
+    /// Returns `None` in case no latencies are counted.
+    pub fn stdev(&self) -> Option<Duration> {
+        let counts = self.load_counts();
+        let total: u64 = counts.iter().sum();
+        if total == 0 {
+            return None;
+        }
+        let mean = self.inner.sum.load(Ordering::Relaxed) as f64 / total as f64;
+        let max = self.inner.max.load(Ordering::Relaxed);
+        let variance = counts
+            .into_iter()
+            .enumerate()
+            .filter(|(_, count)| *count > 0)
+            .map(|(index, count)| {
+                let delta = bucket_upper_bound(index).min(max) as f64 - mean;
+                delta * delta * count as f64
+            })
+            .sum::<f64>()
+            / total as f64;
+        Some(Duration::from_micros(variance.sqrt() as u64))
+    }
+
+    /// Estimate the given quantile (e.g. `0.95` for the p95) of the counted latencies.
+    ///
+    /// Returns `None` in case no latencies are counted.
+    pub fn quantile(&self, quantile: f64) -> Option<Duration> {
+        self.quantile_with_min_samples(quantile, 1)
+    }
+
+    /// Estimate the given quantile (e.g. `0.95` for the p95) of the counted latencies,
+    /// in case at least `min_samples` latencies are counted.
+    ///
+    /// Unlike calling [`Self::count`] followed by [`Self::quantile`],
+    /// this reads the counts only once.
+    pub fn quantile_with_min_samples(&self, quantile: f64, min_samples: u64) -> Option<Duration> {
+        let counts = self.load_counts();
+        let total: u64 = counts.iter().sum();
+        if total == 0 || total < min_samples {
+            return None;
+        }
+
+        // no counted latency is above the recorded maximum
+        let max = self.inner.max.load(Ordering::Relaxed);
+        let target = ((total as f64) * quantile.clamp(0.0, 1.0)).ceil().max(1.0) as u64;
+        let mut seen = 0;
+        for (index, count) in counts.into_iter().enumerate() {
+            seen += count;
+            if seen >= target {
+                return Some(Duration::from_micros(bucket_upper_bound(index).min(max)));
+            }
+        }
+        Some(Duration::from_micros(max))
+    }
+
+    fn load_counts(&self) -> [u64; BUCKETS] {
+        std::array::from_fn(|index| self.inner.buckets[index].load(Ordering::Relaxed))
+    }
+}
+
+impl Default for LatencyHistogram {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+fn bucket_index(micros: u64) -> usize {
+    if micros < SUB_BUCKETS as u64 {
+        return micros as usize;
+    }
+    let bits = SUB_BUCKET_BITS as usize;
+    let exp = 63 - micros.leading_zeros() as usize;
+    let sub = ((micros >> (exp - bits)) as usize) & (SUB_BUCKETS - 1);
+    ((exp - bits + 1) * SUB_BUCKETS + sub).min(BUCKETS - 1)
+}
+
+fn bucket_upper_bound(index: usize) -> u64 {
+    if index < SUB_BUCKETS {
+        return index as u64;
+    }
+    let bits = SUB_BUCKET_BITS as usize;
+    let exp = index / SUB_BUCKETS + bits - 1;
+    let sub = (index % SUB_BUCKETS) as u64;
+    ((SUB_BUCKETS as u64 + sub + 1) << (exp - bits)) - 1
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_bucket_bounds() {
+        for micros in [0, 1, 3, 4, 7, 8, 9, 100, 1_000, 123_456, 10_000_000] {
+            let index = bucket_index(micros);
+            assert!(micros <= bucket_upper_bound(index), "micros: {micros}");
+            if index > 0 {
+                assert!(micros > bucket_upper_bound(index - 1), "micros: {micros}");
+            }
+        }
+        assert_eq!(bucket_index(u64::MAX), BUCKETS - 1);
+    }
+
+    #[test]
+    fn test_latency_histogram_quantile() {
+        let histogram = LatencyHistogram::new();
+        assert!(histogram.quantile(0.95).is_none());
+
+        for ms in 1..=100 {
+            histogram.record(Duration::from_millis(ms));
+        }
+        assert_eq!(histogram.count(), 100);
+        assert!(histogram.quantile_with_min_samples(0.95, 101).is_none());
+        assert_eq!(
+            histogram.quantile_with_min_samples(0.95, 100),
+            histogram.quantile(0.95)
+        );
+
+        let p95 = histogram.quantile(0.95).unwrap();
+        assert!(p95 >= Duration::from_millis(95), "p95: {p95:?}");
+        assert!(p95 <= Duration::from_millis(115), "p95: {p95:?}");
+
+        let p50 = histogram.quantile(0.5).unwrap();
+        assert!(p50 >= Duration::from_millis(50), "p50: {p50:?}");
+        assert!(p50 <= Duration::from_millis(60), "p50: {p50:?}");
+
+        assert_eq!(histogram.quantile(1.0), Some(Duration::from_millis(100)));
+    }
+
+    #[test]
+    fn test_latency_histogram_merge_and_stats() {
+        let histogram = LatencyHistogram::new().with_window(u64::MAX);
+        assert!(histogram.min().is_none());
+        assert!(histogram.max().is_none());
+        assert!(histogram.mean().is_none());
+        assert!(histogram.stdev().is_none());
+
+        for ms in 1..=100 {
+            histogram.record(Duration::from_millis(ms));
+        }
+        let other = LatencyHistogram::new();
+        other.record(Duration::from_secs(1));
+        histogram.merge(&other);
+
+        assert_eq!(histogram.count(), 101);
+        assert_eq!(histogram.min(), Some(Duration::from_millis(1)));
+        assert_eq!(histogram.max(), Some(Duration::from_secs(1)));
+        assert_eq!(histogram.mean(), Some(Duration::from_micros(59_900)));
+        assert_eq!(histogram.quantile(1.0), Some(Duration::from_secs(1)));
+
+        let stdev = histogram.stdev().unwrap().as_micros() as f64;
+        assert!((stdev - 95_600.0).abs() / 95_600.0 < 0.1, "stdev: {stdev}");
+    }
+
+    #[test]
+    fn test_latency_histogram_window() {
+        let histogram = LatencyHistogram::new().with_window(10);
+        for _ in 0..9 {
+            histogram.record(Duration::from_millis(1));
+        }
+        assert_eq!(histogram.count(), 9);
+        histogram.record(Duration::from_millis(1));
+        assert_eq!(histogram.count(), 5);
+    }
+}
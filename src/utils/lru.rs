@@ -0,0 +1,321 @@
+//! A bounded least recently used (LRU) map,
+//! shared by the in-memory caches of Rama.
+
+use std::{borrow::Borrow, collections::HashMap, fmt, hash::Hash};
+
+const NIL: usize = usize::MAX;
+
+/// A map bounded by an amount of entries and a total size,
+/// evicting the least recently used entries to make room for new ones.
+///
+/// Entries are stored in a dense slab, linked in order of use,
+/// such that lookups, insertions and evictions are all `O(1)`.
+/// The size of an entry is given by the caller when inserting it,
+/// e.g. its length in bytes, or `0` for a map bounded only by its amount of entries.
+pub(crate) struct LruCache<K, V> {
+    index: HashMap<K, usize>,
+    nodes: Vec<Node<K, V>>,
+    /// most recently used node
+    head: usize,
+    /// least recently used node
+    tail: usize,
+    capacity: usize,
+    max_size: usize,
+    size: usize,
+}
+
+struct Node<K, V> {
+    key: K,
+    value: V,
+    size: usize,
+    prev: usize,
+    next: usize,
+}
+
+impl<K, V> LruCache<K, V> {
+    /// Create a new [`LruCache`] holding at most `capacity` entries
+    /// and `max_size` in total size.
+    pub(crate) fn new(capacity: usize, max_size: usize) -> Self {
+        Self {
+            index: HashMap::new(),
+            nodes: Vec::new(),
+            head: NIL,
+            tail: NIL,
+            capacity,
+            max_size,
+            size: 0,
+        }
+    }
+
+    /// Returns the maximum amount of entries.
+    pub(crate) fn capacity(&self) -> usize {
+        self.capacity
+    }
+
+    /// Returns the maximum total size of all entries.
+    pub(crate) fn max_size(&self) -> usize {
+        self.max_size
+    }
+
+    /// Returns the amount of entries.
+    pub(crate) fn len(&self) -> usize {
+        self.nodes.len()
+    }
+
+    /// Returns `true` if there are no entries.
+    pub(crate) fn is_empty(&self) -> bool {
+        self.nodes.is_empty()
+    }
+
+    /// Returns the total size of all entries.
+    pub(crate) fn size(&self) -> usize {
+        self.size
+    }
+
+    /// Remove all entries.
+    pub(crate) fn clear(&mut self) {
+        self.index.clear();
+        self.nodes.clear();
+        self.head = NIL;
+        self.tail = NIL;
+        self.size = 0;
+    }
+
+    /// Returns the least recently used entry, without marking it as used.
+    pub(crate) fn peek_lru(&self) -> Option<(&K, &V)> {
+        self.nodes
+            .get(self.tail)
+            .map(|node| (&node.key, &node.value))
+    }
+
+    fn unlink(&mut self, index: usize) {
+        let (prev, next) = (self.nodes[index].prev, self.nodes[index].next);
+        match prev {
+            NIL => self.head = next,
+            prev => self.nodes[prev].next = next,
+        }
+        match next {
+            NIL => self.tail = prev,
+            next => self.nodes[next].prev = prev,
+        }
+    }
+
+    fn push_front(&mut self, index: usize) {
+        self.nodes[index].prev = NIL;
+        self.nodes[index].next = self.head;
+        match self.head {
+            NIL => self.tail = index,
+            head => self.nodes[head].prev = index,
+        }
+        self.head = index;
+    }
+}
+
+impl<K: Hash + Eq + Clone, V> LruCache<K, V> {
+    /// Set the maximum amount of entries,
+    /// evicting the least recently used entries which no longer fit.
+    pub(crate) fn set_capacity(&mut self, capacity: usize) {
+        self.capacity = capacity;
+        while self.nodes.len() > self.capacity {
+            self.pop_lru();
+        }
+    }
+
+    /// Set the maximum total size of all entries,
+    /// evicting the least recently used entries which no longer fit.
+    pub(crate) fn set_max_size(&mut self, max_size: usize) {
+        self.max_size = max_size;
+        while self.size > self.max_size {
+            self.pop_lru();
+        }
+    }
+
+    /// Returns the value for the given key, marking it as most recently used.
+    pub(crate) fn get<Q>(&mut self, key: &Q) -> Option<&mut V>
+    where
+        K: Borrow<Q>,
+        Q: Hash + Eq + ?Sized,
+    {
+        let index = *self.index.get(key)?;
+        if index != self.head {
+            self.unlink(index);
+            self.push_front(index);
+        }
+        Some(&mut self.nodes[index].value)
+    }
+
+    /// Returns the value for the given key, without marking it as used.
+    pub(crate) fn peek_mut<Q>(&mut self, key: &Q) -> Option<&mut V>
+    where
+        K: Borrow<Q>,
+        Q: Hash + Eq + ?Sized,
+    {
+        let index = *self.index.get(key)?;
+        Some(&mut self.nodes[index].value)
+    }
+
+    /// Insert the value for the given key as most recently used,
+    /// replacing the existing value, if any.
+    ///
+    /// The least recently used entries are evicted until the new entry fits.
+    /// Returns `false` in case the entry is too large to ever fit,
+    /// in which case it is not inserted (and a replaced value is still removed).
+    pub(crate) fn insert(&mut self, key: K, value: V, size: usize) -> bool {
+        if let Some(&index) = self.index.get(&key) {
+            self.remove_node(index);
+        }
+        if self.capacity == 0 || size > self.max_size {
+            return false;
+        }
+
+        while self.nodes.len() >= self.capacity || self.size + size > self.max_size {
+            if self.pop_lru().is_none() {
+                break;
+            }
+        }
+
+        let index = self.nodes.len();
+        self.index.insert(key.clone(), index);
+        self.nodes.push(Node {
+            key,
+            value,
+            size,
+            prev: NIL,
+            next: NIL,
+        });
+        self.size += size;
+        self.push_front(index);
+        true
+    }
+
+    /// Remove the entry for the given key, returning its value, if any.
+    pub(crate) fn remove<Q>(&mut self, key: &Q) -> Option<V>
+    where
+        K: Borrow<Q>,
+        Q: Hash + Eq + ?Sized,
+    {
+        let index = *self.index.get(key)?;
+        Some(self.remove_node(index).value)
+    }
+
+    /// Remove the least recently used entry, returning it, if any.
+    pub(crate) fn pop_lru(&mut self) -> Option<(K, V)> {
+        if self.tail == NIL {
+            return None;
+        }
+        let node = self.remove_node(self.tail);
+        Some((node.key, node.value))
+    }
+
+    fn remove_node(&mut self, index: usize) -> Node<K, V> {
+        self.unlink(index);
+        let node = self.nodes.swap_remove(index);
+        self.index.remove(&node.key);
+        self.size -= node.size;
+
+        if index < self.nodes.len() {
+            // the last node was moved into the freed slot, relink it
+            let (prev, next) = (self.nodes[index].prev, self.nodes[index].next);
+            match prev {
+                NIL => self.head = index,
+                prev => self.nodes[prev].next = index,
+            }
+            match next {
+                NIL => self.tail = index,
+                next => self.nodes[next].prev = index,
+            }
+            if let Some(slot) = self.index.get_mut(&self.nodes[index].key) {
+                *slot = index;
+            }
+        }
+
+        node
+    }
+}
+
+impl<K, V> fmt::Debug for LruCache<K, V> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("LruCache")
+            .field("capacity", &self.capacity)
+            .field("max_size", &self.max_size)
+            .field("len", &self.len())
+            .field("size", &self.size)
+            .finish()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn keys(cache: &LruCache<u32, u32>) -> Vec<u32> {
+        let mut keys = Vec::new();
+        let mut index = cache.head;
+        while index != NIL {
+            keys.push(cache.nodes[index].key);
+            index = cache.nodes[index].next;
+        }
+        keys
+    }
+
+    #[test]
+    fn test_lru_cache_evicts_least_recently_used() {
+        let mut cache = LruCache::new(3, usize::MAX);
+        for key in 0..3 {
+            assert!(cache.insert(key, key * 10, 0));
+        }
+        assert_eq!(keys(&cache), vec![2, 1, 0]);
+
+        assert_eq!(cache.get(&0).copied(), Some(0));
+        assert_eq!(keys(&cache), vec![0, 2, 1]);
+
+        assert!(cache.insert(3, 30, 0));
+        assert_eq!(keys(&cache), vec![3, 0, 2]);
+        assert!(cache.get(&1).is_none());
+        assert_eq!(cache.len(), 3);
+    }
+
+    #[test]
+    fn test_lru_cache_max_size() {
+        let mut cache = LruCache::new(usize::MAX, 10);
+        assert!(cache.insert(0, 0, 4));
+        assert!(cache.insert(1, 1, 4));
+        assert_eq!(cache.size(), 8);
+
+        assert!(cache.insert(2, 2, 4));
+        assert_eq!(keys(&cache), vec![2, 1]);
+        assert_eq!(cache.size(), 8);
+
+        assert!(!cache.insert(3, 3, 11));
+        assert_eq!(keys(&cache), vec![2, 1]);
+
+        cache.set_max_size(4);
+        assert_eq!(keys(&cache), vec![2]);
+        assert_eq!(cache.size(), 4);
+    }
+
+    #[test]
+    fn test_lru_cache_replace_and_remove() {
+        let mut cache = LruCache::new(4, usize::MAX);
+        for key in 0..4 {
+            assert!(cache.insert(key, key, 1));
+        }
+
+        assert!(cache.insert(1, 100, 2));
+        assert_eq!(keys(&cache), vec![1, 3, 2, 0]);
+        assert_eq!(cache.size(), 5);
+
+        assert_eq!(cache.remove(&3), Some(3));
+        assert_eq!(cache.remove(&3), None);
+        assert_eq!(keys(&cache), vec![1, 2, 0]);
+        assert_eq!(cache.peek_mut(&1).copied(), Some(100));
+        assert_eq!(cache.peek_lru(), Some((&0, &0)));
+
+        assert_eq!(cache.pop_lru(), Some((0, 0)));
+        assert_eq!(cache.pop_lru(), Some((2, 2)));
+        assert_eq!(cache.pop_lru(), Some((1, 100)));
+        assert_eq!(cache.pop_lru(), None);
+        assert!(cache.is_empty());
+        assert_eq!(cache.size(), 0);
+    }
+}
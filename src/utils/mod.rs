@@ -1,6 +1,7 @@
 //! Utilities in service of the Rama project.
 
 pub(crate) mod future;
+pub(crate) mod lru;
 
 #[macro_use]
 pub(crate) mod macros;